@@ -33,6 +33,9 @@
 #include "app_wifi.h"
 #include "app_storage.h"
 #include "app_priv.h"
+#include "app_report.h"
+#include "app_param_rmaker.h"
+#include "light_driver.h"
 
 static const char *TAG = "rainmaker";
 
@@ -40,6 +43,122 @@ esp_rmaker_device_t *light_device;
 
 extern const char ota_server_cert[] asm("_binary_server_crt_start");
 
+/* The params written within REPORT_WINDOW_MS are applied and reported together,
+ * at most once per REPORT_INTERVAL_MS */
+#define REPORT_WINDOW_MS    50
+#define REPORT_INTERVAL_MS  250
+
+static app_report_handle_t g_report = NULL;
+
+/**
+ * @brief Driver state of a report, filled by the handlers of its params
+ */
+typedef struct {
+    uint32_t hue;
+    uint32_t saturation;
+    uint32_t brightness;
+    bool     color_changed;
+} light_batch_t;
+
+static esp_err_t power_handler(const app_param_desc_t *desc, int32_t value, void *ctx)
+{
+    return app_light_set_power(value);
+}
+
+static esp_err_t brightness_handler(const app_param_desc_t *desc, int32_t value, void *ctx)
+{
+    light_batch_t *batch = (light_batch_t *)ctx;
+    batch->brightness = value;
+    batch->color_changed = true;
+    return ESP_OK;
+}
+
+static esp_err_t hue_handler(const app_param_desc_t *desc, int32_t value, void *ctx)
+{
+    light_batch_t *batch = (light_batch_t *)ctx;
+    batch->hue = value;
+    batch->color_changed = true;
+    return ESP_OK;
+}
+
+static esp_err_t saturation_handler(const app_param_desc_t *desc, int32_t value, void *ctx)
+{
+    light_batch_t *batch = (light_batch_t *)ctx;
+    batch->saturation = value;
+    batch->color_changed = true;
+    return ESP_OK;
+}
+
+/* The params of the light, created and dispatched from this list */
+static const app_param_desc_t g_light_params[] = {
+    {
+        .name = ESP_RMAKER_DEF_POWER_NAME,
+        .type = ESP_RMAKER_PARAM_POWER,
+        .is_bool = true,
+        .def = DEFAULT_POWER,
+        .handler = power_handler,
+    },
+    {
+        .name = ESP_RMAKER_DEF_BRIGHTNESS_NAME,
+        .type = ESP_RMAKER_PARAM_BRIGHTNESS,
+        .ui_type = ESP_RMAKER_UI_SLIDER,
+        .def = DEFAULT_BRIGHTNESS,
+        .max = 100,
+        .handler = brightness_handler,
+    },
+    {
+        .name = ESP_RMAKER_DEF_HUE_NAME,
+        .type = ESP_RMAKER_PARAM_HUE,
+        .ui_type = "esp.ui.hue-circle",
+        .def = DEFAULT_HUE,
+        .max = 360,
+        .handler = hue_handler,
+    },
+    {
+        .name = ESP_RMAKER_DEF_SATURATION_NAME,
+        .type = ESP_RMAKER_PARAM_SATURATION,
+        .ui_type = ESP_RMAKER_UI_SLIDER,
+        .def = DEFAULT_SATURATION,
+        .max = 100,
+        .handler = saturation_handler,
+    },
+};
+
+static app_param_table_handle_t g_param_table = NULL;
+
+/* Apply the latest value of each param at once, then report them in one publish */
+static esp_err_t report_flush_cb(const app_report_update_t *updates, size_t num, void *arg)
+{
+    light_batch_t batch = {
+        .hue        = light_driver_get_hue(),
+        .saturation = light_driver_get_saturation(),
+        .brightness = light_driver_get_value(),
+    };
+
+    for (int i = 0; i < num; i++) {
+        app_param_dispatch(g_param_table, updates[i].param, updates[i].value, &batch);
+    }
+
+    /* One fade and one NVS write for the three of them */
+    if (batch.color_changed) {
+        app_light_set(batch.hue, batch.saturation, batch.brightness);
+    }
+
+    for (int i = 0; i < num; i++) {
+        const app_param_desc_t *desc = app_param_table_find(g_param_table, updates[i].param);
+        esp_rmaker_param_val_t val = desc->is_bool ? esp_rmaker_bool(updates[i].value) : esp_rmaker_int(updates[i].value);
+
+        /* The last one reports all the params updated before it */
+        if (i < num - 1) {
+            esp_rmaker_param_update(updates[i].param, val);
+        } else {
+            esp_rmaker_param_update_and_report(updates[i].param, val);
+        }
+    }
+
+    return ESP_OK;
+}
+
 /* Callback to handle commands received from the RainMaker cloud */
 static esp_err_t write_cb(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param,
             const esp_rmaker_param_val_t val, void *priv_data, esp_rmaker_write_ctx_t *ctx)
@@ -47,30 +166,19 @@ static esp_err_t write_cb(const esp_rmaker_device_t *device, const esp_rmaker_pa
     if (ctx) {
         ESP_LOGI(TAG, "Received write request via : %s", esp_rmaker_device_cb_src_to_str(ctx->src));
     }
-    const char *device_name = esp_rmaker_device_get_name(device);
-    const char *param_name = esp_rmaker_param_get_name(param);
-    if (strcmp(param_name, ESP_RMAKER_DEF_POWER_NAME) == 0) {
-        ESP_LOGI(TAG, "Received value = %s for %s - %s",
-                val.val.b? "true" : "false", device_name, param_name);
-        app_light_set_power(val.val.b);
-    } else if (strcmp(param_name, ESP_RMAKER_DEF_BRIGHTNESS_NAME) == 0) {
-        ESP_LOGI(TAG, "Received value = %d for %s - %s",
-                val.val.i, device_name, param_name);
-        app_light_set_brightness(val.val.i);
-    } else if (strcmp(param_name, ESP_RMAKER_DEF_HUE_NAME) == 0) {
-        ESP_LOGI(TAG, "Received value = %d for %s - %s",
-                val.val.i, device_name, param_name);
-        app_light_set_hue(val.val.i);
-    } else if (strcmp(param_name, ESP_RMAKER_DEF_SATURATION_NAME) == 0) {
-        ESP_LOGI(TAG, "Received value = %d for %s - %s",
-                val.val.i, device_name, param_name);
-        app_light_set_saturation(val.val.i);
-    } else {
+
+    /* Bound when the params were created, no name to compare */
+    const app_param_desc_t *desc = app_param_table_find(g_param_table, param);
+    if (!desc) {
         /* Silently ignoring invalid params */
         return ESP_OK;
     }
-    esp_rmaker_param_update_and_report(param, val);
-    return ESP_OK;
+
+    int32_t value = desc->is_bool ? val.val.b : val.val.i;
+    ESP_LOGI(TAG, "Received value = %d for %s - %s", (int)value, esp_rmaker_device_get_name(device), desc->name);
+
+    /* Applied and reported by report_flush_cb(), with the params that follow it */
+    return app_report_update(g_report, (void *)param, value);
 }
 
 void app_main()
@@ -110,18 +218,19 @@ void app_main()
         abort();
     }
 
+    const app_report_config_t report_cfg = {
+        .window_ms       = REPORT_WINDOW_MS,
+        .min_interval_ms = REPORT_INTERVAL_MS,
+        .flush_cb        = report_flush_cb,
+    };
+    ESP_ERROR_CHECK(app_report_create(&report_cfg, &g_report));
+
     /* Create a device and add the relevant parameters to it */
     light_device = esp_rmaker_lightbulb_device_create("Light", NULL, DEFAULT_POWER);
     esp_rmaker_device_add_cb(light_device, write_cb, NULL);
 
-    esp_rmaker_device_add_param(light_device, esp_rmaker_brightness_param_create(ESP_RMAKER_DEF_BRIGHTNESS_NAME, DEFAULT_BRIGHTNESS));
-    
-    // esp_rmaker_device_add_param(light_device, esp_rmaker_hue_param_create(ESP_RMAKER_DEF_HUE_NAME, DEFAULT_HUE));
-    esp_rmaker_param_t *hue_param = esp_rmaker_hue_param_create(ESP_RMAKER_DEF_HUE_NAME, DEFAULT_HUE);
-    esp_rmaker_param_add_ui_type(hue_param, "esp.ui.hue-circle");
-    esp_rmaker_device_add_param(light_device, hue_param);
-
-    esp_rmaker_device_add_param(light_device, esp_rmaker_saturation_param_create(ESP_RMAKER_DEF_SATURATION_NAME, DEFAULT_SATURATION));
+    ESP_ERROR_CHECK(app_param_table_create(g_light_params, sizeof(g_light_params) / sizeof(g_light_params[0]), &g_param_table));
+    ESP_ERROR_CHECK(app_param_rmaker_add(g_param_table, light_device));
 
     esp_rmaker_node_add_device(node, light_device);
 
@@ -146,8 +255,8 @@ void app_main()
 
     /* Start the Wi-Fi.
      * If the node is provisioned, it will start connection attempts,
-     * else, it will start Wi-Fi provisioning. The function will return
-     * after a connection has been successfully established
+     * else, it will start Wi-Fi provisioning. The function returns right
+     * away, the connection is made in the background
      */
     err = app_wifi_start(POP_TYPE_RANDOM);
     if (err != ESP_OK) {
@@ -158,6 +267,14 @@ void app_main()
 
     while (1) {
         ESP_LOGI(TAG, "[%02d] Hello world!", i++);
+
+        app_report_stats_t report_stats;
+        if (app_report_get_stats(g_report, &report_stats) == ESP_OK && report_stats.sent_count) {
+            ESP_LOGI(TAG, "%u param writes, %u reports, latency mean %u ms max %u ms",
+                     (unsigned)report_stats.update_count, (unsigned)report_stats.publish_count,
+                     (unsigned)(report_stats.latency_sum_us / report_stats.sent_count / 1000),
+                     (unsigned)(report_stats.latency_max_us / 1000));
+        }
         vTaskDelay(pdMS_TO_TICKS(5000));
     }
 }
@@ -45,6 +45,8 @@ void app_driver_init()
         .gpio_button_config = {
             .gpio_num     = LIGHT_BUTTON_GPIO,
             .active_level = LIGHT_BUTTON_ACTIVE_LEVEL,
+            /* Only scan the button after a press, so it does not keep the chip out of light sleep */
+            .enable_power_save = true,
         },
     };
     button_handle_t btn_handle = iot_button_create(&btn_cfg);
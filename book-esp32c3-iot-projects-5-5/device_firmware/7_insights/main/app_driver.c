@@ -15,6 +15,7 @@
 
 #include "iot_button.h"
 #include "light_driver.h"
+#include "app_boot.h"
 
 #include <esp_rmaker_utils.h>
 
@@ -31,6 +32,15 @@ static bool g_power = DEFAULT_POWER;
 static int g_brightness = DEFAULT_BRIGHTNESS;
 static int g_hue = DEFAULT_HUE;
 static int g_saturation = DEFAULT_SATURATION;
+static app_light_change_cb_t g_change_cb = NULL;
+
+/* Only the attributes that changed, the metrics are recorded from there */
+static void app_light_notify(app_light_attr_t attr, int old_value, int value)
+{
+    if (g_change_cb && old_value != value) {
+        g_change_cb(attr, value);
+    }
+}
 
 static void push_btn_cb(void *arg)
 {
@@ -42,6 +52,16 @@ static void factory_reset_trigger(void *arg)
     esp_rmaker_factory_reset(0, REBOOT_DELAY);
 }
 
+/* The light is only kept awake while it moves, a static light sleeps with the chip */
+static void light_activity_cb(bool active, void *arg)
+{
+    if (active) {
+        app_pm_acquire(APP_PM_LIGHT);
+    } else {
+        app_pm_release(APP_PM_LIGHT);
+    }
+}
+
 void app_driver_init()
 {
     /* Configure push button */
@@ -50,6 +70,8 @@ void app_driver_init()
         .gpio_button_config = {
             .gpio_num     = LIGHT_BUTTON_GPIO,
             .active_level = LIGHT_BUTTON_ACTIVE_LEVEL,
+            /* Only scan the button after a press, so it does not keep the chip out of light sleep */
+            .enable_power_save = true,
         },
     };
     button_handle_t btn_handle = iot_button_create(&btn_cfg);
@@ -72,11 +94,18 @@ void app_driver_init()
         .fade_period_ms  = LIGHT_FADE_PERIOD_MS,
         .blink_period_ms = LIGHT_BLINK_PERIOD_MS,
         .freq_hz         = LIGHT_FREQ_HZ,
+#if CONFIG_PM_ENABLE
+        /* APB changes with DFS and stops in light sleep, RC_FAST keeps the duty without a lock */
+        .clk_cfg         = LEDC_USE_RC_FAST_CLK,
+#else
         .clk_cfg         = LEDC_USE_APB_CLK,
+#endif
         .duty_resolution = LEDC_TIMER_11_BIT,
     };
+    iot_led_set_activity_cb(light_activity_cb, NULL);
     ESP_ERROR_CHECK(light_driver_init(&driver_config));
     app_light_set_power(true);
+    app_boot_mark("light_on");
 }
 
 int IRAM_ATTR app_driver_set_state(bool state)
@@ -86,12 +115,11 @@ int IRAM_ATTR app_driver_set_state(bool state)
         if (g_output_state) {
             // light on
             ESP_LOGI(TAG, "Light ON");
-            light_driver_set_switch(true);
         } else {
             // light off
             ESP_LOGI(TAG, "Light OFF");
-            light_driver_set_switch(false);
         }
+        app_light_set_power(g_output_state);
     }
     return ESP_OK;
 }
@@ -101,26 +129,27 @@ bool app_driver_get_state(void)
     return g_output_state;
 }
 
+void app_driver_set_change_cb(app_light_change_cb_t cb)
+{
+    g_change_cb = cb;
+}
+
 esp_err_t app_light_set_power(bool power)
 {
+    app_light_notify(APP_LIGHT_POWER, g_power, power);
     g_power = power;
-    if (power) {
-        // PM Lock
-        app_pm_lock_acquire();
-        // light on
-        light_driver_set_switch(true);
-    } else {
-        // light off
-        light_driver_set_switch(false);
-        // PM UnLock
-        app_pm_lock_release();
-    }
+    g_output_state = power;
+    /* The PM lock follows the fade, see light_activity_cb() */
+    light_driver_set_switch(power);
     return ESP_OK;
 }
 bool app_light_get_power() { return g_power; } 
 
 esp_err_t app_light_set(uint32_t hue, uint32_t saturation, uint32_t brightness)
 {
+    app_light_notify(APP_LIGHT_BRIGHTNESS, g_brightness, brightness);
+    app_light_notify(APP_LIGHT_HUE, g_hue, hue);
+    app_light_notify(APP_LIGHT_SATURATION, g_saturation, saturation);
     g_brightness = brightness;
     g_hue = hue;
     g_saturation = saturation;
@@ -129,18 +158,21 @@ esp_err_t app_light_set(uint32_t hue, uint32_t saturation, uint32_t brightness)
 
 esp_err_t app_light_set_brightness(uint16_t brightness)
 {
+    app_light_notify(APP_LIGHT_BRIGHTNESS, g_brightness, brightness);
     g_brightness = brightness;
     return light_driver_set_value(brightness);
 }
 
 esp_err_t app_light_set_hue(uint16_t hue)
 {
+    app_light_notify(APP_LIGHT_HUE, g_hue, hue);
     g_hue = hue;
     return light_driver_set_hue(hue);
 }
 
 esp_err_t app_light_set_saturation(uint16_t saturation)
 {
+    app_light_notify(APP_LIGHT_SATURATION, g_saturation, saturation);
     g_saturation = saturation;
     return light_driver_set_saturation(saturation);
 }
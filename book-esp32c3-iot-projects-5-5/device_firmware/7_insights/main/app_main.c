@@ -18,6 +18,7 @@
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 
 #include "lwip/sockets.h"
@@ -33,7 +34,11 @@
 #include "app_wifi.h"
 #include "app_storage.h"
 #include "app_priv.h"
+#include "app_report.h"
+#include "app_param_rmaker.h"
+#include "app_metrics.h"
 #include "app_insights.h"
+#include "app_boot.h"
 
 #include "esp_diagnostics_metrics.h"
 
@@ -43,6 +48,155 @@ esp_rmaker_device_t *light_device;
 
 extern const char ota_server_cert[] asm("_binary_server_crt_start");
 
+/* The params written within REPORT_WINDOW_MS are applied and reported together,
+ * at most once per REPORT_INTERVAL_MS */
+#define REPORT_WINDOW_MS    50
+#define REPORT_INTERVAL_MS  250
+
+static app_report_handle_t g_report = NULL;
+
+/**
+ * @brief Driver state of a report, filled by the handlers of its params
+ */
+typedef struct {
+    uint32_t hue;
+    uint32_t saturation;
+    uint32_t brightness;
+    bool     color_changed;
+} light_batch_t;
+
+static esp_err_t power_handler(const app_param_desc_t *desc, int32_t value, void *ctx)
+{
+    return app_light_set_power(value);
+}
+
+static esp_err_t brightness_handler(const app_param_desc_t *desc, int32_t value, void *ctx)
+{
+    light_batch_t *batch = (light_batch_t *)ctx;
+    batch->brightness = value;
+    batch->color_changed = true;
+    return ESP_OK;
+}
+
+static esp_err_t hue_handler(const app_param_desc_t *desc, int32_t value, void *ctx)
+{
+    light_batch_t *batch = (light_batch_t *)ctx;
+    batch->hue = value;
+    batch->color_changed = true;
+    return ESP_OK;
+}
+
+static esp_err_t saturation_handler(const app_param_desc_t *desc, int32_t value, void *ctx)
+{
+    light_batch_t *batch = (light_batch_t *)ctx;
+    batch->saturation = value;
+    batch->color_changed = true;
+    return ESP_OK;
+}
+
+/* Driver getters of the sampled params */
+static int32_t power_get(void)
+{
+    return app_light_get_power();
+}
+
+static int32_t brightness_get(void)
+{
+    return app_light_get_brightness();
+}
+
+static int32_t hue_get(void)
+{
+    return app_light_get_hue();
+}
+
+static int32_t saturation_get(void)
+{
+    return app_light_get_saturation();
+}
+
+/* The params of the light, created, dispatched and recorded from this list */
+static const app_param_desc_t g_light_params[APP_LIGHT_ATTR_MAX] = {
+    [APP_LIGHT_POWER] = {
+        .name = ESP_RMAKER_DEF_POWER_NAME,
+        .type = ESP_RMAKER_PARAM_POWER,
+        .is_bool = true,
+        .def = DEFAULT_POWER,
+        .handler = power_handler,
+        .get = power_get,
+        .metric_key = "power",
+        .metric_path = "light.power",
+    },
+    [APP_LIGHT_BRIGHTNESS] = {
+        .name = ESP_RMAKER_DEF_BRIGHTNESS_NAME,
+        .type = ESP_RMAKER_PARAM_BRIGHTNESS,
+        .ui_type = ESP_RMAKER_UI_SLIDER,
+        .def = DEFAULT_BRIGHTNESS,
+        .max = 100,
+        .handler = brightness_handler,
+        .get = brightness_get,
+        .metric_key = "brightness",
+        .metric_path = "light.brightness",
+    },
+    [APP_LIGHT_HUE] = {
+        .name = ESP_RMAKER_DEF_HUE_NAME,
+        .type = ESP_RMAKER_PARAM_HUE,
+        .ui_type = ESP_RMAKER_UI_HUE_SLIDER,
+        .def = DEFAULT_HUE,
+        .max = 360,
+        .handler = hue_handler,
+        .get = hue_get,
+        .metric_key = "hue",
+        .metric_path = "light.hue",
+    },
+    [APP_LIGHT_SATURATION] = {
+        .name = ESP_RMAKER_DEF_SATURATION_NAME,
+        .type = ESP_RMAKER_PARAM_SATURATION,
+        .ui_type = ESP_RMAKER_UI_SLIDER,
+        .def = DEFAULT_SATURATION,
+        .max = 100,
+        .handler = saturation_handler,
+        .get = saturation_get,
+        .metric_key = "saturation",
+        .metric_path = "light.saturation",
+    },
+};
+
+static app_param_table_handle_t g_param_table = NULL;
+
+/* Apply the latest value of each param at once, then report them in one publish */
+static esp_err_t report_flush_cb(const app_report_update_t *updates, size_t num, void *arg)
+{
+    light_batch_t batch = {
+        .hue        = app_light_get_hue(),
+        .saturation = app_light_get_saturation(),
+        .brightness = app_light_get_brightness(),
+    };
+
+    for (int i = 0; i < num; i++) {
+        app_param_dispatch(g_param_table, updates[i].param, updates[i].value, &batch);
+    }
+
+    /* One fade and one NVS write for the three of them */
+    if (batch.color_changed) {
+        app_light_set(batch.hue, batch.saturation, batch.brightness);
+    }
+
+    for (int i = 0; i < num; i++) {
+        const app_param_desc_t *desc = app_param_table_find(g_param_table, updates[i].param);
+        esp_rmaker_param_val_t val = desc->is_bool ? esp_rmaker_bool(updates[i].value) : esp_rmaker_int(updates[i].value);
+
+        /* The last one reports all the params updated before it */
+        if (i < num - 1) {
+            esp_rmaker_param_update(updates[i].param, val);
+        } else {
+            esp_rmaker_param_update_and_report(updates[i].param, val);
+        }
+    }
+
+    return ESP_OK;
+}
+
 /* Callback to handle commands received from the RainMaker cloud */
 static esp_err_t write_cb(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param,
             const esp_rmaker_param_val_t val, void *priv_data, esp_rmaker_write_ctx_t *ctx)
@@ -50,72 +204,158 @@ static esp_err_t write_cb(const esp_rmaker_device_t *device, const esp_rmaker_pa
     if (ctx) {
         ESP_LOGI(TAG, "Received write request via : %s", esp_rmaker_device_cb_src_to_str(ctx->src));
     }
-    const char *device_name = esp_rmaker_device_get_name(device);
-    const char *param_name = esp_rmaker_param_get_name(param);
-    if (strcmp(param_name, ESP_RMAKER_DEF_POWER_NAME) == 0) {
-        ESP_LOGI(TAG, "Received value = %s for %s - %s",
-                val.val.b? "true" : "false", device_name, param_name);
-        app_light_set_power(val.val.b);
-    } else if (strcmp(param_name, ESP_RMAKER_DEF_BRIGHTNESS_NAME) == 0) {
-        ESP_LOGI(TAG, "Received value = %d for %s - %s",
-                val.val.i, device_name, param_name);
-        app_light_set_brightness(val.val.i);
-    } else if (strcmp(param_name, ESP_RMAKER_DEF_HUE_NAME) == 0) {
-        ESP_LOGI(TAG, "Received value = %d for %s - %s",
-                val.val.i, device_name, param_name);
-        app_light_set_hue(val.val.i);
-    } else if (strcmp(param_name, ESP_RMAKER_DEF_SATURATION_NAME) == 0) {
-        ESP_LOGI(TAG, "Received value = %d for %s - %s",
-                val.val.i, device_name, param_name);
-        app_light_set_saturation(val.val.i);
-    } else {
+
+    /* Bound when the params were created, no name to compare */
+    const app_param_desc_t *desc = app_param_table_find(g_param_table, param);
+    if (!desc) {
         /* Silently ignoring invalid params */
         return ESP_OK;
     }
-    esp_rmaker_param_update_and_report(param, val);
-    return ESP_OK;
+
+    int32_t value = desc->is_bool ? val.val.b : val.val.i;
+    ESP_LOGI(TAG, "Received value = %d for %s - %s", (int)value, esp_rmaker_device_get_name(device), desc->name);
+
+    /* Applied and reported by report_flush_cb(), with the params that follow it */
+    return app_report_update(g_report, (void *)param, value);
 }
 
-void light_metrics_task(void *arg)
+/* A light metric is recorded when it changes, the heartbeat keeps a static light on the dashboard */
+#define LIGHT_METRICS_HEARTBEAT_MS  (5 * 60 * 1000)
+#define SYSTEM_METRICS_PERIOD_MS    15000
+
+static const app_metric_config_t g_light_metric_configs[APP_LIGHT_ATTR_MAX] = {
+    [APP_LIGHT_POWER]      = {.deadband = 0, .min_interval_ms = 0,    .heartbeat_ms = LIGHT_METRICS_HEARTBEAT_MS},
+    [APP_LIGHT_BRIGHTNESS] = {.deadband = 2, .min_interval_ms = 1000, .heartbeat_ms = LIGHT_METRICS_HEARTBEAT_MS},
+    [APP_LIGHT_HUE]        = {.deadband = 5, .min_interval_ms = 1000, .heartbeat_ms = LIGHT_METRICS_HEARTBEAT_MS},
+    [APP_LIGHT_SATURATION] = {.deadband = 2, .min_interval_ms = 1000, .heartbeat_ms = LIGHT_METRICS_HEARTBEAT_MS},
+};
+
+static app_metrics_handle_t g_light_metrics = NULL;
+
+static esp_err_t light_metrics_record_cb(size_t index, int32_t value, void *arg)
 {
-    while (1) {
-        esp_diag_metrics_add_bool("power", app_light_get_power());
-        esp_diag_metrics_add_uint("brightness", app_light_get_brightness());
-        esp_diag_metrics_add_uint("hue", app_light_get_hue());
-        esp_diag_metrics_add_uint("saturation", app_light_get_saturation());
+    const app_param_desc_t *desc = &g_light_params[index];
+
+    return desc->is_bool ? esp_diag_metrics_add_bool(desc->metric_key, value) :
+                           esp_diag_metrics_add_uint(desc->metric_key, value);
+}
+
+static void light_change_cb(app_light_attr_t attr, int value)
+{
+    app_metrics_update(g_light_metrics, attr, value);
+}
+
+static esp_err_t light_metrics_start(void)
+{
+    int32_t initial[APP_LIGHT_ATTR_MAX];
+
+    for (int i = 0; i < APP_LIGHT_ATTR_MAX; i++) {
+        esp_diag_metrics_register("light", g_light_params[i].metric_key, g_light_params[i].name, g_light_params[i].metric_path,
+                                  g_light_params[i].is_bool ? ESP_DIAG_DATA_TYPE_BOOL : ESP_DIAG_DATA_TYPE_UINT);
+        initial[i] = g_light_params[i].get();
+    }
+
+    esp_err_t err = app_metrics_create(g_light_metric_configs, initial, APP_LIGHT_ATTR_MAX,
+                                       light_metrics_record_cb, NULL, &g_light_metrics);
 
-        vTaskDelay(pdMS_TO_TICKS(15000));
+    if (err == ESP_OK) {
+        app_driver_set_change_cb(light_change_cb);
     }
+
+    return err;
 }
 
-void app_main()
+/* The counters that only make sense per period, from the esp_timer task */
+static void system_metrics_cb(void *arg)
 {
-    int i = 0;
-    esp_err_t err = ESP_OK;
-    ESP_LOGE(TAG, "app_main");
+    static uint32_t wifi_connect_count = 0;
+    static uint64_t pm_held_us[APP_PM_SUBSYS_MAX] = {0};
+    static app_report_stats_t last_report = {0};
+
+    /* One time-to-IP sample per connection */
+    app_wifi_stats_t wifi_stats;
+    if (app_wifi_get_stats(&wifi_stats) == ESP_OK && wifi_stats.connect_count != wifi_connect_count) {
+        wifi_connect_count = wifi_stats.connect_count;
+        esp_diag_metrics_add_uint("time_to_ip", wifi_stats.time_to_ip_ms);
+    }
+
+    /* Reports sent over the last period and their mean latency */
+    app_report_stats_t report_stats;
+    if (app_report_get_stats(g_report, &report_stats) == ESP_OK && report_stats.sent_count != last_report.sent_count) {
+        esp_diag_metrics_add_uint("report_publish", report_stats.publish_count - last_report.publish_count);
+        esp_diag_metrics_add_uint("report_latency", (uint32_t)((report_stats.latency_sum_us - last_report.latency_sum_us) /
+                                                              (report_stats.sent_count - last_report.sent_count) / 1000));
+        last_report = report_stats;
+    }
+
+    /* Time each PM lock was held over the last period */
+    for (int i = 0; i < APP_PM_SUBSYS_MAX; i++) {
+        app_pm_stats_t pm_stats;
+        app_pm_get_stats(i, &pm_stats);
+        esp_diag_metrics_add_uint(app_pm_subsys_name(i), (uint32_t)((pm_stats.held_us - pm_held_us[i]) / 1000));
+        pm_held_us[i] = pm_stats.held_us;
+    }
+}
+
+static esp_err_t system_metrics_start(void)
+{
+    esp_timer_handle_t timer = NULL;
+    const esp_timer_create_args_t timer_args = {
+        .callback = system_metrics_cb,
+        .name     = "system_metrics",
+    };
+
+    esp_err_t err = esp_timer_create(&timer_args, &timer);
+
+    if (err == ESP_OK) {
+        err = esp_timer_start_periodic(timer, SYSTEM_METRICS_PERIOD_MS * 1000);
+    }
 
+    return err;
+}
+
+/**
+ * @brief Stages of the init graph, see g_boot_stages
+ */
+static esp_err_t boot_storage_init(void)
+{
     /**
      * @brief NVS Flash initialization
      */
     ESP_LOGI(TAG, "NVS Flash initialization");
-    app_storage_init();
+    return app_storage_init();
+}
 
+static esp_err_t boot_pm_init(void)
+{
     /**
-     * @brief Power Manager initialization
+     * @brief Power Manager initialization, fails without CONFIG_PM_ENABLE which is not an error
      */
     app_pm_init();
-    
+    return ESP_OK;
+}
+
+static esp_err_t boot_driver_init(void)
+{
     /**
      * @brief Application driver initialization
      */
     ESP_LOGI(TAG, "Application driver initialization");
     app_driver_init();
+    return ESP_OK;
+}
 
+static esp_err_t boot_wifi_init(void)
+{
     /**
      * @brief Initialize Wi-Fi. Note that, this should be called before esp_rmaker_init()
      */
     app_wifi_init();
-    
+    return ESP_OK;
+}
+
+static esp_err_t boot_rmaker_init(void)
+{
     /**
      * @brief Initialize the ESP RainMaker Agent.
      * Note that this should be called after app_wifi_init() but before app_wifi_start()
@@ -125,18 +365,29 @@ void app_main()
     };
     esp_rmaker_node_t *node = esp_rmaker_node_init(&rainmaker_cfg, "ESP RainMaker Device", "Lightbulb");
     if (!node) {
-        ESP_LOGE(TAG, "Could not initialise node. Aborting!!!");
-        vTaskDelay(pdMS_TO_TICKS(5000));
-        abort();
+        ESP_LOGE(TAG, "Could not initialise node.");
+        return ESP_FAIL;
+    }
+
+    const app_report_config_t report_cfg = {
+        .window_ms       = REPORT_WINDOW_MS,
+        .min_interval_ms = REPORT_INTERVAL_MS,
+        .flush_cb        = report_flush_cb,
+    };
+    if (app_report_create(&report_cfg, &g_report) != ESP_OK) {
+        ESP_LOGE(TAG, "Could not create the param report.");
+        return ESP_FAIL;
     }
 
     /* Create a device and add the relevant parameters to it */
     light_device = esp_rmaker_lightbulb_device_create("Light", NULL, DEFAULT_POWER);
     esp_rmaker_device_add_cb(light_device, write_cb, NULL);
 
-    esp_rmaker_device_add_param(light_device, esp_rmaker_brightness_param_create(ESP_RMAKER_DEF_BRIGHTNESS_NAME, DEFAULT_BRIGHTNESS));
-    esp_rmaker_device_add_param(light_device, esp_rmaker_hue_param_create(ESP_RMAKER_DEF_HUE_NAME, DEFAULT_HUE));
-    esp_rmaker_device_add_param(light_device, esp_rmaker_saturation_param_create(ESP_RMAKER_DEF_SATURATION_NAME, DEFAULT_SATURATION));
+    if (app_param_table_create(g_light_params, sizeof(g_light_params) / sizeof(g_light_params[0]), &g_param_table) != ESP_OK ||
+        app_param_rmaker_add(g_param_table, light_device) != ESP_OK) {
+        ESP_LOGE(TAG, "Could not add the light params.");
+        return ESP_FAIL;
+    }
 
     esp_rmaker_node_add_device(node, light_device);
 
@@ -162,24 +413,87 @@ void app_main()
     /* Start the ESP RainMaker Agent */
     esp_rmaker_start();
     
-    esp_diag_metrics_register("light", "power", "Power", "light.power", ESP_DIAG_DATA_TYPE_BOOL);
-    esp_diag_metrics_register("light", "brightness", "Brightness", "light.brightness", ESP_DIAG_DATA_TYPE_UINT);
-    esp_diag_metrics_register("light", "hue", "Hue", "light.hue", ESP_DIAG_DATA_TYPE_UINT);
-    esp_diag_metrics_register("light", "saturation", "Saturation", "light.saturation", ESP_DIAG_DATA_TYPE_UINT);
+    if (light_metrics_start() != ESP_OK) {
+        ESP_LOGE(TAG, "Could not create the light metrics.");
+        return ESP_FAIL;
+    }
+
+    esp_diag_metrics_register("wifi", "time_to_ip", "Time to IP (ms)", "wifi.time_to_ip", ESP_DIAG_DATA_TYPE_UINT);
+    esp_diag_metrics_register("report", "report_publish", "Param reports published", "report.publish", ESP_DIAG_DATA_TYPE_UINT);
+    esp_diag_metrics_register("report", "report_latency", "Param write to report (ms)", "report.latency", ESP_DIAG_DATA_TYPE_UINT);
+    esp_diag_metrics_register("pm", app_pm_subsys_name(APP_PM_LIGHT), "Light PM lock held (ms per 15 s)", "pm.lock", ESP_DIAG_DATA_TYPE_UINT);
+    esp_diag_metrics_register("pm", app_pm_subsys_name(APP_PM_WIFI), "Wi-Fi PM lock held (ms per 15 s)", "pm.lock", ESP_DIAG_DATA_TYPE_UINT);
+    return ESP_OK;
+}
 
+static esp_err_t boot_wifi_start(void)
+{
     /* Start the Wi-Fi.
      * If the node is provisioned, it will start connection attempts,
-     * else, it will start Wi-Fi provisioning. The function will return
-     * after a connection has been successfully established
+     * else, it will start Wi-Fi provisioning. The function returns right
+     * away, the connection is made in the background
      */
-    err = app_wifi_start(POP_TYPE_RANDOM);
+    app_pm_track_wifi();
+    return app_wifi_start(POP_TYPE_RANDOM);
+}
+
+enum {
+    BOOT_STORAGE,
+    BOOT_PM,
+    BOOT_DRIVER,
+    BOOT_WIFI_INIT,
+    BOOT_RMAKER,
+    BOOT_WIFI_START,
+};
+
+/* The light comes on while Wi-Fi initializes. RainMaker reads the light's
+ * state for its params and metrics and hooks the driver's change callback,
+ * so it waits for the driver too */
+static const app_boot_stage_t g_boot_stages[] = {
+    [BOOT_STORAGE]    = {"storage",    boot_storage_init, 0},
+    [BOOT_PM]         = {"pm",         boot_pm_init,      0},
+    [BOOT_DRIVER]     = {"driver",     boot_driver_init,  APP_BOOT_AFTER(BOOT_STORAGE) | APP_BOOT_AFTER(BOOT_PM)},
+    [BOOT_WIFI_INIT]  = {"wifi_init",  boot_wifi_init,    APP_BOOT_AFTER(BOOT_STORAGE)},
+    [BOOT_RMAKER]     = {"rmaker",     boot_rmaker_init,  APP_BOOT_AFTER(BOOT_WIFI_INIT) | APP_BOOT_AFTER(BOOT_DRIVER)},
+    [BOOT_WIFI_START] = {"wifi_start", boot_wifi_start,   APP_BOOT_AFTER(BOOT_RMAKER) | APP_BOOT_AFTER(BOOT_DRIVER)},
+};
+
+/* One metric per stage in ms, its duration, or its time for a mark or a skipped stage */
+static void boot_report_metrics(void)
+{
+    const app_boot_record_t *records = NULL;
+    size_t record_num = app_boot_get_records(&records);
+
+    for (int i = 0; i < record_num; i++) {
+        int64_t time_us = records[i].end_us > records[i].begin_us ? records[i].end_us - records[i].begin_us : records[i].begin_us;
+
+        esp_diag_metrics_register("boot", records[i].name, records[i].name, "boot", ESP_DIAG_DATA_TYPE_UINT);
+        esp_diag_metrics_add_uint(records[i].name, (uint32_t)(time_us / 1000));
+    }
+}
+
+void app_main()
+{
+    int i = 0;
+    esp_err_t err = ESP_OK;
+    ESP_LOGE(TAG, "app_main");
+
+    err = app_boot_run(g_boot_stages, sizeof(g_boot_stages) / sizeof(g_boot_stages[0]));
+    app_boot_dump();
+
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Could not start Wifi. Aborting!!!");
+        ESP_LOGE(TAG, "Could not start. Aborting!!!");
         vTaskDelay(pdMS_TO_TICKS(5000));
         abort();
     }
 
-    xTaskCreate(light_metrics_task, "light_metrics_task", 4096, NULL, 5, NULL);
+    boot_report_metrics();
+
+    system_metrics_start();
+
+#if CONFIG_APP_PM_MEASURE
+    app_pm_measure_start();
+#endif
     
     while (1) {
         ESP_LOGI(TAG, "[%02d] Hello world!", i++);
@@ -150,8 +150,8 @@ void app_main()
 
     /* Start the Wi-Fi.
      * If the node is provisioned, it will start connection attempts,
-     * else, it will start Wi-Fi provisioning. The function will return
-     * after a connection has been successfully established
+     * else, it will start Wi-Fi provisioning. The function returns right
+     * away, the connection is made in the background
      */
     err = app_wifi_start(POP_TYPE_RANDOM);
     if (err != ESP_OK) {
@@ -7,20 +7,171 @@
 */
 
 #include <stdio.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #include "esp_log.h"
 #include "esp_pm.h"
+#include "esp_timer.h"
+#include "esp_event.h"
+#include "esp_wifi.h"
 
 #include "app_priv.h"
 
-#if CONFIG_PM_ENABLE
-
 #define LIGHT_EXAMPLE_MAX_CPU_FREQ_MHZ (80)
 #define LIGHT_EXAMPLE_MIN_CPU_FREQ_MHZ (10)
 
+/* Held after the IP to cover the TLS handshake of the MQTT connection */
+#define APP_PM_WIFI_TAIL_MS            (5000)
+
 static const char *TAG = "app-pm";
-static bool g_pm_lock_acquired = false;
-static esp_pm_lock_handle_t g_pm_apb_lock = NULL;
+
+/**
+ * @brief A subsystem that holds the chip awake while it is busy
+ */
+typedef struct {
+    const char          *name;
+    esp_pm_lock_type_t   type;
+    esp_pm_lock_handle_t handle;
+    uint32_t             count;     /**< Reference count of the holders */
+    int64_t              since_us;  /**< Time the count went from 0 to 1 */
+    app_pm_stats_t       stats;
+} app_pm_lock_t;
+
+/* The light only needs the tick on time while it moves, Wi-Fi the CPU while it handshakes */
+static app_pm_lock_t g_pm_locks[APP_PM_SUBSYS_MAX] = {
+    [APP_PM_LIGHT] = {.name = "l_light", .type = ESP_PM_NO_LIGHT_SLEEP},
+    [APP_PM_WIFI]  = {.name = "l_wifi",  .type = ESP_PM_CPU_FREQ_MAX},
+};
+static portMUX_TYPE g_pm_spinlock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t g_wifi_tail_timer = NULL;
+static bool g_wifi_burst = false;
+
+esp_err_t app_pm_acquire(app_pm_subsys_t subsys)
+{
+    if (subsys >= APP_PM_SUBSYS_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    app_pm_lock_t *lock = &g_pm_locks[subsys];
+
+    portENTER_CRITICAL(&g_pm_spinlock);
+
+    if (lock->count++ == 0) {
+        lock->since_us = esp_timer_get_time();
+        lock->stats.acquire_count++;
+
+#if CONFIG_PM_ENABLE
+        if (lock->handle) {
+            esp_pm_lock_acquire(lock->handle);
+        }
+#endif
+    }
+
+    portEXIT_CRITICAL(&g_pm_spinlock);
+
+    return ESP_OK;
+}
+
+esp_err_t app_pm_release(app_pm_subsys_t subsys)
+{
+    if (subsys >= APP_PM_SUBSYS_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    app_pm_lock_t *lock = &g_pm_locks[subsys];
+    esp_err_t ret = ESP_OK;
+
+    portENTER_CRITICAL(&g_pm_spinlock);
+
+    if (lock->count == 0) {
+        ret = ESP_ERR_INVALID_STATE;
+    } else if (--lock->count == 0) {
+        uint64_t held_us = esp_timer_get_time() - lock->since_us;
+        lock->stats.held_us += held_us;
+        lock->stats.held_max_us = MAX(lock->stats.held_max_us, held_us);
+
+#if CONFIG_PM_ENABLE
+        if (lock->handle) {
+            esp_pm_lock_release(lock->handle);
+        }
+#endif
+    }
+
+    portEXIT_CRITICAL(&g_pm_spinlock);
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "%s released more than acquired", lock->name);
+    }
+
+    return ret;
+}
+
+esp_err_t app_pm_get_stats(app_pm_subsys_t subsys, app_pm_stats_t *stats)
+{
+    if (subsys >= APP_PM_SUBSYS_MAX || !stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    app_pm_lock_t *lock = &g_pm_locks[subsys];
+
+    portENTER_CRITICAL(&g_pm_spinlock);
+    *stats = lock->stats;
+    stats->count = lock->count;
+
+    /* Include the time of the hold in progress */
+    if (lock->count) {
+        stats->held_us += esp_timer_get_time() - lock->since_us;
+    }
+
+    portEXIT_CRITICAL(&g_pm_spinlock);
+
+    return ESP_OK;
+}
+
+const char *app_pm_subsys_name(app_pm_subsys_t subsys)
+{
+    return subsys < APP_PM_SUBSYS_MAX ? g_pm_locks[subsys].name : "unknown";
+}
+
+/**
+ * @brief A Wi-Fi burst lasts from the association to a while after the IP
+ */
+static void app_pm_wifi_burst(bool busy)
+{
+    /* The spinlock nests, the events and the tail timer cannot reorder acquire and release */
+    portENTER_CRITICAL(&g_pm_spinlock);
+
+    if (g_wifi_burst != busy) {
+        g_wifi_burst = busy;
+        busy ? app_pm_acquire(APP_PM_WIFI) : app_pm_release(APP_PM_WIFI);
+    }
+
+    portEXIT_CRITICAL(&g_pm_spinlock);
+}
+
+static void app_pm_wifi_tail_cb(void *arg)
+{
+    app_pm_wifi_burst(false);
+}
+
+static void app_pm_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        esp_timer_stop(g_wifi_tail_timer);
+        app_pm_wifi_burst(true);
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        /* Waiting for the next attempt, the Wi-Fi driver holds its own locks while it scans */
+        esp_timer_stop(g_wifi_tail_timer);
+        app_pm_wifi_burst(false);
+    } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+        esp_timer_stop(g_wifi_tail_timer);
+        esp_timer_start_once(g_wifi_tail_timer, APP_PM_WIFI_TAIL_MS * 1000);
+    }
+}
 
 esp_err_t app_pm_init()
 {
@@ -42,55 +193,141 @@ esp_err_t app_pm_init()
 #endif
     };
     ESP_ERROR_CHECK( esp_pm_configure(&pm_config) );
-#endif // CONFIG_PM_ENABLE
 
-    if (g_pm_apb_lock == NULL) {
-        if (esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "l_apb", &g_pm_apb_lock) != ESP_OK) {
-            ESP_LOGE(TAG, "esp pm lock l_apb create failed");
+    for (int i = 0; i < APP_PM_SUBSYS_MAX; i++) {
+        if (g_pm_locks[i].handle == NULL &&
+            esp_pm_lock_create(g_pm_locks[i].type, 0, g_pm_locks[i].name, &g_pm_locks[i].handle) != ESP_OK) {
+            ESP_LOGE(TAG, "esp pm lock %s create failed", g_pm_locks[i].name);
         }
     }
+#endif // CONFIG_PM_ENABLE
 
+    if (g_wifi_tail_timer == NULL) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = app_pm_wifi_tail_cb,
+            .name     = "pm_wifi_tail",
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&timer_args, &g_wifi_tail_timer));
+    }
+
+#if CONFIG_PM_ENABLE
     return ESP_OK;
+#else
+    /* The subsystems are still accounted for, there is just no lock to take */
+    return ESP_FAIL;
+#endif
 }
 
-esp_err_t app_pm_lock_acquire()
+esp_err_t app_pm_track_wifi(void)
 {
-    if (!g_pm_lock_acquired) {
-        ESP_ERROR_CHECK(esp_pm_lock_acquire(g_pm_apb_lock));
-        g_pm_lock_acquired = true;
-    } else {
-        ESP_LOGI(TAG, "already acquire");
+    if (g_wifi_tail_timer == NULL) {
+        return ESP_ERR_INVALID_STATE;
     }
+
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, app_pm_event_handler, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, app_pm_event_handler, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, app_pm_event_handler, NULL));
     return ESP_OK;
 }
 
-esp_err_t app_pm_lock_release()
+#if CONFIG_APP_PM_MEASURE
+
+/**
+ * @brief A step of the scripted session, the action is run once at its start
+ */
+typedef struct {
+    const char *name;
+    void (*action)(void);
+    uint32_t    duration_ms;
+} app_pm_step_t;
+
+static void measure_on(void)
 {
-    if (g_pm_lock_acquired) {
-        ESP_ERROR_CHECK(esp_pm_lock_release(g_pm_apb_lock));
-        g_pm_lock_acquired = false;
-    } else {
-        ESP_LOGI(TAG, "already release");
-    }
+    app_light_set_power(true);
+}
 
-    return ESP_OK;
+static void measure_off(void)
+{
+    app_light_set_power(false);
 }
 
-#else
+static void measure_dim(void)
+{
+    app_light_set_brightness(10);
+}
 
-esp_err_t app_pm_init()
+static void measure_bright(void)
 {
-    return ESP_FAIL;
+    app_light_set_brightness(100);
 }
 
-esp_err_t app_pm_lock_acquire()
+static void measure_color(void)
 {
-    return ESP_FAIL;
+    app_light_set_hue((app_light_get_hue() + 120) % 360);
 }
 
-esp_err_t app_pm_lock_release()
+static void measure_idle(void)
 {
-    return ESP_FAIL;
 }
 
-#endif // CONFIG_PM_ENABLE
+static const app_pm_step_t g_measure_steps[] = {
+    {"on",     measure_on,     2000},
+    {"static", measure_idle,   10000},
+    {"dim",    measure_dim,    2000},
+    {"bright", measure_bright, 2000},
+    {"color",  measure_color,  2000},
+    {"static", measure_idle,   10000},
+    {"off",    measure_off,    2000},
+    {"dark",   measure_idle,   10000},
+    {"on",     measure_on,     2000},
+};
+
+static void app_pm_measure_task(void *arg)
+{
+    app_pm_stats_t before[APP_PM_SUBSYS_MAX];
+    app_pm_stats_t after;
+
+    ESP_LOGI(TAG, "PM measurement: %d steps", (int)(sizeof(g_measure_steps) / sizeof(g_measure_steps[0])));
+
+    for (int i = 0; i < sizeof(g_measure_steps) / sizeof(g_measure_steps[0]); i++) {
+        const app_pm_step_t *step = &g_measure_steps[i];
+
+        for (int j = 0; j < APP_PM_SUBSYS_MAX; j++) {
+            app_pm_get_stats(j, &before[j]);
+        }
+
+        step->action();
+        vTaskDelay(pdMS_TO_TICKS(step->duration_ms));
+
+        /* Held time of each lock over the step, the full table comes from esp_pm */
+        for (int j = 0; j < APP_PM_SUBSYS_MAX; j++) {
+            app_pm_get_stats(j, &after);
+            uint64_t held_ms = (after.held_us - before[j].held_us) / 1000;
+            ESP_LOGI(TAG, "[%d] %-7s %-8s held %5u of %5u ms (%3u%%), acquired %u times", i, step->name,
+                     g_pm_locks[j].name, (unsigned)held_ms, (unsigned)step->duration_ms,
+                     (unsigned)(held_ms * 100 / step->duration_ms),
+                     (unsigned)(after.acquire_count - before[j].acquire_count));
+        }
+
+#if CONFIG_PM_ENABLE
+        esp_pm_dump_locks(stdout);
+#endif
+    }
+
+    ESP_LOGI(TAG, "PM measurement done");
+    vTaskDelete(NULL);
+}
+
+esp_err_t app_pm_measure_start(void)
+{
+    return xTaskCreate(app_pm_measure_task, "pm_measure", 4096, NULL, 4, NULL) == pdPASS ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+#else
+
+esp_err_t app_pm_measure_start(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif // CONFIG_APP_PM_MEASURE
@@ -98,20 +98,84 @@ esp_err_t app_light_set_saturation(uint16_t saturation);
  */
 int  app_light_get_saturation();
 
+/**
+ * @brief Attributes of the light, the index of their param and metric
+ */
+typedef enum {
+    APP_LIGHT_POWER,
+    APP_LIGHT_BRIGHTNESS,
+    APP_LIGHT_HUE,
+    APP_LIGHT_SATURATION,
+    APP_LIGHT_ATTR_MAX,
+} app_light_attr_t;
+
+typedef void (*app_light_change_cb_t)(app_light_attr_t attr, int value);
+
+/**
+ * @brief Be told of every change of the light, from the cloud, the button or the PM measurement
+ *
+ * @note  Called from the task of the setter, before the driver fades to the new value
+ */
+void app_driver_set_change_cb(app_light_change_cb_t cb);
+
+/**
+ * @brief Subsystems that hold the chip awake while they are busy, each with its own PM lock
+ */
+typedef enum {
+    APP_PM_LIGHT,   /**< A fade, blink or timeline runs */
+    APP_PM_WIFI,    /**< From the association to a while after the IP */
+    APP_PM_SUBSYS_MAX,
+} app_pm_subsys_t;
+
+typedef struct {
+    uint32_t count;           /**< Holders right now */
+    uint32_t acquire_count;   /**< Times the lock was taken from 0 holders */
+    uint64_t held_us;         /**< Total time held, including the hold in progress */
+    uint64_t held_max_us;     /**< Longest hold */
+} app_pm_stats_t;
+
+/**
+ * @brief Configure DFS and light sleep, and create the locks of the subsystems
+ *
+ * @return ESP_FAIL without CONFIG_PM_ENABLE, the subsystems are still accounted for
+ */
 esp_err_t app_pm_init();
 
 /**
- * @brief 
- * 
- * @return esp_err_t 
+ * @brief Hold the lock of a subsystem while it is busy, Wi-Fi is tracked by the driver events
+ *
+ * @note  Reference counted, callable from the esp_timer task
  */
-esp_err_t app_pm_lock_acquire();
+esp_err_t app_pm_acquire(app_pm_subsys_t subsys);
 
 /**
- * @brief 
- * 
- * @return esp_err_t 
+ * @brief Drop one hold of a subsystem, its lock is released with the last one
+ *
+ * @return ESP_ERR_INVALID_STATE if it was not held
+ */
+esp_err_t app_pm_release(app_pm_subsys_t subsys);
+
+/**
+ * @brief Get the lock held-time statistics of a subsystem
+ */
+esp_err_t app_pm_get_stats(app_pm_subsys_t subsys, app_pm_stats_t *stats);
+
+/**
+ * @brief Name of the PM lock of a subsystem, as shown by esp_pm_dump_locks()
+ */
+const char *app_pm_subsys_name(app_pm_subsys_t subsys);
+
+/**
+ * @brief Hold APP_PM_WIFI through the Wi-Fi bursts, after app_pm_init() and app_wifi_init()
+ */
+esp_err_t app_pm_track_wifi(void);
+
+/**
+ * @brief Run the scripted usage session of CONFIG_APP_PM_MEASURE and log the held time
+ *        of every lock over each of its steps, followed by esp_pm_dump_locks()
+ *
+ * @return ESP_ERR_NOT_SUPPORTED without CONFIG_APP_PM_MEASURE
  */
-esp_err_t app_pm_lock_release();
+esp_err_t app_pm_measure_start(void);
 
 #endif /**< __APP_PRIVATE_H__ */
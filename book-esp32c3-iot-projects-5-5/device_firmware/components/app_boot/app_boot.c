@@ -0,0 +1,281 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "string.h"
+#include "stdio.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "app_boot.h"
+
+static const char *TAG = "app_boot";
+
+static app_boot_record_t g_boot_records[CONFIG_APP_BOOT_RECORD_MAX] = {0};
+static size_t g_boot_record_num = 0;
+static portMUX_TYPE g_boot_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief An init graph being run, shared by the caller and the workers
+ */
+typedef struct {
+    const app_boot_stage_t *stages;
+    size_t             stage_num;
+    uint32_t           started;    /**< Stages taken by a task */
+    uint32_t           failed;     /**< Stages failed or skipped */
+    esp_err_t          err;
+    SemaphoreHandle_t  lock;
+    EventGroupHandle_t done;       /**< Bit i: stage i is over */
+    SemaphoreHandle_t  exited;     /**< Given by each worker on its way out */
+} app_boot_graph_t;
+
+static void app_boot_record(const char *name, int64_t begin_us, int64_t end_us, esp_err_t err)
+{
+    portENTER_CRITICAL(&g_boot_lock);
+
+    if (g_boot_record_num < CONFIG_APP_BOOT_RECORD_MAX) {
+        app_boot_record_t *record = &g_boot_records[g_boot_record_num++];
+        record->name     = name;
+        record->begin_us = begin_us;
+        record->end_us   = end_us;
+        record->err      = err;
+    }
+
+    portEXIT_CRITICAL(&g_boot_lock);
+}
+
+void app_boot_begin(const char *name)
+{
+    app_boot_record(name, esp_timer_get_time(), 0, ESP_OK);
+}
+
+void app_boot_mark(const char *name)
+{
+    int64_t now = esp_timer_get_time();
+    app_boot_record(name, now, now, ESP_OK);
+}
+
+void app_boot_end(const char *name, esp_err_t err)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&g_boot_lock);
+
+    for (int i = g_boot_record_num - 1; i >= 0; i--) {
+        if (!g_boot_records[i].end_us && !strcmp(g_boot_records[i].name, name)) {
+            g_boot_records[i].end_us = now;
+            g_boot_records[i].err    = err;
+            break;
+        }
+    }
+
+    portEXIT_CRITICAL(&g_boot_lock);
+}
+
+esp_err_t app_boot_get(const char *name, app_boot_record_t *record)
+{
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    portENTER_CRITICAL(&g_boot_lock);
+
+    for (int i = g_boot_record_num - 1; i >= 0; i--) {
+        if (!strcmp(g_boot_records[i].name, name)) {
+            *record = g_boot_records[i];
+            ret = ESP_OK;
+            break;
+        }
+    }
+
+    portEXIT_CRITICAL(&g_boot_lock);
+
+    return ret;
+}
+
+size_t app_boot_get_records(const app_boot_record_t **records)
+{
+    *records = g_boot_records;
+    return g_boot_record_num;
+}
+
+void app_boot_clear(void)
+{
+    portENTER_CRITICAL(&g_boot_lock);
+    g_boot_record_num = 0;
+    portEXIT_CRITICAL(&g_boot_lock);
+}
+
+void app_boot_dump(void)
+{
+    ESP_LOGI(TAG, "%-20s %10s %10s %10s", "stage (ms)", "begin", "end", "time");
+
+    for (int i = 0; i < g_boot_record_num; i++) {
+        const app_boot_record_t *record = &g_boot_records[i];
+        int64_t time_us = record->end_us - record->begin_us;
+
+        if (record->begin_us == record->end_us) {
+            ESP_LOGI(TAG, "%-20s %6d.%03d %s", record->name,
+                     (int)(record->begin_us / 1000), (int)(record->begin_us % 1000),
+                     record->err == ESP_OK ? "" : "skipped");
+        } else if (!record->end_us) {
+            ESP_LOGI(TAG, "%-20s %6d.%03d    running", record->name,
+                     (int)(record->begin_us / 1000), (int)(record->begin_us % 1000));
+        } else {
+            ESP_LOGI(TAG, "%-20s %6d.%03d %6d.%03d %6d.%03d %s", record->name,
+                     (int)(record->begin_us / 1000), (int)(record->begin_us % 1000),
+                     (int)(record->end_us / 1000), (int)(record->end_us % 1000),
+                     (int)(time_us / 1000), (int)(time_us % 1000),
+                     record->err == ESP_OK ? "" : esp_err_to_name(record->err));
+        }
+    }
+}
+
+/**
+ * @brief Run the stages that are ready until none is left to start
+ */
+static void app_boot_work(app_boot_graph_t *graph)
+{
+    const uint32_t all = (1UL << graph->stage_num) - 1;
+
+    for (;;) {
+        const app_boot_stage_t *stage = NULL;
+        uint32_t bit = 0;
+
+        xSemaphoreTake(graph->lock, portMAX_DELAY);
+        uint32_t done = xEventGroupGetBits(graph->done) & all;
+
+        for (int i = 0; i < graph->stage_num && !stage; i++) {
+            if (!(graph->started & APP_BOOT_AFTER(i)) && (graph->stages[i].after & done) == graph->stages[i].after) {
+                stage = &graph->stages[i];
+                bit = APP_BOOT_AFTER(i);
+                graph->started |= bit;
+            }
+        }
+
+        uint32_t started = graph->started;
+        bool skip = stage && (stage->after & graph->failed);
+        xSemaphoreGive(graph->lock);
+
+        if (!stage) {
+            if (started == all) {
+                return;
+            }
+
+            /**< Nothing ready, wait for one of the running stages */
+            xEventGroupWaitBits(graph->done, started & ~done, pdFALSE, pdFALSE, portMAX_DELAY);
+            continue;
+        }
+
+        esp_err_t err = ESP_ERR_INVALID_STATE;
+
+        if (skip) {
+            int64_t now = esp_timer_get_time();
+            app_boot_record(stage->name, now, now, err);
+            ESP_LOGW(TAG, "%s skipped, a stage it needs failed", stage->name);
+        } else {
+            app_boot_begin(stage->name);
+            err = stage->init();
+            app_boot_end(stage->name, err);
+
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "%s failed, err: %s", stage->name, esp_err_to_name(err));
+            }
+        }
+
+        if (err != ESP_OK) {
+            xSemaphoreTake(graph->lock, portMAX_DELAY);
+            graph->failed |= bit;
+            graph->err = graph->err == ESP_OK ? err : graph->err;
+            xSemaphoreGive(graph->lock);
+        }
+
+        xEventGroupSetBits(graph->done, bit);
+    }
+}
+
+static void app_boot_worker_task(void *arg)
+{
+    app_boot_graph_t *graph = (app_boot_graph_t *)arg;
+
+    app_boot_work(graph);
+    xSemaphoreGive(graph->exited);
+    vTaskDelete(NULL);
+}
+
+esp_err_t app_boot_run(const app_boot_stage_t *stages, size_t stage_num)
+{
+    if (!stages || !stage_num || stage_num > APP_BOOT_STAGE_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (int i = 0; i < stage_num; i++) {
+        /**< Only earlier stages, so the graph has no cycle */
+        if (!stages[i].init || (stages[i].after >> i)) {
+            ESP_LOGE(TAG, "stage %d is invalid", i);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    app_boot_graph_t graph = {
+        .stages    = stages,
+        .stage_num = stage_num,
+        .err       = ESP_OK,
+        .lock      = xSemaphoreCreateMutex(),
+        .done      = xEventGroupCreate(),
+        .exited    = xSemaphoreCreateCounting(CONFIG_APP_BOOT_WORKER_NUM + 1, 0),
+    };
+    int worker_num = 0;
+
+    if (!graph.lock || !graph.done || !graph.exited) {
+        graph.err = ESP_ERR_NO_MEM;
+        goto EXIT;
+    }
+
+    /**< The caller is a worker too */
+    for (int i = 0; i < CONFIG_APP_BOOT_WORKER_NUM && i < stage_num - 1; i++) {
+        if (xTaskCreate(app_boot_worker_task, "app_boot", CONFIG_APP_BOOT_WORKER_STACK_SIZE, &graph,
+                        uxTaskPriorityGet(NULL), NULL) != pdPASS) {
+            ESP_LOGW(TAG, "Only %d workers", worker_num);
+            break;
+        }
+
+        worker_num++;
+    }
+
+    app_boot_work(&graph);
+
+    for (int i = 0; i < worker_num; i++) {
+        xSemaphoreTake(graph.exited, portMAX_DELAY);
+    }
+
+EXIT:
+
+    if (graph.lock) {
+        vSemaphoreDelete(graph.lock);
+    }
+
+    if (graph.done) {
+        vEventGroupDelete(graph.done);
+    }
+
+    if (graph.exited) {
+        vSemaphoreDelete(graph.exited);
+    }
+
+    return graph.err;
+}
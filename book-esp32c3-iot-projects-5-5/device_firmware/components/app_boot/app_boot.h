@@ -0,0 +1,113 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * Times are esp_timer_get_time(), counted from the start of the application:
+ * the ROM and the second stage bootloader come before 0.
+ */
+typedef struct {
+    const char *name;
+    int64_t     begin_us;
+    int64_t     end_us;       /**< Same as begin_us for a mark or a skipped stage, 0 while the stage runs */
+    esp_err_t   err;          /**< ESP_ERR_INVALID_STATE for a skipped stage */
+} app_boot_record_t;
+
+#define APP_BOOT_STAGE_MAX      24
+#define APP_BOOT_AFTER(index)   (1UL << (index))
+
+/**
+ * @brief A stage of the init graph
+ */
+typedef struct {
+    const char *name;
+    esp_err_t (*init)(void);
+    uint32_t    after;        /**< APP_BOOT_AFTER() of the earlier stages of the table it needs */
+} app_boot_stage_t;
+
+/**
+ * @brief  Record the beginning of a stage
+ *
+ * @param  name Kept as a pointer, a string literal
+ */
+void app_boot_begin(const char *name);
+
+/**
+ * @brief  Record the end of the last stage begun with this name
+ */
+void app_boot_end(const char *name, esp_err_t err);
+
+/**
+ * @brief  Record a point in time, e.g. the light turning on
+ */
+void app_boot_mark(const char *name);
+
+/**
+ * @brief  Find the last record with this name
+ *
+ * @return
+ *     - ESP_ERR_NOT_FOUND
+ *     - ESP_OK
+ */
+esp_err_t app_boot_get(const char *name, app_boot_record_t *record);
+
+/**
+ * @brief  All the records, in the order they were begun
+ *
+ * @return Number of records
+ */
+size_t app_boot_get_records(const app_boot_record_t **records);
+
+/**
+ * @brief  Log the records as a table
+ */
+void app_boot_dump(void);
+
+/**
+ * @brief  Drop the records, e.g. before profiling a second run
+ */
+void app_boot_clear(void);
+
+/**
+ * @brief  Run an init graph, each stage as soon as the stages it is after are done
+ *
+ * @note   Independent stages run at the same time on CONFIG_APP_BOOT_WORKER_NUM tasks
+ *         and the caller. Every stage is recorded with app_boot_begin() and app_boot_end().
+ *         The stages after a failed one are skipped, and recorded at the time they are
+ *         skipped with ESP_ERR_INVALID_STATE.
+ *
+ * @param  stages    At most APP_BOOT_STAGE_MAX, a stage can only be after earlier ones
+ * @param  stage_num
+ *
+ * @return
+ *     - ESP_ERR_INVALID_ARG
+ *     - ESP_ERR_NO_MEM
+ *     - The error of the first failed stage
+ *     - ESP_OK
+ */
+esp_err_t app_boot_run(const app_boot_stage_t *stages, size_t stage_num);
+
+#ifdef __cplusplus
+}
+#endif
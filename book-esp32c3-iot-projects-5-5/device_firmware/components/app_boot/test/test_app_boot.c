@@ -0,0 +1,174 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stdio.h"
+#include "string.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "unity.h"
+#include "app_boot.h"
+
+#define LIGHT_ON_BUDGET_MS    100
+
+/**
+ * @brief Mocked components, each takes about as long as on the device
+ */
+static esp_err_t mock_storage_init(void)
+{
+    vTaskDelay(pdMS_TO_TICKS(10));
+    return ESP_OK;
+}
+
+static esp_err_t mock_pm_init(void)
+{
+    vTaskDelay(pdMS_TO_TICKS(5));
+    return ESP_OK;
+}
+
+static esp_err_t mock_driver_init(void)
+{
+    /**< Restore the light state and start the LEDs, then the button */
+    vTaskDelay(pdMS_TO_TICKS(20));
+    app_boot_mark("light_on");
+    vTaskDelay(pdMS_TO_TICKS(10));
+    return ESP_OK;
+}
+
+static esp_err_t mock_wifi_init(void)
+{
+    vTaskDelay(pdMS_TO_TICKS(30));
+    return ESP_OK;
+}
+
+static esp_err_t mock_rmaker_init(void)
+{
+    vTaskDelay(pdMS_TO_TICKS(60));
+    return ESP_OK;
+}
+
+static esp_err_t mock_wifi_start(void)
+{
+    vTaskDelay(pdMS_TO_TICKS(10));
+    return ESP_OK;
+}
+
+static esp_err_t mock_fail(void)
+{
+    return ESP_ERR_NOT_FOUND;
+}
+
+enum {
+    STAGE_STORAGE,
+    STAGE_PM,
+    STAGE_DRIVER,
+    STAGE_WIFI_INIT,
+    STAGE_RMAKER,
+    STAGE_WIFI_START,
+};
+
+/**< The app_main of 7_insights */
+static const app_boot_stage_t g_boot_stages[] = {
+    [STAGE_STORAGE]    = {"storage",    mock_storage_init, 0},
+    [STAGE_PM]         = {"pm",         mock_pm_init,      0},
+    [STAGE_DRIVER]     = {"driver",     mock_driver_init,  APP_BOOT_AFTER(STAGE_STORAGE) | APP_BOOT_AFTER(STAGE_PM)},
+    [STAGE_WIFI_INIT]  = {"wifi_init",  mock_wifi_init,    APP_BOOT_AFTER(STAGE_STORAGE)},
+    [STAGE_RMAKER]     = {"rmaker",     mock_rmaker_init,  APP_BOOT_AFTER(STAGE_WIFI_INIT) | APP_BOOT_AFTER(STAGE_DRIVER)},
+    [STAGE_WIFI_START] = {"wifi_start", mock_wifi_start,   APP_BOOT_AFTER(STAGE_RMAKER)},
+};
+
+#define STAGE_NUM (sizeof(g_boot_stages) / sizeof(g_boot_stages[0]))
+
+static app_boot_record_t test_boot_get(const char *name)
+{
+    app_boot_record_t record;
+    TEST_ASSERT_EQUAL(ESP_OK, app_boot_get(name, &record));
+    return record;
+}
+
+TEST_CASE("app_boot init graph follows its dependencies", "[app_boot]")
+{
+    app_boot_clear();
+    int64_t start_us = esp_timer_get_time();
+    TEST_ASSERT_EQUAL(ESP_OK, app_boot_run(g_boot_stages, STAGE_NUM));
+    int64_t total_us = esp_timer_get_time() - start_us;
+    app_boot_dump();
+
+    for (int i = 0; i < STAGE_NUM; i++) {
+        app_boot_record_t record = test_boot_get(g_boot_stages[i].name);
+        TEST_ASSERT_EQUAL(ESP_OK, record.err);
+        TEST_ASSERT_GREATER_THAN(record.begin_us, record.end_us);
+
+        for (int j = 0; j < i; j++) {
+            if (g_boot_stages[i].after & APP_BOOT_AFTER(j)) {
+                TEST_ASSERT_GREATER_OR_EQUAL(test_boot_get(g_boot_stages[j].name).end_us, record.begin_us);
+            }
+        }
+    }
+
+    /**< The regression check: light on within the budget, whatever the cloud stages do */
+    app_boot_record_t light_on = test_boot_get("light_on");
+    ESP_LOGI("APP_BOOT TEST", "light on at %d ms, init graph %d ms",
+             (int)((light_on.begin_us - start_us) / 1000), (int)(total_us / 1000));
+    TEST_ASSERT_LESS_THAN(LIGHT_ON_BUDGET_MS * 1000, light_on.begin_us - start_us);
+
+#if CONFIG_APP_BOOT_WORKER_NUM > 0
+    /**< The driver runs while Wi-Fi initializes, the graph takes its critical path */
+    app_boot_record_t driver = test_boot_get("driver");
+    app_boot_record_t wifi_init = test_boot_get("wifi_init");
+    TEST_ASSERT_LESS_THAN(driver.end_us, wifi_init.begin_us);
+    TEST_ASSERT_LESS_THAN((10 + 5 + 30 + 30 + 60 + 10) * 1000, total_us);
+#endif
+}
+
+TEST_CASE("app_boot skips the stages after a failed one", "[app_boot]")
+{
+    const app_boot_stage_t stages[] = {
+        {"ok",      mock_pm_init, 0},
+        {"fail",    mock_fail,    0},
+        {"skipped", mock_pm_init, APP_BOOT_AFTER(1)},
+        {"after",   mock_pm_init, APP_BOOT_AFTER(0)},
+    };
+
+    app_boot_clear();
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, app_boot_run(stages, 4));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, test_boot_get("fail").err);
+    TEST_ASSERT_EQUAL(ESP_OK, test_boot_get("after").err);
+
+    /**< Recorded without running */
+    app_boot_record_t skipped = test_boot_get("skipped");
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, skipped.err);
+    TEST_ASSERT_EQUAL(skipped.begin_us, skipped.end_us);
+    TEST_ASSERT_GREATER_OR_EQUAL(test_boot_get("fail").end_us, skipped.begin_us);
+}
+
+TEST_CASE("app_boot rejects invalid graphs", "[app_boot]")
+{
+    const app_boot_stage_t forward[] = {
+        {"first",  mock_pm_init, APP_BOOT_AFTER(1)},
+        {"second", mock_pm_init, 0},
+    };
+    const app_boot_stage_t self[] = {
+        {"self", mock_pm_init, APP_BOOT_AFTER(0)},
+    };
+    const app_boot_stage_t no_init[] = {
+        {"none", NULL, 0},
+    };
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_boot_run(forward, 2));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_boot_run(self, 1));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_boot_run(no_init, 1));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_boot_run(g_boot_stages, 0));
+}
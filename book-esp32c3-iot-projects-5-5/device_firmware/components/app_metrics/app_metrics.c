@@ -0,0 +1,215 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "string.h"
+#include "stdlib.h"
+#include "sys/param.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "app_metrics.h"
+
+typedef struct {
+    int32_t  recorded;       /**< Last recorded value */
+    int32_t  value;          /**< Latest value */
+    int64_t  recorded_us;
+    bool     deferred;       /**< value is out of the deadband, waiting for min_interval_ms */
+} app_metric_state_t;
+
+struct app_metrics {
+    const app_metric_config_t *configs;
+    size_t                 num;
+    app_metrics_record_cb_t record_cb;
+    void                  *arg;
+    app_metrics_stats_t    stats;
+    SemaphoreHandle_t      lock;
+    esp_timer_handle_t     timer;
+    app_metric_state_t     states[];
+};
+
+static void app_metrics_record(app_metrics_handle_t metrics, size_t index, int64_t now)
+{
+    app_metric_state_t *state = &metrics->states[index];
+
+    state->recorded    = state->value;
+    state->recorded_us = now;
+    state->deferred    = false;
+    metrics->record_cb(index, state->value, metrics->arg);
+}
+
+/**
+ * @brief Arm the timer for the earliest deferred change or heartbeat, if any
+ */
+static void app_metrics_schedule(app_metrics_handle_t metrics, int64_t now)
+{
+    int64_t due_us = INT64_MAX;
+
+    for (int i = 0; i < metrics->num; i++) {
+        const app_metric_config_t *config = &metrics->configs[i];
+        const app_metric_state_t *state = &metrics->states[i];
+
+        if (state->deferred) {
+            due_us = MIN(due_us, state->recorded_us + config->min_interval_ms * 1000LL);
+        } else if (config->heartbeat_ms) {
+            due_us = MIN(due_us, state->recorded_us + config->heartbeat_ms * 1000LL);
+        }
+    }
+
+    esp_timer_stop(metrics->timer);
+
+    if (due_us != INT64_MAX) {
+        esp_timer_start_once(metrics->timer, MAX(due_us - now, 0));
+    }
+}
+
+static void app_metrics_timer_cb(void *arg)
+{
+    app_metrics_handle_t metrics = (app_metrics_handle_t)arg;
+
+    xSemaphoreTake(metrics->lock, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+
+    for (int i = 0; i < metrics->num; i++) {
+        const app_metric_config_t *config = &metrics->configs[i];
+        app_metric_state_t *state = &metrics->states[i];
+        int64_t elapsed_us = now - state->recorded_us;
+
+        if (state->deferred && elapsed_us >= config->min_interval_ms * 1000LL) {
+            metrics->stats.change_count++;
+            app_metrics_record(metrics, i, now);
+        } else if (!state->deferred && config->heartbeat_ms && elapsed_us >= config->heartbeat_ms * 1000LL) {
+            metrics->stats.heartbeat_count++;
+            app_metrics_record(metrics, i, now);
+        }
+    }
+
+    app_metrics_schedule(metrics, now);
+    xSemaphoreGive(metrics->lock);
+}
+
+esp_err_t app_metrics_create(const app_metric_config_t *configs, const int32_t *initial, size_t num,
+                             app_metrics_record_cb_t record_cb, void *arg, app_metrics_handle_t *handle)
+{
+    if (!configs || !initial || !num || !record_cb || !handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct app_metrics *metrics = calloc(1, sizeof(struct app_metrics) + num * sizeof(app_metric_state_t));
+
+    if (!metrics) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    metrics->configs   = configs;
+    metrics->num       = num;
+    metrics->record_cb = record_cb;
+    metrics->arg       = arg;
+    metrics->lock      = xSemaphoreCreateMutex();
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = app_metrics_timer_cb,
+        .arg      = metrics,
+        .name     = "app_metrics",
+    };
+
+    if (!metrics->lock || esp_timer_create(&timer_args, &metrics->timer) != ESP_OK) {
+        app_metrics_delete(metrics);
+        return ESP_ERR_NO_MEM;
+    }
+
+    int64_t now = esp_timer_get_time();
+
+    for (int i = 0; i < num; i++) {
+        metrics->states[i].value = initial[i];
+        app_metrics_record(metrics, i, now);
+    }
+
+    app_metrics_schedule(metrics, now);
+
+    *handle = metrics;
+    return ESP_OK;
+}
+
+esp_err_t app_metrics_delete(app_metrics_handle_t metrics)
+{
+    if (!metrics) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (metrics->timer) {
+        esp_timer_stop(metrics->timer);
+        esp_timer_delete(metrics->timer);
+    }
+
+    if (metrics->lock) {
+        vSemaphoreDelete(metrics->lock);
+    }
+
+    free(metrics);
+    return ESP_OK;
+}
+
+esp_err_t app_metrics_update(app_metrics_handle_t metrics, size_t index, int32_t value)
+{
+    if (!metrics || index >= metrics->num) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const app_metric_config_t *config = &metrics->configs[index];
+    app_metric_state_t *state = &metrics->states[index];
+
+    xSemaphoreTake(metrics->lock, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    bool was_deferred = state->deferred;
+
+    metrics->stats.update_count++;
+    state->value = value;
+
+    /* Against the last recorded value, so a slow drift is recorded once it adds up */
+    if (abs(value - state->recorded) <= config->deadband) {
+        state->deferred = false;
+    } else if (now - state->recorded_us >= config->min_interval_ms * 1000LL) {
+        metrics->stats.change_count++;
+        app_metrics_record(metrics, index, now);
+    } else if (!state->deferred) {
+        metrics->stats.deferred_count++;
+        state->deferred = true;
+    }
+
+    /* The heartbeat is pushed back by a record, and a deferred change comes first */
+    if (state->recorded_us == now || state->deferred != was_deferred) {
+        app_metrics_schedule(metrics, now);
+    }
+
+    xSemaphoreGive(metrics->lock);
+
+    return ESP_OK;
+}
+
+esp_err_t app_metrics_get_stats(app_metrics_handle_t metrics, app_metrics_stats_t *stats)
+{
+    if (!metrics || !stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(metrics->lock, portMAX_DELAY);
+    *stats = metrics->stats;
+    xSemaphoreGive(metrics->lock);
+
+    return ESP_OK;
+}
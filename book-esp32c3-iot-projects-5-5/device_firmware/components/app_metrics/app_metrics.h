@@ -0,0 +1,87 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * @brief When a metric is recorded
+ */
+typedef struct {
+    uint32_t deadband;         /**< Changes from the last recorded value up to this are not recorded */
+    uint32_t min_interval_ms;  /**< Between two records, a change meanwhile is recorded at the end of it */
+    uint32_t heartbeat_ms;     /**< Record the unchanged value this long after the last record, 0 for never */
+} app_metric_config_t;
+
+/**
+ * @brief  Record a value, e.g. with esp_diag_metrics_add_uint(), called from the
+ *         task of app_metrics_update() or from the esp_timer task
+ *
+ * @param  index Of the metric in the configs given to app_metrics_create()
+ */
+typedef esp_err_t (*app_metrics_record_cb_t)(size_t index, int32_t value, void *arg);
+
+typedef struct {
+    uint32_t update_count;     /**< Values given to app_metrics_update() */
+    uint32_t change_count;     /**< Records of a change */
+    uint32_t deferred_count;   /**< Of which held back by min_interval_ms */
+    uint32_t heartbeat_count;  /**< Records of an unchanged value */
+} app_metrics_stats_t;
+
+typedef struct app_metrics *app_metrics_handle_t;
+
+/**
+ * @brief  Create a set of change-driven metrics and record their initial values
+ *
+ * @note   Nothing runs while the values do not change: a one-shot esp_timer is
+ *         only armed for a deferred change or the next heartbeat.
+ *
+ * @param  configs Kept as a pointer, a static table
+ * @param  initial One value per metric
+ *
+ * @return
+ *     - ESP_ERR_INVALID_ARG
+ *     - ESP_ERR_NO_MEM
+ *     - ESP_OK
+ */
+esp_err_t app_metrics_create(const app_metric_config_t *configs, const int32_t *initial, size_t num,
+                             app_metrics_record_cb_t record_cb, void *arg, app_metrics_handle_t *handle);
+
+/**
+ * @brief  Delete a set of metrics, a deferred change is dropped
+ */
+esp_err_t app_metrics_delete(app_metrics_handle_t handle);
+
+/**
+ * @brief  Give the new value of a metric, recorded now, later, or not at all
+ */
+esp_err_t app_metrics_update(app_metrics_handle_t handle, size_t index, int32_t value);
+
+/**
+ * @brief  Get the record counters
+ */
+esp_err_t app_metrics_get_stats(app_metrics_handle_t handle, app_metrics_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,240 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "unity.h"
+#include "app_metrics.h"
+
+#define TRACE_STEP_MS       10
+#define TRACE_LENGTH_MS     (10 * 60 * 1000)
+#define POLL_INTERVAL_MS    15000          /**< The light_metrics_task of 7_insights */
+#define RECORD_MAX          64
+
+enum {
+    METRIC_POWER,
+    METRIC_BRIGHTNESS,
+    METRIC_HUE,
+    METRIC_SATURATION,
+    METRIC_NUM,
+};
+
+/**< The table of 7_insights */
+static const app_metric_config_t g_configs[METRIC_NUM] = {
+    [METRIC_POWER]      = {.deadband = 0, .min_interval_ms = 0,    .heartbeat_ms = 300000},
+    [METRIC_BRIGHTNESS] = {.deadband = 2, .min_interval_ms = 1000, .heartbeat_ms = 300000},
+    [METRIC_HUE]        = {.deadband = 5, .min_interval_ms = 1000, .heartbeat_ms = 300000},
+    [METRIC_SATURATION] = {.deadband = 2, .min_interval_ms = 1000, .heartbeat_ms = 300000},
+};
+
+typedef struct {
+    int64_t time_us;
+    size_t  index;
+    int32_t value;
+} test_record_t;
+
+typedef struct {
+    test_record_t records[RECORD_MAX];
+    size_t        num;
+    int32_t       value[METRIC_NUM];   /**< What the dashboard shows */
+} test_sink_t;
+
+static esp_err_t test_record_cb(size_t index, int32_t value, void *arg)
+{
+    test_sink_t *sink = (test_sink_t *)arg;
+
+    if (sink->num < RECORD_MAX) {
+        sink->records[sink->num++] = (test_record_t) {
+            esp_timer_get_time(), index, value
+        };
+    }
+
+    sink->value[index] = value;
+    return ESP_OK;
+}
+
+static bool test_recorded(const test_sink_t *sink, size_t index, int32_t value, int64_t from_us, int64_t to_us)
+{
+    for (int i = 0; i < sink->num; i++) {
+        const test_record_t *record = &sink->records[i];
+
+        if (record->index == index && record->value == value && record->time_us >= from_us && record->time_us <= to_us) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief The light over ten minutes: a dimming, a color change, a double tap
+ *        of the switch, a noisy sensor, a scene
+ */
+static void test_trace(uint32_t t, int32_t value[METRIC_NUM])
+{
+    value[METRIC_POWER] = !((t >= 130000 && t < 130300) || (t >= 200000 && t < 250000));
+
+    if (t < 10000) {
+        value[METRIC_BRIGHTNESS] = 50;
+    } else if (t < 12000) {
+        value[METRIC_BRIGHTNESS] = 50 + 50 * (t - 10000) / 2000;
+    } else if (t >= 300000 && t < 310000) {
+        value[METRIC_BRIGHTNESS] = 100 + (int32_t)(t / TRACE_STEP_MS % 5) - 2;
+    } else if (t < 400000) {
+        value[METRIC_BRIGHTNESS] = 100;
+    } else {
+        value[METRIC_BRIGHTNESS] = 20;
+    }
+
+    if (t < 70000) {
+        value[METRIC_HUE] = 0;
+    } else if (t < 73000) {
+        value[METRIC_HUE] = 240 * (t - 70000) / 3000;
+    } else {
+        value[METRIC_HUE] = 240;
+    }
+
+    value[METRIC_SATURATION] = 100;
+}
+
+TEST_CASE("app_metrics records the changes out of the deadband", "[app_metrics]")
+{
+    static const app_metric_config_t configs[] = {
+        {.deadband = 2, .min_interval_ms = 1000, .heartbeat_ms = 10000},
+    };
+    static test_sink_t sink;
+    app_metrics_handle_t metrics = NULL;
+    app_metrics_stats_t stats;
+    int32_t initial = 50;
+
+    memset(&sink, 0, sizeof(sink));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_metrics_create(configs, &initial, 0, test_record_cb, &sink, &metrics));
+    TEST_ASSERT_EQUAL(ESP_OK, app_metrics_create(configs, &initial, 1, test_record_cb, &sink, &metrics));
+    TEST_ASSERT_EQUAL(1, sink.num);
+    int64_t start_us = esp_timer_get_time();
+
+    /**< In the deadband */
+    vTaskDelay(pdMS_TO_TICKS(2000));
+    app_metrics_update(metrics, 0, 52);
+    app_metrics_update(metrics, 0, 48);
+    TEST_ASSERT_EQUAL(1, sink.num);
+
+    /**< Out of it and after min_interval_ms: right away */
+    app_metrics_update(metrics, 0, 60);
+    TEST_ASSERT_EQUAL(2, sink.num);
+    TEST_ASSERT_EQUAL(60, sink.value[0]);
+
+    /**< Within min_interval_ms: the last value at the end of it */
+    vTaskDelay(pdMS_TO_TICKS(100));
+    app_metrics_update(metrics, 0, 70);
+    app_metrics_update(metrics, 0, 80);
+    TEST_ASSERT_EQUAL(2, sink.num);
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    TEST_ASSERT_EQUAL(3, sink.num);
+    TEST_ASSERT_EQUAL(80, sink.value[0]);
+    TEST_ASSERT_INT64_WITHIN(1000, start_us + 3000000, sink.records[2].time_us);
+
+    /**< A deferred change that goes back into the deadband is dropped */
+    app_metrics_update(metrics, 0, 90);
+    app_metrics_update(metrics, 0, 81);
+    vTaskDelay(pdMS_TO_TICKS(2000));
+    TEST_ASSERT_EQUAL(3, sink.num);
+
+    /**< Unchanged: a heartbeat every heartbeat_ms, with the latest value */
+    vTaskDelay(pdMS_TO_TICKS(25000));
+    TEST_ASSERT_EQUAL(5, sink.num);
+    TEST_ASSERT_EQUAL(81, sink.value[0]);
+    TEST_ASSERT_INT64_WITHIN(1000, start_us + 13000000, sink.records[3].time_us);
+
+    TEST_ASSERT_EQUAL(ESP_OK, app_metrics_get_stats(metrics, &stats));
+    TEST_ASSERT_EQUAL(7, stats.update_count);
+    TEST_ASSERT_EQUAL(2, stats.change_count);
+    TEST_ASSERT_EQUAL(2, stats.deferred_count);
+    TEST_ASSERT_EQUAL(2, stats.heartbeat_count);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_metrics_update(metrics, 1, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, app_metrics_delete(metrics));
+}
+
+TEST_CASE("app_metrics samples and fidelity against polling on a light trace", "[app_metrics][bench]")
+{
+    static test_sink_t sink;
+    app_metrics_handle_t metrics = NULL;
+    app_metrics_stats_t stats;
+    int32_t value[METRIC_NUM], polled[METRIC_NUM];
+    uint32_t poll_count = 0;
+    uint32_t stale_ms = 0, poll_stale_ms = 0;    /**< Time a metric shows a value off by more than its deadband */
+
+    memset(&sink, 0, sizeof(sink));
+    test_trace(0, value);
+    memcpy(polled, value, sizeof(polled));
+    int64_t start_us = esp_timer_get_time();
+    TEST_ASSERT_EQUAL(ESP_OK, app_metrics_create(g_configs, value, METRIC_NUM, test_record_cb, &sink, &metrics));
+
+    for (uint32_t t = 0; t < TRACE_LENGTH_MS; t += TRACE_STEP_MS) {
+        int32_t next[METRIC_NUM];
+        test_trace(t, next);
+
+        /**< What app_driver does: a notification per change */
+        for (int i = 0; i < METRIC_NUM; i++) {
+            if (next[i] != value[i]) {
+                app_metrics_update(metrics, i, next[i]);
+            }
+        }
+
+        memcpy(value, next, sizeof(value));
+
+        if (t % POLL_INTERVAL_MS == 0) {
+            memcpy(polled, value, sizeof(polled));
+            poll_count += METRIC_NUM;
+        }
+
+        for (int i = 0; i < METRIC_NUM; i++) {
+            stale_ms += abs(sink.value[i] - value[i]) > g_configs[i].deadband ? TRACE_STEP_MS : 0;
+            poll_stale_ms += abs(polled[i] - value[i]) > g_configs[i].deadband ? TRACE_STEP_MS : 0;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(TRACE_STEP_MS));
+    }
+
+    app_metrics_get_stats(metrics, &stats);
+    ESP_LOGI("APP_METRICS TEST", "change driven: %u samples, %u ms stale (%u changes, %u deferred, %u heartbeats)",
+             (unsigned)sink.num, (unsigned)stale_ms, (unsigned)stats.change_count,
+             (unsigned)stats.deferred_count, (unsigned)stats.heartbeat_count);
+    ESP_LOGI("APP_METRICS TEST", "polled every %d s: %u samples, %u ms stale", POLL_INTERVAL_MS / 1000,
+             (unsigned)poll_count, (unsigned)poll_stale_ms);
+
+    /**< Fewer samples, and closer to the light */
+    TEST_ASSERT_LESS_THAN(RECORD_MAX, sink.num);
+    TEST_ASSERT_LESS_THAN(poll_count / 4, sink.num);
+    TEST_ASSERT_LESS_THAN(poll_stale_ms / 5, stale_ms);
+
+    /**< A change is shown at most min_interval_ms late */
+    TEST_ASSERT_LESS_OR_EQUAL(2 * g_configs[METRIC_BRIGHTNESS].min_interval_ms + 3 * g_configs[METRIC_HUE].min_interval_ms,
+                              stale_ms);
+
+    /**< The double tap polling misses, the jitter polling records */
+    TEST_ASSERT_TRUE(test_recorded(&sink, METRIC_POWER, 0, start_us + 130000000, start_us + 130010000));
+    TEST_ASSERT_TRUE(test_recorded(&sink, METRIC_POWER, 1, start_us + 130300000, start_us + 130310000));
+    TEST_ASSERT_FALSE(test_recorded(&sink, METRIC_BRIGHTNESS, 98, start_us + 300000000, start_us + 311000000));
+    TEST_ASSERT_FALSE(test_recorded(&sink, METRIC_BRIGHTNESS, 102, start_us + 300000000, start_us + 311000000));
+
+    /**< Only the unchanged saturation needs a heartbeat */
+    TEST_ASSERT_TRUE(test_recorded(&sink, METRIC_SATURATION, 100, start_us + 300000000, start_us + 300010000));
+    TEST_ASSERT_EQUAL(ESP_OK, app_metrics_delete(metrics));
+}
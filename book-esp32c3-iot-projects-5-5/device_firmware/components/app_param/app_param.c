@@ -0,0 +1,144 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "string.h"
+#include "stdlib.h"
+
+#include "esp_log.h"
+
+#include "app_param.h"
+
+static const char *TAG = "app_param";
+
+/**
+ * The handles are spread by a multiplicative hash over twice as many slots
+ * as params, a lookup is one or two probes whatever the number of params.
+ */
+typedef struct {
+    const void *handle;    /**< NULL while the slot is free */
+    uint16_t    index;
+} app_param_slot_t;
+
+struct app_param_table {
+    const app_param_desc_t *descs;
+    size_t             num;
+    uint32_t           mask;     /**< Slots - 1, a power of two */
+    uint8_t            shift;    /**< 32 - log2(slots), the hash keeps the top bits */
+    app_param_slot_t   slots[];
+};
+
+static inline uint32_t app_param_hash(app_param_table_handle_t table, const void *handle)
+{
+    /* Fibonacci hashing, the top bits of the product depend on all the bits of the pointer */
+    return ((uint32_t)(uintptr_t)handle * 2654435769U) >> table->shift;
+}
+
+esp_err_t app_param_table_create(const app_param_desc_t *descs, size_t num, app_param_table_handle_t *table)
+{
+    if (!descs || !num || num > UINT16_MAX || !table) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t slot_num = 4;
+    uint8_t shift = 30;
+
+    while (slot_num < 2 * num) {
+        slot_num <<= 1;
+        shift--;
+    }
+
+    struct app_param_table *t = calloc(1, sizeof(struct app_param_table) + slot_num * sizeof(app_param_slot_t));
+
+    if (!t) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    t->descs = descs;
+    t->num   = num;
+    t->mask  = slot_num - 1;
+    t->shift = shift;
+
+    *table = t;
+    return ESP_OK;
+}
+
+esp_err_t app_param_table_delete(app_param_table_handle_t table)
+{
+    if (!table) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    free(table);
+    return ESP_OK;
+}
+
+esp_err_t app_param_table_bind(app_param_table_handle_t table, size_t index, const void *handle)
+{
+    if (!table || index >= table->num || !handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    /* Never full: at most num of the 2 * num slots are taken */
+    for (uint32_t i = app_param_hash(table, handle);; i = (i + 1) & table->mask) {
+        app_param_slot_t *slot = &table->slots[i];
+
+        if (slot->handle == handle) {
+            ESP_LOGW(TAG, "%s: handle bound already", table->descs[index].name);
+            return ESP_ERR_INVALID_STATE;
+        }
+
+        if (!slot->handle) {
+            slot->handle = handle;
+            slot->index  = index;
+            return ESP_OK;
+        }
+    }
+}
+
+const app_param_desc_t *app_param_table_find(app_param_table_handle_t table, const void *handle)
+{
+    if (!table || !handle) {
+        return NULL;
+    }
+
+    for (uint32_t i = app_param_hash(table, handle);; i = (i + 1) & table->mask) {
+        const app_param_slot_t *slot = &table->slots[i];
+
+        if (slot->handle == handle) {
+            return &table->descs[slot->index];
+        }
+
+        if (!slot->handle) {
+            return NULL;
+        }
+    }
+}
+
+esp_err_t app_param_dispatch(app_param_table_handle_t table, const void *handle, int32_t value, void *ctx)
+{
+    const app_param_desc_t *desc = app_param_table_find(table, handle);
+
+    if (!desc) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    return desc->handler ? desc->handler(desc, value, ctx) : ESP_OK;
+}
+
+size_t app_param_table_get_descs(app_param_table_handle_t table, const app_param_desc_t **descs)
+{
+    *descs = table->descs;
+    return table->num;
+}
@@ -0,0 +1,109 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct app_param_desc app_param_desc_t;
+
+/**
+ * @brief  Typed handler of a param, e.g. stores the value in the driver state of a batch
+ *
+ * @param  ctx Given to app_param_dispatch()
+ */
+typedef esp_err_t (*app_param_handler_t)(const app_param_desc_t *desc, int32_t value, void *ctx);
+
+/**
+ * @brief One line of the declarative param list, it drives the param creation,
+ *        the write dispatch and the diag metrics
+ */
+struct app_param_desc {
+    const char         *name;          /**< RainMaker param name */
+    const char         *type;          /**< RainMaker param type, e.g. ESP_RMAKER_PARAM_HUE */
+    const char         *ui_type;       /**< NULL for none */
+    bool                is_bool;
+    int32_t             def;
+    int32_t             min;           /**< Bounds of an int param, none if min == max */
+    int32_t             max;
+    app_param_handler_t handler;
+    int32_t           (*get)(void);    /**< Driver getter, NULL if the param is not sampled */
+    const char         *metric_key;    /**< Diag metric key, NULL for none */
+    const char         *metric_path;
+};
+
+typedef struct app_param_table *app_param_table_handle_t;
+
+/**
+ * @brief  Create the binding table of a param list
+ *
+ * @param  descs Kept as a pointer, a static list
+ *
+ * @return
+ *     - ESP_ERR_INVALID_ARG
+ *     - ESP_ERR_NO_MEM
+ *     - ESP_OK
+ */
+esp_err_t app_param_table_create(const app_param_desc_t *descs, size_t num, app_param_table_handle_t *table);
+
+/**
+ * @brief  Delete a binding table
+ */
+esp_err_t app_param_table_delete(app_param_table_handle_t table);
+
+/**
+ * @brief  Bind a param list entry to the handle of its param, once at registration
+ *
+ * @param  handle e.g. the esp_rmaker_param_t created for descs[index]
+ *
+ * @return
+ *     - ESP_ERR_INVALID_ARG
+ *     - ESP_ERR_INVALID_STATE if the handle is bound already
+ *     - ESP_OK
+ */
+esp_err_t app_param_table_bind(app_param_table_handle_t table, size_t index, const void *handle);
+
+/**
+ * @brief  Find the list entry bound to a handle, in constant time
+ *
+ * @return NULL if the handle is not bound
+ */
+const app_param_desc_t *app_param_table_find(app_param_table_handle_t table, const void *handle);
+
+/**
+ * @brief  Call the handler of the list entry bound to a handle
+ *
+ * @return
+ *     - ESP_ERR_NOT_FOUND if the handle is not bound
+ *     - The result of the handler
+ */
+esp_err_t app_param_dispatch(app_param_table_handle_t table, const void *handle, int32_t value, void *ctx);
+
+/**
+ * @brief  The param list of a table, to walk it, e.g. to register the metrics
+ */
+size_t app_param_table_get_descs(app_param_table_handle_t table, const app_param_desc_t **descs);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,64 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "esp_log.h"
+
+#include <esp_rmaker_core.h>
+
+#include "app_param_rmaker.h"
+
+static const char *TAG = "app_param";
+
+esp_err_t app_param_rmaker_add(app_param_table_handle_t table, esp_rmaker_device_t *device)
+{
+    const app_param_desc_t *descs = NULL;
+    size_t num = app_param_table_get_descs(table, &descs);
+
+    for (int i = 0; i < num; i++) {
+        const app_param_desc_t *desc = &descs[i];
+        esp_rmaker_param_t *param = esp_rmaker_device_get_param_by_name(device, desc->name);
+
+        if (!param) {
+            esp_rmaker_param_val_t val = desc->is_bool ? esp_rmaker_bool(desc->def) : esp_rmaker_int(desc->def);
+            param = esp_rmaker_param_create(desc->name, desc->type, val, PROP_FLAG_READ | PROP_FLAG_WRITE | PROP_FLAG_PERSIST);
+
+            if (!param) {
+                ESP_LOGE(TAG, "%s: esp_rmaker_param_create failed", desc->name);
+                return ESP_ERR_NO_MEM;
+            }
+
+            if (desc->ui_type) {
+                esp_rmaker_param_add_ui_type(param, desc->ui_type);
+            }
+
+            if (desc->min != desc->max) {
+                esp_rmaker_param_add_bounds(param, esp_rmaker_int(desc->min), esp_rmaker_int(desc->max), esp_rmaker_int(1));
+            }
+
+            if (esp_rmaker_device_add_param(device, param) != ESP_OK) {
+                ESP_LOGE(TAG, "%s: esp_rmaker_device_add_param failed", desc->name);
+                return ESP_FAIL;
+            }
+        }
+
+        esp_err_t ret = app_param_table_bind(table, i, param);
+
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    return ESP_OK;
+}
@@ -0,0 +1,42 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <esp_rmaker_core.h>
+
+#include "app_param.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * @brief  Add the params of a table to a RainMaker device and bind them
+ *
+ * @note   A param the device has already, e.g. the power of a lightbulb, is only bound.
+ *         The others are created from their list entry, persistent and writable.
+ *
+ * @return
+ *     - ESP_ERR_NO_MEM
+ *     - ESP_FAIL
+ *     - ESP_OK
+ */
+esp_err_t app_param_rmaker_add(app_param_table_handle_t table, esp_rmaker_device_t *device);
+
+#ifdef __cplusplus
+}
+#endif
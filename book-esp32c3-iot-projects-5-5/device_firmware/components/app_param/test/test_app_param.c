@@ -0,0 +1,137 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stdio.h"
+#include "string.h"
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "unity.h"
+#include "app_param.h"
+
+#define TEST_PARAM_MAX       32
+#define BENCH_DISPATCHES     200000
+
+/**
+ * @brief Mocked esp_rmaker_param_t, only its name is read by the write_cb of the examples
+ */
+typedef struct {
+    char    *name;
+    uint8_t  data[40];
+} mock_param_t;
+
+static mock_param_t g_mock_params[TEST_PARAM_MAX];
+static char g_names[TEST_PARAM_MAX][16];
+static app_param_desc_t g_descs[TEST_PARAM_MAX];
+
+static esp_err_t mock_handler(const app_param_desc_t *desc, int32_t value, void *ctx)
+{
+    int32_t *values = (int32_t *)ctx;
+    values[desc - g_descs] = value;
+    return ESP_OK;
+}
+
+static app_param_table_handle_t test_table_create(size_t num)
+{
+    app_param_table_handle_t table = NULL;
+
+    for (int i = 0; i < num; i++) {
+        /**< Names share a prefix, as the standard ones do */
+        snprintf(g_names[i], sizeof(g_names[i]), "Light Param %02d", i);
+        g_mock_params[i].name = g_names[i];
+        g_descs[i] = (app_param_desc_t) {
+            .name    = g_names[i],
+            .max     = 100,
+            .handler = mock_handler,
+        };
+    }
+
+    TEST_ASSERT_EQUAL(ESP_OK, app_param_table_create(g_descs, num, &table));
+
+    for (int i = 0; i < num; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, app_param_table_bind(table, i, &g_mock_params[i]));
+    }
+
+    return table;
+}
+
+/**
+ * @brief What write_cb did before, a chain of strcmp() on the param name
+ */
+static esp_err_t strcmp_dispatch(size_t num, const mock_param_t *param, int32_t value, void *ctx)
+{
+    for (int i = 0; i < num; i++) {
+        if (strcmp(param->name, g_descs[i].name) == 0) {
+            return g_descs[i].handler(&g_descs[i], value, ctx);
+        }
+    }
+
+    return ESP_ERR_NOT_FOUND;
+}
+
+TEST_CASE("app_param table finds every bound param", "[app_param]")
+{
+    app_param_table_handle_t table = test_table_create(TEST_PARAM_MAX);
+    int32_t values[TEST_PARAM_MAX] = {0};
+    mock_param_t unknown = {0};
+
+    for (int i = 0; i < TEST_PARAM_MAX; i++) {
+        TEST_ASSERT_EQUAL_PTR(&g_descs[i], app_param_table_find(table, &g_mock_params[i]));
+        TEST_ASSERT_EQUAL(ESP_OK, app_param_dispatch(table, &g_mock_params[i], i + 1, values));
+        TEST_ASSERT_EQUAL(i + 1, values[i]);
+    }
+
+    TEST_ASSERT_NULL(app_param_table_find(table, &unknown));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, app_param_dispatch(table, &unknown, 0, values));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, app_param_table_bind(table, 0, &g_mock_params[3]));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_param_table_bind(table, TEST_PARAM_MAX, &unknown));
+
+    TEST_ASSERT_EQUAL(ESP_OK, app_param_table_delete(table));
+}
+
+TEST_CASE("app_param dispatch cost for 4 and 32 params", "[app_param][bench]")
+{
+    const size_t nums[] = {4, TEST_PARAM_MAX};
+    uint32_t table_cycles[2], strcmp_cycles[2];
+    int32_t values[TEST_PARAM_MAX] = {0};
+
+    for (int n = 0; n < 2; n++) {
+        size_t num = nums[n];
+        app_param_table_handle_t table = test_table_create(num);
+
+        /**< Every param in turn, as many writes of each */
+        uint32_t start = esp_cpu_get_cycle_count();
+
+        for (int i = 0; i < BENCH_DISPATCHES; i++) {
+            strcmp_dispatch(num, &g_mock_params[i % num], i, values);
+        }
+
+        strcmp_cycles[n] = (esp_cpu_get_cycle_count() - start) / (BENCH_DISPATCHES / 1000);
+        start = esp_cpu_get_cycle_count();
+
+        for (int i = 0; i < BENCH_DISPATCHES; i++) {
+            app_param_dispatch(table, &g_mock_params[i % num], i, values);
+        }
+
+        table_cycles[n] = (esp_cpu_get_cycle_count() - start) / (BENCH_DISPATCHES / 1000);
+
+        printf("%2d params: strcmp chain %6u cycles, table %6u cycles per 1000 dispatches\n", (int)num,
+               (unsigned)strcmp_cycles[n], (unsigned)table_cycles[n]);
+        TEST_ASSERT_EQUAL(ESP_OK, app_param_table_delete(table));
+    }
+
+    /**< The chain grows with the params, the table does not */
+    TEST_ASSERT_LESS_THAN(strcmp_cycles[1] / 2, table_cycles[1]);
+    TEST_ASSERT_LESS_OR_EQUAL(3 * table_cycles[0] + 1, table_cycles[1]);
+}
@@ -0,0 +1,240 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "string.h"
+#include "stdlib.h"
+#include "sys/param.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "app_report.h"
+
+static const char *TAG = "app_report";
+
+struct app_report {
+    app_report_config_t config;
+    app_report_update_t pending[CONFIG_APP_REPORT_PARAM_MAX];
+    size_t              pending_num;
+    int64_t             last_flush_us; /**< Start of the last flush_cb */
+    app_report_stats_t  stats;
+    SemaphoreHandle_t   lock;          /**< pending and stats */
+    SemaphoreHandle_t   flush_lock;    /**< One flush_cb at a time, the reports are sent in order */
+    esp_timer_handle_t  timer;
+    TaskHandle_t        task;          /**< Runs the flush_cb once the timer is due */
+};
+
+static void app_report_task(void *arg)
+{
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        app_report_flush((app_report_handle_t)arg);
+    }
+}
+
+/**< The flush_cb publishes, which must not hold up the other esp_timer callbacks */
+static void app_report_timer_cb(void *arg)
+{
+    xTaskNotifyGive(((struct app_report *)arg)->task);
+}
+
+esp_err_t app_report_create(const app_report_config_t *config, app_report_handle_t *handle)
+{
+    if (!config || !config->flush_cb || !handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct app_report *report = calloc(1, sizeof(struct app_report));
+
+    if (!report) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    report->config     = *config;
+    report->lock       = xSemaphoreCreateMutex();
+    report->flush_lock = xSemaphoreCreateMutex();
+    /**< No report yet, the first one only waits for the window */
+    report->last_flush_us = -(int64_t)config->min_interval_ms * 1000;
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = app_report_timer_cb,
+        .arg      = report,
+        .name     = "app_report",
+    };
+
+    if (!report->lock || !report->flush_lock || esp_timer_create(&timer_args, &report->timer) != ESP_OK ||
+            xTaskCreate(app_report_task, "app_report", CONFIG_APP_REPORT_TASK_STACK_SIZE, report,
+                        CONFIG_APP_REPORT_TASK_PRIORITY, &report->task) != pdPASS) {
+        app_report_delete(report);
+        return ESP_ERR_NO_MEM;
+    }
+
+    *handle = report;
+    return ESP_OK;
+}
+
+esp_err_t app_report_delete(app_report_handle_t report)
+{
+    if (!report) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (report->timer) {
+        esp_timer_stop(report->timer);
+        esp_timer_delete(report->timer);
+    }
+
+    /**< Not in the middle of a flush_cb, the task holds nothing else while it waits */
+    if (report->task) {
+        xSemaphoreTake(report->flush_lock, portMAX_DELAY);
+        vTaskDelete(report->task);
+        xSemaphoreGive(report->flush_lock);
+    }
+
+    if (report->lock) {
+        vSemaphoreDelete(report->lock);
+    }
+
+    if (report->flush_lock) {
+        vSemaphoreDelete(report->flush_lock);
+    }
+
+    free(report);
+    return ESP_OK;
+}
+
+esp_err_t app_report_update(app_report_handle_t report, void *param, int32_t value)
+{
+    if (!report) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int64_t now = esp_timer_get_time();
+    bool full = false;
+
+    xSemaphoreTake(report->lock, portMAX_DELAY);
+
+    app_report_update_t *update = NULL;
+
+    for (int i = 0; i < report->pending_num && !update; i++) {
+        if (report->pending[i].param == param) {
+            update = &report->pending[i];
+        }
+    }
+
+    if (update) {
+        /**< Only the latest value is worth sending */
+        update->value = value;
+        report->stats.superseded_count++;
+        report->stats.update_count++;
+    } else if (report->pending_num == CONFIG_APP_REPORT_PARAM_MAX) {
+        full = true;
+    } else {
+        update = &report->pending[report->pending_num++];
+        update->param    = param;
+        update->value    = value;
+        update->since_us = now;
+        report->stats.update_count++;
+
+        if (report->pending_num == 1) {
+            int64_t due_us = MAX(now + report->config.window_ms * 1000LL,
+                                 report->last_flush_us + report->config.min_interval_ms * 1000LL);
+
+            esp_timer_start_once(report->timer, due_us - now);
+        }
+    }
+
+    xSemaphoreGive(report->lock);
+
+    if (full) {
+        ESP_LOGD(TAG, "%d params pending, sent early", CONFIG_APP_REPORT_PARAM_MAX);
+        app_report_flush(report);
+        return app_report_update(report, param, value);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t app_report_flush(app_report_handle_t report)
+{
+    if (!report) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    app_report_update_t updates[CONFIG_APP_REPORT_PARAM_MAX];
+    esp_err_t ret = ESP_OK;
+
+    xSemaphoreTake(report->flush_lock, portMAX_DELAY);
+
+    xSemaphoreTake(report->lock, portMAX_DELAY);
+    size_t num = report->pending_num;
+    memcpy(updates, report->pending, num * sizeof(app_report_update_t));
+    report->pending_num = 0;
+    esp_timer_stop(report->timer);
+
+    /**< The updates that arrive during the flush_cb are due min_interval_ms after its start */
+    if (num) {
+        report->last_flush_us = esp_timer_get_time();
+    }
+
+    xSemaphoreGive(report->lock);
+
+    if (num) {
+        ret = report->config.flush_cb(updates, num, report->config.arg);
+        int64_t now = esp_timer_get_time();
+
+        xSemaphoreTake(report->lock, portMAX_DELAY);
+
+        if (ret == ESP_OK) {
+            report->stats.publish_count++;
+            report->stats.sent_count += num;
+
+            for (int i = 0; i < num; i++) {
+                uint32_t latency_us = (uint32_t)(now - updates[i].since_us);
+                report->stats.latency_sum_us += latency_us;
+                report->stats.latency_max_us = MAX(report->stats.latency_max_us, latency_us);
+            }
+        } else {
+            report->stats.error_count++;
+        }
+
+        xSemaphoreGive(report->lock);
+    }
+
+    xSemaphoreGive(report->flush_lock);
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Report of %d params failed, err: %s", (int)num, esp_err_to_name(ret));
+    }
+
+    return ret;
+}
+
+esp_err_t app_report_get_stats(app_report_handle_t report, app_report_stats_t *stats)
+{
+    if (!report || !stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(report->lock, portMAX_DELAY);
+    *stats = report->stats;
+    xSemaphoreGive(report->lock);
+
+    return ESP_OK;
+}
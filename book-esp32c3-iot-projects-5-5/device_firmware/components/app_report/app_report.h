@@ -0,0 +1,102 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct app_report *app_report_handle_t;
+
+/**
+ * @brief The latest value of a param, the ones it superseded are dropped
+ */
+typedef struct {
+    void     *param;          /**< Handle of the caller, e.g. an esp_rmaker_param_t */
+    int32_t   value;
+    int64_t   since_us;       /**< Arrival of the first value of this param in the report */
+} app_report_update_t;
+
+/**
+ * @brief Apply and send the report, called from the task of the report, or from the
+ *        task calling app_report_flush() or app_report_update() when the report is full
+ *
+ * @param updates One per param, in the order the params were first updated
+ */
+typedef esp_err_t (*app_report_flush_cb_t)(const app_report_update_t *updates, size_t num, void *arg);
+
+typedef struct {
+    uint32_t              window_ms;        /**< Wait after the first update for the ones that follow it */
+    uint32_t              min_interval_ms;  /**< Between two reports, whatever the window */
+    app_report_flush_cb_t flush_cb;
+    void                 *arg;
+} app_report_config_t;
+
+typedef struct {
+    uint32_t update_count;      /**< Values given to app_report_update() */
+    uint32_t superseded_count;  /**< Values replaced before they were sent */
+    uint32_t publish_count;     /**< Reports sent, one flush_cb each */
+    uint32_t error_count;       /**< Reports the flush_cb failed */
+    uint32_t latency_max_us;    /**< From the arrival of a value to its report */
+    uint64_t latency_sum_us;    /**< Over the sent params, / sent_count for the mean */
+    uint32_t sent_count;        /**< Params sent */
+} app_report_stats_t;
+
+/**
+ * @brief  Create a report aggregator
+ *
+ * @return
+ *     - ESP_ERR_INVALID_ARG
+ *     - ESP_ERR_NO_MEM
+ *     - ESP_OK
+ */
+esp_err_t app_report_create(const app_report_config_t *config, app_report_handle_t *handle);
+
+/**
+ * @brief  Delete a report aggregator, the pending updates are dropped
+ *
+ * @note   Waits for a flush_cb in progress, so not from the flush_cb itself
+ */
+esp_err_t app_report_delete(app_report_handle_t handle);
+
+/**
+ * @brief  Add the value of a param to the next report
+ *
+ * @note   Never blocks on the report: the flush_cb runs once window_ms has passed
+ *         since the first pending update, and min_interval_ms since the last report.
+ *         With CONFIG_APP_REPORT_PARAM_MAX params pending, the report is sent first.
+ */
+esp_err_t app_report_update(app_report_handle_t handle, void *param, int32_t value);
+
+/**
+ * @brief  Send the pending updates now, from the calling task
+ */
+esp_err_t app_report_flush(app_report_handle_t handle);
+
+/**
+ * @brief  Get the publish and latency counters
+ */
+esp_err_t app_report_get_stats(app_report_handle_t handle, app_report_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,199 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stdio.h"
+#include "string.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "unity.h"
+#include "app_report.h"
+
+#define TEST_WINDOW_MS       50
+#define TEST_INTERVAL_MS     200
+#define TEST_SLIDER_MS       20      /**< A slider of the phone app sends a value this often */
+#define TEST_SLIDER_STEPS    50
+#define TEST_PUBLISH_MS      120     /**< A slow MQTT publish, longer than the window */
+
+/**
+ * @brief Mocked esp_rmaker_param_update_and_report(), one MQTT publish per call
+ */
+typedef struct {
+    int      publishes;
+    int      params;
+    int32_t  last[3];
+    bool     duplicate;     /**< A param twice in one report */
+    size_t   max_num;
+} mock_cloud_t;
+
+static int g_params[3];     /**< Stand for the hue, saturation and brightness params */
+
+static esp_err_t mock_flush_cb(const app_report_update_t *updates, size_t num, void *arg)
+{
+    mock_cloud_t *cloud = (mock_cloud_t *)arg;
+
+    for (int i = 0; i < num; i++) {
+        int index = (int *)updates[i].param - g_params;
+        TEST_ASSERT_TRUE(index >= 0 && index < 3);
+
+        for (int j = 0; j < i; j++) {
+            cloud->duplicate |= updates[j].param == updates[i].param;
+        }
+
+        cloud->last[index] = updates[i].value;
+    }
+
+    cloud->publishes++;
+    cloud->params += num;
+    cloud->max_num = num > cloud->max_num ? num : cloud->max_num;
+    return ESP_OK;
+}
+
+static app_report_handle_t test_report_create(mock_cloud_t *cloud)
+{
+    const app_report_config_t config = {
+        .window_ms       = TEST_WINDOW_MS,
+        .min_interval_ms = TEST_INTERVAL_MS,
+        .flush_cb        = mock_flush_cb,
+        .arg             = cloud,
+    };
+    app_report_handle_t report = NULL;
+
+    memset(cloud, 0, sizeof(mock_cloud_t));
+    TEST_ASSERT_EQUAL(ESP_OK, app_report_create(&config, &report));
+    return report;
+}
+
+TEST_CASE("app_report coalesces a slider into a few reports", "[app_report]")
+{
+    mock_cloud_t cloud;
+    app_report_handle_t report = test_report_create(&cloud);
+    app_report_stats_t stats = {0};
+
+    /**< The color picker moves the hue and the saturation, then the brightness follows */
+    for (int i = 1; i <= TEST_SLIDER_STEPS; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, app_report_update(report, &g_params[0], i * 7 % 360));
+        TEST_ASSERT_EQUAL(ESP_OK, app_report_update(report, &g_params[1], i * 2));
+        TEST_ASSERT_EQUAL(ESP_OK, app_report_update(report, &g_params[2], 100 - i));
+        vTaskDelay(pdMS_TO_TICKS(TEST_SLIDER_MS));
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(TEST_INTERVAL_MS + TEST_WINDOW_MS));
+    TEST_ASSERT_EQUAL(ESP_OK, app_report_get_stats(report, &stats));
+
+    printf("%d updates over %d ms: %u reports of %u params instead of %d, latency mean %u max %u ms\n",
+           3 * TEST_SLIDER_STEPS, TEST_SLIDER_STEPS * TEST_SLIDER_MS, (unsigned)stats.publish_count,
+           (unsigned)stats.sent_count, 3 * TEST_SLIDER_STEPS,
+           (unsigned)(stats.latency_sum_us / stats.sent_count / 1000), (unsigned)(stats.latency_max_us / 1000));
+
+    /**< Every value is counted, the cloud ends on the last ones */
+    TEST_ASSERT_EQUAL(3 * TEST_SLIDER_STEPS, stats.update_count);
+    TEST_ASSERT_EQUAL(stats.update_count, stats.superseded_count + stats.sent_count);
+    TEST_ASSERT_EQUAL(TEST_SLIDER_STEPS * 7 % 360, cloud.last[0]);
+    TEST_ASSERT_EQUAL(TEST_SLIDER_STEPS * 2, cloud.last[1]);
+    TEST_ASSERT_EQUAL(100 - TEST_SLIDER_STEPS, cloud.last[2]);
+    TEST_ASSERT_FALSE(cloud.duplicate);
+    TEST_ASSERT_EQUAL(3, cloud.max_num);
+
+    /**< At most one report per interval, none of them late by more than an interval */
+    TEST_ASSERT_EQUAL(cloud.publishes, stats.publish_count);
+    TEST_ASSERT_LESS_OR_EQUAL(TEST_SLIDER_STEPS * TEST_SLIDER_MS / TEST_INTERVAL_MS + 2, stats.publish_count);
+    TEST_ASSERT_LESS_OR_EQUAL((TEST_INTERVAL_MS + TEST_SLIDER_MS) * 1000, stats.latency_max_us);
+
+    TEST_ASSERT_EQUAL(ESP_OK, app_report_delete(report));
+}
+
+TEST_CASE("app_report sends a lone update after the window", "[app_report]")
+{
+    mock_cloud_t cloud;
+    app_report_handle_t report = test_report_create(&cloud);
+    app_report_stats_t stats = {0};
+
+    TEST_ASSERT_EQUAL(ESP_OK, app_report_update(report, &g_params[2], 42));
+    vTaskDelay(pdMS_TO_TICKS(TEST_WINDOW_MS / 2));
+    TEST_ASSERT_EQUAL(0, cloud.publishes);
+
+    vTaskDelay(pdMS_TO_TICKS(TEST_WINDOW_MS));
+    TEST_ASSERT_EQUAL(1, cloud.publishes);
+    TEST_ASSERT_EQUAL(42, cloud.last[2]);
+
+    TEST_ASSERT_EQUAL(ESP_OK, app_report_get_stats(report, &stats));
+    TEST_ASSERT_UINT32_WITHIN(10 * 1000, TEST_WINDOW_MS * 1000, stats.latency_max_us);
+
+    /**< By hand, right away */
+    TEST_ASSERT_EQUAL(ESP_OK, app_report_update(report, &g_params[2], 43));
+    TEST_ASSERT_EQUAL(ESP_OK, app_report_flush(report));
+    TEST_ASSERT_EQUAL(2, cloud.publishes);
+    TEST_ASSERT_EQUAL(43, cloud.last[2]);
+
+    /**< Nothing pending, nothing sent */
+    TEST_ASSERT_EQUAL(ESP_OK, app_report_flush(report));
+    vTaskDelay(pdMS_TO_TICKS(TEST_INTERVAL_MS + TEST_WINDOW_MS));
+    TEST_ASSERT_EQUAL(2, cloud.publishes);
+
+    TEST_ASSERT_EQUAL(ESP_OK, app_report_delete(report));
+}
+
+typedef struct {
+    int      publishes;
+    int64_t  start_us[2];
+    bool     in_timer_task;
+} slow_cloud_t;
+
+static esp_err_t slow_flush_cb(const app_report_update_t *updates, size_t num, void *arg)
+{
+    slow_cloud_t *cloud = (slow_cloud_t *)arg;
+
+    if (cloud->publishes < 2) {
+        cloud->start_us[cloud->publishes] = esp_timer_get_time();
+    }
+
+    cloud->in_timer_task |= !strcmp(pcTaskGetName(NULL), "esp_timer");
+    cloud->publishes++;
+    vTaskDelay(pdMS_TO_TICKS(TEST_PUBLISH_MS));
+    return ESP_OK;
+}
+
+TEST_CASE("app_report keeps the interval from the start of a slow report", "[app_report]")
+{
+    slow_cloud_t cloud = {0};
+    const app_report_config_t config = {
+        .window_ms       = TEST_WINDOW_MS,
+        .min_interval_ms = TEST_INTERVAL_MS,
+        .flush_cb        = slow_flush_cb,
+        .arg             = &cloud,
+    };
+    app_report_handle_t report = NULL;
+
+    TEST_ASSERT_EQUAL(ESP_OK, app_report_create(&config, &report));
+
+    /**< The second value arrives while the first report is being published */
+    TEST_ASSERT_EQUAL(ESP_OK, app_report_update(report, &g_params[0], 1));
+    vTaskDelay(pdMS_TO_TICKS(TEST_WINDOW_MS + TEST_PUBLISH_MS / 2));
+    TEST_ASSERT_EQUAL(1, cloud.publishes);
+    TEST_ASSERT_EQUAL(ESP_OK, app_report_update(report, &g_params[0], 2));
+
+    vTaskDelay(pdMS_TO_TICKS(TEST_INTERVAL_MS + TEST_PUBLISH_MS));
+    TEST_ASSERT_EQUAL(2, cloud.publishes);
+    TEST_ASSERT_FALSE(cloud.in_timer_task);
+
+    /**< Not min_interval_ms after the end of the first one */
+    int64_t gap_us = cloud.start_us[1] - cloud.start_us[0];
+    TEST_ASSERT_GREATER_OR_EQUAL(TEST_INTERVAL_MS * 1000, gap_us);
+    TEST_ASSERT_LESS_THAN((TEST_INTERVAL_MS + TEST_PUBLISH_MS) * 1000, gap_us);
+
+    TEST_ASSERT_EQUAL(ESP_OK, app_report_delete(report));
+}
@@ -16,13 +16,258 @@
 #include "stdio.h"
 #include "stdlib.h"
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/timers.h"
+
+#include "esp_system.h"
+#include "esp_timer.h"
 #include "nvs.h"
 #include "nvs_flash.h"
 
 #include "app_storage.h"
 
+#define APP_STORAGE_SLOTS            CONFIG_APP_STORAGE_CACHE_SLOTS
+#define APP_STORAGE_MIRROR_MAX_SIZE  CONFIG_APP_STORAGE_CACHE_VALUE_MAX_SIZE
+
+#ifdef CONFIG_APP_STORAGE_WRITE_BEHIND
+#define APP_STORAGE_DEBOUNCE_US      ((int64_t)CONFIG_APP_STORAGE_DEBOUNCE_MS * 1000)
+#define APP_STORAGE_MAX_STALENESS_US ((int64_t)CONFIG_APP_STORAGE_MAX_STALENESS_MS * 1000)
+#endif
+
+/**
+ * @brief A key whose latest value is held in RAM
+ */
+typedef struct {
+    char     key[NVS_KEY_NAME_MAX_SIZE];
+    void    *value;
+    size_t   length;
+    bool     dirty;            /**< Value differs from flash, written by the write-behind timer */
+    int64_t  dirty_since_us;   /**< Time of the first write since the last flush */
+    uint32_t last_used;        /**< Access sequence number, the least recently used clean slot is evicted */
+} app_storage_slot_t;
+
 static const char *TAG = "app_storage";
 
+static app_storage_stats_t g_storage_stats = {0};
+static app_storage_slot_t g_storage_slots[APP_STORAGE_SLOTS] = {0};
+static uint32_t g_storage_use_seq          = 0;
+static nvs_handle g_storage_handle         = 0;
+static SemaphoreHandle_t g_storage_lock    = NULL;  /**< Recursive, held by the task owning a transaction */
+static int g_storage_txn_depth             = 0;
+static bool g_storage_txn_pending          = false;
+
+#ifdef CONFIG_APP_STORAGE_WRITE_BEHIND
+static TimerHandle_t g_storage_timer       = NULL;
+#endif
+
+#define STORAGE_LOCK()   xSemaphoreTakeRecursive(g_storage_lock, portMAX_DELAY)
+#define STORAGE_UNLOCK() xSemaphoreGiveRecursive(g_storage_lock)
+
+/* -------------------- RAM mirror -------------------- */
+
+static app_storage_slot_t *storage_slot_find(const char *key)
+{
+    for (int i = 0; i < APP_STORAGE_SLOTS; i++) {
+        if (g_storage_slots[i].value && !strcmp(g_storage_slots[i].key, key)) {
+            g_storage_slots[i].last_used = ++g_storage_use_seq;
+            return g_storage_slots + i;
+        }
+    }
+
+    return NULL;
+}
+
+static void storage_slot_drop(app_storage_slot_t *slot)
+{
+    free(slot->value);
+    memset(slot, 0, sizeof(app_storage_slot_t));
+}
+
+/**
+ * @brief Find the slot of key, or claim a free one, or evict the least recently used clean one
+ */
+static app_storage_slot_t *storage_slot_get(const char *key)
+{
+    app_storage_slot_t *slot   = storage_slot_find(key);
+    app_storage_slot_t *victim = NULL;
+
+    for (int i = 0; i < APP_STORAGE_SLOTS && !slot; i++) {
+        if (!g_storage_slots[i].value) {
+            slot = g_storage_slots + i;
+        } else if (!g_storage_slots[i].dirty
+                   && (!victim || g_storage_slots[i].last_used < victim->last_used)) {
+            victim = g_storage_slots + i;
+        }
+    }
+
+    if (!slot && victim) {
+        storage_slot_drop(victim);
+        slot = victim;
+    }
+
+    return slot;
+}
+
+/**
+ * @brief Copy value into the slot of key, returns NULL if no slot could be used
+ */
+static app_storage_slot_t *storage_slot_store(const char *key, const void *value, size_t length)
+{
+    app_storage_slot_t *slot = storage_slot_get(key);
+
+    if (!slot) {
+        return NULL;
+    }
+
+    if (slot->length != length) {
+        void *buf = realloc(slot->value, length);
+
+        if (!buf) {
+            storage_slot_drop(slot);
+            return NULL;
+        }
+
+        slot->value  = buf;
+        slot->length = length;
+    }
+
+    strncpy(slot->key, key, NVS_KEY_NAME_MAX_SIZE - 1);
+    memcpy(slot->value, value, length);
+    slot->last_used = ++g_storage_use_seq;
+
+    return slot;
+}
+
+/**
+ * @brief Drop the cached value of key, or of every key if key is the namespace
+ */
+static void storage_slot_invalidate(const char *key)
+{
+    for (int i = 0; i < APP_STORAGE_SLOTS; i++) {
+        if (g_storage_slots[i].value && (!strcmp(key, CONFIG_RAINMAKER_APP_PARTITION_NAMESPACE)
+                                         || !strcmp(g_storage_slots[i].key, key))) {
+            storage_slot_drop(g_storage_slots + i);
+        }
+    }
+}
+
+/* -------------------- NVS access, g_storage_lock held -------------------- */
+
+static esp_err_t storage_commit_locked(void)
+{
+    if (g_storage_txn_depth > 0) {
+        g_storage_txn_pending = true;
+        return ESP_OK;
+    }
+
+    /**< Write any pending changes to non-volatile storage */
+    esp_err_t ret = nvs_commit(g_storage_handle);
+    g_storage_stats.commit_count++;
+    g_storage_txn_pending = false;
+
+    return ret;
+}
+
+static esp_err_t storage_write_locked(const char *key, const void *value, size_t length)
+{
+    /**< set variable length binary value for given key */
+    esp_err_t ret = nvs_set_blob(g_storage_handle, key, value, length);
+    g_storage_stats.write_count++;
+    APP_STORAGE_ERROR_CHECK(ret != ESP_OK, ret, "Set value for given key, key: %s", key);
+
+    return storage_commit_locked();
+}
+
+#ifdef CONFIG_APP_STORAGE_WRITE_BEHIND
+
+static esp_err_t storage_flush_locked(void)
+{
+    esp_err_t ret = ESP_OK;
+    bool written[APP_STORAGE_SLOTS] = {0};
+    bool dirty = false;
+
+    xTimerStop(g_storage_timer, 0);
+
+    /**< All dirty slots share one commit */
+    g_storage_txn_depth++;
+
+    for (int i = 0; i < APP_STORAGE_SLOTS; i++) {
+        app_storage_slot_t *slot = g_storage_slots + i;
+
+        if (!slot->dirty) {
+            continue;
+        }
+
+        esp_err_t err = storage_write_locked(slot->key, slot->value, slot->length);
+
+        if (err != ESP_OK) {
+            ret = err;
+            dirty = true;
+            continue;
+        }
+
+        slot->dirty = false;
+        written[i]  = true;
+    }
+
+    if (--g_storage_txn_depth == 0 && g_storage_txn_pending) {
+        esp_err_t err = storage_commit_locked();
+
+        /**< The values written are not on flash, write them again on the next flush */
+        if (err != ESP_OK) {
+            ret = err;
+
+            for (int i = 0; i < APP_STORAGE_SLOTS; i++) {
+                g_storage_slots[i].dirty |= written[i];
+                dirty |= written[i];
+            }
+        }
+    }
+
+    /**< Retry after a debounce period rather than at once, the stale slots would otherwise retry every tick */
+    if (dirty) {
+        TickType_t ticks = pdMS_TO_TICKS(CONFIG_APP_STORAGE_DEBOUNCE_MS);
+        xTimerChangePeriod(g_storage_timer, ticks ? ticks : 1, 0);
+    }
+
+    return ret;
+}
+
+static void storage_timer_cb(TimerHandle_t timer)
+{
+    STORAGE_LOCK();
+    storage_flush_locked();
+    STORAGE_UNLOCK();
+}
+
+/**
+ * @brief Re-arm the flush timer for the earliest of the debounce and staleness deadlines
+ */
+static void storage_timer_arm_locked(int64_t now)
+{
+    int64_t deadline = now + APP_STORAGE_DEBOUNCE_US;
+
+    for (int i = 0; i < APP_STORAGE_SLOTS; i++) {
+        if (g_storage_slots[i].dirty
+                && g_storage_slots[i].dirty_since_us + APP_STORAGE_MAX_STALENESS_US < deadline) {
+            deadline = g_storage_slots[i].dirty_since_us + APP_STORAGE_MAX_STALENESS_US;
+        }
+    }
+
+    TickType_t ticks = pdMS_TO_TICKS((deadline > now ? deadline - now : 0) / 1000);
+    xTimerChangePeriod(g_storage_timer, ticks ? ticks : 1, 0);
+}
+
+static void storage_shutdown_handler(void)
+{
+    app_storage_flush();
+}
+
+#endif /**< CONFIG_APP_STORAGE_WRITE_BEHIND */
+
+/* -------------------- Public API -------------------- */
+
 esp_err_t app_storage_init()
 {
     static bool init_flag = false;
@@ -39,6 +284,22 @@ esp_err_t app_storage_init()
 
         ESP_ERROR_CHECK(ret);
 
+        /**< The namespace stays open for the lifetime of the application */
+        ret = nvs_open(CONFIG_RAINMAKER_APP_PARTITION_NAMESPACE, NVS_READWRITE, &g_storage_handle);
+        APP_STORAGE_ERROR_CHECK(ret != ESP_OK, ret, "Open non-volatile storage");
+
+        g_storage_lock = xSemaphoreCreateRecursiveMutex();
+        APP_STORAGE_ERROR_CHECK(!g_storage_lock, ESP_ERR_NO_MEM, "Create storage lock");
+
+#ifdef CONFIG_APP_STORAGE_WRITE_BEHIND
+        g_storage_timer = xTimerCreate("app_storage", 1, pdFALSE, NULL, storage_timer_cb);
+        APP_STORAGE_ERROR_CHECK(!g_storage_timer, ESP_ERR_NO_MEM, "Create write-behind timer");
+
+        /**< Pending values must reach flash before esp_restart() */
+        ret = esp_register_shutdown_handler(storage_shutdown_handler);
+        APP_STORAGE_ERROR_CHECK(ret != ESP_OK, ret, "Register shutdown handler");
+#endif
+
         init_flag = true;
     }
 
@@ -48,28 +309,28 @@ esp_err_t app_storage_init()
 esp_err_t app_storage_erase(const char *key)
 {
     APP_STORAGE_PARAM_CHECK(key);
+    APP_STORAGE_ERROR_CHECK(!g_storage_lock, ESP_ERR_INVALID_STATE, "app_storage_init() must be called first");
 
-    esp_err_t ret    = ESP_OK;
-    nvs_handle handle = 0;
+    esp_err_t ret = ESP_OK;
 
-    /**< Open non-volatile storage with a given namespace from the default NVS partition */
-    ret = nvs_open(CONFIG_RAINMAKER_APP_PARTITION_NAMESPACE, NVS_READWRITE, &handle);
-    APP_STORAGE_ERROR_CHECK(ret != ESP_OK, ret, "Open non-volatile storage");
+    STORAGE_LOCK();
+
+    storage_slot_invalidate(key);
 
     /**
      * @brief If key is CONFIG_RAINMAKER_APP_PARTITION_NAMESPACE, erase all info in CONFIG_RAINMAKER_APP_PARTITION_NAMESPACE
      */
     if (!strcmp(key, CONFIG_RAINMAKER_APP_PARTITION_NAMESPACE)) {
-        ret = nvs_erase_all(handle);
+        ret = nvs_erase_all(g_storage_handle);
     } else {
-        ret = nvs_erase_key(handle, key);
+        ret = nvs_erase_key(g_storage_handle, key);
     }
 
-    /**< Write any pending changes to non-volatile storage */
-    nvs_commit(handle);
+    if (ret == ESP_OK) {
+        storage_commit_locked();
+    }
 
-    /**< Close the storage handle and free any allocated resources */
-    nvs_close(handle);
+    STORAGE_UNLOCK();
 
     APP_STORAGE_ERROR_CHECK(ret != ESP_OK && ret != ESP_ERR_NVS_NOT_FOUND,
                     ret, "Erase key-value pair, key: %s", key);
@@ -82,24 +343,132 @@ esp_err_t app_storage_set(const char *key, const void *value, size_t length)
     APP_STORAGE_PARAM_CHECK(key);
     APP_STORAGE_PARAM_CHECK(value);
     APP_STORAGE_PARAM_CHECK(length > 0);
+    APP_STORAGE_ERROR_CHECK(!g_storage_lock, ESP_ERR_INVALID_STATE, "app_storage_init() must be called first");
 
-    esp_err_t ret     = ESP_OK;
-    nvs_handle handle = 0;
+    esp_err_t ret = ESP_OK;
 
-    /**< Open non-volatile storage with a given namespace from the default NVS partition */
-    ret = nvs_open(CONFIG_RAINMAKER_APP_PARTITION_NAMESPACE, NVS_READWRITE, &handle);
-    APP_STORAGE_ERROR_CHECK(ret != ESP_OK, ret, "Open non-volatile storage");
+    STORAGE_LOCK();
 
-    /**< set variable length binary value for given key */
-    ret = nvs_set_blob(handle, key, value, length);
+    g_storage_stats.set_count++;
 
-    /**< Write any pending changes to non-volatile storage */
-    nvs_commit(handle);
+    /**< A synchronous write supersedes any pending value of the same key */
+    storage_slot_invalidate(key);
 
-    /**< Close the storage handle and free any allocated resources */
-    nvs_close(handle);
+    ret = storage_write_locked(key, value, length);
 
-    APP_STORAGE_ERROR_CHECK(ret != ESP_OK, ret, "Set value for given key, key: %s", key);
+    if (ret == ESP_OK && length <= APP_STORAGE_MIRROR_MAX_SIZE) {
+        storage_slot_store(key, value, length);
+    }
+
+    STORAGE_UNLOCK();
+
+    return ret;
+}
+
+esp_err_t app_storage_set_lazy(const char *key, const void *value, size_t length)
+{
+#ifdef CONFIG_APP_STORAGE_WRITE_BEHIND
+    APP_STORAGE_PARAM_CHECK(key);
+    APP_STORAGE_PARAM_CHECK(value);
+    APP_STORAGE_PARAM_CHECK(length > 0);
+    APP_STORAGE_PARAM_CHECK(strlen(key) < NVS_KEY_NAME_MAX_SIZE);
+    APP_STORAGE_ERROR_CHECK(!g_storage_lock, ESP_ERR_INVALID_STATE, "app_storage_init() must be called first");
+
+    STORAGE_LOCK();
+
+    app_storage_slot_t *slot = storage_slot_find(key);
+
+    /**< Nothing to do if the cached value is already the requested one */
+    if (slot && slot->length == length && !memcmp(slot->value, value, length)) {
+        g_storage_stats.set_count++;
+        STORAGE_UNLOCK();
+        return ESP_OK;
+    }
+
+    bool dirty      = slot && slot->dirty;
+    int64_t since   = slot ? slot->dirty_since_us : 0;
+
+    slot = storage_slot_store(key, value, length);
+
+    if (!slot) {
+        STORAGE_UNLOCK();
+        ESP_LOGD(TAG, "No free write-behind slot, write through, key: %s", key);
+        return app_storage_set(key, value, length);
+    }
+
+    int64_t now = esp_timer_get_time();
+
+    g_storage_stats.set_count++;
+    slot->dirty          = true;
+    slot->dirty_since_us = dirty ? since : now;
+
+    storage_timer_arm_locked(now);
+
+    STORAGE_UNLOCK();
+
+    return ESP_OK;
+#else
+    return app_storage_set(key, value, length);
+#endif /**< CONFIG_APP_STORAGE_WRITE_BEHIND */
+}
+
+esp_err_t app_storage_flush(void)
+{
+#ifdef CONFIG_APP_STORAGE_WRITE_BEHIND
+    if (!g_storage_lock) {
+        return ESP_OK;
+    }
+
+    STORAGE_LOCK();
+    esp_err_t ret = storage_flush_locked();
+    STORAGE_UNLOCK();
+
+    return ret;
+#else
+    return ESP_OK;
+#endif
+}
+
+esp_err_t app_storage_txn_begin(void)
+{
+    APP_STORAGE_ERROR_CHECK(!g_storage_lock, ESP_ERR_INVALID_STATE, "app_storage_init() must be called first");
+
+    /**< Released by app_storage_txn_commit() */
+    STORAGE_LOCK();
+    g_storage_txn_depth++;
+
+    return ESP_OK;
+}
+
+esp_err_t app_storage_txn_commit(void)
+{
+    APP_STORAGE_ERROR_CHECK(!g_storage_lock, ESP_ERR_INVALID_STATE, "app_storage_init() must be called first");
+
+    esp_err_t ret = ESP_OK;
+
+    STORAGE_LOCK();
+
+    if (g_storage_txn_depth <= 0) {
+        STORAGE_UNLOCK();
+        ESP_LOGW(TAG, "<ESP_ERR_INVALID_STATE> No transaction in progress");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (--g_storage_txn_depth == 0 && g_storage_txn_pending) {
+        ret = storage_commit_locked();
+    }
+
+    STORAGE_UNLOCK();   /**< Taken above */
+    STORAGE_UNLOCK();   /**< Taken by app_storage_txn_begin() */
+
+    return ret;
+}
+
+esp_err_t app_storage_get_stats(app_storage_stats_t *stats)
+{
+    APP_STORAGE_PARAM_CHECK(stats);
+
+    *stats = g_storage_stats;
 
     return ESP_OK;
 }
@@ -109,19 +478,37 @@ esp_err_t app_storage_get(const char *key, void *value, size_t length)
     APP_STORAGE_PARAM_CHECK(key);
     APP_STORAGE_PARAM_CHECK(value);
     APP_STORAGE_PARAM_CHECK(length > 0);
+    APP_STORAGE_ERROR_CHECK(!g_storage_lock, ESP_ERR_INVALID_STATE, "app_storage_init() must be called first");
+
+    esp_err_t ret = ESP_OK;
 
-    esp_err_t ret     = ESP_OK;
-    nvs_handle handle = 0;
+    STORAGE_LOCK();
 
-    /**< Open non-volatile storage with a given namespace from the default NVS partition */
-    ret = nvs_open(CONFIG_RAINMAKER_APP_PARTITION_NAMESPACE, NVS_READWRITE, &handle);
-    APP_STORAGE_ERROR_CHECK(ret != ESP_OK, ret, "Open non-volatile storage");
+    /**< The RAM copy is always at least as new as flash */
+    app_storage_slot_t *slot = storage_slot_find(key);
+
+    if (slot) {
+        if (slot->length > length) {
+            ret = ESP_ERR_NVS_INVALID_LENGTH;
+        } else {
+            memcpy(value, slot->value, slot->length);
+            g_storage_stats.cache_hit_count++;
+        }
+
+        STORAGE_UNLOCK();
+        APP_STORAGE_ERROR_CHECK(ret != ESP_OK, ret, "Get value for given key, key: %s", key);
+        return ESP_OK;
+    }
 
     /**< get variable length binary value for given key */
-    ret = nvs_get_blob(handle, key, value, &length);
+    ret = nvs_get_blob(g_storage_handle, key, value, &length);
+    g_storage_stats.read_count++;
+
+    if (ret == ESP_OK && length <= APP_STORAGE_MIRROR_MAX_SIZE) {
+        storage_slot_store(key, value, length);
+    }
 
-    /**< Close the storage handle and free any allocated resources */
-    nvs_close(handle);
+    STORAGE_UNLOCK();
 
     if (ret == ESP_ERR_NVS_NOT_FOUND) {
         ESP_LOGD(TAG, "<ESP_ERR_NVS_NOT_FOUND> Get value for given key, key: %s", key);
@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <stdint.h>
+#include <stddef.h>
 #include <esp_err.h>
 #include <esp_log.h>
 
@@ -94,6 +96,82 @@ esp_err_t app_storage_get(const char *key, void *value, size_t length);
  */
 esp_err_t app_storage_erase(const char *key);
 
+/**
+ * @brief Storage statistics
+ */
+typedef struct {
+    uint32_t set_count;       /**< Number of app_storage_set() / app_storage_set_lazy() calls */
+    uint32_t write_count;     /**< Number of values actually written with nvs_set_blob() */
+    uint32_t commit_count;    /**< Number of nvs_commit() calls */
+    uint32_t read_count;      /**< Number of values actually read with nvs_get_blob() */
+    uint32_t cache_hit_count; /**< Number of app_storage_get() calls served from RAM */
+} app_storage_stats_t;
+
+/**
+ * @brief  Save the information with given key, deferring the flash write
+ *
+ * @note   The value is kept in RAM and written once no new value has arrived for
+ *         CONFIG_APP_STORAGE_DEBOUNCE_MS, or at the latest CONFIG_APP_STORAGE_MAX_STALENESS_MS
+ *         after it first became dirty. Only the last value of a burst reaches flash.
+ *         app_storage_get() returns the pending value. Falls back to app_storage_set()
+ *         when CONFIG_APP_STORAGE_WRITE_BEHIND is disabled or no slot is free.
+ *
+ * @param  key    Key name. Maximal length is 15 characters. Shouldn't be empty.
+ * @param  value  The value to set.
+ * @param  length length of binary value to set, in bytes
+ *
+ * @return
+ *     - ESP_ERR_NO_MEM
+ *     - ESP_FAIL
+ *     - ESP_OK
+ */
+esp_err_t app_storage_set_lazy(const char *key, const void *value, size_t length);
+
+/**
+ * @brief  Write every pending value to flash with a single commit
+ *
+ * @note   Called automatically before restart, see esp_register_shutdown_handler().
+ *
+ * @return
+ *     - ESP_FAIL
+ *     - ESP_OK
+ */
+esp_err_t app_storage_flush(void);
+
+/**
+ * @brief  Start a transaction, values set until app_storage_txn_commit() share one nvs_commit
+ *
+ * @attention  The storage is locked for other tasks until the matching app_storage_txn_commit().
+ *             Transactions may be nested, only the outermost commit reaches flash.
+ *             NVS has no rollback, values are visible to app_storage_get() as soon as they are set.
+ *
+ * @return
+ *     - ESP_ERR_INVALID_STATE
+ *     - ESP_OK
+ */
+esp_err_t app_storage_txn_begin(void);
+
+/**
+ * @brief  End a transaction started with app_storage_txn_begin()
+ *
+ * @return
+ *     - ESP_ERR_INVALID_STATE
+ *     - ESP_FAIL
+ *     - ESP_OK
+ */
+esp_err_t app_storage_txn_commit(void);
+
+/**
+ * @brief  Get the storage statistics
+ *
+ * @param  stats Pointer to the statistics to fill
+ *
+ * @return
+ *     - ESP_ERR_INVALID_ARG
+ *     - ESP_OK
+ */
+esp_err_t app_storage_get_stats(app_storage_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,341 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stdio.h"
+#include "string.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "unity.h"
+#include "app_storage.h"
+
+static const char *TAG = "APP_STORAGE TEST";
+
+#define TEST_STORE_KEY        "test_status"
+#define SLIDER_PERIOD_MS      20    /**< RainMaker slider update rate while dragging */
+
+typedef struct {
+    uint16_t hue;
+    uint8_t  saturation;
+    uint8_t  value;
+} test_status_t;
+
+/**
+ * @brief Mocked NVS backend: every call is counted, then forwarded to the real NVS unless it is set to fail
+ */
+typedef struct {
+    uint32_t open;
+    uint32_t close;
+    uint32_t set;
+    uint32_t get;
+    uint32_t commit;
+} nvs_ops_t;
+
+static nvs_ops_t g_nvs_ops = {0};
+static esp_err_t g_nvs_set_error    = ESP_OK;
+static esp_err_t g_nvs_commit_error = ESP_OK;
+
+esp_err_t __real_nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle);
+void __real_nvs_close(nvs_handle_t handle);
+esp_err_t __real_nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length);
+esp_err_t __real_nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length);
+esp_err_t __real_nvs_commit(nvs_handle_t handle);
+
+esp_err_t __wrap_nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    g_nvs_ops.open++;
+    return __real_nvs_open(name, open_mode, out_handle);
+}
+
+void __wrap_nvs_close(nvs_handle_t handle)
+{
+    g_nvs_ops.close++;
+    __real_nvs_close(handle);
+}
+
+esp_err_t __wrap_nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    g_nvs_ops.set++;
+    return g_nvs_set_error ? g_nvs_set_error : __real_nvs_set_blob(handle, key, value, length);
+}
+
+esp_err_t __wrap_nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    g_nvs_ops.get++;
+    return __real_nvs_get_blob(handle, key, out_value, length);
+}
+
+esp_err_t __wrap_nvs_commit(nvs_handle_t handle)
+{
+    g_nvs_ops.commit++;
+    return g_nvs_commit_error ? g_nvs_commit_error : __real_nvs_commit(handle);
+}
+
+static uint32_t nvs_ops_total(void)
+{
+    return g_nvs_ops.open + g_nvs_ops.close + g_nvs_ops.set + g_nvs_ops.get + g_nvs_ops.commit;
+}
+
+/**
+ * @brief The app_storage_set() of the previous release: open, set, commit, close per write
+ */
+static void legacy_storage_set(const char *key, const void *value, size_t length)
+{
+    nvs_handle handle = 0;
+
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_open(CONFIG_RAINMAKER_APP_PARTITION_NAMESPACE, NVS_READWRITE, &handle));
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_set_blob(handle, key, value, length));
+    nvs_commit(handle);
+    nvs_close(handle);
+}
+
+/**
+ * @brief The app_storage_get() of the previous release: open, get, close per read
+ */
+static void legacy_storage_get(const char *key, void *value, size_t length)
+{
+    nvs_handle handle = 0;
+
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_open(CONFIG_RAINMAKER_APP_PARTITION_NAMESPACE, NVS_READWRITE, &handle));
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_get_blob(handle, key, value, &length));
+    nvs_close(handle);
+}
+
+#define BENCH_ROUNDS    10
+#define BENCH_KEYS      3
+
+static const char *g_bench_keys[BENCH_KEYS] = {"light_status", "user_preset", "schedule"};
+
+static void bench_report(const char *name, uint32_t logical, uint32_t ops)
+{
+    /**< Fixed point, two decimals, printf may lack float support */
+    uint32_t per_write = ops * 100 / logical;
+    printf("%-26s %4u logical, %4u flash ops, %2u.%02u ops per logical op\n",
+           name, (unsigned)logical, (unsigned)ops, (unsigned)(per_write / 100), (unsigned)(per_write % 100));
+}
+
+TEST_CASE("app_storage flash operations per logical write", "[app_storage][bench]")
+{
+    test_status_t status = {0};
+    uint32_t ops         = 0;
+
+    TEST_ASSERT_EQUAL(ESP_OK, app_storage_init());
+
+    /**< Before: every write opens, commits and closes the namespace */
+    ops = nvs_ops_total();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (int key = 0; key < BENCH_KEYS; key++) {
+            status.hue = round;
+            legacy_storage_set(g_bench_keys[key], &status, sizeof(status));
+        }
+    }
+    ops = nvs_ops_total() - ops;
+    bench_report("legacy set", BENCH_ROUNDS * BENCH_KEYS, ops);
+    TEST_ASSERT_EQUAL(4 * BENCH_ROUNDS * BENCH_KEYS, ops);
+
+    /**< After: the cached handle leaves set + commit */
+    ops = nvs_ops_total();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (int key = 0; key < BENCH_KEYS; key++) {
+            status.hue = round;
+            TEST_ASSERT_EQUAL(ESP_OK, app_storage_set(g_bench_keys[key], &status, sizeof(status)));
+        }
+    }
+    ops = nvs_ops_total() - ops;
+    bench_report("app_storage_set", BENCH_ROUNDS * BENCH_KEYS, ops);
+    TEST_ASSERT_EQUAL(2 * BENCH_ROUNDS * BENCH_KEYS, ops);
+
+    /**< After: one commit for all keys of a round */
+    ops = nvs_ops_total();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        TEST_ASSERT_EQUAL(ESP_OK, app_storage_txn_begin());
+        for (int key = 0; key < BENCH_KEYS; key++) {
+            status.hue = round;
+            TEST_ASSERT_EQUAL(ESP_OK, app_storage_set(g_bench_keys[key], &status, sizeof(status)));
+        }
+        TEST_ASSERT_EQUAL(ESP_OK, app_storage_txn_commit());
+    }
+    ops = nvs_ops_total() - ops;
+    bench_report("app_storage_txn", BENCH_ROUNDS * BENCH_KEYS, ops);
+    TEST_ASSERT_EQUAL((BENCH_KEYS + 1) * BENCH_ROUNDS, ops);
+
+#ifdef CONFIG_APP_STORAGE_WRITE_BEHIND
+    /**< After: a burst collapses into one write per key and one commit */
+    ops = nvs_ops_total();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (int key = 0; key < BENCH_KEYS; key++) {
+            status.hue = 100 + round;
+            TEST_ASSERT_EQUAL(ESP_OK, app_storage_set_lazy(g_bench_keys[key], &status, sizeof(status)));
+        }
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, app_storage_flush());
+    ops = nvs_ops_total() - ops;
+    bench_report("app_storage_set_lazy", BENCH_ROUNDS * BENCH_KEYS, ops);
+    TEST_ASSERT_EQUAL(BENCH_KEYS + 1, ops);
+#endif
+
+    /**< Boot: the same key is read repeatedly */
+    ops = nvs_ops_total();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        legacy_storage_get(g_bench_keys[0], &status, sizeof(status));
+    }
+    ops = nvs_ops_total() - ops;
+    bench_report("legacy get", BENCH_ROUNDS, ops);
+
+    ops = nvs_ops_total();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        TEST_ASSERT_EQUAL(ESP_OK, app_storage_get(g_bench_keys[0], &status, sizeof(status)));
+    }
+    ops = nvs_ops_total() - ops;
+    bench_report("app_storage_get", BENCH_ROUNDS, ops);
+    TEST_ASSERT_LESS_OR_EQUAL(1, ops);
+
+    for (int key = 0; key < BENCH_KEYS; key++) {
+        TEST_ASSERT_EQUAL(ESP_OK, app_storage_erase(g_bench_keys[key]));
+    }
+}
+
+#ifdef CONFIG_APP_STORAGE_WRITE_BEHIND
+
+static void read_from_flash(test_status_t *status)
+{
+    nvs_handle handle = 0;
+    size_t length     = sizeof(test_status_t);
+
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_open(CONFIG_RAINMAKER_APP_PARTITION_NAMESPACE, NVS_READONLY, &handle));
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_get_blob(handle, TEST_STORE_KEY, status, &length));
+    nvs_close(handle);
+}
+
+/**
+ * @brief Drag the hue slider: one write every SLIDER_PERIOD_MS for duration_ms
+ */
+static void slider_drag(uint32_t duration_ms, test_status_t *last)
+{
+    for (uint32_t t = 0; t < duration_ms; t += SLIDER_PERIOD_MS) {
+        last->hue        = (t / SLIDER_PERIOD_MS) % 360;
+        last->saturation = 100;
+        last->value      = 80;
+        TEST_ASSERT_EQUAL(ESP_OK, app_storage_set_lazy(TEST_STORE_KEY, last, sizeof(test_status_t)));
+        vTaskDelay(pdMS_TO_TICKS(SLIDER_PERIOD_MS));
+    }
+}
+
+TEST_CASE("app_storage write-behind coalesces a slider drag", "[app_storage]")
+{
+    app_storage_stats_t before = {0};
+    app_storage_stats_t after  = {0};
+    test_status_t last         = {0};
+    test_status_t stored       = {0};
+    uint32_t duration_ms       = CONFIG_APP_STORAGE_MAX_STALENESS_MS / 2;
+
+    TEST_ASSERT_EQUAL(ESP_OK, app_storage_init());
+    TEST_ASSERT_EQUAL(ESP_OK, app_storage_erase(TEST_STORE_KEY));
+    TEST_ASSERT_EQUAL(ESP_OK, app_storage_get_stats(&before));
+
+    slider_drag(duration_ms, &last);
+
+    /**< Reads see the pending value before it reaches flash */
+    TEST_ASSERT_EQUAL(ESP_OK, app_storage_get(TEST_STORE_KEY, &stored, sizeof(test_status_t)));
+    TEST_ASSERT_EQUAL_MEMORY(&last, &stored, sizeof(test_status_t));
+
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_APP_STORAGE_DEBOUNCE_MS + 100));
+    TEST_ASSERT_EQUAL(ESP_OK, app_storage_get_stats(&after));
+
+    ESP_LOGI(TAG, "%u updates -> %u writes, %u commits",
+             (unsigned)(after.set_count - before.set_count),
+             (unsigned)(after.write_count - before.write_count),
+             (unsigned)(after.commit_count - before.commit_count));
+
+    TEST_ASSERT_EQUAL(duration_ms / SLIDER_PERIOD_MS, after.set_count - before.set_count);
+    TEST_ASSERT_EQUAL(1, after.write_count - before.write_count);
+    TEST_ASSERT_EQUAL(1, after.commit_count - before.commit_count);
+
+    read_from_flash(&stored);
+    TEST_ASSERT_EQUAL_MEMORY(&last, &stored, sizeof(test_status_t));
+}
+
+TEST_CASE("app_storage write-behind honours the staleness bound", "[app_storage]")
+{
+    app_storage_stats_t before = {0};
+    app_storage_stats_t after  = {0};
+    test_status_t last         = {0};
+    test_status_t stored       = {0};
+    uint32_t duration_ms       = CONFIG_APP_STORAGE_MAX_STALENESS_MS * 5 / 2;
+
+    TEST_ASSERT_EQUAL(ESP_OK, app_storage_init());
+    TEST_ASSERT_EQUAL(ESP_OK, app_storage_get_stats(&before));
+
+    /**< The debounce window never expires while dragging, the staleness bound must */
+    slider_drag(duration_ms, &last);
+    TEST_ASSERT_EQUAL(ESP_OK, app_storage_get_stats(&after));
+    TEST_ASSERT_EQUAL(2, after.commit_count - before.commit_count);
+
+    TEST_ASSERT_EQUAL(ESP_OK, app_storage_flush());
+    TEST_ASSERT_EQUAL(ESP_OK, app_storage_get_stats(&after));
+    TEST_ASSERT_EQUAL(3, after.commit_count - before.commit_count);
+
+    read_from_flash(&stored);
+    TEST_ASSERT_EQUAL_MEMORY(&last, &stored, sizeof(test_status_t));
+
+    /**< Nothing is pending any more */
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_APP_STORAGE_DEBOUNCE_MS + 100));
+    TEST_ASSERT_EQUAL(ESP_OK, app_storage_get_stats(&before));
+    TEST_ASSERT_EQUAL(after.commit_count, before.commit_count);
+}
+
+TEST_CASE("app_storage write-behind retries a failed flush", "[app_storage]")
+{
+    test_status_t status = {.hue = 120, .saturation = 50, .value = 30};
+    test_status_t stored = {0};
+
+    TEST_ASSERT_EQUAL(ESP_OK, app_storage_init());
+    TEST_ASSERT_EQUAL(ESP_OK, app_storage_erase(TEST_STORE_KEY));
+
+    /**< The write fails: the value stays pending and the timer tries again */
+    g_nvs_set_error = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    TEST_ASSERT_EQUAL(ESP_OK, app_storage_set_lazy(TEST_STORE_KEY, &status, sizeof(test_status_t)));
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_APP_STORAGE_DEBOUNCE_MS + 100));
+    g_nvs_set_error = ESP_OK;
+    TEST_ASSERT_EQUAL(ESP_OK, app_storage_get(TEST_STORE_KEY, &stored, sizeof(test_status_t)));
+    TEST_ASSERT_EQUAL_MEMORY(&status, &stored, sizeof(test_status_t));
+
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_APP_STORAGE_DEBOUNCE_MS + 100));
+    read_from_flash(&stored);
+    TEST_ASSERT_EQUAL_MEMORY(&status, &stored, sizeof(test_status_t));
+
+    /**< The commit fails: its error is returned and the value is written again */
+    status.hue = 240;
+    g_nvs_commit_error = ESP_FAIL;
+    TEST_ASSERT_EQUAL(ESP_OK, app_storage_set_lazy(TEST_STORE_KEY, &status, sizeof(test_status_t)));
+    TEST_ASSERT_EQUAL(ESP_FAIL, app_storage_flush());
+    g_nvs_commit_error = ESP_OK;
+
+    uint32_t set = g_nvs_ops.set;
+    uint32_t commit = g_nvs_ops.commit;
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_APP_STORAGE_DEBOUNCE_MS + 100));
+    TEST_ASSERT_EQUAL(set + 1, g_nvs_ops.set);
+    TEST_ASSERT_EQUAL(commit + 1, g_nvs_ops.commit);
+    read_from_flash(&stored);
+    TEST_ASSERT_EQUAL_MEMORY(&status, &stored, sizeof(test_status_t));
+
+    /**< Nothing is pending any more */
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_APP_STORAGE_DEBOUNCE_MS + 100));
+    TEST_ASSERT_EQUAL(set + 1, g_nvs_ops.set);
+
+    TEST_ASSERT_EQUAL(ESP_OK, app_storage_erase(TEST_STORE_KEY));
+}
+
+#endif /**< CONFIG_APP_STORAGE_WRITE_BEHIND */
@@ -6,12 +6,15 @@
    CONDITIONS OF ANY KIND, either express or implied.
 */
 #include <string.h>
+#include <sys/param.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/event_groups.h>
 #include <esp_wifi.h>
 #include <esp_event.h>
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_random.h>
 #include <esp_idf_version.h>
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 1, 0)
 // Features supported in 4.1+
@@ -34,12 +37,30 @@
 #include <qrcode.h>
 #include <nvs.h>
 #include <nvs_flash.h>
+#include "app_storage.h"
 #include "app_wifi.h"
+#include "app_wifi_reconnect.h"
 
 static const char *TAG = "app_wifi";
 static const int WIFI_CONNECTED_EVENT = BIT0;
 static EventGroupHandle_t wifi_event_group;
 
+#define AP_CACHE_KEY            "wifi_ap"
+
+/* The AP of the last connection, kept across reboots for the first attempt */
+typedef struct {
+    uint8_t ssid[32];
+    uint8_t bssid[6];
+    uint8_t channel;
+} app_wifi_ap_cache_t;
+
+/* s_reconnect is only used from the event loop, the retry timer only reads s_ap_cache */
+static app_wifi_reconnect_t s_reconnect;
+static app_wifi_ap_cache_t s_ap_cache;
+static esp_timer_handle_t s_retry_timer;
+static bool s_retry_fast;
+static app_wifi_stats_t s_stats;
+
 #define PROV_QR_VERSION "v1"
 
 #define PROV_TRANSPORT_SOFTAP   "softap"
@@ -109,6 +130,73 @@ static void app_wifi_print_qr(const char *name, const char *pop, const char *tra
     ESP_LOGI(TAG, "If QR code is not visible, copy paste the below URL in a browser.\n%s?data=%s", QRCODE_BASE_URL, payload);
 }
 
+static void app_wifi_connect(bool fast)
+{
+    wifi_config_t wifi_config = {0};
+
+    if (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) == ESP_OK) {
+        /* A cached AP only helps for the network it was cached on */
+        fast = fast && !memcmp(wifi_config.sta.ssid, s_ap_cache.ssid, sizeof(s_ap_cache.ssid));
+
+        if (fast) {
+            wifi_config.sta.bssid_set = true;
+            memcpy(wifi_config.sta.bssid, s_ap_cache.bssid, sizeof(wifi_config.sta.bssid));
+            wifi_config.sta.channel = s_ap_cache.channel;
+            esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+        } else if (wifi_config.sta.bssid_set || wifi_config.sta.channel) {
+            wifi_config.sta.bssid_set = false;
+            wifi_config.sta.channel = 0;
+            esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+        }
+    }
+
+    s_stats.attempt_count++;
+    s_stats.fast_attempt_count += fast;
+
+    esp_err_t err = esp_wifi_connect();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "esp_wifi_connect failed, err: %s", esp_err_to_name(err));
+    }
+}
+
+static void app_wifi_retry_timer_cb(void *arg)
+{
+    app_wifi_connect(s_retry_fast);
+}
+
+/* Connect now or after the backoff delay, on start and after every disconnection */
+static void app_wifi_schedule_connect(void)
+{
+    app_wifi_attempt_t attempt = app_wifi_reconnect_next(&s_reconnect, esp_timer_get_time() / 1000);
+
+    esp_timer_stop(s_retry_timer);
+
+    if (!attempt.delay_ms) {
+        app_wifi_connect(attempt.fast);
+        return;
+    }
+
+    ESP_LOGD(TAG, "Retry in %u ms%s", (unsigned) attempt.delay_ms, attempt.fast ? " on the cached AP" : "");
+    s_retry_fast = attempt.fast;
+    esp_timer_start_once(s_retry_timer, (uint64_t) attempt.delay_ms * 1000);
+}
+
+static void app_wifi_cache_ap(const wifi_event_sta_connected_t *event)
+{
+    app_wifi_ap_cache_t cache = {0};
+
+    memcpy(cache.ssid, event->ssid, MIN(event->ssid_len, sizeof(cache.ssid)));
+    memcpy(cache.bssid, event->bssid, sizeof(cache.bssid));
+    cache.channel = event->channel;
+    app_wifi_reconnect_set_ap(&s_reconnect, cache.bssid, cache.channel);
+
+    /* Roaming between the same APs does not wear the flash */
+    if (memcmp(&cache, &s_ap_cache, sizeof(cache))) {
+        s_ap_cache = cache;
+        app_storage_set_lazy(AP_CACHE_KEY, &s_ap_cache, sizeof(s_ap_cache));
+    }
+}
+
 /* Event handler for catching system events */
 static void event_handler(void* arg, esp_event_base_t event_base,
                           int32_t event_id, void* event_data)
@@ -124,6 +212,9 @@ static void event_handler(void* arg, esp_event_base_t event_base,
                          "\n\tSSID     : %s\n\tPassword : %s",
                          (const char *) wifi_sta_cfg->ssid,
                          (const char *) wifi_sta_cfg->password);
+                /* The cached AP belongs to the previous network */
+                app_wifi_reconnect_forget(&s_reconnect);
+                memset(&s_ap_cache, 0, sizeof(s_ap_cache));
                 break;
             }
             case NETWORK_PROV_WIFI_CRED_FAIL: {
@@ -145,20 +236,34 @@ static void event_handler(void* arg, esp_event_base_t event_base,
                 break;
         }
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        esp_wifi_connect();
+        app_wifi_schedule_connect();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        app_wifi_cache_ap((wifi_event_sta_connected_t *) event_data);
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-        ESP_LOGI(TAG, "Connected with IP Address:" IPSTR, IP2STR(&event->ip_info.ip));
+        uint32_t time_to_ip = app_wifi_reconnect_done(&s_reconnect, esp_timer_get_time() / 1000);
+
+        s_stats.connect_count++;
+        s_stats.time_to_ip_ms = time_to_ip;
+        if (time_to_ip > s_stats.time_to_ip_max_ms) {
+            s_stats.time_to_ip_max_ms = time_to_ip;
+        }
+
+        ESP_LOGI(TAG, "Connected with IP Address:" IPSTR " in %u ms", IP2STR(&event->ip_info.ip), (unsigned) time_to_ip);
         /* Signal main application to continue execution */
         xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_EVENT);
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        ESP_LOGI(TAG, "Disconnected. Connecting to the AP again...");
-        esp_wifi_connect();
+        wifi_event_sta_disconnected_t *event = (wifi_event_sta_disconnected_t *) event_data;
+        ESP_LOGI(TAG, "Disconnected, reason: %d. Connecting to the AP again...", event->reason);
+        xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_EVENT);
+        app_wifi_schedule_connect();
     }
 }
 
 static void wifi_init_sta()
 {
+    /* The credentials are already in flash, the BSSID and channel set on every attempt need not be */
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_start());
 }
@@ -255,6 +360,25 @@ void app_wifi_init(void)
     ESP_ERROR_CHECK(esp_event_loop_create_default());
     wifi_event_group = xEventGroupCreate();
 
+    app_wifi_reconnect_config_t reconnect_config = {
+        .backoff_min_ms = CONFIG_APP_WIFI_BACKOFF_MIN_MS,
+        .backoff_max_ms = CONFIG_APP_WIFI_BACKOFF_MAX_MS,
+        .scan_interval  = CONFIG_APP_WIFI_SCAN_INTERVAL,
+    };
+    app_wifi_reconnect_init(&s_reconnect, &reconnect_config, esp_random());
+
+    if (app_storage_get(AP_CACHE_KEY, &s_ap_cache, sizeof(s_ap_cache)) == ESP_OK && s_ap_cache.channel) {
+        app_wifi_reconnect_set_ap(&s_reconnect, s_ap_cache.bssid, s_ap_cache.channel);
+    } else {
+        memset(&s_ap_cache, 0, sizeof(s_ap_cache));
+    }
+
+    const esp_timer_create_args_t retry_timer_args = {
+        .callback = app_wifi_retry_timer_cb,
+        .name = "app_wifi_retry",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&retry_timer_args, &s_retry_timer));
+
     /* Register our event handler for Wi-Fi, IP and Provisioning related events */
     ESP_ERROR_CHECK(esp_event_handler_register(NETWORK_PROV_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL));
     ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL));
@@ -385,7 +509,24 @@ esp_err_t app_wifi_start(app_wifi_pop_type_t pop_type)
         /* Start Wi-Fi station */
         wifi_init_sta();
     }
-    /* Wait for Wi-Fi connection */
-    xEventGroupWaitBits(wifi_event_group, WIFI_CONNECTED_EVENT, false, true, portMAX_DELAY);
+    /* The connection goes on in the background, see app_wifi_wait_connected() */
+    return ESP_OK;
+}
+
+esp_err_t app_wifi_wait_connected(uint32_t timeout_ms)
+{
+    TickType_t ticks = timeout_ms == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    EventBits_t bits = xEventGroupWaitBits(wifi_event_group, WIFI_CONNECTED_EVENT, false, true, ticks);
+
+    return (bits & WIFI_CONNECTED_EVENT) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t app_wifi_get_stats(app_wifi_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *stats = s_stats;
     return ESP_OK;
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 */
 #pragma once
 
+#include <stdint.h>
 #include <esp_err.h>
 
 /** Types of Proof of Possession */
@@ -17,6 +18,15 @@ typedef enum {
     POP_TYPE_RANDOM
 } app_wifi_pop_type_t;
 
+/** Connection statistics of the station */
+typedef struct {
+    uint32_t connect_count;         /**< Times the station got an IP */
+    uint32_t attempt_count;         /**< Calls to esp_wifi_connect() */
+    uint32_t fast_attempt_count;    /**< Attempts to the cached BSSID on the cached channel */
+    uint32_t time_to_ip_ms;         /**< From Wi-Fi start or the link loss to the last IP */
+    uint32_t time_to_ip_max_ms;
+} app_wifi_stats_t;
+
 /**
  * @brief
  *
@@ -24,9 +34,32 @@ typedef enum {
 void app_wifi_init();
 
 /**
- * @brief
+ * @brief Start provisioning, or the station if the device is already provisioned
+ *
+ * @note Returns without waiting for the connection, the station keeps reconnecting
+ *       with a backoff in the background. See app_wifi_wait_connected().
  *
  * @param pop_type
  * @return esp_err_t
  */
 esp_err_t app_wifi_start(app_wifi_pop_type_t pop_type);
+
+/**
+ * @brief Wait until the station has an IP
+ *
+ * @param timeout_ms UINT32_MAX to wait forever
+ * @return
+ *      - ESP_OK
+ *      - ESP_ERR_TIMEOUT
+ */
+esp_err_t app_wifi_wait_connected(uint32_t timeout_ms);
+
+/**
+ * @brief Get the connection statistics
+ *
+ * @param stats
+ * @return
+ *      - ESP_OK
+ *      - ESP_ERR_INVALID_ARG
+ */
+esp_err_t app_wifi_get_stats(app_wifi_stats_t *stats);
@@ -0,0 +1,81 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <string.h>
+#include "app_wifi_reconnect.h"
+
+void app_wifi_reconnect_init(app_wifi_reconnect_t *reconnect, const app_wifi_reconnect_config_t *config, uint32_t seed)
+{
+    memset(reconnect, 0, sizeof(app_wifi_reconnect_t));
+    reconnect->config = *config;
+    /* xorshift gets stuck on 0 */
+    reconnect->seed = seed ? seed : 0x9e3779b9;
+}
+
+void app_wifi_reconnect_set_ap(app_wifi_reconnect_t *reconnect, const uint8_t bssid[6], uint8_t channel)
+{
+    memcpy(reconnect->bssid, bssid, sizeof(reconnect->bssid));
+    reconnect->channel = channel;
+}
+
+void app_wifi_reconnect_forget(app_wifi_reconnect_t *reconnect)
+{
+    memset(reconnect->bssid, 0, sizeof(reconnect->bssid));
+    reconnect->channel = 0;
+}
+
+static uint32_t reconnect_random(app_wifi_reconnect_t *reconnect)
+{
+    uint32_t x = reconnect->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    reconnect->seed = x;
+    return x;
+}
+
+app_wifi_attempt_t app_wifi_reconnect_next(app_wifi_reconnect_t *reconnect, uint32_t now_ms)
+{
+    const app_wifi_reconnect_config_t *config = &reconnect->config;
+    app_wifi_attempt_t attempt = {0};
+
+    if (!reconnect->connecting) {
+        reconnect->connecting = true;
+        reconnect->attempt = 0;
+        reconnect->lost_time_ms = now_ms;
+    }
+
+    if (reconnect->attempt > 0) {
+        uint32_t delay = config->backoff_max_ms;
+
+        /* Stop shifting before the delay overflows */
+        if (reconnect->attempt <= 16 && (config->backoff_min_ms << (reconnect->attempt - 1)) < delay) {
+            delay = config->backoff_min_ms << (reconnect->attempt - 1);
+        }
+
+        attempt.delay_ms = delay / 2 + reconnect_random(reconnect) % (delay / 2 + 1);
+    }
+
+    attempt.fast = reconnect->channel &&
+                   !(config->scan_interval && reconnect->attempt % config->scan_interval == config->scan_interval - 1);
+
+    if (reconnect->attempt < UINT16_MAX) {
+        reconnect->attempt++;
+    }
+
+    return attempt;
+}
+
+uint32_t app_wifi_reconnect_done(app_wifi_reconnect_t *reconnect, uint32_t now_ms)
+{
+    uint32_t elapsed = reconnect->connecting ? now_ms - reconnect->lost_time_ms : 0;
+
+    reconnect->connecting = false;
+    reconnect->attempt = 0;
+
+    return elapsed;
+}
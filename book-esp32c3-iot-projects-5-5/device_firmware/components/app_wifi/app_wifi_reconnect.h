@@ -0,0 +1,79 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Reconnect policy of the station, without any Wi-Fi calls so that it can be
+ * driven from a simulation as well as from the event handler.
+ *
+ * The first attempt after the link is lost is made right away. The next ones
+ * back off exponentially from backoff_min_ms to backoff_max_ms, each delay
+ * drawn in [delay / 2, delay] so that devices losing the same AP spread out.
+ * While an AP is cached, attempts go to its BSSID on its channel, except
+ * every scan_interval-th attempt which scans in case the AP has moved.
+ */
+typedef struct {
+    uint32_t backoff_min_ms;
+    uint32_t backoff_max_ms;
+    uint8_t  scan_interval;         /**< 0: never scan while an AP is cached */
+} app_wifi_reconnect_config_t;
+
+typedef struct {
+    app_wifi_reconnect_config_t config;
+    uint8_t  bssid[6];
+    uint8_t  channel;               /**< 0: no AP cached */
+    bool     connecting;
+    uint16_t attempt;               /**< Attempts since the link was lost */
+    uint32_t seed;
+    uint32_t lost_time_ms;          /**< When the link was lost */
+} app_wifi_reconnect_t;
+
+typedef struct {
+    uint32_t delay_ms;
+    bool     fast;                  /**< Connect to the cached BSSID on the cached channel */
+} app_wifi_attempt_t;
+
+/**
+ * @brief Set up the policy with no AP cached
+ *
+ * @param seed Seed of the delay jitter, different on every device
+ */
+void app_wifi_reconnect_init(app_wifi_reconnect_t *reconnect, const app_wifi_reconnect_config_t *config, uint32_t seed);
+
+/**
+ * @brief Cache the AP the station is connected to
+ */
+void app_wifi_reconnect_set_ap(app_wifi_reconnect_t *reconnect, const uint8_t bssid[6], uint8_t channel);
+
+/**
+ * @brief Drop the cached AP, e.g. when the credentials change
+ */
+void app_wifi_reconnect_forget(app_wifi_reconnect_t *reconnect);
+
+/**
+ * @brief Plan the next attempt, on start and on every disconnection
+ */
+app_wifi_attempt_t app_wifi_reconnect_next(app_wifi_reconnect_t *reconnect, uint32_t now_ms);
+
+/**
+ * @brief The station got an IP, reset the backoff
+ *
+ * @return Time from the link loss to the IP, in ms
+ */
+uint32_t app_wifi_reconnect_done(app_wifi_reconnect_t *reconnect, uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
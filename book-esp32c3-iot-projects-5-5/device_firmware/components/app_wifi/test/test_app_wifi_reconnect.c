@@ -0,0 +1,248 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "app_wifi_reconnect.h"
+
+#define FLEET_SIZE          64
+
+/* Mocked esp_wifi: how long a connection attempt takes on the air */
+#define WIFI_FAST_MS        120     /* Probe of one BSSID on one channel */
+#define WIFI_SCAN_MS        2400    /* Probes on the 13 channels */
+#define WIFI_ASSOC_MS       400     /* Auth, assoc, 4-way handshake and DHCP */
+#define WIFI_TIMEOUT_MS     1000    /* Until an association the AP dropped fails */
+
+/* Mocked AP: associations it can take in a window, the others are dropped */
+#define AP_WINDOW_MS        100
+#define AP_ASSOC_PER_WINDOW 4
+#define AP_WINDOW_NUM       (10 * 60 * 1000 / AP_WINDOW_MS)
+
+static const uint8_t g_ap_bssid[6] = {0x24, 0x0a, 0xc4, 0x12, 0x34, 0x56};
+
+static const app_wifi_reconnect_config_t g_config = {
+    .backoff_min_ms = 250,
+    .backoff_max_ms = 4000,
+    .scan_interval  = 4,
+};
+
+/**
+ * @brief The AP of the mocked esp_wifi, off the air until up_ms
+ */
+typedef struct {
+    uint32_t up_ms;
+    uint8_t  channel;
+    uint32_t stagger_ms;        /* Device i loses the link at i * stagger_ms */
+} mock_ap_t;
+
+typedef struct {
+    app_wifi_reconnect_t reconnect;
+    uint32_t lost_ms;
+    uint32_t next_ms;           /* Next attempt */
+    bool     fast;
+    bool     connected;
+} mock_device_t;
+
+typedef struct {
+    uint32_t p50;
+    uint32_t p90;
+    uint32_t max;
+    uint32_t attempts;
+    uint32_t assoc_attempts;    /* Attempts that reached the AP */
+    uint32_t search_ms;         /* Air time spent looking for the AP */
+} mock_fleet_t;
+
+static uint8_t g_ap_assoc[AP_WINDOW_NUM];
+
+static int mock_compare(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief esp_wifi_connect() of the mock, returns when the attempt succeeds or fails
+ */
+static uint32_t mock_wifi_connect(const mock_ap_t *ap, mock_device_t *device, mock_fleet_t *fleet)
+{
+    uint32_t search_ms = device->fast ? WIFI_FAST_MS : WIFI_SCAN_MS;
+    uint32_t now = device->next_ms + search_ms;
+
+    fleet->attempts++;
+    fleet->search_ms += search_ms;
+
+    if (now < ap->up_ms || (device->fast && device->reconnect.channel != ap->channel)) {
+        return now;
+    }
+
+    fleet->assoc_attempts++;
+    TEST_ASSERT_LESS_THAN(AP_WINDOW_NUM, now / AP_WINDOW_MS);
+
+    if (g_ap_assoc[now / AP_WINDOW_MS] >= AP_ASSOC_PER_WINDOW) {
+        return now + WIFI_TIMEOUT_MS;
+    }
+
+    g_ap_assoc[now / AP_WINDOW_MS]++;
+    device->connected = true;
+    return now + WIFI_ASSOC_MS;
+}
+
+/**
+ * @brief Replay the event handler of app_wifi on every device of the fleet at once
+ *
+ * @param at_once What app_wifi did before, a full scan right after every disconnection
+ */
+static mock_fleet_t mock_fleet(const mock_ap_t *ap, uint8_t cached_channel, bool at_once)
+{
+    static mock_device_t devices[FLEET_SIZE];
+    uint32_t time_to_ip[FLEET_SIZE];
+    mock_fleet_t fleet = {0};
+
+    memset(g_ap_assoc, 0, sizeof(g_ap_assoc));
+
+    for (int i = 0; i < FLEET_SIZE; i++) {
+        mock_device_t *device = &devices[i];
+        memset(device, 0, sizeof(mock_device_t));
+        app_wifi_reconnect_init(&device->reconnect, &g_config, i + 1);
+
+        if (cached_channel) {
+            app_wifi_reconnect_set_ap(&device->reconnect, g_ap_bssid, cached_channel);
+        }
+
+        device->lost_ms = i * ap->stagger_ms;
+        app_wifi_attempt_t attempt = app_wifi_reconnect_next(&device->reconnect, device->lost_ms);
+        device->next_ms = device->lost_ms + (at_once ? 0 : attempt.delay_ms);
+        device->fast = !at_once && attempt.fast;
+    }
+
+    for (int done = 0; done < FLEET_SIZE; done++) {
+        mock_device_t *device = NULL;
+
+        /* The attempts run in time order, they share the AP */
+        while (!device || !device->connected) {
+            device = NULL;
+
+            for (int i = 0; i < FLEET_SIZE; i++) {
+                if (!devices[i].connected && (!device || devices[i].next_ms < device->next_ms)) {
+                    device = &devices[i];
+                }
+            }
+
+            uint32_t now = mock_wifi_connect(ap, device, &fleet);
+
+            if (device->connected) {
+                time_to_ip[done] = app_wifi_reconnect_done(&device->reconnect, now);
+            } else {
+                app_wifi_attempt_t attempt = app_wifi_reconnect_next(&device->reconnect, now);
+                device->next_ms = now + (at_once ? 0 : attempt.delay_ms);
+                device->fast = !at_once && attempt.fast;
+            }
+        }
+    }
+
+    qsort(time_to_ip, FLEET_SIZE, sizeof(uint32_t), mock_compare);
+    fleet.p50 = time_to_ip[FLEET_SIZE / 2];
+    fleet.p90 = time_to_ip[FLEET_SIZE * 9 / 10];
+    fleet.max = time_to_ip[FLEET_SIZE - 1];
+
+    return fleet;
+}
+
+static void mock_fleet_print(const char *name, const mock_fleet_t *fleet)
+{
+    printf("%-26s time to IP p50 %5u p90 %5u max %5u ms, %4u attempts, %4u to the AP, %7u ms searching\n", name,
+           (unsigned)fleet->p50, (unsigned)fleet->p90, (unsigned)fleet->max, (unsigned)fleet->attempts,
+           (unsigned)fleet->assoc_attempts, (unsigned)fleet->search_ms);
+}
+
+TEST_CASE("app_wifi reconnect backoff and jitter", "[app_wifi]")
+{
+    app_wifi_reconnect_t reconnect;
+    uint32_t delays[2][8];
+
+    for (int seed = 0; seed < 2; seed++) {
+        app_wifi_reconnect_init(&reconnect, &g_config, seed + 1);
+
+        for (int i = 0; i < 8; i++) {
+            delays[seed][i] = app_wifi_reconnect_next(&reconnect, 0).delay_ms;
+        }
+    }
+
+    /* Right away, then doubling up to the max, each drawn in [delay / 2, delay] */
+    TEST_ASSERT_EQUAL(0, delays[0][0]);
+
+    for (int i = 1; i < 8; i++) {
+        uint32_t delay = g_config.backoff_min_ms << (i - 1);
+        delay = delay < g_config.backoff_max_ms ? delay : g_config.backoff_max_ms;
+        TEST_ASSERT_UINT32_WITHIN(delay / 4, delay * 3 / 4, delays[0][i]);
+    }
+
+    TEST_ASSERT_NOT_EQUAL(0, memcmp(delays[0], delays[1], sizeof(delays[0])));
+
+    /* Back to an immediate retry once connected */
+    TEST_ASSERT_EQUAL(0, app_wifi_reconnect_done(&reconnect, 0));
+    TEST_ASSERT_EQUAL(0, app_wifi_reconnect_next(&reconnect, 0).delay_ms);
+}
+
+TEST_CASE("app_wifi reconnect scans every scan_interval attempts", "[app_wifi]")
+{
+    app_wifi_reconnect_t reconnect;
+
+    app_wifi_reconnect_init(&reconnect, &g_config, 1);
+
+    /* Nothing cached, every attempt scans */
+    TEST_ASSERT_FALSE(app_wifi_reconnect_next(&reconnect, 0).fast);
+    TEST_ASSERT_FALSE(app_wifi_reconnect_next(&reconnect, 0).fast);
+    app_wifi_reconnect_done(&reconnect, 0);
+
+    app_wifi_reconnect_set_ap(&reconnect, g_ap_bssid, 6);
+
+    for (int i = 0; i < 3 * g_config.scan_interval; i++) {
+        bool scan = i % g_config.scan_interval == g_config.scan_interval - 1;
+        TEST_ASSERT_EQUAL(!scan, app_wifi_reconnect_next(&reconnect, 0).fast);
+    }
+
+    app_wifi_reconnect_forget(&reconnect);
+    TEST_ASSERT_FALSE(app_wifi_reconnect_next(&reconnect, 0).fast);
+}
+
+TEST_CASE("app_wifi reconnect latency of a fleet on a mocked AP", "[app_wifi][bench]")
+{
+    /* The devices drop the link one after the other, the AP stays up */
+    const mock_ap_t drop = {.up_ms = 0, .channel = 6, .stagger_ms = 1000};
+    /* The router reboots for 30 s */
+    const mock_ap_t reboot = {.up_ms = 30000, .channel = 6};
+    /* The router reboots and picks another channel */
+    const mock_ap_t reboot_moved = {.up_ms = 30000, .channel = 11};
+
+    mock_fleet_t drop_before = mock_fleet(&drop, 0, true);
+    mock_fleet_t drop_after = mock_fleet(&drop, 6, false);
+    mock_fleet_t reboot_before = mock_fleet(&reboot, 0, true);
+    mock_fleet_t reboot_after = mock_fleet(&reboot, 6, false);
+    mock_fleet_t moved_after = mock_fleet(&reboot_moved, 6, false);
+
+    mock_fleet_print("link drop, scan at once", &drop_before);
+    mock_fleet_print("link drop, cached AP", &drop_after);
+    mock_fleet_print("reboot, scan at once", &reboot_before);
+    mock_fleet_print("reboot, cached AP", &reboot_after);
+    mock_fleet_print("reboot to another channel", &moved_after);
+
+    /* A cached AP skips the scan */
+    TEST_ASSERT_EQUAL(WIFI_FAST_MS + WIFI_ASSOC_MS, drop_after.max);
+    TEST_ASSERT_LESS_THAN(drop_before.p50, drop_after.max);
+
+    /* The jitter spreads the fleet over the AP once it is back */
+    TEST_ASSERT_LESS_THAN(reboot_before.p90, reboot_after.p90);
+    TEST_ASSERT_LESS_THAN(reboot_before.assoc_attempts, reboot_after.assoc_attempts);
+    TEST_ASSERT_LESS_THAN(reboot_before.search_ms / 2, reboot_after.search_ms);
+
+    /* A moved AP is found by one of the scans */
+    TEST_ASSERT_LESS_OR_EQUAL(reboot_moved.up_ms + 2 * g_config.scan_interval * (g_config.backoff_max_ms + WIFI_SCAN_MS),
+                              moved_after.max);
+}
@@ -9,12 +9,14 @@
 #include "driver/gpio.h"
 
 // ==== NEW ADC APIs (IDF 5.x) ====
-#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_continuous.h"
 #include "esp_adc/adc_cali.h"
 #include "esp_adc/adc_cali_scheme.h"
+#include "soc/soc_caps.h"
 
 #include "button_adc.h"
 #include "esp_timer.h"
+#include "sdkconfig.h"
 
 static const char *TAG = "adc button";
 
@@ -26,7 +28,8 @@ static const char *TAG = "adc button";
     }                                                        \
 } while (0)
 
-#define NO_OF_SAMPLES   CONFIG_ADC_BUTTON_SAMPLE_TIMES   // multisampling
+#define NO_OF_SAMPLES   CONFIG_ADC_BUTTON_SAMPLE_TIMES   // số mẫu mỗi kênh trong một chu kỳ quét
+#define SCAN_PERIOD_US  (CONFIG_BUTTON_PERIOD_TIME_MS * 1000)
 
 // Dùng DB_12 (DB_11 là alias deprecated)
 #define ADC_BUTTON_ATTEN        ADC_ATTEN_DB_12
@@ -34,6 +37,23 @@ static const char *TAG = "adc button";
 #define ADC_BUTTON_MAX_CHANNEL  CONFIG_ADC_BUTTON_MAX_CHANNEL
 #define ADC_BUTTON_MAX_BUTTON   CONFIG_ADC_BUTTON_MAX_BUTTON_PER_CHANNEL
 
+/* Một frame DMA = NO_OF_SAMPLES mẫu của mỗi kênh, tức một chu kỳ quét */
+#define ADC_FRAME_SIZE(ch_num)  (SOC_ADC_DIGI_RESULT_BYTES * NO_OF_SAMPLES * (ch_num))
+#define ADC_FRAME_MAX           ADC_FRAME_SIZE(ADC_BUTTON_MAX_CHANNEL)
+#define ADC_POOL_FRAMES         (4)
+
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define ADC_OUTPUT_CHANNEL(p)   ((p)->type1.channel)
+#define ADC_OUTPUT_DATA(p)      ((p)->type1.data)
+#define ADC_OUTPUT_FORMAT       ADC_DIGI_OUTPUT_FORMAT_TYPE1
+#else
+#define ADC_OUTPUT_CHANNEL(p)   ((p)->type2.channel)
+#define ADC_OUTPUT_DATA(p)      ((p)->type2.data)
+#define ADC_OUTPUT_FORMAT       ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#endif
+
+#define FILTER_MEDIAN_LEN       (3)
+
 typedef struct {
     uint16_t min;   // mV
     uint16_t max;   // mV
@@ -41,22 +61,29 @@ typedef struct {
 
 typedef struct {
     adc1_channel_t channel_legacy;   // alias của adc_channel_t (giữ tương thích)
-    adc_channel_t  channel_oneshot;  // kênh theo API mới
+    adc_channel_t  channel_adc;      // kênh theo API mới
     uint8_t        is_init;
     button_data_t  btns[ADC_BUTTON_MAX_BUTTON];  /* các nút trên kênh */
-    uint64_t       last_time;                    /* thời điểm sample cuối (us) */
+    uint16_t       mv;                           /* mẫu đã lọc của chu kỳ quét hiện tại */
+    uint8_t        has_sample;                   /* bộ lọc bắt đầu từ mẫu đầu tiên, không từ 0 */
+#ifdef CONFIG_ADC_BUTTON_FILTER_MEDIAN
+    uint16_t       history[FILTER_MEDIAN_LEN];
+    uint8_t        history_idx;
+#endif
 } btn_adc_channel_t;
 
 typedef struct {
     bool                           is_configured;
-    adc_oneshot_unit_handle_t      unit;
+    adc_continuous_handle_t        handle;
+    uint64_t                       last_time;    /* lần đọc DMA cuối (us), chung cho mọi kênh */
+    uint8_t                        frame[ADC_FRAME_MAX];
 
     bool                           cali_inited;
     adc_cali_handle_t              cali_handle;
     int                            cali_scheme;  // 0: none, 1: curve
 
     btn_adc_channel_t              ch[ADC_BUTTON_MAX_CHANNEL];
-    uint8_t                        ch_num;
+    uint8_t                        ch_num;       /* số kênh đang dùng */
 } adc_button_t;
 
 static adc_button_t g_button = {0};
@@ -110,29 +137,138 @@ static void adc_calibration_deinit(adc_cali_handle_t handle, int scheme)
     }
 }
 
-/* Đọc trung bình và (nếu có) chuyển sang mV bằng calibration */
-static uint32_t get_adc_voltage(btn_adc_channel_t *ch)
+static uint16_t adc_raw_to_mv(int raw)
 {
-    int sum = 0;
-    for (int i = 0; i < NO_OF_SAMPLES; i++) {
-        int raw = 0;
-        adc_oneshot_read(g_button.unit, ch->channel_oneshot, &raw);
-        sum += raw;
-    }
-    int raw_avg = sum / NO_OF_SAMPLES;
-
     int mv = 0;
     if (g_button.cali_inited) {
-        if (adc_cali_raw_to_voltage(g_button.cali_handle, raw_avg, &mv) != ESP_OK) {
+        if (adc_cali_raw_to_voltage(g_button.cali_handle, raw, &mv) != ESP_OK) {
             mv = 0; // lỗi calibration -> an toàn trả 0
         }
     } else {
         // Không có calibration: dùng raw (chú ý min/max nên đặt theo raw khi không calib)
-        mv = raw_avg;
+        mv = raw;
     }
+    return (uint16_t)mv;
+}
 
-    ESP_LOGV(TAG, "RAW=%d => %d mV", raw_avg, mv);
-    return (uint32_t)mv;
+static uint16_t adc_filter(btn_adc_channel_t *ch, uint16_t mv)
+{
+    if (!ch->has_sample) {
+        ch->has_sample = 1;
+#ifdef CONFIG_ADC_BUTTON_FILTER_MEDIAN
+        for (int i = 0; i < FILTER_MEDIAN_LEN; i++) {
+            ch->history[i] = mv;
+        }
+#endif
+        return mv;
+    }
+
+#if defined(CONFIG_ADC_BUTTON_FILTER_MEDIAN)
+    ch->history[ch->history_idx] = mv;
+    ch->history_idx = (ch->history_idx + 1) % FILTER_MEDIAN_LEN;
+
+    uint16_t a = ch->history[0], b = ch->history[1], c = ch->history[2];
+    if ((a <= b && b <= c) || (c <= b && b <= a)) return b;
+    if ((b <= a && a <= c) || (c <= a && a <= b)) return a;
+    return c;
+#elif defined(CONFIG_ADC_BUTTON_FILTER_IIR)
+    // Dịch phải làm tròn xuống: khi tăng, làm tròn lên để bộ lọc tới đúng mẫu mới theo cả hai chiều
+    int32_t diff = (int32_t)mv - ch->mv;
+    if (diff > 0) {
+        diff += (1 << CONFIG_ADC_BUTTON_FILTER_IIR_SHIFT) - 1;
+    }
+    return ch->mv + (diff >> CONFIG_ADC_BUTTON_FILTER_IIR_SHIFT);
+#else
+    return mv;
+#endif
+}
+
+/* (Re)start DMA với pattern gồm mọi kênh đang dùng; gọi khi thêm/bớt kênh */
+static esp_err_t adc_continuous_restart(void)
+{
+    if (g_button.handle) {
+        adc_continuous_stop(g_button.handle);
+        adc_continuous_deinit(g_button.handle);
+        g_button.handle = NULL;
+    }
+
+    if (g_button.ch_num == 0) {
+        return ESP_OK;
+    }
+
+    adc_continuous_handle_cfg_t handle_cfg = {
+        .max_store_buf_size = ADC_FRAME_SIZE(g_button.ch_num) * ADC_POOL_FRAMES,
+        .conv_frame_size    = ADC_FRAME_SIZE(g_button.ch_num),
+    };
+    esp_err_t err = adc_continuous_new_handle(&handle_cfg, &g_button.handle);
+    ADC_BTN_CHECK(err == ESP_OK, "adc_continuous_new_handle failed", err);
+
+    adc_digi_pattern_config_t pattern[ADC_BUTTON_MAX_CHANNEL] = {0};
+    uint8_t n = 0;
+    for (size_t i = 0; i < ADC_BUTTON_MAX_CHANNEL; i++) {
+        if (g_button.ch[i].is_init) {
+            pattern[n].atten     = ADC_BUTTON_ATTEN;
+            pattern[n].channel   = g_button.ch[i].channel_adc;
+            pattern[n].unit      = ADC_BUTTON_UNIT;
+            pattern[n].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+            n++;
+        }
+    }
+
+    // Đủ nhanh để mỗi chu kỳ quét có một frame, trong giới hạn của phần cứng
+    uint32_t freq = (uint32_t)n * NO_OF_SAMPLES * 1000000 / SCAN_PERIOD_US;
+    if (freq < SOC_ADC_SAMPLE_FREQ_THRES_LOW) freq = SOC_ADC_SAMPLE_FREQ_THRES_LOW;
+    if (freq > SOC_ADC_SAMPLE_FREQ_THRES_HIGH) freq = SOC_ADC_SAMPLE_FREQ_THRES_HIGH;
+
+    adc_continuous_config_t dig_cfg = {
+        .pattern_num    = n,
+        .adc_pattern    = pattern,
+        .sample_freq_hz = freq,
+        .conv_mode      = ADC_CONV_SINGLE_UNIT_1,
+        .format         = ADC_OUTPUT_FORMAT,
+    };
+    err = adc_continuous_config(g_button.handle, &dig_cfg);
+    ADC_BTN_CHECK(err == ESP_OK, "adc_continuous_config failed", err);
+
+    g_button.last_time = 0;
+    return adc_continuous_start(g_button.handle);
+}
+
+/* Một lần mỗi chu kỳ quét: đọc hết frame DMA, trung bình theo kênh, lọc và đổi sang mV */
+static void adc_button_refresh(void)
+{
+    uint64_t now = esp_timer_get_time(); // us
+    if ((now - g_button.last_time) < SCAN_PERIOD_US / 2) {
+        return;
+    }
+    g_button.last_time = now;
+
+    uint32_t sum[ADC_BUTTON_MAX_CHANNEL] = {0};
+    uint32_t cnt[ADC_BUTTON_MAX_CHANNEL] = {0};
+    uint32_t len = 0;
+
+    while (adc_continuous_read(g_button.handle, g_button.frame, ADC_FRAME_SIZE(g_button.ch_num), &len, 0) == ESP_OK) {
+        for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= len; i += SOC_ADC_DIGI_RESULT_BYTES) {
+            const adc_digi_output_data_t *p = (const adc_digi_output_data_t *)&g_button.frame[i];
+
+            for (size_t j = 0; j < ADC_BUTTON_MAX_CHANNEL; j++) {
+                if (g_button.ch[j].is_init && g_button.ch[j].channel_adc == ADC_OUTPUT_CHANNEL(p)) {
+                    sum[j] += ADC_OUTPUT_DATA(p);
+                    cnt[j]++;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Kênh chưa có frame mới giữ mẫu cũ
+    for (size_t j = 0; j < ADC_BUTTON_MAX_CHANNEL; j++) {
+        if (cnt[j]) {
+            g_button.ch[j].mv = adc_filter(&g_button.ch[j], adc_raw_to_mv(sum[j] / cnt[j]));
+            ESP_LOGV(TAG, "CH%d: %u samples => %u mV", g_button.ch[j].channel_adc,
+                     (unsigned)cnt[j], g_button.ch[j].mv);
+        }
+    }
 }
 
 /* ========= Public API ========= */
@@ -145,7 +281,7 @@ esp_err_t button_adc_init(const button_adc_config_t *config)
 
     // alias cũ -> kiểu mới
     adc1_channel_t ch_legacy = config->adc_channel;
-    adc_channel_t  ch_oneshot = (adc_channel_t)config->adc_channel;
+    adc_channel_t  ch_adc = (adc_channel_t)config->adc_channel;
 
     int ch_index = find_channel_legacy(ch_legacy);
     if (ch_index >= 0) {
@@ -158,37 +294,32 @@ esp_err_t button_adc_init(const button_adc_config_t *config)
         ch_index = unused;
     }
 
-    // Khởi tạo unit & calibration một lần
+    // Khởi tạo calibration một lần
     if (!g_button.is_configured) {
-        adc_oneshot_unit_init_cfg_t unit_cfg = {
-            .unit_id = ADC_BUTTON_UNIT,
-        };
-        esp_err_t err = adc_oneshot_new_unit(&unit_cfg, &g_button.unit);
-        ADC_BTN_CHECK(err == ESP_OK, "adc_oneshot_new_unit failed", err);
-
         g_button.cali_inited = adc_calibration_init(&g_button.cali_handle, &g_button.cali_scheme);
         g_button.is_configured = true;
     }
 
-    // Cấu hình channel nếu chưa có
+    // Kênh mới: thêm vào pattern DMA
     if (g_button.ch[ch_index].is_init == 0) {
-        adc_oneshot_chan_cfg_t chan_cfg = {
-            .bitwidth = ADC_BITWIDTH_DEFAULT,
-            .atten    = ADC_BUTTON_ATTEN,
-        };
-        esp_err_t err = adc_oneshot_config_channel(g_button.unit, ch_oneshot, &chan_cfg);
-        ADC_BTN_CHECK(err == ESP_OK, "adc_oneshot_config_channel failed", err);
-
+        memset(&g_button.ch[ch_index], 0, sizeof(btn_adc_channel_t));
         g_button.ch[ch_index].channel_legacy  = ch_legacy;
-        g_button.ch[ch_index].channel_oneshot = ch_oneshot;
+        g_button.ch[ch_index].channel_adc     = ch_adc;
         g_button.ch[ch_index].is_init         = 1;
-        g_button.ch[ch_index].last_time       = 0;
+        g_button.ch_num++;
+
+        esp_err_t err = adc_continuous_restart();
+        if (err != ESP_OK) {
+            g_button.ch[ch_index].is_init = 0;
+            g_button.ch_num--;
+            adc_continuous_restart();
+            return err;
+        }
     }
 
     // Lưu ngưỡng mV cho button_index
     g_button.ch[ch_index].btns[config->button_index].max = config->max;
     g_button.ch[ch_index].btns[config->button_index].min = config->min;
-    g_button.ch_num++;
 
     return ESP_OK;
 }
@@ -212,6 +343,8 @@ esp_err_t button_adc_deinit(adc1_channel_t channel, int button_index)
     if (unused_button == ADC_BUTTON_MAX_BUTTON && g_button.ch[ch_index].is_init) {
         g_button.ch[ch_index].is_init = 0;
         g_button.ch[ch_index].channel_legacy = (adc1_channel_t)0xFF;
+        g_button.ch_num--;
+        adc_continuous_restart();
         ESP_LOGD(TAG, "all buttons unused on channel, mark channel free");
     }
 
@@ -227,12 +360,8 @@ esp_err_t button_adc_deinit(adc1_channel_t channel, int button_index)
             g_button.cali_inited = false;
             g_button.cali_scheme = 0;
         }
-        if (g_button.unit) {
-            adc_oneshot_del_unit(g_button.unit);
-            g_button.unit = NULL;
-        }
         memset(&g_button, 0, sizeof(g_button));
-        ESP_LOGD(TAG, "all channels unused, ADC oneshot deinitialized");
+        ESP_LOGD(TAG, "all channels unused, ADC continuous deinitialized");
     }
 
     return ESP_OK;
@@ -240,8 +369,6 @@ esp_err_t button_adc_deinit(adc1_channel_t channel, int button_index)
 
 uint8_t button_adc_get_key_level(void *button_index)
 {
-    static uint16_t last_mv = 0;
-
     uint32_t ch_legacy = ADC_BUTTON_SPLIT_CHANNEL(button_index);
     uint32_t index     = ADC_BUTTON_SPLIT_INDEX(button_index);
 
@@ -252,15 +379,12 @@ uint8_t button_adc_get_key_level(void *button_index)
     int ch_index = find_channel_legacy((adc1_channel_t)ch_legacy);
     ADC_BTN_CHECK(ch_index >= 0, "The button_index is not init", 0);
 
-    // Lấy mẫu ít nhất mỗi 1ms
-    uint64_t now = esp_timer_get_time(); // us
-    if ((now - g_button.ch[ch_index].last_time) > 1000) {
-        last_mv = (uint16_t)get_adc_voltage(&g_button.ch[ch_index]);
-        g_button.ch[ch_index].last_time = now;
-    }
+    // Nút đầu tiên của lượt quét đọc DMA cho mọi kênh, các nút sau chỉ so ngưỡng
+    adc_button_refresh();
 
-    if (last_mv <= g_button.ch[ch_index].btns[index].max &&
-        last_mv >  g_button.ch[ch_index].btns[index].min) {
+    uint16_t mv = g_button.ch[ch_index].mv;
+    if (mv <= g_button.ch[ch_index].btns[index].max &&
+        mv >  g_button.ch[ch_index].btns[index].min) {
         return 1;
     }
     return 0;
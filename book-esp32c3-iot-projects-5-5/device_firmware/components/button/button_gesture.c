@@ -0,0 +1,234 @@
+// Copyright 2020 Espressif Systems (Shanghai) Co. Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include "esp_log.h"
+#include "button_gesture.h"
+
+static const char *TAG = "button gesture";
+
+#define GESTURE_CHECK(a, str, ret_val)                          \
+    if (!(a))                                                     \
+    {                                                             \
+        ESP_LOGE(TAG, "%s(%d): %s", __FUNCTION__, __LINE__, str); \
+        return (ret_val);                                         \
+    }
+
+typedef enum {
+    GESTURE_READY,      /**< waiting for the first press */
+    GESTURE_RUNNING,
+    GESTURE_DONE,
+    GESTURE_DEAD,
+} gesture_status_t;
+
+typedef enum {
+    INPUT_PRESS,
+    INPUT_RELEASE,
+    INPUT_TICK,
+} gesture_input_t;
+
+esp_err_t button_gesture_init(button_gesture_t *gesture, const button_gesture_def_t *defs, uint8_t def_num,
+                              button_gesture_state_t *states, uint16_t chord_ms)
+{
+    GESTURE_CHECK(NULL != gesture && NULL != defs && NULL != states, "Pointer is invalid", ESP_ERR_INVALID_ARG);
+    GESTURE_CHECK(def_num > 0, "def_num is invalid", ESP_ERR_INVALID_ARG);
+
+    for (int i = 0; i < def_num; i++) {
+        GESTURE_CHECK(defs[i].step_num > 0 && NULL != defs[i].steps, "gesture without steps", ESP_ERR_INVALID_ARG);
+        GESTURE_CHECK(BUTTON_GESTURE_PRESS == defs[i].steps[0].type, "gesture must start with a press", ESP_ERR_INVALID_ARG);
+
+        for (int j = 0; j < defs[i].step_num; j++) {
+            GESTURE_CHECK(defs[i].steps[j].mask && defs[i].steps[j].type <= BUTTON_GESTURE_HOLD, "step is invalid",
+                          ESP_ERR_INVALID_ARG);
+        }
+    }
+
+    memset(gesture, 0, sizeof(button_gesture_t));
+    gesture->defs = defs;
+    gesture->states = states;
+    gesture->def_num = def_num;
+    gesture->chord_ms = chord_ms;
+    button_gesture_reset(gesture);
+
+    return ESP_OK;
+}
+
+void button_gesture_reset(button_gesture_t *gesture)
+{
+    memset(gesture->states, 0, gesture->def_num * sizeof(button_gesture_state_t));
+    gesture->pending = BUTTON_GESTURE_NONE;
+}
+
+/**
+ * @brief Move one gesture on by an input, returns whether it has just completed
+ */
+static bool gesture_step(const button_gesture_t *gesture, const button_gesture_def_t *def,
+                         button_gesture_state_t *state, gesture_input_t input, uint8_t bit, uint32_t now)
+{
+    const button_gesture_step_t *step = &def->steps[state->step];
+    uint32_t elapsed = now - state->time_ms;
+    bool matched = false;
+
+    if (GESTURE_READY == state->status) {
+        /**< every gesture starts from the first press of a sequence, or never */
+        if (INPUT_PRESS != input) {
+            return false;
+        }
+        state->status = GESTURE_RUNNING;
+        state->time_ms = now;
+        elapsed = 0;
+    }
+
+    switch (step->type) {
+    case BUTTON_GESTURE_PRESS:
+        if (step->max_ms && state->step > 0 && elapsed > step->max_ms) {
+            state->status = GESTURE_DEAD;
+        } else if ((step->mask & (step->mask - 1)) && (gesture->pressed & step->mask) &&
+                   (int32_t)(gesture->press_time_ms - state->time_ms) >= 0 &&
+                   now - gesture->press_time_ms > gesture->chord_ms) {
+            /**< part of a chord pressed for too long, buttons still down from the previous step do not count */
+            state->status = GESTURE_DEAD;
+        } else if (INPUT_PRESS == input) {
+            if (!(step->mask & bit)) {
+                state->status = GESTURE_DEAD;
+            } else {
+                matched = (gesture->pressed & step->mask) == step->mask;
+            }
+        } else if (INPUT_RELEASE == input && (int32_t)(gesture->press_time_ms - state->time_ms) >= 0) {
+            /**< a chord let go before it was complete, releases left over from the previous step do not count */
+            state->status = GESTURE_DEAD;
+        }
+        break;
+
+    case BUTTON_GESTURE_RELEASE:
+        if (INPUT_PRESS == input || (step->max_ms && elapsed > step->max_ms)) {
+            state->status = GESTURE_DEAD;
+        } else if (INPUT_RELEASE == input && (step->mask & bit)) {
+            if (elapsed >= step->min_ms) {
+                matched = true;
+            } else {
+                state->status = GESTURE_DEAD;
+            }
+        }
+        break;
+
+    case BUTTON_GESTURE_HOLD:
+        if (INPUT_PRESS == input || (INPUT_RELEASE == input && (step->mask & bit))) {
+            state->status = GESTURE_DEAD;
+        } else if (elapsed >= step->min_ms) {
+            matched = true;
+            /**< a later step measures from the end of the hold, not from the last tick */
+            now = state->time_ms + step->min_ms;
+        }
+        break;
+    }
+
+    if (!matched) {
+        return false;
+    }
+
+    state->time_ms = now;
+
+    if (++state->step == def->step_num) {
+        state->status = GESTURE_DONE;
+        return true;
+    }
+
+    return false;
+}
+
+static int gesture_run(button_gesture_t *gesture, gesture_input_t input, uint8_t bit, uint32_t now)
+{
+    bool running = false;
+    int completed = BUTTON_GESTURE_NONE;
+
+    for (int i = 0; i < gesture->def_num; i++) {
+        button_gesture_state_t *state = &gesture->states[i];
+
+        if (GESTURE_READY == state->status || GESTURE_RUNNING == state->status) {
+            /**< of the gestures completing on the same input, the first one in the table wins */
+            if (gesture_step(gesture, &gesture->defs[i], state, input, bit, now) && BUTTON_GESTURE_NONE == completed) {
+                completed = i;
+            }
+        }
+
+        running |= GESTURE_RUNNING == state->status;
+    }
+
+    if (BUTTON_GESTURE_NONE != completed) {
+        gesture->pending = completed;
+    }
+
+    if (running) {
+        return BUTTON_GESTURE_NONE;
+    }
+
+    /**< nothing left to wait for, start over from the next press */
+    int result = gesture->pending;
+    bool started = result != BUTTON_GESTURE_NONE;
+
+    for (int i = 0; i < gesture->def_num && !started; i++) {
+        started = GESTURE_READY != gesture->states[i].status;
+    }
+
+    if (started) {
+        button_gesture_reset(gesture);
+    }
+
+    return result;
+}
+
+int button_gesture_feed(button_gesture_t *gesture, uint8_t button, bool pressed, uint32_t time_ms)
+{
+    GESTURE_CHECK(NULL != gesture && button < BUTTON_GESTURE_BUTTON_MAX, "Argument is invalid", BUTTON_GESTURE_NONE);
+    uint8_t bit = 1U << button;
+
+    if (pressed) {
+        if (!gesture->pressed) {
+            gesture->press_time_ms = time_ms;
+        }
+        gesture->pressed |= bit;
+    } else {
+        gesture->pressed &= ~bit;
+    }
+
+    return gesture_run(gesture, pressed ? INPUT_PRESS : INPUT_RELEASE, bit, time_ms);
+}
+
+int button_gesture_tick(button_gesture_t *gesture, uint32_t time_ms)
+{
+    if (!button_gesture_busy(gesture)) {
+        return BUTTON_GESTURE_NONE;
+    }
+
+    return gesture_run(gesture, INPUT_TICK, 0, time_ms);
+}
+
+bool button_gesture_busy(const button_gesture_t *gesture)
+{
+    if (NULL == gesture || NULL == gesture->states) {
+        return false;
+    }
+
+    if (BUTTON_GESTURE_NONE != gesture->pending) {
+        return true;
+    }
+
+    for (int i = 0; i < gesture->def_num; i++) {
+        if (GESTURE_RUNNING == gesture->states[i].status) {
+            return true;
+        }
+    }
+
+    return false;
+}
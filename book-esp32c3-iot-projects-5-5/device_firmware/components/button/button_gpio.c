@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include "esp_log.h"
+#include "esp_sleep.h"
 #include "driver/gpio.h"
 #include "button_gpio.h"
 
@@ -63,3 +64,46 @@ uint8_t button_gpio_get_key_level(void *gpio_num)
 {
     return (uint8_t)gpio_get_level((uint32_t)gpio_num);
 }
+
+esp_err_t button_gpio_set_intr(int gpio_num, gpio_int_type_t intr_type, gpio_isr_t isr_handler, void *args)
+{
+    static bool isr_service_installed = false;
+
+    gpio_set_intr_type(gpio_num, intr_type);
+
+    if (!isr_service_installed) {
+        /** ESP_ERR_INVALID_STATE: already installed by another driver */
+        esp_err_t ret = gpio_install_isr_service(0);
+        GPIO_BTN_CHECK(ESP_OK == ret || ESP_ERR_INVALID_STATE == ret, "gpio isr service install failed", ret);
+        isr_service_installed = true;
+    }
+
+    return gpio_isr_handler_add(gpio_num, isr_handler, args);
+}
+
+esp_err_t button_gpio_intr_control(int gpio_num, bool enable)
+{
+    if (enable) {
+        gpio_intr_enable(gpio_num);
+    } else {
+        gpio_intr_disable(gpio_num);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t button_gpio_enable_gpio_wakeup(int gpio_num, uint8_t active_level, bool enable)
+{
+    esp_err_t ret;
+
+    if (enable) {
+        ret = gpio_wakeup_enable(gpio_num, active_level ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+    } else {
+        ret = gpio_wakeup_disable(gpio_num);
+    }
+
+    GPIO_BTN_CHECK(ESP_OK == ret, "gpio wakeup config failed", ret);
+
+    /** light sleep only checks the gpio wakeup sources once this is enabled */
+    return enable ? esp_sleep_enable_gpio_wakeup() : ESP_OK;
+}
@@ -0,0 +1,118 @@
+// Copyright 2020 Espressif Systems (Shanghai) Co. Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef __IOT_BUTTON_GESTURE_H__
+#define __IOT_BUTTON_GESTURE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A gesture is a table of steps over the press and release events of up to 8
+ * buttons. All the gestures of a matcher follow the events side by side from
+ * the first press on. A gesture that completes while a longer one can still
+ * match waits for it: the last gesture to complete is reported once none is
+ * left running, so a double click is not reported in the middle of a triple
+ * click.
+ */
+#define BUTTON_GESTURE_NONE        (-1)
+#define BUTTON_GESTURE_BUTTON_MAX  (8)
+
+typedef enum {
+    BUTTON_GESTURE_PRESS,    /**< Every button of mask pressed, at most max_ms after the previous step (0: any time) */
+    BUTTON_GESTURE_RELEASE,  /**< A button of mask released after the press was held min_ms to max_ms (0: no limit) */
+    BUTTON_GESTURE_HOLD,     /**< The buttons of mask still pressed min_ms after the previous step */
+} button_gesture_step_type_t;
+
+typedef struct {
+    uint8_t  type;       /**< button_gesture_step_type_t */
+    uint8_t  mask;       /**< Bit n: button n of the matcher */
+    uint16_t min_ms;
+    uint16_t max_ms;
+} button_gesture_step_t;
+
+#define BUTTON_GESTURE_PRESS_STEP(mask, gap_ms)            {BUTTON_GESTURE_PRESS, (mask), 0, (gap_ms)}
+#define BUTTON_GESTURE_RELEASE_STEP(mask, min_ms, max_ms)  {BUTTON_GESTURE_RELEASE, (mask), (min_ms), (max_ms)}
+#define BUTTON_GESTURE_HOLD_STEP(mask, ms)                 {BUTTON_GESTURE_HOLD, (mask), (ms), 0}
+
+typedef struct {
+    const button_gesture_step_t *steps;
+    uint8_t                      step_num;
+} button_gesture_def_t;
+
+/**
+ * @brief Progress of one gesture, kept by the caller next to the table
+ */
+typedef struct {
+    uint8_t  step;       /**< Next step to match */
+    uint8_t  status;
+    uint32_t time_ms;    /**< When the previous step matched */
+} button_gesture_state_t;
+
+typedef struct {
+    const button_gesture_def_t *defs;
+    button_gesture_state_t     *states;
+    uint8_t                     def_num;
+    uint8_t                     pressed;         /**< Buttons down */
+    uint16_t                    chord_ms;        /**< Buttons of one PRESS step go down within this window */
+    uint32_t                    press_time_ms;   /**< First press since all buttons were up */
+    int16_t                     pending;         /**< Completed gesture waiting for the longer ones */
+} button_gesture_t;
+
+/**
+ * @brief  Set up a matcher, it keeps pointers to defs and states
+ *
+ * @param  states   def_num entries, the only memory the matcher writes
+ * @param  chord_ms Window for the presses of a multi-button PRESS step
+ *
+ * @return
+ *      - ESP_OK
+ *      - ESP_ERR_INVALID_ARG
+ */
+esp_err_t button_gesture_init(button_gesture_t *gesture, const button_gesture_def_t *defs, uint8_t def_num,
+                              button_gesture_state_t *states, uint16_t chord_ms);
+
+/**
+ * @brief  Feed a debounced press or release of button
+ *
+ * @return Index of the gesture recognized, or BUTTON_GESTURE_NONE
+ */
+int button_gesture_feed(button_gesture_t *gesture, uint8_t button, bool pressed, uint32_t time_ms);
+
+/**
+ * @brief  Let time pass for HOLD steps and timing windows, call it periodically
+ *
+ * @return Index of the gesture recognized, or BUTTON_GESTURE_NONE
+ */
+int button_gesture_tick(button_gesture_t *gesture, uint32_t time_ms);
+
+/**
+ * @brief  Whether a gesture is in progress and needs button_gesture_tick()
+ */
+bool button_gesture_busy(const button_gesture_t *gesture);
+
+/**
+ * @brief  Drop the gestures in progress
+ */
+void button_gesture_reset(button_gesture_t *gesture);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /**< __IOT_BUTTON_GESTURE_H__ */
@@ -27,6 +27,7 @@ extern "C" {
 typedef struct {
     int32_t gpio_num;
     uint8_t active_level;
+    bool enable_power_save;   /**< Scan the button only from its first press on, woken by a GPIO interrupt */
 } button_gpio_config_t;
 
 /**
@@ -58,6 +59,43 @@ esp_err_t button_gpio_deinit(int gpio_num);
  */
 uint8_t button_gpio_get_key_level(void *gpio_num);
 
+/**
+ * @brief Install an interrupt handler on button gpio
+ *
+ * @param gpio_num gpio number of button
+ * @param intr_type interrupt type, a level type for a button that may have to wake the chip
+ * @param isr_handler handler, run from the GPIO ISR service
+ * @param args argument of the handler
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - Others: the GPIO ISR service could not be installed
+ */
+esp_err_t button_gpio_set_intr(int gpio_num, gpio_int_type_t intr_type, gpio_isr_t isr_handler, void *args);
+
+/**
+ * @brief Enable or disable the interrupt of button gpio, can be called from an ISR
+ *
+ * @param gpio_num gpio number of button
+ * @param enable true to enable
+ *
+ * @return Always return ESP_OK
+ */
+esp_err_t button_gpio_intr_control(int gpio_num, bool enable);
+
+/**
+ * @brief Let button gpio wake the chip from light sleep when it reaches active_level
+ *
+ * @param gpio_num gpio number of button
+ * @param active_level level of a pressed button
+ * @param enable true to enable
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG   gpio_num cannot wake the chip
+ */
+esp_err_t button_gpio_enable_gpio_wakeup(int gpio_num, uint8_t active_level, bool enable);
+
 #ifdef __cplusplus
 }
 #endif
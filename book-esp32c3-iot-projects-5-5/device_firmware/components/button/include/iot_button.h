@@ -14,13 +14,25 @@
 #ifndef __IOT_BUTTON_H__
 #define __IOT_BUTTON_H__
 
+#include "sdkconfig.h"
 #include "button_adc.h"
 #include "button_gpio.h"
+#include "button_gesture.h"
+#ifdef CONFIG_BUTTON_CALLBACK_ESP_EVENT
+#include "esp_event.h"
+#endif
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#ifdef CONFIG_BUTTON_CALLBACK_ESP_EVENT
+/**
+ * @brief Event base of the button callbacks, the event id is the button_event_t of the callback
+ */
+ESP_EVENT_DECLARE_BASE(BUTTON_EVENT);
+#endif
+
 typedef void (* button_cb_t)(void *);
 typedef void *button_handle_t;
 
@@ -36,6 +48,7 @@ typedef enum {
     BUTTON_DOUBLE_CLICK,
     BUTTON_LONG_PRESS_START,
     BUTTON_LONG_PRESS_HOLD,
+    BUTTON_GESTURE,          /**< a gesture of iot_button_set_gesture(), see iot_button_get_gesture() */
     BUTTON_EVENT_MAX,
     BUTTON_NONE_PRESS,
 } button_event_t;
@@ -73,6 +86,11 @@ button_handle_t iot_button_create(const button_config_t *config);
 /**
  * @brief Delete a button
  *
+ * When the callbacks are queued, it waits until the ones already queued have returned.
+ * Called from the task running them, i.e. from a button callback or, with
+ * CONFIG_BUTTON_CALLBACK_ESP_EVENT, from any handler of the default event loop, it
+ * cannot wait: the callbacks still queued for the button are dropped.
+ *
  * @param btn_handle A button handle to delete
  *
  * @return
@@ -84,6 +102,10 @@ esp_err_t iot_button_delete(button_handle_t btn_handle);
 /**
  * @brief Register the button event callback function.
  *
+ * The callback runs from the esp_timer task, the button task or the default event
+ * loop depending on the Kconfig. When it is queued, iot_button_get_event() and
+ * iot_button_get_repeat() called from the callback return the state at the time of the event.
+ *
  * @param btn_handle A button handle to register
  * @param event Button event
  * @param cb Callback function.
@@ -124,6 +146,68 @@ button_event_t iot_button_get_event(button_handle_t btn_handle);
  */
 uint8_t iot_button_get_repeat(button_handle_t btn_handle);
 
+/**
+ * @brief Recognize gestures over the presses and releases of some buttons
+ *
+ * The debounced presses and releases of btn_handles[i] are fed to the matcher as
+ * button i, with the time of the scan. BUTTON_GESTURE is reported on btn_handles[0].
+ * The matcher belongs to these buttons until they are deleted.
+ *
+ * @param gesture Matcher set up with button_gesture_init(), NULL to stop recognizing gestures
+ * @param btn_handles Buttons of the matcher
+ * @param btn_num Number of buttons, at most BUTTON_GESTURE_BUTTON_MAX
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG   Arguments is invalid.
+ */
+esp_err_t iot_button_set_gesture(button_gesture_t *gesture, const button_handle_t *btn_handles, uint8_t btn_num);
+
+/**
+ * @brief Get the last gesture recognized
+ *
+ * @param btn_handle First button of the matcher
+ *
+ * @return Index of the gesture in the matcher table, or BUTTON_GESTURE_NONE
+ */
+int iot_button_get_gesture(button_handle_t btn_handle);
+
+/**
+ * @brief Button scan statistics, shared by all buttons
+ *
+ */
+typedef struct {
+    uint32_t scan_count;                          /**< times the button timer scanned the buttons */
+    uint32_t irq_count;                           /**< times a power save button woke the scan up */
+    uint32_t event_count;                         /**< events with a callback registered */
+    uint32_t event_dropped;                       /**< events dropped because the queue was full */
+    uint32_t queue_depth;                         /**< events waiting for their callback */
+    uint32_t queue_depth_max;                     /**< most events waiting at once */
+    uint32_t latency_p50_us;                      /**< from the event to its callback, interpolated in buckets of powers of two */
+    uint32_t latency_p90_us;
+    uint32_t latency_p99_us;
+    uint32_t latency_max_us;
+} button_stats_t;
+
+/**
+ * @brief Get the button scan statistics
+ *
+ * @param stats Filled with the statistics since the last reset
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG   Arguments is invalid.
+ */
+esp_err_t iot_button_get_stats(button_stats_t *stats);
+
+/**
+ * @brief Reset the button scan statistics
+ *
+ * @return
+ *      - ESP_OK on success
+ */
+esp_err_t iot_button_reset_stats(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -13,14 +13,19 @@
 // limitations under the License.
 #include <stdio.h>
 #include <string.h>
+#include <stdatomic.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "freertos/timers.h"
 #include "esp_log.h"
 #include "driver/gpio.h"
 #include "iot_button.h"
 #include "esp_timer.h"
 #include "sdkconfig.h"
+#ifdef CONFIG_BUTTON_CALLBACK_ESP_EVENT
+#include "esp_event.h"
+#endif
 
 static const char *TAG = "button";
 
@@ -42,21 +47,82 @@ typedef struct Button {
     uint8_t         (*hal_button_Level)(void *usr_data);
     void            *usr_data;
     button_type_t   type;
+    bool            enable_power_save;
+    button_gesture_t *gesture;
+    uint8_t         gesture_button;      /**< index of this button in the gesture matcher */
+    int16_t         gesture_id;          /**< last gesture recognized */
     button_cb_t     cb[BUTTON_EVENT_MAX];
     struct Button   *next;
 } button_dev_t;
 
 //button handle list head.
 static button_dev_t *g_head_handle = NULL;
-static esp_timer_handle_t g_button_timer_handle;
+static esp_timer_handle_t g_button_timer_handle = NULL;
 static bool g_is_timer_running = false;
+static button_stats_t g_button_stats = {0};
 
 #define TICKS_INTERVAL    CONFIG_BUTTON_PERIOD_TIME_MS
 #define DEBOUNCE_TICKS    CONFIG_BUTTON_DEBOUNCE_TICKS //MAX 8
 #define SHORT_TICKS       (CONFIG_BUTTON_SHORT_PRESS_TIME_MS /TICKS_INTERVAL)
 #define LONG_TICKS        (CONFIG_BUTTON_LONG_PRESS_TIME_MS /TICKS_INTERVAL)
 
+#ifdef CONFIG_BUTTON_CALLBACK_TIMER
 #define CALL_EVENT_CB(ev)   if(btn->cb[ev])btn->cb[ev](btn)
+#else
+#define CALL_EVENT_CB(ev)   if(btn->cb[ev])button_post_event(btn, ev)
+
+#define EVENT_QUEUE_LEN     CONFIG_BUTTON_EVENT_QUEUE_LEN
+#define LATENCY_BUCKETS     (20)
+
+_Static_assert((EVENT_QUEUE_LEN & (EVENT_QUEUE_LEN - 1)) == 0, "CONFIG_BUTTON_EVENT_QUEUE_LEN must be a power of two");
+
+/**
+ * @brief An event waiting for its callback, with the button state at the time it happened
+ */
+typedef struct {
+    button_dev_t   *btn;
+    int64_t         time_us;
+    uint8_t         cb;          /**< index of the callback to run */
+    uint8_t         event;       /**< btn->event, BUTTON_PRESS_DOWN for BUTTON_PRESS_REPEAT */
+    uint8_t         repeat;
+    int16_t         gesture_id;
+} button_msg_t;
+
+/**< posted and dispatched event counts, the scan posts and one consumer dispatches */
+static atomic_uint g_queue_head = 0;
+static atomic_uint g_queue_tail = 0;
+static uint32_t g_latency_hist[LATENCY_BUCKETS] = {0};
+static const button_msg_t *g_dispatch_msg = NULL;
+static TaskHandle_t g_dispatch_msg_task = NULL;
+static SemaphoreHandle_t g_dispatch_done = NULL;   /**< given after each event dispatched, for button_dispatch_wait() */
+
+#ifdef CONFIG_BUTTON_CALLBACK_TASK
+static button_msg_t g_queue[EVENT_QUEUE_LEN];
+static TaskHandle_t g_dispatch_task = NULL;
+#else
+/**< the task of the default event loop, named by esp_event_loop_create_default() */
+#define EVENT_LOOP_TASK_NAME    "sys_evt"
+
+ESP_EVENT_DEFINE_BASE(BUTTON_EVENT);
+static bool g_event_handler_registered = false;
+#endif
+
+static void button_post_event(button_dev_t *btn, button_event_t cb);
+#endif
+
+/**
+ * @brief Report a gesture on the first button of its matcher
+ */
+static void button_gesture_report(button_gesture_t *gesture, int gesture_id)
+{
+    for (button_dev_t *btn = g_head_handle; btn; btn = btn->next) {
+        if (btn->gesture == gesture && btn->gesture_button == 0) {
+            btn->gesture_id = gesture_id;
+            CALL_EVENT_CB(BUTTON_GESTURE);
+            return;
+        }
+    }
+}
 
 /**
   * @brief  Button driver core function, driver state machine.
@@ -75,6 +141,14 @@ static void button_handler(button_dev_t *btn)
         if (++(btn->debounce_cnt) >= DEBOUNCE_TICKS) {
             btn->button_level = read_gpio_level;
             btn->debounce_cnt = 0;
+
+            if (btn->gesture) {
+                int id = button_gesture_feed(btn->gesture, btn->gesture_button, btn->button_level == btn->active_level,
+                                             (uint32_t)(esp_timer_get_time() / 1000));
+                if (id != BUTTON_GESTURE_NONE) {
+                    button_gesture_report(btn->gesture, id);
+                }
+            }
         }
     } else {
         btn->debounce_cnt = 0;
@@ -155,18 +229,240 @@ static void button_handler(button_dev_t *btn)
     }
 }
 
+#ifndef CONFIG_BUTTON_CALLBACK_TIMER
+static bool button_is_listed(const button_dev_t *btn)
+{
+    for (button_dev_t *target = g_head_handle; target; target = target->next) {
+        if (target == btn) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void button_dispatch(const button_msg_t *msg)
+{
+    uint32_t latency = (uint32_t)(esp_timer_get_time() - msg->time_us);
+    int bucket = latency > 1 ? 31 - __builtin_clz(latency) : 0;
+
+    g_latency_hist[bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1]++;
+    if (latency > g_button_stats.latency_max_us) {
+        g_button_stats.latency_max_us = latency;
+    }
+
+    /**< a button deleted from a callback still has its events in the queue */
+    button_cb_t cb = button_is_listed(msg->btn) ? msg->btn->cb[msg->cb] : NULL;
+
+    if (cb) {
+        g_dispatch_msg_task = xTaskGetCurrentTaskHandle();
+        g_dispatch_msg = msg;
+        cb(msg->btn);
+        g_dispatch_msg = NULL;
+    }
+
+    atomic_fetch_add_explicit(&g_queue_tail, 1, memory_order_release);
+    xSemaphoreGive(g_dispatch_done);
+}
+
+#ifdef CONFIG_BUTTON_CALLBACK_TASK
+static void button_dispatch_task(void *arg)
+{
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        uint32_t tail = atomic_load_explicit(&g_queue_tail, memory_order_relaxed);
+
+        while (tail != atomic_load_explicit(&g_queue_head, memory_order_acquire)) {
+            button_dispatch(&g_queue[tail++ & (EVENT_QUEUE_LEN - 1)]);
+        }
+    }
+}
+#else
+static void button_event_handler(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    button_dispatch(data);
+}
+#endif
+
+/**
+ * @brief Queue a callback from the scan, it never waits for the consumer
+ */
+static void button_post_event(button_dev_t *btn, button_event_t cb)
+{
+    uint32_t head = atomic_load_explicit(&g_queue_head, memory_order_relaxed);
+    uint32_t depth = head - atomic_load_explicit(&g_queue_tail, memory_order_acquire);
+    button_msg_t msg = {
+        .btn = btn,
+        .time_us = esp_timer_get_time(),
+        .cb = cb,
+        .event = btn->event,
+        .repeat = btn->repeat,
+        .gesture_id = btn->gesture_id,
+    };
+
+    g_button_stats.event_count++;
+
+    if (depth >= EVENT_QUEUE_LEN) {
+        g_button_stats.event_dropped++;
+        return;
+    }
+
+#ifdef CONFIG_BUTTON_CALLBACK_TASK
+    g_queue[head & (EVENT_QUEUE_LEN - 1)] = msg;
+    atomic_store_explicit(&g_queue_head, head + 1, memory_order_release);
+    xTaskNotifyGive(g_dispatch_task);
+#else
+    /**< the default event loop is created by the application, maybe after the first button */
+    if (!g_event_handler_registered) {
+        g_event_handler_registered = esp_event_handler_register(BUTTON_EVENT, ESP_EVENT_ANY_ID,
+                                                                button_event_handler, NULL) == ESP_OK;
+    }
+
+    if (!g_event_handler_registered || esp_event_post(BUTTON_EVENT, cb, &msg, sizeof(msg), 0) != ESP_OK) {
+        g_button_stats.event_dropped++;
+        return;
+    }
+
+    atomic_store_explicit(&g_queue_head, head + 1, memory_order_release);
+#endif
+
+    if (depth + 1 > g_button_stats.queue_depth_max) {
+        g_button_stats.queue_depth_max = depth + 1;
+    }
+}
+
+/**
+ * @brief Whether this task runs the callbacks, so it cannot wait for them
+ */
+static bool button_is_dispatch_task(void)
+{
+#ifdef CONFIG_BUTTON_CALLBACK_TASK
+    return xTaskGetCurrentTaskHandle() == g_dispatch_task;
+#else
+    /**< a callback, or any other handler of the default event loop */
+    return strcmp(pcTaskGetName(NULL), EVENT_LOOP_TASK_NAME) == 0;
+#endif
+}
+
+/**
+ * @brief Wait until the callbacks queued so far have returned
+ */
+static void button_dispatch_wait(void)
+{
+    uint32_t head = atomic_load_explicit(&g_queue_head, memory_order_acquire);
+
+    if (button_is_dispatch_task()) {
+        return;
+    }
+
+    /**< a give left from an earlier callback only costs one more check */
+    while ((int32_t)(head - atomic_load_explicit(&g_queue_tail, memory_order_acquire)) > 0) {
+        xSemaphoreTake(g_dispatch_done, portMAX_DELAY);
+    }
+}
+
+/**
+ * @brief Latency of the event at the rank of the percentile, interpolated in its bucket
+ */
+static uint32_t button_latency_percentile(uint32_t total, uint32_t percent)
+{
+    uint32_t rank = (uint32_t)(((uint64_t)total * percent + 99) / 100);
+    uint32_t count = 0;
+
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        if (g_latency_hist[i] && count + g_latency_hist[i] >= rank) {
+            /**< bucket i holds [2^i, 2^(i+1)), the first one [0, 2) */
+            uint32_t low = i ? 1U << i : 0;
+            uint32_t us = low + (uint32_t)((uint64_t)((2U << i) - low) * (rank - count) / g_latency_hist[i]);
+
+            /**< the last bucket has no upper bound, and no event was slower than the max */
+            return us < g_button_stats.latency_max_us ? us : g_button_stats.latency_max_us;
+        }
+
+        count += g_latency_hist[i];
+    }
+
+    return 0;
+}
+#endif
+
+static bool button_is_idle(const button_dev_t *btn)
+{
+    /**< a gesture waiting for its timing windows needs the scan too */
+    return btn->state == 0 && btn->debounce_cnt == 0 && btn->button_level != btn->active_level &&
+           !button_gesture_busy(btn->gesture);
+}
+
 static void button_cb(void *args)
 {
     button_dev_t *target;
+    bool enter_power_save = true;
+
+    g_button_stats.scan_count++;
+
     for (target = g_head_handle; target; target = target->next) {
         button_handler(target);
+
+        /**< one tick per matcher, on its first button */
+        if (target->gesture && target->gesture_button == 0) {
+            int id = button_gesture_tick(target->gesture, (uint32_t)(esp_timer_get_time() / 1000));
+            if (id != BUTTON_GESTURE_NONE) {
+                button_gesture_report(target->gesture, id);
+            }
+        }
+
+        /**< the scan can only stop if every button can wake it up again */
+        if (!target->enable_power_save || !button_is_idle(target)) {
+            enter_power_save = false;
+        }
+    }
+
+    if (enter_power_save && g_is_timer_running) {
+        esp_timer_stop(g_button_timer_handle);
+        g_is_timer_running = false;
+
+        /**< level interrupts: a button pressed meanwhile fires as soon as it is enabled */
+        for (target = g_head_handle; target; target = target->next) {
+            button_gpio_intr_control((int)(target->usr_data), true);
+        }
     }
 }
 
-static button_dev_t *button_create_com(uint8_t active_level, uint8_t (*hal_get_key_state)(void *usr_data), void *usr_data)
+static void button_power_save_isr_handler(void *arg)
+{
+    g_button_stats.irq_count++;
+
+    /**< the level stays active while pressed, mask it until the scan sees the button idle */
+    button_gpio_intr_control((int)arg, false);
+
+    if (!g_is_timer_running) {
+        esp_timer_start_periodic(g_button_timer_handle, TICKS_INTERVAL * 1000U);
+        g_is_timer_running = true;
+    }
+}
+
+static button_dev_t *button_create_com(uint8_t active_level, uint8_t (*hal_get_key_state)(void *usr_data), void *usr_data,
+                                       bool enable_power_save)
 {
     BTN_CHECK(NULL != hal_get_key_state, "Function pointer is invalid", NULL);
 
+#ifndef CONFIG_BUTTON_CALLBACK_TIMER
+    if (NULL == g_dispatch_done) {
+        g_dispatch_done = xSemaphoreCreateBinary();
+        BTN_CHECK(NULL != g_dispatch_done, "button semaphore create failed", NULL);
+    }
+#endif
+
+#ifdef CONFIG_BUTTON_CALLBACK_TASK
+    /**< kept once created, a callback may delete the last button */
+    if (NULL == g_dispatch_task) {
+        xTaskCreate(button_dispatch_task, "button", CONFIG_BUTTON_TASK_STACK_SIZE, NULL,
+                    CONFIG_BUTTON_TASK_PRIORITY, &g_dispatch_task);
+        BTN_CHECK(NULL != g_dispatch_task, "button task create failed", NULL);
+    }
+#endif
+
     button_dev_t *btn = (button_dev_t *) calloc(1, sizeof(button_dev_t));
     BTN_CHECK(NULL != btn, "Button memory alloc failed", NULL);
     btn->usr_data = usr_data;
@@ -174,18 +470,24 @@ static button_dev_t *button_create_com(uint8_t active_level, uint8_t (*hal_get_k
     btn->active_level = active_level;
     btn->hal_button_Level = hal_get_key_state;
     btn->button_level = !active_level;
+    btn->enable_power_save = enable_power_save;
+    btn->gesture_id = BUTTON_GESTURE_NONE;
 
     /** Add handle to list */
     btn->next = g_head_handle;
     g_head_handle = btn;
 
-    if (false == g_is_timer_running) {
-        esp_timer_create_args_t button_timer;
+    if (NULL == g_button_timer_handle) {
+        esp_timer_create_args_t button_timer = {0};
         button_timer.arg = NULL;
         button_timer.callback = button_cb;
         button_timer.dispatch_method = ESP_TIMER_TASK;
         button_timer.name = "button_timer";
         esp_timer_create(&button_timer, &g_button_timer_handle);
+    }
+
+    /**< a power save button starts the scan from its interrupt */
+    if (!enable_power_save && false == g_is_timer_running) {
         esp_timer_start_periodic(g_button_timer_handle, TICKS_INTERVAL * 1000U);
         g_is_timer_running = true;
     }
@@ -197,11 +499,20 @@ static esp_err_t button_delete_com(button_dev_t *btn)
 {
     BTN_CHECK(NULL != btn, "Pointer of handle is invalid", ESP_ERR_INVALID_ARG);
 
+#ifndef CONFIG_BUTTON_CALLBACK_TIMER
+    /**< run the callbacks already queued for it, unless they run on this task */
+    button_dispatch_wait();
+#endif
+
     button_dev_t **curr;
     for (curr = &g_head_handle; *curr; ) {
         button_dev_t *entry = *curr;
         if (entry == btn) {
             *curr = entry->next;
+#ifndef CONFIG_BUTTON_CALLBACK_TIMER
+            /**< the ones posted meanwhile are skipped, wait until none is running */
+            button_dispatch_wait();
+#endif
             free(entry);
         } else {
             curr = &entry->next;
@@ -217,10 +528,13 @@ static esp_err_t button_delete_com(button_dev_t *btn)
     }
     ESP_LOGD(TAG, "remain btn number=%d", number);
 
-    if (0 == number && g_is_timer_running) { /**<  if all button is deleted, stop the timer */
-        esp_timer_stop(g_button_timer_handle);
+    if (0 == number && g_button_timer_handle) { /**<  if all button is deleted, stop the timer */
+        if (g_is_timer_running) {
+            esp_timer_stop(g_button_timer_handle);
+            g_is_timer_running = false;
+        }
         esp_timer_delete(g_button_timer_handle);
-        g_is_timer_running = false;
+        g_button_timer_handle = NULL;
     }
     return ESP_OK;
 }
@@ -234,13 +548,34 @@ button_handle_t iot_button_create(const button_config_t *config)
         const button_gpio_config_t *cfg = &(config->gpio_button_config);
         ret = button_gpio_init(cfg);
         BTN_CHECK(ESP_OK == ret, "gpio button init failed", NULL);
-        btn = button_create_com(cfg->active_level, button_gpio_get_key_level, (void *)cfg->gpio_num);
+        btn = button_create_com(cfg->active_level, button_gpio_get_key_level, (void *)cfg->gpio_num,
+                                cfg->enable_power_save);
+        BTN_CHECK(NULL != btn, "button create failed", NULL);
+        btn->type = BUTTON_TYPE_GPIO;
+
+        if (cfg->enable_power_save) {
+            ret = button_gpio_set_intr(cfg->gpio_num, cfg->active_level ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL,
+                                       button_power_save_isr_handler, (void *)cfg->gpio_num);
+            if (ESP_OK != ret) {
+                ESP_LOGE(TAG, "gpio button interrupt init failed");
+                iot_button_delete(btn);
+                return NULL;
+            }
+
+            button_gpio_intr_control(cfg->gpio_num, true);
+
+            /**< not every gpio can wake the chip, the button then works while the chip is awake */
+            if (button_gpio_enable_gpio_wakeup(cfg->gpio_num, cfg->active_level, true) != ESP_OK) {
+                ESP_LOGW(TAG, "gpio %d cannot wake up the chip from light sleep", (int)cfg->gpio_num);
+            }
+        }
     } break;
     case BUTTON_TYPE_ADC: {
         const button_adc_config_t *cfg = &(config->adc_button_config);
         ret = button_adc_init(cfg);
         BTN_CHECK(ESP_OK == ret, "adc button init failed", NULL);
-        btn = button_create_com(1, button_adc_get_key_level, (void *)ADC_BUTTON_COMBINE(cfg->adc_channel, cfg->button_index));
+        btn = button_create_com(1, button_adc_get_key_level, (void *)ADC_BUTTON_COMBINE(cfg->adc_channel, cfg->button_index),
+                                false);
     } break;
 
     default:
@@ -259,6 +594,11 @@ esp_err_t iot_button_delete(button_handle_t btn_handle)
     button_dev_t *btn = (button_dev_t *)btn_handle;
     switch (btn->type) {
     case BUTTON_TYPE_GPIO:
+        if (btn->enable_power_save) {
+            button_gpio_intr_control((int)(btn->usr_data), false);
+            gpio_isr_handler_remove((int)(btn->usr_data));
+            button_gpio_enable_gpio_wakeup((int)(btn->usr_data), btn->active_level, false);
+        }
         ret = button_gpio_deinit((int)(btn->usr_data));
         break;
     case BUTTON_TYPE_ADC:
@@ -294,6 +634,12 @@ button_event_t iot_button_get_event(button_handle_t btn_handle)
 {
     BTN_CHECK(NULL != btn_handle, "Pointer of handle is invalid", BUTTON_NONE_PRESS);
     button_dev_t *btn = (button_dev_t *) btn_handle;
+#ifndef CONFIG_BUTTON_CALLBACK_TIMER
+    /**< from a callback, the event it was queued for */
+    if (g_dispatch_msg && g_dispatch_msg->btn == btn && g_dispatch_msg_task == xTaskGetCurrentTaskHandle()) {
+        return g_dispatch_msg->event;
+    }
+#endif
     return btn->event;
 }
 
@@ -301,5 +647,75 @@ uint8_t iot_button_get_repeat(button_handle_t btn_handle)
 {
     BTN_CHECK(NULL != btn_handle, "Pointer of handle is invalid", 0);
     button_dev_t *btn = (button_dev_t *) btn_handle;
+#ifndef CONFIG_BUTTON_CALLBACK_TIMER
+    if (g_dispatch_msg && g_dispatch_msg->btn == btn && g_dispatch_msg_task == xTaskGetCurrentTaskHandle()) {
+        return g_dispatch_msg->repeat;
+    }
+#endif
     return btn->repeat;
 }
+
+esp_err_t iot_button_set_gesture(button_gesture_t *gesture, const button_handle_t *btn_handles, uint8_t btn_num)
+{
+    BTN_CHECK(NULL != btn_handles, "Pointer of handles is invalid", ESP_ERR_INVALID_ARG);
+    BTN_CHECK(btn_num > 0 && btn_num <= BUTTON_GESTURE_BUTTON_MAX, "btn_num is invalid", ESP_ERR_INVALID_ARG);
+
+    for (int i = 0; i < btn_num; i++) {
+        BTN_CHECK(NULL != btn_handles[i], "Pointer of handle is invalid", ESP_ERR_INVALID_ARG);
+    }
+
+    if (gesture) {
+        button_gesture_reset(gesture);
+    }
+
+    for (int i = 0; i < btn_num; i++) {
+        button_dev_t *btn = (button_dev_t *) btn_handles[i];
+        btn->gesture_button = i;
+        btn->gesture_id = BUTTON_GESTURE_NONE;
+        btn->gesture = gesture;
+    }
+
+    return ESP_OK;
+}
+
+int iot_button_get_gesture(button_handle_t btn_handle)
+{
+    BTN_CHECK(NULL != btn_handle, "Pointer of handle is invalid", BUTTON_GESTURE_NONE);
+    button_dev_t *btn = (button_dev_t *) btn_handle;
+#ifndef CONFIG_BUTTON_CALLBACK_TIMER
+    if (g_dispatch_msg && g_dispatch_msg->btn == btn && g_dispatch_msg_task == xTaskGetCurrentTaskHandle()) {
+        return g_dispatch_msg->gesture_id;
+    }
+#endif
+    return btn->gesture_id;
+}
+
+esp_err_t iot_button_get_stats(button_stats_t *stats)
+{
+    BTN_CHECK(NULL != stats, "Pointer of stats is invalid", ESP_ERR_INVALID_ARG);
+    *stats = g_button_stats;
+
+#ifndef CONFIG_BUTTON_CALLBACK_TIMER
+    uint32_t total = 0;
+
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        total += g_latency_hist[i];
+    }
+
+    stats->queue_depth = atomic_load(&g_queue_head) - atomic_load(&g_queue_tail);
+    stats->latency_p50_us = button_latency_percentile(total, 50);
+    stats->latency_p90_us = button_latency_percentile(total, 90);
+    stats->latency_p99_us = button_latency_percentile(total, 99);
+#endif
+
+    return ESP_OK;
+}
+
+esp_err_t iot_button_reset_stats(void)
+{
+    memset(&g_button_stats, 0, sizeof(button_stats_t));
+#ifndef CONFIG_BUTTON_CALLBACK_TIMER
+    memset(g_latency_hist, 0, sizeof(g_latency_hist));
+#endif
+    return ESP_OK;
+}
@@ -13,11 +13,17 @@
 // limitations under the License.
 
 #include "stdio.h"
+#include "string.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "freertos/timers.h"
 #include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "esp_adc/adc_oneshot.h"
+#include "driver/gpio.h"
 #include "unity.h"
 #include "iot_button.h"
 
@@ -231,4 +237,346 @@ TEST_CASE("adc gpio button test", "[button][iot]")
     for (size_t i = 0; i < 6; i++) {
         iot_button_delete(g_btns[i]);
     }
-}
\ No newline at end of file
+}
+
+#define TRACE_GPIO_NUM        4
+#define TRACE_EVENT_MAX       64
+
+typedef struct {
+    uint8_t  pressed;
+    uint16_t ms;                  /**< 0: a glitch of 3 ms */
+} trace_step_t;
+
+typedef struct {
+    button_event_t event;
+    uint8_t        repeat;
+    uint16_t       count;         /**< consecutive BUTTON_LONG_PRESS_HOLD are counted in one entry */
+} trace_event_t;
+
+/**
+ * Single click, glitch, double click, triple click and long press, each
+ * followed by enough idle time for the power save scan to stop.
+ */
+static const trace_step_t g_trace[] = {
+    {0, 1000}, {1, 100}, {0, 1000},
+    {1, 0},   {0, 1000},
+    {1, 80},  {0, 80},  {1, 80}, {0, 1000},
+    {1, 80},  {0, 80},  {1, 80}, {0, 80}, {1, 80}, {0, 1000},
+    {1, 2000}, {0, 1000},
+};
+
+static trace_event_t g_trace_events[TRACE_EVENT_MAX];
+static size_t g_trace_event_num;
+
+/**
+ * The callbacks run from the default event loop, the application creates it
+ */
+static void button_test_event_loop(void)
+{
+#ifdef CONFIG_BUTTON_CALLBACK_ESP_EVENT
+    esp_err_t ret = esp_event_loop_create_default();
+    TEST_ASSERT_TRUE(ESP_OK == ret || ESP_ERR_INVALID_STATE == ret);
+#endif
+}
+
+static void button_trace_cb(void *arg)
+{
+    button_event_t event = iot_button_get_event(arg);
+    trace_event_t *last = g_trace_event_num ? &g_trace_events[g_trace_event_num - 1] : NULL;
+
+    if (last && event == BUTTON_LONG_PRESS_HOLD && last->event == BUTTON_LONG_PRESS_HOLD) {
+        last->count++;
+        return;
+    }
+
+    TEST_ASSERT_LESS_THAN(TRACE_EVENT_MAX, g_trace_event_num);
+    g_trace_events[g_trace_event_num++] = (trace_event_t) {
+        .event = event, .repeat = iot_button_get_repeat(arg), .count = 1,
+    };
+}
+
+/**
+ * Drive the button pin through its output, read back by the button's input
+ */
+static size_t button_replay_trace(bool enable_power_save, trace_event_t *events, button_stats_t *stats)
+{
+    button_config_t cfg = {
+        .type = BUTTON_TYPE_GPIO,
+        .gpio_button_config = {
+            .gpio_num = TRACE_GPIO_NUM,
+            .active_level = 0,
+            .enable_power_save = enable_power_save,
+        },
+    };
+
+    g_trace_event_num = 0;
+    button_test_event_loop();
+    button_handle_t btn = iot_button_create(&cfg);
+    TEST_ASSERT_NOT_NULL(btn);
+    TEST_ASSERT_EQUAL(ESP_OK, gpio_set_direction(TRACE_GPIO_NUM, GPIO_MODE_INPUT_OUTPUT));
+    gpio_set_level(TRACE_GPIO_NUM, 1);
+
+    for (int i = 0; i < BUTTON_EVENT_MAX; i++) {
+        iot_button_register_cb(btn, i, button_trace_cb);
+    }
+
+    iot_button_reset_stats();
+
+    for (int i = 0; i < sizeof(g_trace) / sizeof(g_trace[0]); i++) {
+        gpio_set_level(TRACE_GPIO_NUM, !g_trace[i].pressed);
+
+        if (g_trace[i].ms) {
+            vTaskDelay(pdMS_TO_TICKS(g_trace[i].ms));
+        } else {
+            esp_rom_delay_us(3000);
+        }
+    }
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_button_get_stats(stats));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_button_delete(btn));
+    memcpy(events, g_trace_events, g_trace_event_num * sizeof(trace_event_t));
+    return g_trace_event_num;
+}
+
+TEST_CASE("gpio button power save replays the same events", "[button][power_save]")
+{
+    static trace_event_t scan_events[TRACE_EVENT_MAX];
+    static trace_event_t irq_events[TRACE_EVENT_MAX];
+    button_stats_t scan_stats = {0};
+    button_stats_t irq_stats = {0};
+
+    size_t scan_num = button_replay_trace(false, scan_events, &scan_stats);
+    size_t irq_num = button_replay_trace(true, irq_events, &irq_stats);
+
+    ESP_LOGI(TAG, "%u events, scans: %u polling, %u power save woken up %u times", (unsigned)scan_num,
+             (unsigned)scan_stats.scan_count, (unsigned)irq_stats.scan_count, (unsigned)irq_stats.irq_count);
+
+    TEST_ASSERT_GREATER_THAN(0, scan_num);
+    TEST_ASSERT_EQUAL(scan_num, irq_num);
+
+    for (size_t i = 0; i < scan_num; i++) {
+        TEST_ASSERT_EQUAL(scan_events[i].event, irq_events[i].event);
+        TEST_ASSERT_EQUAL(scan_events[i].repeat, irq_events[i].repeat);
+        /**< the scan phase differs by up to one tick */
+        TEST_ASSERT_UINT32_WITHIN(1, scan_events[i].count, irq_events[i].count);
+    }
+
+    /**< every press and the glitch wake the scan up once */
+    TEST_ASSERT_EQUAL(0, scan_stats.irq_count);
+    TEST_ASSERT_EQUAL(5, irq_stats.irq_count);
+    TEST_ASSERT_LESS_THAN(scan_stats.scan_count / 2, irq_stats.scan_count);
+}
+
+
+#ifdef CONFIG_BUTTON_CALLBACK_TASK
+static uint32_t g_hold_count;
+
+static void button_slow_hold_cb(void *arg)
+{
+    /**< like a callback committing to NVS */
+    g_hold_count++;
+    vTaskDelay(pdMS_TO_TICKS(20));
+}
+
+TEST_CASE("gpio button slow callbacks do not hold up the scan", "[button][queue]")
+{
+    button_config_t cfg = {
+        .type = BUTTON_TYPE_GPIO,
+        .gpio_button_config = {
+            .gpio_num = TRACE_GPIO_NUM,
+            .active_level = 0,
+        },
+    };
+    button_stats_t stats = {0};
+
+    g_hold_count = 0;
+    button_handle_t btn = iot_button_create(&cfg);
+    TEST_ASSERT_NOT_NULL(btn);
+    TEST_ASSERT_EQUAL(ESP_OK, gpio_set_direction(TRACE_GPIO_NUM, GPIO_MODE_INPUT_OUTPUT));
+    gpio_set_level(TRACE_GPIO_NUM, 1);
+    iot_button_register_cb(btn, BUTTON_LONG_PRESS_HOLD, button_slow_hold_cb);
+    iot_button_reset_stats();
+
+    /**< about 100 hold events, one every scan, each callback takes 4 scans */
+    gpio_set_level(TRACE_GPIO_NUM, 0);
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_BUTTON_LONG_PRESS_TIME_MS + 500));
+    gpio_set_level(TRACE_GPIO_NUM, 1);
+    vTaskDelay(pdMS_TO_TICKS(500));
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_button_get_stats(&stats));
+    uint32_t scan_count = stats.scan_count;
+
+    /**< deleting waits for the queued callbacks */
+    TEST_ASSERT_EQUAL(ESP_OK, iot_button_delete(btn));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_button_get_stats(&stats));
+
+    ESP_LOGI(TAG, "%u scans, %u events, %u dropped, depth max %u, latency p50 %u p90 %u p99 %u max %u us",
+             (unsigned)scan_count, (unsigned)stats.event_count, (unsigned)stats.event_dropped,
+             (unsigned)stats.queue_depth_max, (unsigned)stats.latency_p50_us, (unsigned)stats.latency_p90_us,
+             (unsigned)stats.latency_p99_us, (unsigned)stats.latency_max_us);
+
+    /**< the scan keeps its period, the queue absorbs what the callback cannot keep up with */
+    TEST_ASSERT_UINT32_WITHIN(10, (CONFIG_BUTTON_LONG_PRESS_TIME_MS + 1000) / CONFIG_BUTTON_PERIOD_TIME_MS, scan_count);
+    TEST_ASSERT_GREATER_THAN(0, stats.event_dropped);
+    TEST_ASSERT_EQUAL(CONFIG_BUTTON_EVENT_QUEUE_LEN, stats.queue_depth_max);
+    TEST_ASSERT_EQUAL(stats.event_count - stats.event_dropped, g_hold_count);
+    TEST_ASSERT_EQUAL(0, stats.queue_depth);
+    TEST_ASSERT_LESS_OR_EQUAL(stats.latency_p90_us, stats.latency_p50_us);
+    TEST_ASSERT_LESS_OR_EQUAL(stats.latency_p99_us, stats.latency_p90_us);
+    TEST_ASSERT_LESS_OR_EQUAL(stats.latency_max_us, stats.latency_p99_us);
+}
+#endif
+
+#ifdef CONFIG_BUTTON_CALLBACK_ESP_EVENT
+ESP_EVENT_DEFINE_BASE(BUTTON_TEST_EVENT);
+
+static uint32_t g_down_count;
+static SemaphoreHandle_t g_deleted;
+
+static void button_count_down_cb(void *arg)
+{
+    g_down_count++;
+}
+
+static void button_delete_handler(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    /**< the press is posted behind this event, its callback cannot run before this handler returns */
+    gpio_set_level(TRACE_GPIO_NUM, 0);
+    vTaskDelay(pdMS_TO_TICKS(50));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_button_delete(*(button_handle_t *)data));
+    xSemaphoreGive(g_deleted);
+}
+
+TEST_CASE("gpio button deleted from another event handler", "[button][esp_event]")
+{
+    button_config_t cfg = {
+        .type = BUTTON_TYPE_GPIO,
+        .gpio_button_config = {
+            .gpio_num = TRACE_GPIO_NUM,
+            .active_level = 0,
+        },
+    };
+    button_stats_t stats = {0};
+
+    button_test_event_loop();
+    g_deleted = xSemaphoreCreateBinary();
+    g_down_count = 0;
+    button_handle_t btn = iot_button_create(&cfg);
+    TEST_ASSERT_NOT_NULL(btn);
+    TEST_ASSERT_EQUAL(ESP_OK, gpio_set_direction(TRACE_GPIO_NUM, GPIO_MODE_INPUT_OUTPUT));
+    gpio_set_level(TRACE_GPIO_NUM, 1);
+    iot_button_register_cb(btn, BUTTON_PRESS_DOWN, button_count_down_cb);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_handler_register(BUTTON_TEST_EVENT, 0, button_delete_handler, NULL));
+    iot_button_reset_stats();
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_post(BUTTON_TEST_EVENT, 0, &btn, sizeof(btn), portMAX_DELAY));
+
+    /**< waiting for the press callback would block the event loop for ever */
+    TEST_ASSERT_TRUE(xSemaphoreTake(g_deleted, pdMS_TO_TICKS(1000)));
+    vTaskDelay(pdMS_TO_TICKS(100));
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_button_get_stats(&stats));
+    TEST_ASSERT_EQUAL(1, stats.event_count);
+    TEST_ASSERT_EQUAL(0, stats.queue_depth);
+    /**< dropped with its button */
+    TEST_ASSERT_EQUAL(0, g_down_count);
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_handler_unregister(BUTTON_TEST_EVENT, 0, button_delete_handler));
+    gpio_set_level(TRACE_GPIO_NUM, 1);
+    vSemaphoreDelete(g_deleted);
+}
+#endif
+
+#define BENCH_CHANNEL_NUM     3
+#define BENCH_BUTTON_NUM      8
+#define BENCH_SCAN_NUM        200
+
+static const adc_channel_t g_bench_channel[BENCH_CHANNEL_NUM] = {ADC_CHANNEL_0, ADC_CHANNEL_1, ADC_CHANNEL_2};
+
+static uint8_t bench_classify(uint32_t mv, int button)
+{
+    return mv > button * 400 && mv <= (button + 1) * 400;
+}
+
+/**
+ * The former backend: blocking oneshot reads of every channel in each scan
+ */
+static int64_t bench_oneshot_scan(adc_oneshot_unit_handle_t unit, uint32_t *pressed)
+{
+    int64_t start = esp_timer_get_time();
+
+    for (int ch = 0; ch < BENCH_CHANNEL_NUM; ch++) {
+        int sum = 0;
+
+        for (int i = 0; i < CONFIG_ADC_BUTTON_SAMPLE_TIMES; i++) {
+            int raw = 0;
+            adc_oneshot_read(unit, g_bench_channel[ch], &raw);
+            sum += raw;
+        }
+
+        for (int i = 0; i < BENCH_BUTTON_NUM; i++) {
+            *pressed += bench_classify(sum / CONFIG_ADC_BUTTON_SAMPLE_TIMES, i);
+        }
+    }
+
+    return esp_timer_get_time() - start;
+}
+
+TEST_CASE("adc button scan of 3 channels x 8 buttons, oneshot vs continuous", "[button][adc][bench]")
+{
+    adc_oneshot_unit_handle_t unit = NULL;
+    adc_oneshot_unit_init_cfg_t unit_cfg = {.unit_id = ADC_UNIT_1};
+    adc_oneshot_chan_cfg_t chan_cfg = {.bitwidth = ADC_BITWIDTH_DEFAULT, .atten = ADC_ATTEN_DB_12};
+    int64_t oneshot_us = 0, continuous_us = 0;
+    uint32_t pressed = 0;
+
+    TEST_ASSERT_EQUAL(ESP_OK, adc_oneshot_new_unit(&unit_cfg, &unit));
+
+    for (int ch = 0; ch < BENCH_CHANNEL_NUM; ch++) {
+        TEST_ASSERT_EQUAL(ESP_OK, adc_oneshot_config_channel(unit, g_bench_channel[ch], &chan_cfg));
+    }
+
+    for (int i = 0; i < BENCH_SCAN_NUM; i++) {
+        oneshot_us += bench_oneshot_scan(unit, &pressed);
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_BUTTON_PERIOD_TIME_MS));
+    }
+
+    TEST_ASSERT_EQUAL(ESP_OK, adc_oneshot_del_unit(unit));
+
+    /**< the same buttons on the backend, one DMA read per scan for all channels */
+    for (int ch = 0; ch < BENCH_CHANNEL_NUM; ch++) {
+        for (int i = 0; i < BENCH_BUTTON_NUM; i++) {
+            button_adc_config_t cfg = {
+                .adc_channel = g_bench_channel[ch],
+                .button_index = i,
+                .min = i * 400,
+                .max = (i + 1) * 400,
+            };
+            TEST_ASSERT_EQUAL(ESP_OK, button_adc_init(&cfg));
+        }
+    }
+
+    for (int i = 0; i < BENCH_SCAN_NUM; i++) {
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_BUTTON_PERIOD_TIME_MS));
+        int64_t start = esp_timer_get_time();
+
+        for (int ch = 0; ch < BENCH_CHANNEL_NUM; ch++) {
+            for (int j = 0; j < BENCH_BUTTON_NUM; j++) {
+                pressed += button_adc_get_key_level((void *)ADC_BUTTON_COMBINE(g_bench_channel[ch], j));
+            }
+        }
+
+        continuous_us += esp_timer_get_time() - start;
+    }
+
+    for (int ch = 0; ch < BENCH_CHANNEL_NUM; ch++) {
+        for (int i = 0; i < BENCH_BUTTON_NUM; i++) {
+            TEST_ASSERT_EQUAL(ESP_OK, button_adc_deinit(g_bench_channel[ch], i));
+        }
+    }
+
+    printf("%d scans of %d x %d buttons: oneshot %u us, continuous %u us (%u presses)\n", BENCH_SCAN_NUM,
+           BENCH_CHANNEL_NUM, BENCH_BUTTON_NUM, (unsigned)oneshot_us, (unsigned)continuous_us, (unsigned)pressed);
+    TEST_ASSERT_TRUE(continuous_us < oneshot_us);
+}
+
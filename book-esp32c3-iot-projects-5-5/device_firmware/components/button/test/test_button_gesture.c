@@ -0,0 +1,215 @@
+// Copyright 2020 Espressif Systems (Shanghai) Co. Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stdio.h"
+#include "string.h"
+#include "unity.h"
+#include "button_gesture.h"
+
+#define SCAN_MS        5
+#define HIT_MAX        8
+#define CHORD_MS       80
+
+enum {
+    GESTURE_CLICK,
+    GESTURE_DOUBLE_CLICK,
+    GESTURE_TRIPLE_CLICK,
+    GESTURE_CLICK_HOLD,
+    GESTURE_LONG_PRESS,
+    GESTURE_MEDIUM_PRESS,
+    GESTURE_CHORD,
+    GESTURE_NUM,
+};
+
+static const button_gesture_step_t g_click[] = {
+    BUTTON_GESTURE_PRESS_STEP(0x1, 0), BUTTON_GESTURE_RELEASE_STEP(0x1, 0, 300),
+};
+
+static const button_gesture_step_t g_double_click[] = {
+    BUTTON_GESTURE_PRESS_STEP(0x1, 0),   BUTTON_GESTURE_RELEASE_STEP(0x1, 0, 300),
+    BUTTON_GESTURE_PRESS_STEP(0x1, 250), BUTTON_GESTURE_RELEASE_STEP(0x1, 0, 300),
+};
+
+static const button_gesture_step_t g_triple_click[] = {
+    BUTTON_GESTURE_PRESS_STEP(0x1, 0),   BUTTON_GESTURE_RELEASE_STEP(0x1, 0, 300),
+    BUTTON_GESTURE_PRESS_STEP(0x1, 250), BUTTON_GESTURE_RELEASE_STEP(0x1, 0, 300),
+    BUTTON_GESTURE_PRESS_STEP(0x1, 250), BUTTON_GESTURE_RELEASE_STEP(0x1, 0, 300),
+};
+
+static const button_gesture_step_t g_click_hold[] = {
+    BUTTON_GESTURE_PRESS_STEP(0x1, 0),   BUTTON_GESTURE_RELEASE_STEP(0x1, 0, 300),
+    BUTTON_GESTURE_PRESS_STEP(0x1, 250), BUTTON_GESTURE_HOLD_STEP(0x1, 1000),
+};
+
+static const button_gesture_step_t g_long_press[] = {
+    BUTTON_GESTURE_PRESS_STEP(0x1, 0), BUTTON_GESTURE_HOLD_STEP(0x1, 3000),
+};
+
+static const button_gesture_step_t g_medium_press[] = {
+    BUTTON_GESTURE_PRESS_STEP(0x1, 0), BUTTON_GESTURE_RELEASE_STEP(0x1, 600, 2000),
+};
+
+static const button_gesture_step_t g_chord[] = {
+    BUTTON_GESTURE_PRESS_STEP(0x3, 0), BUTTON_GESTURE_RELEASE_STEP(0x3, 0, 0),
+};
+
+#define GESTURE_DEF(steps) {steps, sizeof(steps) / sizeof(steps[0])}
+
+static const button_gesture_def_t g_defs[GESTURE_NUM] = {
+    [GESTURE_CLICK]        = GESTURE_DEF(g_click),
+    [GESTURE_DOUBLE_CLICK] = GESTURE_DEF(g_double_click),
+    [GESTURE_TRIPLE_CLICK] = GESTURE_DEF(g_triple_click),
+    [GESTURE_CLICK_HOLD]   = GESTURE_DEF(g_click_hold),
+    [GESTURE_LONG_PRESS]   = GESTURE_DEF(g_long_press),
+    [GESTURE_MEDIUM_PRESS] = GESTURE_DEF(g_medium_press),
+    [GESTURE_CHORD]        = GESTURE_DEF(g_chord),
+};
+
+/**
+ * Debounced edges as the scan sees them
+ */
+typedef struct {
+    uint32_t time_ms;
+    uint8_t  button;
+    uint8_t  pressed;
+} gesture_edge_t;
+
+typedef struct {
+    int      gesture;
+    uint32_t time_ms;
+} gesture_hit_t;
+
+/**
+ * @brief Feed the edges in time order and tick every scan until nothing is in progress
+ */
+static int gesture_replay(const gesture_edge_t *edges, int edge_num, gesture_hit_t *hits)
+{
+    static button_gesture_state_t states[GESTURE_NUM];
+    button_gesture_t gesture;
+    int hit_num = 0;
+    int next = 0;
+
+    TEST_ASSERT_EQUAL(ESP_OK, button_gesture_init(&gesture, g_defs, GESTURE_NUM, states, CHORD_MS));
+
+    for (uint32_t now = 0; next < edge_num || button_gesture_busy(&gesture); now += SCAN_MS) {
+        while (next < edge_num && edges[next].time_ms <= now) {
+            int id = button_gesture_feed(&gesture, edges[next].button, edges[next].pressed, now);
+            next++;
+
+            if (id != BUTTON_GESTURE_NONE) {
+                TEST_ASSERT_LESS_THAN(HIT_MAX, hit_num);
+                hits[hit_num++] = (gesture_hit_t) {id, now};
+            }
+        }
+
+        int id = button_gesture_tick(&gesture, now);
+
+        if (id != BUTTON_GESTURE_NONE) {
+            TEST_ASSERT_LESS_THAN(HIT_MAX, hit_num);
+            hits[hit_num++] = (gesture_hit_t) {id, now};
+        }
+
+        TEST_ASSERT_LESS_THAN(60000, now);
+    }
+
+    return hit_num;
+}
+
+#define REPLAY(edges, hits) gesture_replay(edges, sizeof(edges) / sizeof(edges[0]), hits)
+
+TEST_CASE("button gesture N-click waits for the longer gestures", "[button][gesture]")
+{
+    const gesture_edge_t click[] = {{100, 0, 1}, {180, 0, 0}};
+    const gesture_edge_t double_click[] = {{100, 0, 1}, {180, 0, 0}, {300, 0, 1}, {380, 0, 0}};
+    const gesture_edge_t triple_click[] = {
+        {100, 0, 1}, {180, 0, 0}, {300, 0, 1}, {380, 0, 0}, {500, 0, 1}, {560, 0, 0},
+    };
+    const gesture_edge_t slow_double_click[] = {{100, 0, 1}, {180, 0, 0}, {480, 0, 1}, {560, 0, 0}};
+    gesture_hit_t hits[HIT_MAX];
+
+    /**< a click is only known once the window for a second press is over */
+    TEST_ASSERT_EQUAL(1, REPLAY(click, hits));
+    TEST_ASSERT_EQUAL(GESTURE_CLICK, hits[0].gesture);
+    TEST_ASSERT_UINT32_WITHIN(SCAN_MS, 180 + 250, hits[0].time_ms);
+
+    TEST_ASSERT_EQUAL(1, REPLAY(double_click, hits));
+    TEST_ASSERT_EQUAL(GESTURE_DOUBLE_CLICK, hits[0].gesture);
+    TEST_ASSERT_UINT32_WITHIN(SCAN_MS, 380 + 250, hits[0].time_ms);
+
+    /**< nothing is longer than a triple click, it is reported on the release */
+    TEST_ASSERT_EQUAL(1, REPLAY(triple_click, hits));
+    TEST_ASSERT_EQUAL(GESTURE_TRIPLE_CLICK, hits[0].gesture);
+    TEST_ASSERT_EQUAL(560, hits[0].time_ms);
+
+    TEST_ASSERT_EQUAL(2, REPLAY(slow_double_click, hits));
+    TEST_ASSERT_EQUAL(GESTURE_CLICK, hits[0].gesture);
+    TEST_ASSERT_EQUAL(GESTURE_CLICK, hits[1].gesture);
+}
+
+TEST_CASE("button gesture click-hold and press duration buckets", "[button][gesture]")
+{
+    const gesture_edge_t click_hold[] = {{100, 0, 1}, {180, 0, 0}, {300, 0, 1}, {1600, 0, 0}};
+    const gesture_edge_t long_press[] = {{100, 0, 1}, {3500, 0, 0}};
+    const gesture_edge_t medium_press[] = {{100, 0, 1}, {1100, 0, 0}};
+    const gesture_edge_t between[] = {{100, 0, 1}, {500, 0, 0}};
+    gesture_hit_t hits[HIT_MAX];
+
+    TEST_ASSERT_EQUAL(1, REPLAY(click_hold, hits));
+    TEST_ASSERT_EQUAL(GESTURE_CLICK_HOLD, hits[0].gesture);
+    TEST_ASSERT_EQUAL(1300, hits[0].time_ms);
+
+    /**< reported while still held, the release belongs to no gesture */
+    TEST_ASSERT_EQUAL(1, REPLAY(long_press, hits));
+    TEST_ASSERT_EQUAL(GESTURE_LONG_PRESS, hits[0].gesture);
+    TEST_ASSERT_EQUAL(3100, hits[0].time_ms);
+
+    TEST_ASSERT_EQUAL(1, REPLAY(medium_press, hits));
+    TEST_ASSERT_EQUAL(GESTURE_MEDIUM_PRESS, hits[0].gesture);
+    TEST_ASSERT_EQUAL(1100, hits[0].time_ms);
+
+    /**< too long for a click, too short for the medium bucket */
+    TEST_ASSERT_EQUAL(0, REPLAY(between, hits));
+}
+
+TEST_CASE("button gesture chords of two buttons", "[button][gesture]")
+{
+    const gesture_edge_t chord[] = {{100, 0, 1}, {140, 1, 1}, {500, 1, 0}, {520, 0, 0}};
+    const gesture_edge_t slow_chord[] = {{100, 0, 1}, {300, 1, 1}, {500, 1, 0}, {520, 0, 0}};
+    const gesture_edge_t other_button[] = {{100, 2, 1}, {180, 2, 0}, {400, 0, 1}, {480, 0, 0}};
+    gesture_hit_t hits[HIT_MAX];
+
+    TEST_ASSERT_EQUAL(1, REPLAY(chord, hits));
+    TEST_ASSERT_EQUAL(GESTURE_CHORD, hits[0].gesture);
+    TEST_ASSERT_EQUAL(500, hits[0].time_ms);
+
+    /**< the second button came after the chord window, and breaks the click */
+    TEST_ASSERT_EQUAL(0, REPLAY(slow_chord, hits));
+
+    /**< a button in no gesture is ignored, the next sequence starts afresh */
+    TEST_ASSERT_EQUAL(1, REPLAY(other_button, hits));
+    TEST_ASSERT_EQUAL(GESTURE_CLICK, hits[0].gesture);
+}
+
+TEST_CASE("button gesture rejects invalid tables", "[button][gesture]")
+{
+    static button_gesture_state_t states[1];
+    const button_gesture_step_t hold_first[] = {BUTTON_GESTURE_HOLD_STEP(0x1, 100)};
+    const button_gesture_step_t no_button[] = {BUTTON_GESTURE_PRESS_STEP(0x0, 0)};
+    const button_gesture_def_t defs[] = {GESTURE_DEF(hold_first), GESTURE_DEF(no_button)};
+    button_gesture_t gesture;
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, button_gesture_init(&gesture, &defs[0], 1, states, CHORD_MS));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, button_gesture_init(&gesture, &defs[1], 1, states, CHORD_MS));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, button_gesture_init(&gesture, g_defs, 0, states, CHORD_MS));
+}
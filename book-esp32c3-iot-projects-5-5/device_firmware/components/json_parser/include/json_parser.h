@@ -0,0 +1,136 @@
+/*
+ *    Copyright 2020 Piyush Shah <shahpiyushv@gmail.com>
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#ifndef _JSON_PARSER_H_
+#define _JSON_PARSER_H_
+
+#define JSMN_PARENT_LINKS
+#define JSMN_HEADER
+#include <jsmn.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define OS_SUCCESS  0
+#define OS_FAIL     -1
+
+typedef jsmn_parser json_parser_t;
+typedef jsmntok_t json_tok_t;
+
+/* Tokens added when an arena runs out, on top of an estimate for the rest of the document */
+#define JSON_TOK_ARENA_CHUNK    16
+
+/* Token storage kept across documents, so that a parse needs no heap call once it is large enough */
+typedef struct {
+    json_tok_t *tokens;
+    int *ends;              /* Last token of the subtree of each token, after the tokens in the same heap block */
+    int max_tokens;
+    bool is_static;         /* tokens is a buffer of the caller, replaced by a heap one to grow */
+    uint32_t alloc_count;   /* Heap calls made for the tokens */
+} json_tok_arena_t;
+
+/* Objects whose key index is kept at once, e.g. the node, a device and one of its params */
+#define JSON_OBJ_INDEX_CACHE    4
+
+/* Arrays whose offset table is kept at once */
+#define JSON_ARR_INDEX_CACHE    2
+
+/* Token of each element of an array */
+typedef struct {
+    int arr;                /* Token of the array */
+    int *elems;
+} json_arr_index_t;
+
+/* Open addressing hash of the keys of an object to their token */
+typedef struct {
+    int obj;                /* Token of the object */
+    int *slots;             /* Key token + 1, 0 for an empty slot */
+    int mask;               /* Slots - 1, a power of 2 */
+} json_obj_index_t;
+
+typedef struct {
+    json_parser_t parser;
+    const char *js;
+    json_tok_t *tokens;
+    json_tok_t *cur;
+    int num_tokens;
+    int *ends;                  /* Of the arena, NULL in a buffer of the caller */
+    json_tok_arena_t *arena;
+    json_tok_arena_t own_arena; /* The arena of json_parse_start() */
+    bool use_index;             /* Index large objects, set by json_parse_start() and json_parse_start_arena() */
+    json_obj_index_t index[JSON_OBJ_INDEX_CACHE];
+    int index_next;             /* Entry replaced by the next object indexed */
+    json_arr_index_t arr_index[JSON_ARR_INDEX_CACHE];
+    int arr_index_next;
+    uint32_t key_cmp_count;     /* Keys compared by the lookups, in the index too */
+    uint32_t skip_count;        /* Tokens stepped through to skip the subtrees before a key or an element */
+} jparse_ctx_t;
+
+int json_parse_start(jparse_ctx_t *jctx, const char *js, int len);
+int json_parse_end(jparse_ctx_t *jctx);
+
+/* Start with a buffer of the caller, or with an empty arena: {0} */
+void json_tok_arena_init(json_tok_arena_t *arena, json_tok_t *buffer_tokens, int buffer_tokens_max_count);
+void json_tok_arena_deinit(json_tok_arena_t *arena);
+/* Parse in one pass into the arena, growing it if needed. The tokens stay in the arena after json_parse_end_arena() */
+int json_parse_start_arena(jparse_ctx_t *jctx, const char *js, int len, json_tok_arena_t *arena);
+int json_parse_end_arena(jparse_ctx_t *jctx);
+int json_parse_start_static(jparse_ctx_t *jctx, const char *js, int len, json_tok_t *buffer_tokens, int buffer_tokens_max_count);
+int json_parse_end_static(jparse_ctx_t *jctx);
+
+int json_obj_get_array(jparse_ctx_t *jctx, const char *name, int *num_elem);
+int json_obj_leave_array(jparse_ctx_t *jctx);
+int json_obj_get_object(jparse_ctx_t *jctx, const char *name);
+int json_obj_leave_object(jparse_ctx_t *jctx);
+int json_obj_get_bool(jparse_ctx_t *jctx, const char *name, bool *val);
+int json_obj_get_int(jparse_ctx_t *jctx, const char *name, int *val);
+int json_obj_get_int64(jparse_ctx_t *jctx, const char *name, int64_t *val);
+int json_obj_get_float(jparse_ctx_t *jctx, const char *name, float *val);
+int json_obj_get_string(jparse_ctx_t *jctx, const char *name, char *val, int size);
+int json_obj_get_strlen(jparse_ctx_t *jctx, const char *name, int *strlen);
+int json_obj_get_object_str(jparse_ctx_t *jctx, const char *name, char *val, int size);
+int json_obj_get_object_strlen(jparse_ctx_t *jctx, const char *name, int *strlen);
+int json_obj_get_array_str(jparse_ctx_t *jctx, const char *name, char *val, int size);
+int json_obj_get_array_strlen(jparse_ctx_t *jctx, const char *name, int *strlen);
+
+int json_arr_get_array(jparse_ctx_t *jctx, uint32_t index);
+int json_arr_leave_array(jparse_ctx_t *jctx);
+int json_arr_get_object(jparse_ctx_t *jctx, uint32_t index);
+int json_arr_leave_object(jparse_ctx_t *jctx);
+int json_arr_get_bool(jparse_ctx_t *jctx, uint32_t index, bool *val);
+int json_arr_get_int(jparse_ctx_t *jctx, uint32_t index, int *val);
+int json_arr_get_int64(jparse_ctx_t *jctx, uint32_t index, int64_t *val);
+int json_arr_get_float(jparse_ctx_t *jctx, uint32_t index, float *val);
+int json_arr_get_string(jparse_ctx_t *jctx, uint32_t index, char *val, int size);
+int json_arr_get_strlen(jparse_ctx_t *jctx, uint32_t index, int *strlen);
+
+/* Longest number json_span_to_float() hands to strtof() when it has no exact conversion */
+#define JSON_NUM_MAX_LEN    64
+
+/* The number in str[0, len), e.g. a token or a json_stream value. Fail on anything else and out of range */
+int json_span_to_int(const char *str, int len, int *val);
+int json_span_to_int64(const char *str, int len, int64_t *val);
+int json_span_to_float(const char *str, int len, float *val);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _JSON_PARSER_H_ */
+
@@ -0,0 +1,85 @@
+/*
+ *    Copyright 2020 Piyush Shah <shahpiyushv@gmail.com>
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#ifndef _JSON_STREAM_H_
+#define _JSON_STREAM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <json_parser.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Nesting the stream can follow, one bit each */
+#define JSON_STREAM_DEPTH_MAX   32
+
+typedef enum {
+    JSON_STREAM_OBJ_START,
+    JSON_STREAM_OBJ_END,
+    JSON_STREAM_ARR_START,
+    JSON_STREAM_ARR_END,
+    JSON_STREAM_STRING,         /* val is the raw string, without the quotes and with its escapes */
+    JSON_STREAM_PRIMITIVE,      /* val is a number, true, false or null */
+} json_stream_event_t;
+
+/*
+ * The spans point into the chunk being fed, or into the carry-over buffer when the
+ * key or the value straddles chunks. They are only valid during the callback.
+ */
+typedef struct {
+    json_stream_event_t event;
+    const char *key;            /* Key of the value in an object, NULL otherwise and for the ends */
+    int key_len;
+    const char *val;            /* For JSON_STREAM_STRING and JSON_STREAM_PRIMITIVE */
+    int val_len;
+    int depth;                  /* Containers around the value, 0 at the top */
+} json_stream_elem_t;
+
+/* Return non-zero to stop the parse, json_stream_feed() then fails */
+typedef int (*json_stream_cb_t)(const json_stream_elem_t *elem, void *arg);
+
+typedef struct {
+    uint8_t state;
+    bool in_key;                /* The string being parsed is a key */
+    bool in_buf;                /* The token being parsed started in an earlier chunk, in buf from val_off */
+    bool key_in_buf;
+    uint8_t unicode_left;
+    int depth;
+    uint8_t is_obj[JSON_STREAM_DEPTH_MAX / 8];
+    const char *key;
+    int key_len;
+    char *buf;                  /* Carry-over buffer of the caller, a key followed by a value at most */
+    int buf_size;
+    int buf_len;
+    int val_off;
+    json_stream_cb_t cb;
+    void *arg;
+} json_stream_t;
+
+/* buf holds the key and the value that straddle two chunks, the longest key and value of the document fit */
+int json_stream_init(json_stream_t *stream, char *buf, int buf_size, json_stream_cb_t cb, void *arg);
+/* Chunks can be split anywhere, a callback is made for each element as soon as it is complete */
+int json_stream_feed(json_stream_t *stream, const char *chunk, int len);
+/* Succeeds if the chunks fed so far were a full document */
+int json_stream_finish(json_stream_t *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _JSON_STREAM_H_ */
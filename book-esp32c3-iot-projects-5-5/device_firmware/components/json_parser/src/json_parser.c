@@ -0,0 +1,840 @@
+/*
+ *    Copyright 2020 Piyush Shah <shahpiyushv@gmail.com>
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include "sdkconfig.h"
+#define JSMN_PARENT_LINKS
+#define JSMN_STRICT
+#define JSMN_STATIC
+#include <jsmn.h>
+#include <json_parser.h>
+
+#ifndef CONFIG_JSON_PARSER_INDEX_MIN_KEYS
+#define CONFIG_JSON_PARSER_INDEX_MIN_KEYS   16
+#endif
+
+/* Smaller arrays are walked, a few jumps cost less than the table */
+#define JSON_ARR_INDEX_MIN_ELEMS    8
+
+static bool token_matches_str(jparse_ctx_t *ctx, json_tok_t *tok, const char *str)
+{
+    const char *js = ctx->js;
+    return ((strncmp(js + tok->start, str, strlen(str)) == 0)
+            && (strlen(str) == (size_t) (tok->end - tok->start)));
+}
+
+static json_tok_t *json_skip_elem_walk(json_tok_t *token)
+{
+    json_tok_t *cur = token;
+    int cnt = cur->size;
+    while (cnt--) {
+        cur++;
+        cur = json_skip_elem_walk(cur);
+    }
+    return cur;
+}
+
+/* The last token of the subtree of token, in one jump once the ends are known */
+static json_tok_t *json_skip_elem(jparse_ctx_t *jctx, json_tok_t *token)
+{
+    if (jctx->ends) {
+        jctx->skip_count++;
+        return &jctx->tokens[jctx->ends[token - jctx->tokens]];
+    }
+    json_tok_t *end = json_skip_elem_walk(token);
+    jctx->skip_count += end - token + 1;
+    return end;
+}
+
+static int json_tok_to_bool(jparse_ctx_t *jctx, json_tok_t *tok, bool *val)
+{
+    if (token_matches_str(jctx, tok, "true") || token_matches_str(jctx, tok, "1")) {
+        *val = true;
+    } else if  (token_matches_str(jctx, tok, "false") || token_matches_str(jctx, tok, "0")) {
+        *val = false;
+    } else {
+        return -OS_FAIL;
+    }
+    return OS_SUCCESS;
+}
+
+/* Exact in a float: 5^10 still fits its 24 bit mantissa */
+static const float json_pow10f[] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f,
+};
+
+#define JSON_FLOAT_EXACT_MANT   (1UL << 24)
+#define JSON_FLOAT_EXACT_EXP    10
+
+int json_span_to_int(const char *str, int len, int *val)
+{
+    const char *end = str + len;
+    bool neg = str < end && *str == '-';
+    if (str < end && (*str == '-' || *str == '+')) {
+        str++;
+    }
+    if (str == end) {
+        return -OS_FAIL;
+    }
+    /* The magnitude of INT32_MIN is one more than INT32_MAX */
+    const uint32_t last_digit = INT32_MAX % 10 + neg;
+    uint32_t u = 0;
+    for (; str < end; str++) {
+        uint32_t d = (uint32_t)(*str - '0');
+        if (d > 9 || u > INT32_MAX / 10 || (u == INT32_MAX / 10 && d > last_digit)) {
+            return -OS_FAIL;
+        }
+        u = u * 10 + d;
+    }
+    *val = (int)(neg ? -(int64_t)u : (int64_t)u);
+    return OS_SUCCESS;
+}
+
+int json_span_to_int64(const char *str, int len, int64_t *val)
+{
+    const char *end = str + len;
+    bool neg = str < end && *str == '-';
+    if (str < end && (*str == '-' || *str == '+')) {
+        str++;
+    }
+    if (str == end) {
+        return -OS_FAIL;
+    }
+    uint64_t u = 0;
+    for (; str < end; str++) {
+        uint32_t d = (uint32_t)(*str - '0');
+        if (d > 9 || u > INT64_MAX / 10 || (u == INT64_MAX / 10 && d > INT64_MAX % 10 + neg)) {
+            return -OS_FAIL;
+        }
+        u = u * 10 + d;
+    }
+    *val = neg ? (int64_t)(0 - u) : (int64_t)u;
+    return OS_SUCCESS;
+}
+
+/* What the fast path does not take: long mantissas, large exponents, inf, nan, hex */
+static int json_span_to_float_libc(const char *str, int len, float *val)
+{
+    char buf[JSON_NUM_MAX_LEN + 1];
+    char *endptr;
+
+    if (len > JSON_NUM_MAX_LEN) {
+        return -OS_FAIL;
+    }
+    memcpy(buf, str, len);
+    buf[len] = 0;
+    float f = strtof(buf, &endptr);
+    if (len == 0 || endptr != buf + len) {
+        return -OS_FAIL;
+    }
+    *val = f;
+    return OS_SUCCESS;
+}
+
+int json_span_to_float(const char *str, int len, float *val)
+{
+    const char *p = str;
+    const char *end = str + len;
+    bool neg = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+')) {
+        p++;
+    }
+
+    /* Up to 9 digits, so that the mantissa fits in 32 bits. Zeros past them only scale it */
+    uint32_t mant = 0;
+    int digits = 0, exp10 = 0;
+    bool truncated = false;
+    for (; p < end && (uint32_t)(*p - '0') <= 9; p++, digits++) {
+        if (mant < 100000000) {
+            mant = mant * 10 + (*p - '0');
+        } else {
+            truncated |= *p != '0';
+            exp10++;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && (uint32_t)(*p - '0') <= 9; p++, digits++) {
+            if (mant < 100000000) {
+                mant = mant * 10 + (*p - '0');
+                exp10--;
+            } else {
+                truncated |= *p != '0';
+            }
+        }
+    }
+    if (digits && p < end && (*p == 'e' || *p == 'E')) {
+        bool exp_neg = false;
+        int e = 0;
+        if (++p < end && (*p == '-' || *p == '+')) {
+            exp_neg = *p++ == '-';
+        }
+        const char *exp_start = p;
+        for (; p < end && (uint32_t)(*p - '0') <= 9; p++) {
+            e = e < 10000 ? e * 10 + (*p - '0') : e;
+        }
+        if (p == exp_start) {
+            return -OS_FAIL;
+        }
+        exp10 += exp_neg ? -e : e;
+    }
+    if (!digits || p != end || truncated) {
+        return json_span_to_float_libc(str, len, val);
+    }
+
+    /* Both operands exact, so the one rounding of the product or the quotient is the correct one */
+    float f = 0;
+    if (mant) {
+        while (exp10 > JSON_FLOAT_EXACT_EXP && mant <= JSON_FLOAT_EXACT_MANT / 10) {
+            mant *= 10;
+            exp10--;
+        }
+        if (mant > JSON_FLOAT_EXACT_MANT || exp10 > JSON_FLOAT_EXACT_EXP || exp10 < -JSON_FLOAT_EXACT_EXP) {
+            return json_span_to_float_libc(str, len, val);
+        }
+        f = exp10 < 0 ? (float)mant / json_pow10f[-exp10] : (float)mant * json_pow10f[exp10];
+    }
+    *val = neg ? -f : f;
+    return OS_SUCCESS;
+}
+
+static int json_tok_to_int(jparse_ctx_t *jctx, json_tok_t *tok, int *val)
+{
+    return json_span_to_int(&jctx->js[tok->start], tok->end - tok->start, val);
+}
+
+static int json_tok_to_int64(jparse_ctx_t *jctx, json_tok_t *tok, int64_t *val)
+{
+    return json_span_to_int64(&jctx->js[tok->start], tok->end - tok->start, val);
+}
+
+static int json_tok_to_float(jparse_ctx_t *jctx, json_tok_t *tok, float *val)
+{
+    return json_span_to_float(&jctx->js[tok->start], tok->end - tok->start, val);
+}
+
+static int json_tok_to_string(jparse_ctx_t *jctx, json_tok_t *tok, char *val, int size)
+{
+    if ((tok->end - tok->start) > (size - 1)) {
+        return -OS_FAIL;
+    }
+    strncpy(val, jctx->js + tok->start, tok->end - tok->start);
+    val[tok->end - tok->start] = 0;
+    return OS_SUCCESS;
+}
+
+#if CONFIG_JSON_PARSER_INDEX_MIN_KEYS
+static uint32_t json_key_hash(const char *key, int len)
+{
+    /* FNV-1a */
+    uint32_t hash = 2166136261u;
+    while (len--) {
+        hash = (hash ^ (uint8_t)*key++) * 16777619u;
+    }
+    return hash;
+}
+
+static void json_obj_index_free(jparse_ctx_t *jctx)
+{
+    for (int i = 0; i < JSON_OBJ_INDEX_CACHE; i++) {
+        free(jctx->index[i].slots);
+    }
+    memset(jctx->index, 0, sizeof(jctx->index));
+    jctx->index_next = 0;
+}
+
+/* The index of an object, built on its first lookup */
+static json_obj_index_t *json_obj_index_get(jparse_ctx_t *jctx, json_tok_t *obj)
+{
+    int obj_pos = obj - jctx->tokens;
+    for (int i = 0; i < JSON_OBJ_INDEX_CACHE; i++) {
+        if (jctx->index[i].slots && jctx->index[i].obj == obj_pos) {
+            return &jctx->index[i];
+        }
+    }
+
+    /* Half full at most */
+    int num_slots = 4;
+    while (num_slots < obj->size * 2) {
+        num_slots <<= 1;
+    }
+    json_obj_index_t *index = &jctx->index[jctx->index_next];
+    free(index->slots);
+    index->slots = calloc(num_slots, sizeof(int));
+    if (!index->slots) {
+        return NULL;
+    }
+    index->obj = obj_pos;
+    index->mask = num_slots - 1;
+    jctx->index_next = (jctx->index_next + 1) % JSON_OBJ_INDEX_CACHE;
+
+    json_tok_t *tok = obj;
+    int size = obj->size;
+    while (size--) {
+        tok++;
+        int len = tok->end - tok->start;
+        int slot = json_key_hash(jctx->js + tok->start, len) & index->mask;
+        while (index->slots[slot]) {
+            json_tok_t *key = &jctx->tokens[index->slots[slot] - 1];
+            jctx->key_cmp_count++;
+            /* A duplicate key, the first one is found, as without the index */
+            if (key->end - key->start == len && !memcmp(jctx->js + key->start, jctx->js + tok->start, len)) {
+                break;
+            }
+            slot = (slot + 1) & index->mask;
+        }
+        if (!index->slots[slot]) {
+            index->slots[slot] = tok - jctx->tokens + 1;
+        }
+        tok = json_skip_elem(jctx, tok);
+    }
+    return index;
+}
+
+static json_tok_t *json_obj_index_search(jparse_ctx_t *jctx, json_obj_index_t *index, const char *key)
+{
+    int len = strlen(key);
+    int slot = json_key_hash(key, len) & index->mask;
+    while (index->slots[slot]) {
+        json_tok_t *tok = &jctx->tokens[index->slots[slot] - 1];
+        jctx->key_cmp_count++;
+        if (tok->end - tok->start == len && !memcmp(jctx->js + tok->start, key, len)) {
+            return tok;
+        }
+        slot = (slot + 1) & index->mask;
+    }
+    return NULL;
+}
+#else
+static void json_obj_index_free(jparse_ctx_t *jctx)
+{
+}
+#endif /* CONFIG_JSON_PARSER_INDEX_MIN_KEYS */
+
+static json_tok_t *json_obj_search(jparse_ctx_t *jctx, const char *key)
+{
+    json_tok_t *tok = jctx->cur;
+    int size = tok->size;
+    if (size <= 0) {
+        return NULL;
+    }
+    if (tok->type != JSMN_OBJECT) {
+        return NULL;
+    }
+
+#if CONFIG_JSON_PARSER_INDEX_MIN_KEYS
+    /* Below the threshold, comparing the keys costs less than hashing */
+    if (jctx->use_index && size >= CONFIG_JSON_PARSER_INDEX_MIN_KEYS) {
+        json_obj_index_t *index = json_obj_index_get(jctx, tok);
+        if (index) {
+            return json_obj_index_search(jctx, index, key);
+        }
+    }
+#endif
+
+    while (size--) {
+        tok++;
+        jctx->key_cmp_count++;
+        if (token_matches_str(jctx, tok, key)) {
+            return tok;
+        }
+        tok = json_skip_elem(jctx, tok);
+    }
+    return NULL;
+}
+
+static json_tok_t *json_obj_get_val_tok(jparse_ctx_t *jctx, const char *name, jsmntype_t type)
+{
+    json_tok_t *tok = json_obj_search(jctx, name);
+    if (!tok) {
+        return NULL;
+    }
+    tok++;
+    if (tok->type != type) {
+        return NULL;
+    }
+    return tok;
+}
+
+int json_obj_get_array(jparse_ctx_t *jctx, const char *name, int *num_elem)
+{
+    json_tok_t *tok = json_obj_get_val_tok(jctx, name, JSMN_ARRAY);
+    if (!tok) {
+        return -OS_FAIL;
+    }
+    jctx->cur = tok;
+    *num_elem = tok->size;
+    return OS_SUCCESS;
+}
+
+int json_obj_leave_array(jparse_ctx_t *jctx)
+{
+    /* The array's parent will be the key */
+    if (jctx->cur->parent < 0) {
+        return -OS_FAIL;
+    }
+    jctx->cur = &jctx->tokens[jctx->cur->parent];
+
+    /* The key's parent will be the actual parent object */
+    if (jctx->cur->parent < 0) {
+        return -OS_FAIL;
+    }
+    jctx->cur = &jctx->tokens[jctx->cur->parent];
+    return OS_SUCCESS;
+}
+
+int json_obj_get_object(jparse_ctx_t *jctx, const char *name)
+{
+    json_tok_t *tok = json_obj_get_val_tok(jctx, name, JSMN_OBJECT);
+    if (!tok) {
+        return -OS_FAIL;
+    }
+    jctx->cur = tok;
+    return OS_SUCCESS;
+}
+
+int json_obj_leave_object(jparse_ctx_t *jctx)
+{
+    /* The objects's parent will be the key */
+    if (jctx->cur->parent < 0) {
+        return -OS_FAIL;
+    }
+    jctx->cur = &jctx->tokens[jctx->cur->parent];
+
+    /* The key's parent will be the actual parent object */
+    if (jctx->cur->parent < 0) {
+        return -OS_FAIL;
+    }
+    jctx->cur = &jctx->tokens[jctx->cur->parent];
+    return OS_SUCCESS;
+}
+
+int json_obj_get_bool(jparse_ctx_t *jctx, const char *name, bool *val)
+{
+    json_tok_t *tok = json_obj_get_val_tok(jctx, name, JSMN_PRIMITIVE);
+    if (!tok) {
+        return -OS_FAIL;
+    }
+    return json_tok_to_bool(jctx, tok, val);
+}
+
+int json_obj_get_int(jparse_ctx_t *jctx, const char *name, int *val)
+{
+    json_tok_t *tok = json_obj_get_val_tok(jctx, name, JSMN_PRIMITIVE);
+    if (!tok) {
+        return -OS_FAIL;
+    }
+    return json_tok_to_int(jctx, tok, val);
+}
+
+int json_obj_get_int64(jparse_ctx_t *jctx, const char *name, int64_t *val)
+{
+    json_tok_t *tok = json_obj_get_val_tok(jctx, name, JSMN_PRIMITIVE);
+    if (!tok) {
+        return -OS_FAIL;
+    }
+    return json_tok_to_int64(jctx, tok, val);
+}
+
+int json_obj_get_float(jparse_ctx_t *jctx, const char *name, float *val)
+{
+    json_tok_t *tok = json_obj_get_val_tok(jctx, name, JSMN_PRIMITIVE);
+    if (!tok) {
+        return -OS_FAIL;
+    }
+    return json_tok_to_float(jctx, tok, val);
+}
+
+int json_obj_get_string(jparse_ctx_t *jctx, const char *name, char *val, int size)
+{
+    json_tok_t *tok = json_obj_get_val_tok(jctx, name, JSMN_STRING);
+    if (!tok) {
+        return -OS_FAIL;
+    }
+    return json_tok_to_string(jctx, tok, val, size);
+}
+
+int json_obj_get_strlen(jparse_ctx_t *jctx, const char *name, int *strlen)
+{
+    json_tok_t *tok = json_obj_get_val_tok(jctx, name, JSMN_STRING);
+    if (!tok) {
+        return -OS_FAIL;
+    }
+    *strlen = tok->end - tok->start;
+    return OS_SUCCESS;
+}
+
+int json_obj_get_object_str(jparse_ctx_t *jctx, const char *name, char *val, int size)
+{
+    json_tok_t *tok = json_obj_get_val_tok(jctx, name, JSMN_OBJECT);
+    if (!tok) {
+        return -OS_FAIL;
+    }
+    return json_tok_to_string(jctx, tok, val, size);
+}
+
+int json_obj_get_object_strlen(jparse_ctx_t *jctx, const char *name, int *strlen)
+{
+    json_tok_t *tok = json_obj_get_val_tok(jctx, name, JSMN_OBJECT);
+    if (!tok) {
+        return -OS_FAIL;
+    }
+    *strlen = tok->end - tok->start;
+    return OS_SUCCESS;
+}
+int json_obj_get_array_str(jparse_ctx_t *jctx, const char *name, char *val, int size)
+{
+    json_tok_t *tok = json_obj_get_val_tok(jctx, name, JSMN_ARRAY);
+    if (!tok) {
+        return -OS_FAIL;
+    }
+    return json_tok_to_string(jctx, tok, val, size);
+}
+
+int json_obj_get_array_strlen(jparse_ctx_t *jctx, const char *name, int *strlen)
+{
+    json_tok_t *tok = json_obj_get_val_tok(jctx, name, JSMN_ARRAY);
+    if (!tok) {
+        return -OS_FAIL;
+    }
+    *strlen = tok->end - tok->start;
+    return OS_SUCCESS;
+}
+
+static void json_arr_index_free(jparse_ctx_t *jctx)
+{
+    for (int i = 0; i < JSON_ARR_INDEX_CACHE; i++) {
+        free(jctx->arr_index[i].elems);
+    }
+    memset(jctx->arr_index, 0, sizeof(jctx->arr_index));
+    jctx->arr_index_next = 0;
+}
+
+/* The token of each element of an array, built on its first access by index */
+static json_arr_index_t *json_arr_index_get(jparse_ctx_t *jctx, json_tok_t *arr)
+{
+    int arr_pos = arr - jctx->tokens;
+    for (int i = 0; i < JSON_ARR_INDEX_CACHE; i++) {
+        if (jctx->arr_index[i].elems && jctx->arr_index[i].arr == arr_pos) {
+            return &jctx->arr_index[i];
+        }
+    }
+
+    json_arr_index_t *arr_index = &jctx->arr_index[jctx->arr_index_next];
+    free(arr_index->elems);
+    arr_index->elems = malloc(arr->size * sizeof(int));
+    if (!arr_index->elems) {
+        return NULL;
+    }
+    arr_index->arr = arr_pos;
+    jctx->arr_index_next = (jctx->arr_index_next + 1) % JSON_ARR_INDEX_CACHE;
+
+    json_tok_t *tok = arr + 1;
+    for (int i = 0; i < arr->size; i++) {
+        arr_index->elems[i] = tok - jctx->tokens;
+        tok = json_skip_elem(jctx, tok) + 1;
+    }
+    return arr_index;
+}
+
+static json_tok_t *json_arr_search(jparse_ctx_t *ctx, uint32_t index)
+{
+    json_tok_t *tok = ctx->cur;
+    if ((tok->type != JSMN_ARRAY) || (tok->size <= 0)) {
+        return NULL;
+    }
+    if (index > (uint32_t)(tok->size - 1)) {
+        return NULL;
+    }
+    if (ctx->use_index && tok->size >= JSON_ARR_INDEX_MIN_ELEMS) {
+        json_arr_index_t *arr_index = json_arr_index_get(ctx, tok);
+        if (arr_index) {
+            return &ctx->tokens[arr_index->elems[index]];
+        }
+    }
+    /* Increment by 1, so that token points to index 0 */
+    tok++;
+    while (index--) {
+        tok = json_skip_elem(ctx, tok);
+        tok++;
+    }
+    return tok;
+}
+static json_tok_t *json_arr_get_val_tok(jparse_ctx_t *jctx, uint32_t index, jsmntype_t type)
+{
+    json_tok_t *tok = json_arr_search(jctx, index);
+    if (!tok) {
+        return NULL;
+    }
+    if (tok->type != type) {
+        return NULL;
+    }
+    return tok;
+}
+
+int json_arr_get_array(jparse_ctx_t *jctx, uint32_t index)
+{
+    json_tok_t *tok = json_arr_get_val_tok(jctx, index, JSMN_ARRAY);
+    if (!tok) {
+        return -OS_FAIL;
+    }
+    jctx->cur = tok;
+    return OS_SUCCESS;
+}
+
+int json_arr_leave_array(jparse_ctx_t *jctx)
+{
+    if (jctx->cur->parent < 0) {
+        return -OS_FAIL;
+    }
+    jctx->cur = &jctx->tokens[jctx->cur->parent];
+    return OS_SUCCESS;
+}
+
+int json_arr_get_object(jparse_ctx_t *jctx, uint32_t index)
+{
+    json_tok_t *tok = json_arr_get_val_tok(jctx, index, JSMN_OBJECT);
+    if (!tok) {
+        return -OS_FAIL;
+    }
+    jctx->cur = tok;
+    return OS_SUCCESS;
+}
+
+int json_arr_leave_object(jparse_ctx_t *jctx)
+{
+    if (jctx->cur->parent < 0) {
+        return -OS_FAIL;
+    }
+    jctx->cur = &jctx->tokens[jctx->cur->parent];
+    return OS_SUCCESS;
+}
+
+int json_arr_get_bool(jparse_ctx_t *jctx, uint32_t index, bool *val)
+{
+    json_tok_t *tok = json_arr_get_val_tok(jctx, index, JSMN_PRIMITIVE);
+    if (!tok) {
+        return -OS_FAIL;
+    }
+    return json_tok_to_bool(jctx, tok, val);
+}
+
+int json_arr_get_int(jparse_ctx_t *jctx, uint32_t index, int *val)
+{
+    json_tok_t *tok = json_arr_get_val_tok(jctx, index, JSMN_PRIMITIVE);
+    if (!tok) {
+        return -OS_FAIL;
+    }
+    return json_tok_to_int(jctx, tok, val);
+}
+
+int json_arr_get_int64(jparse_ctx_t *jctx, uint32_t index, int64_t *val)
+{
+    json_tok_t *tok = json_arr_get_val_tok(jctx, index, JSMN_PRIMITIVE);
+    if (!tok) {
+        return -OS_FAIL;
+    }
+    return json_tok_to_int64(jctx, tok, val);
+}
+
+int json_arr_get_float(jparse_ctx_t *jctx, uint32_t index, float *val)
+{
+    json_tok_t *tok = json_arr_get_val_tok(jctx, index, JSMN_PRIMITIVE);
+    if (!tok) {
+        return -OS_FAIL;
+    }
+    return json_tok_to_float(jctx, tok, val);
+}
+
+int json_arr_get_string(jparse_ctx_t *jctx, uint32_t index, char *val, int size)
+{
+    json_tok_t *tok = json_arr_get_val_tok(jctx, index, JSMN_STRING);
+    if (!tok) {
+        return -OS_FAIL;
+    }
+    return json_tok_to_string(jctx, tok, val, size);
+}
+
+int json_arr_get_strlen(jparse_ctx_t *jctx, uint32_t index, int *strlen)
+{
+    json_tok_t *tok = json_arr_get_val_tok(jctx, index, JSMN_STRING);
+    if (!tok) {
+        return -OS_FAIL;
+    }
+    *strlen = tok->end - tok->start;
+    return OS_SUCCESS;
+}
+
+/* First guess of an empty arena, a RainMaker params payload has a token every 6 bytes */
+#define JSON_TOK_BYTES_ESTIMATE     6
+
+void json_tok_arena_init(json_tok_arena_t *arena, json_tok_t *buffer_tokens, int buffer_tokens_max_count)
+{
+    memset(arena, 0, sizeof(json_tok_arena_t));
+    if (buffer_tokens) {
+        arena->tokens = buffer_tokens;
+        arena->max_tokens = buffer_tokens_max_count;
+        arena->is_static = true;
+    }
+}
+
+void json_tok_arena_deinit(json_tok_arena_t *arena)
+{
+    if (!arena->is_static) {
+        free(arena->tokens);
+    }
+    memset(arena, 0, sizeof(json_tok_arena_t));
+}
+
+static int json_tok_arena_grow(json_tok_arena_t *arena, int max_tokens)
+{
+    json_tok_t *tokens;
+
+    /* The ends are only filled once the document is parsed, there is nothing to keep when they move */
+    size_t block_size = max_tokens * (sizeof(json_tok_t) + sizeof(int));
+
+    arena->alloc_count++;
+    if (arena->is_static) {
+        /* The parsed tokens move to the heap, the buffer of the caller is left as it is */
+        tokens = malloc(block_size);
+        if (tokens) {
+            memcpy(tokens, arena->tokens, arena->max_tokens * sizeof(json_tok_t));
+        }
+    } else {
+        tokens = realloc(arena->tokens, block_size);
+    }
+    if (!tokens) {
+        return -OS_FAIL;
+    }
+    arena->tokens = tokens;
+    arena->ends = (int *)(tokens + max_tokens);
+    arena->max_tokens = max_tokens;
+    arena->is_static = false;
+    return OS_SUCCESS;
+}
+
+/*
+ * The tokens come in document order and a token is the parent of its children, a key of its value.
+ * Going backwards, the children of a token are done before it and give it the end of their subtree.
+ */
+static void json_tok_find_ends(const json_tok_t *tokens, int *ends, int num_tokens)
+{
+    for (int i = 0; i < num_tokens; i++) {
+        ends[i] = i;
+    }
+    for (int i = num_tokens - 1; i > 0; i--) {
+        int parent = tokens[i].parent;
+        if (parent >= 0 && ends[parent] < ends[i]) {
+            ends[parent] = ends[i];
+        }
+    }
+}
+
+static int json_parse_tokens(jparse_ctx_t *jctx, const char *js, int len, json_tok_arena_t *arena, bool can_grow)
+{
+    /* jsmn only counts the tokens without a buffer */
+    if (!arena->tokens) {
+        if (!can_grow || json_tok_arena_grow(arena, len / JSON_TOK_BYTES_ESTIMATE + JSON_TOK_ARENA_CHUNK) != OS_SUCCESS) {
+            return -OS_FAIL;
+        }
+    }
+
+    jsmn_init(&jctx->parser);
+    int ret;
+    /* On JSMN_ERROR_NOMEM jsmn stops at the token it could not add, and resumes from there */
+    while ((ret = jsmn_parse(&jctx->parser, js, len, arena->tokens, arena->max_tokens)) == JSMN_ERROR_NOMEM) {
+        /* As many more as the part parsed so far had per byte */
+        int pos = jctx->parser.pos > 0 ? jctx->parser.pos : 1;
+        int more = (int)((int64_t)(len - jctx->parser.pos) * jctx->parser.toknext / pos) + JSON_TOK_ARENA_CHUNK;
+        if (!can_grow || json_tok_arena_grow(arena, arena->max_tokens + more) != OS_SUCCESS) {
+            return -OS_FAIL;
+        }
+    }
+    if (ret <= 0) {
+        return -OS_FAIL;
+    }
+    if (arena->ends) {
+        json_tok_find_ends(arena->tokens, arena->ends, ret);
+        jctx->ends = arena->ends;
+    }
+    jctx->js = js;
+    jctx->arena = arena;
+    jctx->tokens = arena->tokens;
+    jctx->num_tokens = ret;
+    jctx->cur = jctx->tokens;
+    return OS_SUCCESS;
+}
+
+int json_parse_start(jparse_ctx_t *jctx, const char *js, int len)
+{
+    memset(jctx, 0, sizeof(jparse_ctx_t));
+    if (json_parse_tokens(jctx, js, len, &jctx->own_arena, true) != OS_SUCCESS) {
+        json_tok_arena_deinit(&jctx->own_arena);
+        memset(jctx, 0, sizeof(jparse_ctx_t));
+        return -OS_FAIL;
+    }
+    jctx->use_index = true;
+    return OS_SUCCESS;
+}
+
+int json_parse_end(jparse_ctx_t *jctx)
+{
+    json_obj_index_free(jctx);
+    json_arr_index_free(jctx);
+    json_tok_arena_deinit(&jctx->own_arena);
+    memset(jctx, 0, sizeof(jparse_ctx_t));
+    return OS_SUCCESS;
+}
+
+int json_parse_start_static(jparse_ctx_t *jctx, const char *js, int len, json_tok_t *buffer_tokens, int buffer_tokens_max_count)
+{
+    memset(jctx, 0, sizeof(jparse_ctx_t));
+    json_tok_arena_init(&jctx->own_arena, buffer_tokens, buffer_tokens_max_count);
+    if (json_parse_tokens(jctx, js, len, &jctx->own_arena, false) != OS_SUCCESS) {
+        memset(jctx, 0, sizeof(jparse_ctx_t));
+        return -OS_FAIL;
+    }
+    return OS_SUCCESS;
+}
+
+int json_parse_end_static(jparse_ctx_t *jctx)
+{
+    /* Only if the caller asked for it, a static parse does not index */
+    json_obj_index_free(jctx);
+    json_arr_index_free(jctx);
+    memset(jctx, 0, sizeof(jparse_ctx_t));
+    return OS_SUCCESS;
+}
+
+int json_parse_start_arena(jparse_ctx_t *jctx, const char *js, int len, json_tok_arena_t *arena)
+{
+    memset(jctx, 0, sizeof(jparse_ctx_t));
+    if (json_parse_tokens(jctx, js, len, arena, true) != OS_SUCCESS) {
+        memset(jctx, 0, sizeof(jparse_ctx_t));
+        return -OS_FAIL;
+    }
+    jctx->use_index = true;
+    return OS_SUCCESS;
+}
+
+int json_parse_end_arena(jparse_ctx_t *jctx)
+{
+    json_obj_index_free(jctx);
+    json_arr_index_free(jctx);
+    memset(jctx, 0, sizeof(jparse_ctx_t));
+    return OS_SUCCESS;
+}
@@ -0,0 +1,313 @@
+/*
+ *    Copyright 2020 Piyush Shah <shahpiyushv@gmail.com>
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include <string.h>
+#include <json_stream.h>
+
+/* What the next character can be */
+enum {
+    STREAM_VALUE,               /* At the top, after ':' or after ',' in an array */
+    STREAM_VALUE_OR_END,        /* After '[' */
+    STREAM_KEY,                 /* After ',' in an object */
+    STREAM_KEY_OR_END,          /* After '{' */
+    STREAM_COLON,
+    STREAM_COMMA_OR_END,
+    STREAM_STRING,
+    STREAM_ESCAPE,
+    STREAM_UNICODE,
+    STREAM_PRIMITIVE,
+    STREAM_DONE,
+    STREAM_ERROR,
+};
+
+static inline bool json_stream_is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline bool json_stream_in_obj(json_stream_t *stream)
+{
+    int i = stream->depth - 1;
+    return (stream->is_obj[i / 8] >> (i % 8)) & 1;
+}
+
+static int json_stream_fail(json_stream_t *stream)
+{
+    stream->state = STREAM_ERROR;
+    return -OS_FAIL;
+}
+
+static int json_stream_carry(json_stream_t *stream, const char *data, int len)
+{
+    if (stream->buf_len + len > stream->buf_size) {
+        return -OS_FAIL;
+    }
+    if (len == 0) {
+        return OS_SUCCESS;
+    }
+    memcpy(stream->buf + stream->buf_len, data, len);
+    stream->buf_len += len;
+    return OS_SUCCESS;
+}
+
+/* Calls back with the pending key, then drops it along with anything carried over */
+static int json_stream_emit(json_stream_t *stream, json_stream_event_t event, const char *val, int val_len)
+{
+    json_stream_elem_t elem = {
+        .event = event,
+        .key = stream->key,
+        .key_len = stream->key_len,
+        .val = val,
+        .val_len = val_len,
+        .depth = stream->depth,
+    };
+    stream->key = NULL;
+    stream->key_len = 0;
+    stream->key_in_buf = false;
+    stream->in_buf = false;
+    stream->buf_len = 0;
+    return stream->cb(&elem, stream->arg) ? -OS_FAIL : OS_SUCCESS;
+}
+
+static int json_stream_open(json_stream_t *stream, bool is_obj)
+{
+    if (stream->depth >= JSON_STREAM_DEPTH_MAX) {
+        return -OS_FAIL;
+    }
+    if (json_stream_emit(stream, is_obj ? JSON_STREAM_OBJ_START : JSON_STREAM_ARR_START, NULL, 0) != OS_SUCCESS) {
+        return -OS_FAIL;
+    }
+    int i = stream->depth++;
+    if (is_obj) {
+        stream->is_obj[i / 8] |= 1 << (i % 8);
+    } else {
+        stream->is_obj[i / 8] &= ~(1 << (i % 8));
+    }
+    stream->state = is_obj ? STREAM_KEY_OR_END : STREAM_VALUE_OR_END;
+    return OS_SUCCESS;
+}
+
+static int json_stream_close(json_stream_t *stream, bool is_obj)
+{
+    if (stream->depth == 0 || json_stream_in_obj(stream) != is_obj) {
+        return -OS_FAIL;
+    }
+    stream->depth--;
+    stream->state = stream->depth ? STREAM_COMMA_OR_END : STREAM_DONE;
+    return json_stream_emit(stream, is_obj ? JSON_STREAM_OBJ_END : JSON_STREAM_ARR_END, NULL, 0);
+}
+
+/* The string or primitive ends at end, its start is in the chunk at start or in buf */
+static int json_stream_token_end(json_stream_t *stream, const char *start, const char *end)
+{
+    const char *val = start;
+    int len = end - start;
+
+    if (stream->in_buf) {
+        if (json_stream_carry(stream, start, len) != OS_SUCCESS) {
+            return -OS_FAIL;
+        }
+        val = stream->buf + stream->val_off;
+        len = stream->buf_len - stream->val_off;
+    }
+
+    if (stream->state != STREAM_PRIMITIVE && stream->in_key) {
+        stream->key = val;
+        stream->key_len = len;
+        stream->key_in_buf = stream->in_buf;
+        stream->in_buf = false;
+        stream->state = STREAM_COLON;
+        return OS_SUCCESS;
+    }
+
+    json_stream_event_t event = stream->state == STREAM_PRIMITIVE ? JSON_STREAM_PRIMITIVE : JSON_STREAM_STRING;
+    stream->state = stream->depth ? STREAM_COMMA_OR_END : STREAM_DONE;
+    return json_stream_emit(stream, event, val, len);
+}
+
+int json_stream_init(json_stream_t *stream, char *buf, int buf_size, json_stream_cb_t cb, void *arg)
+{
+    if (!stream || !cb || !buf || buf_size <= 0) {
+        return -OS_FAIL;
+    }
+    memset(stream, 0, sizeof(json_stream_t));
+    stream->state = STREAM_VALUE;
+    stream->buf = buf;
+    stream->buf_size = buf_size;
+    stream->cb = cb;
+    stream->arg = arg;
+    return OS_SUCCESS;
+}
+
+int json_stream_feed(json_stream_t *stream, const char *chunk, int len)
+{
+    if (stream->state == STREAM_ERROR) {
+        return -OS_FAIL;
+    }
+
+    /* Start of the token being parsed within this chunk */
+    const char *start = chunk;
+    const char *end = chunk + len;
+    const char *p = chunk;
+
+    while (p < end) {
+        char c = *p;
+        int ret = OS_SUCCESS;
+
+        switch (stream->state) {
+        case STREAM_STRING:
+            /* The bulk of a document, stay here until something needs a look */
+            while (c != '"' && c != '\\') {
+                if (++p == end) {
+                    goto out;
+                }
+                c = *p;
+            }
+            if (c == '"') {
+                ret = json_stream_token_end(stream, start, p);
+            } else {
+                stream->state = STREAM_ESCAPE;
+            }
+            break;
+        case STREAM_ESCAPE:
+            if (c == 'u') {
+                stream->unicode_left = 4;
+                stream->state = STREAM_UNICODE;
+            } else if (c && strchr("\"/\\bfrnt", c)) {
+                stream->state = STREAM_STRING;
+            } else {
+                ret = -OS_FAIL;
+            }
+            break;
+        case STREAM_UNICODE:
+            if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'))) {
+                ret = -OS_FAIL;
+            } else if (--stream->unicode_left == 0) {
+                stream->state = STREAM_STRING;
+            }
+            break;
+        case STREAM_PRIMITIVE:
+            /* Same end as a jsmn strict primitive, the delimiter is looked at again */
+            if (json_stream_is_space(c) || c == ',' || c == ']' || c == '}') {
+                ret = json_stream_token_end(stream, start, p);
+                if (ret == OS_SUCCESS) {
+                    continue;
+                }
+            } else if (c < 32 || c >= 127) {
+                ret = -OS_FAIL;
+            }
+            break;
+        default:
+            if (json_stream_is_space(c)) {
+                break;
+            }
+            switch (stream->state) {
+            case STREAM_VALUE_OR_END:
+                if (c == ']') {
+                    ret = json_stream_close(stream, false);
+                    break;
+                }
+            /* fall through */
+            case STREAM_VALUE:
+                if (c == '{' || c == '[') {
+                    ret = json_stream_open(stream, c == '{');
+                } else if (c == '"') {
+                    stream->in_key = false;
+                    stream->state = STREAM_STRING;
+                    start = p + 1;
+                } else if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n') {
+                    stream->state = STREAM_PRIMITIVE;
+                    start = p;
+                } else {
+                    ret = -OS_FAIL;
+                }
+                break;
+            case STREAM_KEY_OR_END:
+                if (c == '}') {
+                    ret = json_stream_close(stream, true);
+                    break;
+                }
+            /* fall through */
+            case STREAM_KEY:
+                if (c == '"') {
+                    stream->in_key = true;
+                    stream->state = STREAM_STRING;
+                    start = p + 1;
+                } else {
+                    ret = -OS_FAIL;
+                }
+                break;
+            case STREAM_COLON:
+                if (c == ':') {
+                    stream->state = STREAM_VALUE;
+                } else {
+                    ret = -OS_FAIL;
+                }
+                break;
+            case STREAM_COMMA_OR_END:
+                if (c == ',') {
+                    stream->state = json_stream_in_obj(stream) ? STREAM_KEY : STREAM_VALUE;
+                } else if (c == '}' || c == ']') {
+                    ret = json_stream_close(stream, c == '}');
+                } else {
+                    ret = -OS_FAIL;
+                }
+                break;
+            default:
+                /* Only white space after the document */
+                ret = -OS_FAIL;
+                break;
+            }
+            break;
+        }
+
+        if (ret != OS_SUCCESS) {
+            return json_stream_fail(stream);
+        }
+        p++;
+    }
+
+out:
+    /* The chunk goes away, keep what is pending of it: the key first, then the start of the token */
+    if (stream->key && !stream->key_in_buf) {
+        stream->buf_len = 0;
+        if (json_stream_carry(stream, stream->key, stream->key_len) != OS_SUCCESS) {
+            return json_stream_fail(stream);
+        }
+        stream->key = stream->buf;
+        stream->key_in_buf = true;
+    }
+    if (stream->state >= STREAM_STRING && stream->state <= STREAM_PRIMITIVE) {
+        if (!stream->in_buf) {
+            stream->val_off = stream->buf_len;
+            stream->in_buf = true;
+        }
+        if (json_stream_carry(stream, start, end - start) != OS_SUCCESS) {
+            return json_stream_fail(stream);
+        }
+    }
+    return OS_SUCCESS;
+}
+
+int json_stream_finish(json_stream_t *stream)
+{
+    /* A primitive at the top has no delimiter but the end of the document */
+    if (stream->state == STREAM_PRIMITIVE && stream->depth == 0) {
+        if (json_stream_token_end(stream, stream->buf, stream->buf) != OS_SUCCESS) {
+            return json_stream_fail(stream);
+        }
+    }
+    return stream->state == STREAM_DONE ? OS_SUCCESS : -OS_FAIL;
+}
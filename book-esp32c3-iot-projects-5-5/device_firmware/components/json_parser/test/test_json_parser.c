@@ -0,0 +1,778 @@
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include "esp_cpu.h"
+#endif
+/* The jsmn of json_parser, for the two-pass reference of the benchmarks */
+#define JSMN_PARENT_LINKS
+#define JSMN_STRICT
+#define JSMN_STATIC
+#include <jsmn.h>
+#include "json_parser.h"
+#ifndef CONFIG_JSON_PARSER_INDEX_MIN_KEYS
+#define CONFIG_JSON_PARSER_INDEX_MIN_KEYS   16
+#endif
+#include "unity.h"
+
+#define json_test_str   "{\n\"str_val\" :    \"JSON Parser\",\n" \
+            "\t\"float_val\" : 2.0,\n" \
+            "\"int_val\" : 2017,\n" \
+            "\"bool_val\" : false,\n" \
+            "\"supported_el\" :\t [\"bool\",\"int\","\
+            "\"float\",\"str\"" \
+            ",\"object\",\"array\"],\n" \
+            "\"features\" : { \"objects\":true, "\
+            "\"arrays\":\"yes\"},\n"\
+            "\"int_64\":109174583252}"
+
+TEST_CASE("json_parser basic tests", "[json_parser]")
+{
+    jparse_ctx_t jctx;
+    int ret = json_parse_start(&jctx, json_test_str, strlen(json_test_str));
+    TEST_ASSERT_EQUAL(OS_SUCCESS, ret);
+
+    char str_val[64];
+    int int_val, num_elem;
+    int64_t int64_val;
+    bool bool_val;
+    float float_val;
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_string(&jctx, "str_val", str_val, sizeof(str_val)));
+    TEST_ASSERT_EQUAL_STRING("JSON Parser", str_val);
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_float(&jctx, "float_val", &float_val));
+    TEST_ASSERT(fabs(float_val - 2.0f) < 0.0001f);
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int(&jctx, "int_val", &int_val));
+    TEST_ASSERT_EQUAL_INT(2017, int_val);
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_bool(&jctx, "bool_val", &bool_val));
+    TEST_ASSERT_EQUAL(false, bool_val);
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_array(&jctx, "supported_el", &num_elem));
+    const char *expected_values[] = {"bool", "int", "float", "str", "object", "array"};
+    TEST_ASSERT_EQUAL(sizeof(expected_values) / sizeof(expected_values[0]), num_elem);
+    for (int i = 0; i < num_elem; ++i) {
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_arr_get_string(&jctx, i, str_val, sizeof(str_val)));
+        TEST_ASSERT_EQUAL_STRING(expected_values[i], str_val);
+    }
+    json_obj_leave_array(&jctx);
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_object(&jctx, "features"));
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_bool(&jctx, "objects", &bool_val));
+    TEST_ASSERT_EQUAL(true, bool_val);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_string(&jctx, "arrays", str_val, sizeof(str_val)));
+    TEST_ASSERT_EQUAL_STRING("yes", str_val);
+    json_obj_leave_object(&jctx);
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int64(&jctx, "int_64", &int64_val));
+    TEST_ASSERT(int64_val == 109174583252);
+
+    json_parse_end(&jctx);
+}
+
+static void test_get_values(jparse_ctx_t *jctx)
+{
+    char str_val[64];
+    int int_val, num_elem;
+    int64_t int64_val;
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_string(jctx, "str_val", str_val, sizeof(str_val)));
+    TEST_ASSERT_EQUAL_STRING("JSON Parser", str_val);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int(jctx, "int_val", &int_val));
+    TEST_ASSERT_EQUAL_INT(2017, int_val);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_array(jctx, "supported_el", &num_elem));
+    TEST_ASSERT_EQUAL(6, num_elem);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_arr_get_string(jctx, 5, str_val, sizeof(str_val)));
+    TEST_ASSERT_EQUAL_STRING("array", str_val);
+    json_obj_leave_array(jctx);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int64(jctx, "int_64", &int64_val));
+    TEST_ASSERT(int64_val == 109174583252);
+}
+
+TEST_CASE("json_parser single pass grows the token arena", "[json_parser]")
+{
+    jparse_ctx_t jctx;
+    json_tok_t tokens[32], small[4];
+    json_tok_arena_t arena;
+
+    /* The tokens of a single pass are those of the exact buffer */
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_parse_start_static(&jctx, json_test_str, strlen(json_test_str), tokens, 32));
+    int num_tokens = jctx.num_tokens;
+    test_get_values(&jctx);
+    json_parse_end_static(&jctx);
+    TEST_ASSERT_EQUAL(-OS_FAIL, json_parse_start_static(&jctx, json_test_str, strlen(json_test_str), small, 4));
+
+    /* A buffer of the caller, moved to the heap once it is too small */
+    json_tok_arena_init(&arena, small, 4);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_parse_start_arena(&jctx, json_test_str, strlen(json_test_str), &arena));
+    TEST_ASSERT_EQUAL(num_tokens, jctx.num_tokens);
+    TEST_ASSERT_EQUAL_MEMORY(tokens, jctx.tokens, num_tokens * sizeof(json_tok_t));
+    test_get_values(&jctx);
+    json_parse_end_arena(&jctx);
+    TEST_ASSERT_FALSE(arena.is_static);
+    TEST_ASSERT_GREATER_OR_EQUAL(num_tokens, arena.max_tokens);
+
+    /* Large enough now, the next documents need no heap call */
+    uint32_t alloc_count = arena.alloc_count;
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_parse_start_arena(&jctx, json_test_str, strlen(json_test_str), &arena));
+        test_get_values(&jctx);
+        json_parse_end_arena(&jctx);
+    }
+    TEST_ASSERT_EQUAL(alloc_count, arena.alloc_count);
+    TEST_ASSERT_EQUAL(-OS_FAIL, json_parse_start_arena(&jctx, "{\"key\":", 7, &arena));
+    json_tok_arena_deinit(&arena);
+
+    /* An empty arena */
+    json_tok_arena_init(&arena, NULL, 0);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_parse_start_arena(&jctx, json_test_str, strlen(json_test_str), &arena));
+    test_get_values(&jctx);
+    json_parse_end_arena(&jctx);
+    json_tok_arena_deinit(&arena);
+}
+
+#define BENCH_RUNS      1000
+
+static uint32_t bench_cycles(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    /* ns on Linux */
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+#else
+    return esp_cpu_get_cycle_count();
+#endif
+}
+
+/* The params of a RainMaker light node, with as many schedules as fit in size */
+static char *bench_rmaker_params(int size)
+{
+    char *js = malloc(size + 1);
+    int len = snprintf(js, size, "{\"Light\":{\"Name\":\"Light\",\"Power\":true,\"Brightness\":25,"
+                       "\"Hue\":180,\"Saturation\":100},\"Time\":{\"TZ\":\"Asia/Shanghai\",\"TZ-POSIX\":\"CST-8\"},"
+                       "\"OTA\":{\"Status\":\"success\",\"Info\":\"Firmware updated\"},\"Schedule\":{\"Schedules\":[");
+    const int tail = sizeof("]}}") - 1;
+
+    for (int i = 0; ; i++) {
+        char schedule[192];
+        int n = snprintf(schedule, sizeof(schedule), "%s{\"name\":\"Scene %d\",\"id\":\"%04X\",\"enabled\":%s,"
+                         "\"triggers\":[{\"m\":%d,\"d\":%d}],\"action\":{\"Light\":{\"Power\":%s,\"Brightness\":%d}}}",
+                         i ? "," : "", i, 0x8D36 + i, i % 3 ? "true" : "false", (i * 37) % 1440, 1 << (i % 7),
+                         i % 2 ? "true" : "false", (i * 13) % 100);
+        if (len + n + tail > size) {
+            break;
+        }
+        memcpy(js + len, schedule, n);
+        len += n;
+    }
+    strcpy(js + len, "]}}");
+    return js;
+}
+
+/* json_parse_start() of json_parser 1.0.3: count the tokens, allocate them, parse again */
+static int bench_two_pass_start(jparse_ctx_t *jctx, const char *js, int len)
+{
+    memset(jctx, 0, sizeof(jparse_ctx_t));
+    jsmn_init(&jctx->parser);
+    int num_tokens = jsmn_parse(&jctx->parser, js, len, NULL, 0);
+    if (num_tokens <= 0) {
+        return -OS_FAIL;
+    }
+    jctx->num_tokens = num_tokens;
+    jctx->tokens = calloc(num_tokens, sizeof(json_tok_t));
+    if (!jctx->tokens) {
+        return -OS_FAIL;
+    }
+    jctx->js = js;
+    jsmn_init(&jctx->parser);
+    if (jsmn_parse(&jctx->parser, js, len, jctx->tokens, jctx->num_tokens) <= 0) {
+        free(jctx->tokens);
+        return -OS_FAIL;
+    }
+    jctx->cur = jctx->tokens;
+    return OS_SUCCESS;
+}
+
+TEST_CASE("json_parser single pass against two passes on RainMaker params", "[json_parser][bench]")
+{
+    const int sizes[] = {512, 2048, 8192};
+    json_tok_arena_t arena;
+
+    json_tok_arena_init(&arena, NULL, 0);
+
+    for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        char *js = bench_rmaker_params(sizes[i]);
+        int len = strlen(js);
+        jparse_ctx_t jctx;
+        int power, num_tokens;
+        uint32_t two_pass = 0, single_pass = 0, in_arena = 0;
+        uint32_t single_pass_allocs = 0;
+
+        for (int run = 0; run < BENCH_RUNS; run++) {
+            uint32_t start = bench_cycles();
+            TEST_ASSERT_EQUAL(OS_SUCCESS, bench_two_pass_start(&jctx, js, len));
+            two_pass += bench_cycles() - start;
+            num_tokens = jctx.num_tokens;
+            free(jctx.tokens);
+
+            start = bench_cycles();
+            TEST_ASSERT_EQUAL(OS_SUCCESS, json_parse_start(&jctx, js, len));
+            single_pass += bench_cycles() - start;
+            TEST_ASSERT_EQUAL(num_tokens, jctx.num_tokens);
+            single_pass_allocs += jctx.own_arena.alloc_count + 1;   /* and the free() */
+            json_parse_end(&jctx);
+
+            start = bench_cycles();
+            TEST_ASSERT_EQUAL(OS_SUCCESS, json_parse_start_arena(&jctx, js, len, &arena));
+            in_arena += bench_cycles() - start;
+            TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_object(&jctx, "Light"));
+            TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int(&jctx, "Brightness", &power));
+            TEST_ASSERT_EQUAL_INT(25, power);
+            json_parse_end_arena(&jctx);
+        }
+
+        printf("%5d bytes, %4d tokens: two passes %7u, single pass %7u, arena %7u cycles per parse; "
+               "heap calls per parse 2, %u.%02u, %u.%02u\n", len, num_tokens,
+               (unsigned)(two_pass / BENCH_RUNS), (unsigned)(single_pass / BENCH_RUNS), (unsigned)(in_arena / BENCH_RUNS),
+               (unsigned)(single_pass_allocs / BENCH_RUNS), (unsigned)(single_pass_allocs * 100 / BENCH_RUNS % 100),
+               (unsigned)(arena.alloc_count / BENCH_RUNS), (unsigned)(arena.alloc_count * 100 / BENCH_RUNS % 100));
+
+        /* The first guess and a grow at most, then the free(). Nothing once the arena is large enough */
+        TEST_ASSERT_LESS_OR_EQUAL(3 * BENCH_RUNS, single_pass_allocs);
+        TEST_ASSERT_LESS_OR_EQUAL((i + 1) * 2, arena.alloc_count);
+        free(js);
+    }
+
+    /* Grown for the first documents only */
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(sizes) / sizeof(sizes[0]) * 2, arena.alloc_count);
+    json_tok_arena_deinit(&arena);
+}
+
+/* An object of num keys "key_<i>": i, with a nested object of as many keys at the end */
+static char *test_keys_object(int num, bool nested)
+{
+    char *js = malloc(num * 48 + 64);
+    int len = sprintf(js, "{");
+
+    for (int i = 0; i < num; i++) {
+        len += sprintf(js + len, "%s\"key_%d\":%d", i ? "," : "", i, i);
+    }
+    if (nested) {
+        char *inner = test_keys_object(num, false);
+        len += sprintf(js + len, ",\"nested\":%s,\"key_0\":-1", inner);
+        free(inner);
+    }
+    strcpy(js + len, "}");
+    return js;
+}
+
+TEST_CASE("json_parser key index finds the keys of large objects", "[json_parser]")
+{
+    const int num = 64;
+    char *js = test_keys_object(num, true);
+    jparse_ctx_t jctx;
+    char key[16];
+    int val;
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_parse_start(&jctx, js, strlen(js)));
+
+    for (int round = 0; round < 2; round++) {
+        for (int i = num - 1; i >= 0; i--) {
+            sprintf(key, "key_%d", i);
+            TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int(&jctx, key, &val));
+            /* The first of the duplicate keys, as without the index */
+            TEST_ASSERT_EQUAL_INT(i, val);
+        }
+        TEST_ASSERT_EQUAL(-OS_FAIL, json_obj_get_int(&jctx, "key_", &val));
+        TEST_ASSERT_EQUAL(-OS_FAIL, json_obj_get_int(&jctx, "key_640", &val));
+        TEST_ASSERT_EQUAL(-OS_FAIL, json_obj_get_object(&jctx, "key_1"));
+
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_object(&jctx, "nested"));
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int(&jctx, "key_63", &val));
+        TEST_ASSERT_EQUAL_INT(63, val);
+        TEST_ASSERT_EQUAL(-OS_FAIL, json_obj_get_object(&jctx, "nested"));
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_leave_object(&jctx));
+    }
+    TEST_ASSERT_NOT_NULL(jctx.index[0].slots);
+    TEST_ASSERT_NOT_NULL(jctx.index[1].slots);
+    TEST_ASSERT_NULL(jctx.index[2].slots);
+    json_parse_end(&jctx);
+    free(js);
+
+    /* More large objects than the cache, the oldest index is rebuilt */
+    const int num_objs = JSON_OBJ_INDEX_CACHE + 2;
+    js = malloc(num_objs * 1024);
+    int len = sprintf(js, "{");
+    for (int j = 0; j < num_objs; j++) {
+        char *obj = test_keys_object(20 + j, false);
+        len += sprintf(js + len, "%s\"o%d\":%s", j ? "," : "", j, obj);
+        free(obj);
+    }
+    strcpy(js + len, "}");
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_parse_start(&jctx, js, strlen(js)));
+    for (int round = 0; round < 3; round++) {
+        for (int j = 0; j < num_objs; j++) {
+            sprintf(key, "o%d", j);
+            TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_object(&jctx, key));
+            sprintf(key, "key_%d", 19 + j);
+            TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int(&jctx, key, &val));
+            TEST_ASSERT_EQUAL_INT(19 + j, val);
+            json_obj_leave_object(&jctx);
+        }
+    }
+    json_parse_end(&jctx);
+    free(js);
+}
+
+TEST_CASE("json_parser key lookups in objects of 8, 64 and 256 keys", "[json_parser][bench]")
+{
+    const int nums[] = {8, 64, 256};
+    const int runs = 20;
+
+    for (int n = 0; n < 3; n++) {
+        int num = nums[n];
+        char *js = test_keys_object(num, false);
+        jparse_ctx_t jctx;
+        uint32_t cycles[2], cmps[2];
+        char key[16];
+        int val;
+
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_parse_start(&jctx, js, strlen(js)));
+
+        /* Every key once, as when decoding a node config */
+        for (int use_index = 0; use_index < 2; use_index++) {
+            jctx.use_index = use_index;
+            jctx.key_cmp_count = 0;
+            uint32_t start = bench_cycles();
+            for (int run = 0; run < runs; run++) {
+                for (int i = 0; i < num; i++) {
+                    sprintf(key, "key_%d", i);
+                    json_obj_get_int(&jctx, key, &val);
+                }
+            }
+            cycles[use_index] = (bench_cycles() - start) / runs / num;
+            cmps[use_index] = jctx.key_cmp_count;
+            TEST_ASSERT_EQUAL_INT(num - 1, val);
+        }
+
+        printf("%3d keys: %5u cycles, %5u.%02u keys compared per lookup walking the keys; "
+               "%4u cycles, %u.%02u with the index\n", num,
+               (unsigned)cycles[0], (unsigned)(cmps[0] / runs / num), (unsigned)(cmps[0] * 100 / runs / num % 100),
+               (unsigned)cycles[1], (unsigned)(cmps[1] / runs / num), (unsigned)(cmps[1] * 100 / runs / num % 100));
+        json_parse_end(&jctx);
+        free(js);
+
+        /* The i-th key after i others, quadratic for the whole object */
+        TEST_ASSERT_EQUAL(runs * num * (num + 1) / 2, cmps[0]);
+        if (num < CONFIG_JSON_PARSER_INDEX_MIN_KEYS) {
+            TEST_ASSERT_EQUAL(cmps[0], cmps[1]);
+        } else {
+            /* A half full table, under 2 keys per lookup whatever the size, building it included */
+            TEST_ASSERT_LESS_THAN(runs * num * 2, cmps[1]);
+        }
+    }
+}
+
+/* depth objects, each {"a": <next>, "n": <depth>, "b": [<depth> nested arrays]}, the last one a number */
+static char *test_nested_doc(int depth)
+{
+    char *js = malloc(depth * (depth * 2 + 64) + 16);
+    int len = 0;
+
+    TEST_ASSERT_NOT_NULL(js);
+
+    for (int i = 0; i < depth; i++) {
+        len += sprintf(js + len, "{\"a\":");
+    }
+    len += sprintf(js + len, "0");
+    for (int i = depth - 1; i >= 0; i--) {
+        len += sprintf(js + len, ",\"n\":%d,\"b\":", i);
+        for (int j = 0; j < i; j++) {
+            js[len++] = '[';
+        }
+        len += sprintf(js + len, "%d", i);
+        for (int j = 0; j < i; j++) {
+            js[len++] = ']';
+        }
+        len += sprintf(js + len, ",\"c\":[[%d],{\"x\":[]},%d]}", i, i);
+    }
+    return js;
+}
+
+/* The same lookups in a context with the subtree ends and one walking the tokens */
+static void test_nested_lookups(jparse_ctx_t *jctx, int depth)
+{
+    int val, num_elem;
+
+    for (int i = 0; i < depth; i++) {
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int(jctx, "n", &val));
+        TEST_ASSERT_EQUAL_INT(i, val);
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_array(jctx, "c", &num_elem));
+        TEST_ASSERT_EQUAL_INT(3, num_elem);
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_arr_get_int(jctx, 2, &val));
+        TEST_ASSERT_EQUAL_INT(i, val);
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_arr_get_object(jctx, 1));
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_array(jctx, "x", &num_elem));
+        TEST_ASSERT_EQUAL_INT(0, num_elem);
+        json_obj_leave_array(jctx);
+        json_arr_leave_object(jctx);
+        json_obj_leave_array(jctx);
+        if (i < depth - 1) {
+            TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_object(jctx, "a"));
+        } else {
+            TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int(jctx, "a", &val));
+            TEST_ASSERT_EQUAL_INT(0, val);
+        }
+    }
+}
+
+TEST_CASE("json_parser skips deeply nested subtrees", "[json_parser]")
+{
+    const int depths[] = {1, 2, 16, 64};
+
+    for (int d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+        char *js = test_nested_doc(depths[d]);
+        jparse_ctx_t jctx, walk_jctx;
+        json_tok_arena_t arena;
+
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_parse_start(&jctx, js, strlen(js)));
+        TEST_ASSERT_NOT_NULL(jctx.ends);
+        json_tok_arena_init(&arena, NULL, 0);
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_parse_start_arena(&walk_jctx, js, strlen(js), &arena));
+        walk_jctx.ends = NULL;
+
+        /* The end of a container is its last token within it, the next one starts after it */
+        for (int i = 0; i < jctx.num_tokens; i++) {
+            int end = jctx.ends[i];
+            TEST_ASSERT_GREATER_OR_EQUAL(i, end);
+            if (jctx.tokens[i].type != JSMN_OBJECT && jctx.tokens[i].type != JSMN_ARRAY) {
+                continue;
+            }
+            TEST_ASSERT_LESS_OR_EQUAL(jctx.tokens[i].end, jctx.tokens[end].end);
+            if (end + 1 < jctx.num_tokens) {
+                TEST_ASSERT_GREATER_OR_EQUAL(jctx.tokens[i].end, jctx.tokens[end + 1].start);
+            }
+        }
+        TEST_ASSERT_EQUAL_INT(jctx.num_tokens - 1, jctx.ends[0]);
+
+        test_nested_lookups(&jctx, depths[d]);
+        test_nested_lookups(&walk_jctx, depths[d]);
+        json_parse_end(&jctx);
+        json_parse_end_arena(&walk_jctx);
+        json_tok_arena_deinit(&arena);
+        free(js);
+    }
+}
+
+TEST_CASE("json_parser iterates a 200 element array of objects", "[json_parser][bench]")
+{
+    const int num = 200;
+    const int runs = 10;
+    char *js = malloc(num * 96 + 32);
+    int len = sprintf(js, "{\"Schedules\":[");
+    uint32_t cycles[3], skips[3];
+
+    for (int i = 0; i < num; i++) {
+        len += sprintf(js + len, "%s{\"name\":\"S%d\",\"id\":%d,\"triggers\":[{\"m\":%d,\"d\":31}],"
+                       "\"action\":{\"Light\":{\"Power\":true}}}", i ? "," : "", i, i, i * 7 % 1440);
+    }
+    strcpy(js + len, "]}");
+
+    /* 0: walking every element before the one asked for, as before; 1: jumping over them; 2: offset table */
+    for (int mode = 0; mode < 3; mode++) {
+        jparse_ctx_t jctx;
+        int num_elem, id = -1, sum = 0;
+
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_parse_start(&jctx, js, strlen(js)));
+        jctx.ends = mode ? jctx.ends : NULL;
+        jctx.use_index = mode == 2;
+        uint32_t start = bench_cycles();
+        for (int run = 0; run < runs; run++) {
+            TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_array(&jctx, "Schedules", &num_elem));
+            for (int i = 0; i < num_elem; i++) {
+                json_arr_get_object(&jctx, i);
+                json_obj_get_int(&jctx, "id", &id);
+                sum += id;
+                json_arr_leave_object(&jctx);
+            }
+            json_obj_leave_array(&jctx);
+        }
+        cycles[mode] = (bench_cycles() - start) / runs;
+        skips[mode] = jctx.skip_count;
+        TEST_ASSERT_EQUAL_INT(num - 1, id);
+        TEST_ASSERT_EQUAL_INT(runs * num * (num - 1) / 2, sum);
+        json_parse_end(&jctx);
+    }
+
+    printf("%d objects by index: %u cycles, %u tokens skipped walking; %u, %u jumping over the subtrees; "
+           "%u, %u with the offset table\n", num, (unsigned)cycles[0], (unsigned)(skips[0] / runs),
+           (unsigned)cycles[1], (unsigned)(skips[1] / runs), (unsigned)cycles[2], (unsigned)(skips[2] / runs));
+    /* Still a jump per element before the one asked for, then none. The "name" before "id" is one more */
+    TEST_ASSERT_EQUAL(runs * (num * (num - 1) / 2 + num), skips[1]);
+    TEST_ASSERT_EQUAL(num + runs * num, skips[2]);
+    /* Every token of the elements before */
+    TEST_ASSERT_GREATER_THAN(skips[1] * 10, skips[0]);
+    free(js);
+}
+
+TEST_CASE("json_parser integers are range checked", "[json_parser]")
+{
+    const struct {
+        const char *str;
+        int ret32;
+        int ret64;
+        int64_t val;
+    } cases[] = {
+        {"0", OS_SUCCESS, OS_SUCCESS, 0},
+        {"-0", OS_SUCCESS, OS_SUCCESS, 0},
+        {"+5", OS_SUCCESS, OS_SUCCESS, 5},
+        {"007", OS_SUCCESS, OS_SUCCESS, 7},
+        {"2147483647", OS_SUCCESS, OS_SUCCESS, INT32_MAX},
+        {"-2147483648", OS_SUCCESS, OS_SUCCESS, INT32_MIN},
+        {"2147483648", -OS_FAIL, OS_SUCCESS, 2147483648LL},
+        {"-2147483649", -OS_FAIL, OS_SUCCESS, -2147483649LL},
+        {"4294967295", -OS_FAIL, OS_SUCCESS, 4294967295LL},
+        {"9223372036854775807", -OS_FAIL, OS_SUCCESS, INT64_MAX},
+        {"-9223372036854775808", -OS_FAIL, OS_SUCCESS, INT64_MIN},
+        {"9223372036854775808", -OS_FAIL, -OS_FAIL},
+        {"-9223372036854775809", -OS_FAIL, -OS_FAIL},
+        {"18446744073709551616", -OS_FAIL, -OS_FAIL},
+        {"", -OS_FAIL, -OS_FAIL},
+        {"-", -OS_FAIL, -OS_FAIL},
+        {"1.0", -OS_FAIL, -OS_FAIL},
+        {"1e3", -OS_FAIL, -OS_FAIL},
+        {"12a", -OS_FAIL, -OS_FAIL},
+        {"--1", -OS_FAIL, -OS_FAIL},
+        {"true", -OS_FAIL, -OS_FAIL},
+    };
+
+    for (int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        int i32 = 0;
+        int64_t i64 = 0;
+        int len = strlen(cases[i].str);
+        TEST_ASSERT_EQUAL_MESSAGE(cases[i].ret32, json_span_to_int(cases[i].str, len, &i32), cases[i].str);
+        TEST_ASSERT_EQUAL_MESSAGE(cases[i].ret64, json_span_to_int64(cases[i].str, len, &i64), cases[i].str);
+        if (cases[i].ret32 == OS_SUCCESS) {
+            TEST_ASSERT_EQUAL_MESSAGE(cases[i].val, i32, cases[i].str);
+        }
+        if (cases[i].ret64 == OS_SUCCESS) {
+            TEST_ASSERT_EQUAL_MESSAGE(cases[i].val, i64, cases[i].str);
+        }
+    }
+
+    /* Random digits against strtoll(), which saturates instead */
+    srand(3);
+    for (int run = 0; run < 100000; run++) {
+        char str[24];
+        int len = 0;
+        if (rand() % 2) {
+            str[len++] = '-';
+        }
+        for (int n = 1 + rand() % 20; n > 0; n--) {
+            str[len++] = '0' + rand() % 10;
+        }
+        str[len] = 0;
+
+        errno = 0;
+        long long expected = strtoll(str, NULL, 10);
+        bool in_range = errno == 0;
+        int i32;
+        int64_t i64;
+        TEST_ASSERT_EQUAL_MESSAGE(in_range ? OS_SUCCESS : -OS_FAIL, json_span_to_int64(str, len, &i64), str);
+        TEST_ASSERT_EQUAL_MESSAGE(in_range && expected >= INT32_MIN && expected <= INT32_MAX ? OS_SUCCESS : -OS_FAIL,
+                                  json_span_to_int(str, len, &i32), str);
+        if (in_range) {
+            TEST_ASSERT_EQUAL_MESSAGE(expected, i64, str);
+        }
+    }
+
+    /* Through the getters, where an int used to wrap */
+    const char *js = "{\"ts\":1700000000000,\"brightness\":25,\"neg\":-40}";
+    jparse_ctx_t jctx;
+    int i32;
+    int64_t i64;
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_parse_start(&jctx, js, strlen(js)));
+    TEST_ASSERT_EQUAL(-OS_FAIL, json_obj_get_int(&jctx, "ts", &i32));
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int64(&jctx, "ts", &i64));
+    TEST_ASSERT_EQUAL(1700000000000LL, i64);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int(&jctx, "brightness", &i32));
+    TEST_ASSERT_EQUAL(25, i32);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int(&jctx, "neg", &i32));
+    TEST_ASSERT_EQUAL(-40, i32);
+    json_parse_end(&jctx);
+}
+
+static void test_float_matches_strtof(const char *str)
+{
+    float expected, got;
+    uint32_t expected_bits, got_bits;
+    char *endptr;
+
+    expected = strtof(str, &endptr);
+    TEST_ASSERT_EQUAL_MESSAGE(OS_SUCCESS, json_span_to_float(str, strlen(str), &got), str);
+    memcpy(&expected_bits, &expected, sizeof(expected_bits));
+    memcpy(&got_bits, &got, sizeof(got_bits));
+    TEST_ASSERT_EQUAL_MESSAGE(expected_bits, got_bits, str);
+}
+
+TEST_CASE("json_parser floats match strtof", "[json_parser]")
+{
+#if CONFIG_IDF_TARGET_LINUX
+    /* Every decimal of up to 6 digits, glibc rounds correctly */
+    const int step = 1;
+#else
+    /* newlib rounds through a double, so only a sample */
+    const int step = 997;
+#endif
+    char str[48], digits[16];
+
+    for (int m = 0; m < 1000000; m += step) {
+        int len = snprintf(digits, sizeof(digits), "%d", m);
+        for (int sign = 0; sign < 2; sign++) {
+            const char *minus = sign ? "-" : "";
+            snprintf(str, sizeof(str), "%s%s", minus, digits);
+            test_float_matches_strtof(str);
+            for (int pos = 1; pos < len; pos++) {
+                snprintf(str, sizeof(str), "%s%.*s.%s", minus, pos, digits, digits + pos);
+                test_float_matches_strtof(str);
+            }
+            snprintf(str, sizeof(str), "%s0.%s", minus, digits);
+            test_float_matches_strtof(str);
+            snprintf(str, sizeof(str), "%s0.00%s", minus, digits);
+            test_float_matches_strtof(str);
+        }
+    }
+
+    /* Around the exact range, in and out of it */
+    const char *mants[] = {"1", "5", "12345", "16777215", "16777216", "16777217", "99999999", "123456789",
+                           "1234567891", "0.000001", "100000000000000000000"};
+    for (int i = 0; i < sizeof(mants) / sizeof(mants[0]); i++) {
+        for (int e = -50; e <= 50; e++) {
+            snprintf(str, sizeof(str), "%se%d", mants[i], e);
+            test_float_matches_strtof(str);
+            snprintf(str, sizeof(str), "-%sE%+d", mants[i], e);
+            test_float_matches_strtof(str);
+        }
+    }
+
+    /* Long mantissas for strtof, anywhere in the range */
+    srand(4);
+    for (int run = 0; run < 100000 / step + 100; run++) {
+        int len = 0;
+        int n = 1 + rand() % 25;
+        int point = rand() % (n + 1);
+        for (int d = 0; d < n; d++) {
+            if (d == point && d) {
+                str[len++] = '.';
+            }
+            str[len++] = '0' + rand() % 10;
+        }
+        len += snprintf(str + len, sizeof(str) - len, "e%d", rand() % 100 - 50);
+        test_float_matches_strtof(str);
+    }
+
+    /* What strtof takes besides, and what neither does */
+    float f;
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_span_to_float("2.0", 3, &f));
+    TEST_ASSERT_EQUAL_FLOAT(2.0f, f);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_span_to_float("1e999", 5, &f));
+    TEST_ASSERT_TRUE(isinf(f));
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_span_to_float("0e999", 5, &f));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, f);
+    TEST_ASSERT_EQUAL(-OS_FAIL, json_span_to_float("", 0, &f));
+    TEST_ASSERT_EQUAL(-OS_FAIL, json_span_to_float("-", 1, &f));
+    TEST_ASSERT_EQUAL(-OS_FAIL, json_span_to_float("1e", 2, &f));
+    TEST_ASSERT_EQUAL(-OS_FAIL, json_span_to_float("1.5x", 4, &f));
+    TEST_ASSERT_EQUAL(-OS_FAIL, json_span_to_float("true", 4, &f));
+    /* Only the span is read */
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_span_to_float("12.5e3", 4, &f));
+    TEST_ASSERT_EQUAL_FLOAT(12.5f, f);
+}
+
+TEST_CASE("json_parser numbers per conversion against libc", "[json_parser][bench]")
+{
+    /* What RainMaker params and sensor reports carry */
+    const char *ints[] = {"25", "180", "100", "0", "-40", "1440", "65535", "7"};
+    const char *int64s[] = {"1700000000000", "109174583252", "-1", "4294967296"};
+    const char *floats[] = {"23.5", "-12.75", "0.001", "100", "3.14159", "65.2", "-0.5", "1013.25"};
+    const int num = 8;
+    volatile int64_t sink = 0;
+    uint32_t libc[3] = {0}, span[3] = {0};
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        uint32_t start = bench_cycles();
+        for (int i = 0; i < num; i++) {
+            sink += (int)strtoul(ints[i], NULL, 10);
+        }
+        libc[0] += bench_cycles() - start;
+        start = bench_cycles();
+        for (int i = 0; i < num; i++) {
+            int v;
+            json_span_to_int(ints[i], strlen(ints[i]), &v);
+            sink += v;
+        }
+        span[0] += bench_cycles() - start;
+
+        start = bench_cycles();
+        for (int i = 0; i < num; i++) {
+            sink += (int64_t)strtoull(int64s[i % 4], NULL, 10);
+        }
+        libc[1] += bench_cycles() - start;
+        start = bench_cycles();
+        for (int i = 0; i < num; i++) {
+            int64_t v;
+            json_span_to_int64(int64s[i % 4], strlen(int64s[i % 4]), &v);
+            sink += v;
+        }
+        span[1] += bench_cycles() - start;
+
+        start = bench_cycles();
+        for (int i = 0; i < num; i++) {
+            sink += (int64_t)strtof(floats[i], NULL);
+        }
+        libc[2] += bench_cycles() - start;
+        start = bench_cycles();
+        for (int i = 0; i < num; i++) {
+            float v;
+            json_span_to_float(floats[i], strlen(floats[i]), &v);
+            sink += (int64_t)v;
+        }
+        span[2] += bench_cycles() - start;
+    }
+
+    const char *kinds[] = {"int", "int64", "float"};
+    for (int i = 0; i < 3; i++) {
+        printf("%-5s: libc %5u, span %5u cycles per number\n", kinds[i],
+               (unsigned)(libc[i] / BENCH_RUNS / num), (unsigned)(span[i] / BENCH_RUNS / num));
+    }
+
+    /* The values of libc, which takes every byte of these numbers too */
+    for (int i = 0; i < num; i++) {
+        char *endptr;
+        int v;
+        int64_t v64;
+        float f, expected;
+
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_span_to_int(ints[i], strlen(ints[i]), &v));
+        TEST_ASSERT_EQUAL(strtol(ints[i], &endptr, 10), v);
+        TEST_ASSERT_EQUAL(strlen(ints[i]), endptr - ints[i]);
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_span_to_int64(int64s[i % 4], strlen(int64s[i % 4]), &v64));
+        TEST_ASSERT_EQUAL(strtoll(int64s[i % 4], &endptr, 10), v64);
+        TEST_ASSERT_EQUAL(strlen(int64s[i % 4]), endptr - int64s[i % 4]);
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_span_to_float(floats[i], strlen(floats[i]), &f));
+        expected = strtof(floats[i], &endptr);
+        TEST_ASSERT_EQUAL_MEMORY(&expected, &f, sizeof(f));
+        TEST_ASSERT_EQUAL(strlen(floats[i]), endptr - floats[i]);
+    }
+}
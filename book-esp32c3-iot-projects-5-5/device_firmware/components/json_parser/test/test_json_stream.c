@@ -0,0 +1,324 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include "esp_cpu.h"
+#endif
+
+#include "json_parser.h"
+#include "json_stream.h"
+#include "unity.h"
+
+#define TRACE_SIZE      16384
+#define CARRY_SIZE      128
+
+/* The events of a document, one line each */
+typedef struct {
+    char buf[TRACE_SIZE];
+    int len;
+    const char *find_key;       /* The last primitive with this key */
+    int found;
+} test_trace_t;
+
+static void test_trace_add(test_trace_t *trace, char event, int depth, const char *key, int key_len,
+                           const char *val, int val_len)
+{
+    int n = snprintf(trace->buf + trace->len, TRACE_SIZE - trace->len, "%c%d %.*s:%.*s\n", event, depth,
+                     key ? key_len : 1, key ? key : "-", val_len, val ? val : "");
+    TEST_ASSERT_LESS_THAN(TRACE_SIZE - trace->len, n);
+    trace->len += n;
+}
+
+static int test_stream_cb(const json_stream_elem_t *elem, void *arg)
+{
+    static const char events[] = {
+        [JSON_STREAM_OBJ_START] = '{', [JSON_STREAM_OBJ_END] = '}', [JSON_STREAM_ARR_START] = '[',
+        [JSON_STREAM_ARR_END] = ']', [JSON_STREAM_STRING] = 's', [JSON_STREAM_PRIMITIVE] = 'p',
+    };
+    test_trace_t *trace = (test_trace_t *)arg;
+
+    if (trace->find_key) {
+        if (elem->event == JSON_STREAM_PRIMITIVE && elem->key_len == strlen(trace->find_key) &&
+                !strncmp(elem->key, trace->find_key, elem->key_len)) {
+            trace->found = atoi(elem->val);
+        }
+        return 0;
+    }
+    test_trace_add(trace, events[elem->event], elem->depth, elem->key, elem->key_len, elem->val, elem->val_len);
+    return 0;
+}
+
+/* The same events from the tokens of json_parser, returns the token after the subtree */
+static int test_dom_trace(test_trace_t *trace, const char *js, json_tok_t *tokens, int i,
+                          const char *key, int key_len, int depth)
+{
+    json_tok_t *t = &tokens[i];
+    int next = i + 1;
+
+    switch (t->type) {
+    case JSMN_OBJECT:
+        test_trace_add(trace, '{', depth, key, key_len, NULL, 0);
+        for (int n = 0; n < t->size; n++) {
+            json_tok_t *k = &tokens[next];
+            next = test_dom_trace(trace, js, tokens, next + 1, js + k->start, k->end - k->start, depth + 1);
+        }
+        test_trace_add(trace, '}', depth, NULL, 0, NULL, 0);
+        break;
+    case JSMN_ARRAY:
+        test_trace_add(trace, '[', depth, key, key_len, NULL, 0);
+        for (int n = 0; n < t->size; n++) {
+            next = test_dom_trace(trace, js, tokens, next, NULL, 0, depth + 1);
+        }
+        test_trace_add(trace, ']', depth, NULL, 0, NULL, 0);
+        break;
+    default:
+        test_trace_add(trace, t->type == JSMN_STRING ? 's' : 'p', depth, key, key_len, js + t->start, t->end - t->start);
+        break;
+    }
+    return next;
+}
+
+static int test_dom(test_trace_t *trace, const char *js, int len)
+{
+    jparse_ctx_t jctx;
+
+    trace->len = 0;
+    if (json_parse_start(&jctx, js, len) != OS_SUCCESS) {
+        return -OS_FAIL;
+    }
+    test_dom_trace(trace, js, jctx.tokens, 0, NULL, 0, 0);
+    json_parse_end(&jctx);
+    return OS_SUCCESS;
+}
+
+/* Feed the document in chunks of chunk bytes, or of random sizes up to -chunk */
+static int test_stream(test_trace_t *trace, const char *js, int len, int chunk)
+{
+    json_stream_t stream;
+    char carry[CARRY_SIZE];
+    int ret = OS_SUCCESS;
+
+    trace->len = 0;
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_stream_init(&stream, carry, sizeof(carry), test_stream_cb, trace));
+
+    for (int off = 0; off < len && ret == OS_SUCCESS; ) {
+        int n = chunk > 0 ? chunk : 1 + rand() % -chunk;
+        n = n < len - off ? n : len - off;
+
+        /* A copy, so that a span kept past its chunk shows up as garbage */
+        char *copy = malloc(n);
+        memcpy(copy, js + off, n);
+        ret = json_stream_feed(&stream, copy, n);
+        memset(copy, '#', n);
+        free(copy);
+        off += n;
+    }
+    return ret == OS_SUCCESS ? json_stream_finish(&stream) : ret;
+}
+
+static const char *g_docs[] = {
+    "{\n\"str_val\" :    \"JSON Parser\",\n\t\"float_val\" : 2.0,\n\"int_val\" : 2017,\n\"bool_val\" : false,\n"
+    "\"supported_el\" :\t [\"bool\",\"int\",\"float\",\"str\",\"object\",\"array\"],\n"
+    "\"features\" : { \"objects\":true, \"arrays\":\"yes\"},\n\"int_64\":109174583252}",
+    "{\"Light\":{\"Power\":true,\"Brightness\":25,\"Hue\":180},\"Schedule\":{\"Schedules\":[{\"name\":\"Scene 0\","
+    "\"id\":\"8D36\",\"enabled\":false,\"triggers\":[{\"m\":0,\"d\":1}],\"action\":{\"Light\":{\"Power\":false}}}]}}",
+    "[[], {}, [[[]]], {\"\":{\"\":[null, -1.5e+3, 0]}}, \"\", \"\\\"\\\\\\/\\b\\f\\n\\r\\t\\u00e9\\uD83D\\uDE00\"]",
+    "{\"a long key that goes on for a while\":\"and a long value, to straddle most chunks\",\"b\":[true,false]}",
+    "  \r\n{ \"spaced\" : [ 1 , 2 , 3 ] , \"out\" : { } }\n  ",
+};
+
+#define DOC_NUM (sizeof(g_docs) / sizeof(g_docs[0]))
+
+TEST_CASE("json_stream events match the tokens of json_parser on any chunk split", "[json_stream]")
+{
+    static test_trace_t dom, stream;
+
+    srand(1);
+    for (int i = 0; i < DOC_NUM; i++) {
+        int len = strlen(g_docs[i]);
+        TEST_ASSERT_EQUAL(OS_SUCCESS, test_dom(&dom, g_docs[i], len));
+
+        /* Every fixed size, then random ones */
+        for (int chunk = 1; chunk <= len; chunk++) {
+            TEST_ASSERT_EQUAL(OS_SUCCESS, test_stream(&stream, g_docs[i], len, chunk));
+            TEST_ASSERT_EQUAL(dom.len, stream.len);
+            TEST_ASSERT_EQUAL_STRING_LEN(dom.buf, stream.buf, dom.len);
+        }
+        for (int run = 0; run < 200; run++) {
+            TEST_ASSERT_EQUAL(OS_SUCCESS, test_stream(&stream, g_docs[i], len, -(1 + run % 16)));
+            TEST_ASSERT_EQUAL_STRING_LEN(dom.buf, stream.buf, dom.len);
+        }
+    }
+}
+
+TEST_CASE("json_stream rejects invalid documents wherever they are split", "[json_stream]")
+{
+    static test_trace_t trace;
+    const char *invalid[] = {
+        "", "{", "{\"a\":1", "{\"a\" 1}", "{\"a\":1,}", "[1,]", "[1 2]", "[1]]", "{]", "[}", "{1:2}",
+        "{\"a\":\"\\x\"}", "{\"a\":\"\\u12g4\"}", "[\"open]", "[+1]", "[1] [2]", "{\"a\":1}x",
+    };
+
+    for (int i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        int len = strlen(invalid[i]);
+        for (int chunk = 1; chunk <= len + 1; chunk++) {
+            TEST_ASSERT_EQUAL_MESSAGE(-OS_FAIL, test_stream(&trace, invalid[i], len, chunk), invalid[i]);
+        }
+    }
+
+    /* Nesting up to the limit */
+    char deep[2 * JSON_STREAM_DEPTH_MAX + 3];
+    memset(deep, '[', JSON_STREAM_DEPTH_MAX);
+    memset(deep + JSON_STREAM_DEPTH_MAX, ']', JSON_STREAM_DEPTH_MAX);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, test_stream(&trace, deep, 2 * JSON_STREAM_DEPTH_MAX, 3));
+    memset(deep, '[', JSON_STREAM_DEPTH_MAX + 1);
+    memset(deep + JSON_STREAM_DEPTH_MAX + 1, ']', JSON_STREAM_DEPTH_MAX + 1);
+    TEST_ASSERT_EQUAL(-OS_FAIL, test_stream(&trace, deep, 2 * JSON_STREAM_DEPTH_MAX + 2, 3));
+
+    /* A key and a value longer than the carry-over buffer, once split */
+    char long_str[2 * CARRY_SIZE];
+    snprintf(long_str, sizeof(long_str), "{\"k\":\"%0*d\"}", CARRY_SIZE, 0);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, test_stream(&trace, long_str, strlen(long_str), strlen(long_str)));
+    TEST_ASSERT_EQUAL(-OS_FAIL, test_stream(&trace, long_str, strlen(long_str), 16));
+}
+
+TEST_CASE("json_stream fuzzed documents split at random", "[json_stream]")
+{
+    static test_trace_t whole, split, dom;
+    static const char mutations[] = "{}[]\",:\\ 0-tu";
+    char js[512];
+    int both_valid = 0, stream_valid = 0;
+
+    srand(2);
+    for (int run = 0; run < 20000; run++) {
+        const char *doc = g_docs[run % DOC_NUM];
+        int len = strlen(doc);
+        memcpy(js, doc, len);
+        for (int n = 1 + rand() % 3; n > 0; n--) {
+            js[rand() % len] = mutations[rand() % (sizeof(mutations) - 1)];
+        }
+
+        /* The split never changes the outcome */
+        int ret = test_stream(&whole, js, len, len);
+        TEST_ASSERT_EQUAL(ret, test_stream(&split, js, len, -(1 + run % 8)));
+        if (ret != OS_SUCCESS) {
+            continue;
+        }
+        TEST_ASSERT_EQUAL_STRING_LEN(whole.buf, split.buf, whole.len);
+        stream_valid++;
+
+        /* jsmn is more lenient, but what the stream takes it takes the same way */
+        TEST_ASSERT_EQUAL(OS_SUCCESS, test_dom(&dom, js, len));
+        TEST_ASSERT_EQUAL_STRING_LEN(dom.buf, whole.buf, dom.len);
+        both_valid++;
+    }
+    printf("%d of 20000 fuzzed documents valid\n", both_valid);
+    TEST_ASSERT_GREATER_THAN(100, stream_valid);
+}
+
+#define BENCH_RUNS      100
+#define BENCH_CHUNK     128     /* An MQTT or HTTP receive buffer */
+
+static uint32_t bench_cycles(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    /* ns on Linux */
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+#else
+    return esp_cpu_get_cycle_count();
+#endif
+}
+
+/* The params of a RainMaker light node, with as many schedules as fit in size */
+static char *bench_rmaker_params(int size)
+{
+    char *js = malloc(size + 1);
+    int len = snprintf(js, size, "{\"Light\":{\"Name\":\"Light\",\"Power\":true,\"Brightness\":25,"
+                       "\"Hue\":180,\"Saturation\":100},\"Time\":{\"TZ\":\"Asia/Shanghai\",\"TZ-POSIX\":\"CST-8\"},"
+                       "\"OTA\":{\"Status\":\"success\",\"Info\":\"Firmware updated\"},\"Schedule\":{\"Schedules\":[");
+    const int tail = sizeof("]}}") - 1;
+
+    for (int i = 0; ; i++) {
+        char schedule[192];
+        int n = snprintf(schedule, sizeof(schedule), "%s{\"name\":\"Scene %d\",\"id\":\"%04X\",\"enabled\":%s,"
+                         "\"triggers\":[{\"m\":%d,\"d\":%d}],\"action\":{\"Light\":{\"Power\":%s,\"Brightness\":%d}}}",
+                         i ? "," : "", i, 0x8D36 + i, i % 3 ? "true" : "false", (i * 37) % 1440, 1 << (i % 7),
+                         i % 2 ? "true" : "false", (i * 13) % 100);
+        if (len + n + tail > size) {
+            break;
+        }
+        memcpy(js + len, schedule, n);
+        len += n;
+    }
+    strcpy(js + len, "]}}");
+    return js;
+}
+
+TEST_CASE("json_stream peak memory against json_parser on RainMaker params", "[json_stream][bench]")
+{
+    const int sizes[] = {512, 2048, 8192};
+    int carry_peaks[3];
+
+    for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        char *js = bench_rmaker_params(sizes[i]);
+        int len = strlen(js);
+        uint32_t dom_time = 0, stream_time = 0;
+        int dom_peak = 0, carry_peak = 0;
+
+        for (int run = 0; run < BENCH_RUNS; run++) {
+            /* The chunks put back together, then tokenized */
+            uint32_t start = bench_cycles();
+            char *doc = malloc(len);
+            for (int off = 0; off < len; off += BENCH_CHUNK) {
+                memcpy(doc + off, js + off, len - off < BENCH_CHUNK ? len - off : BENCH_CHUNK);
+            }
+            json_tok_arena_t arena = {0};
+            jparse_ctx_t jctx;
+            int brightness = 0;
+            TEST_ASSERT_EQUAL(OS_SUCCESS, json_parse_start_arena(&jctx, doc, len, &arena));
+            json_obj_get_object(&jctx, "Light");
+            json_obj_get_int(&jctx, "Brightness", &brightness);
+            json_parse_end_arena(&jctx);
+            dom_time += bench_cycles() - start;
+            TEST_ASSERT_EQUAL(25, brightness);
+            dom_peak = len + arena.max_tokens * (sizeof(json_tok_t) + sizeof(int)) + sizeof(jparse_ctx_t);
+            json_tok_arena_deinit(&arena);
+            free(doc);
+
+            /* Each chunk as it comes */
+            static test_trace_t trace;
+            json_stream_t stream;
+            char carry[CARRY_SIZE];
+            trace.find_key = "Brightness";
+            start = bench_cycles();
+            json_stream_init(&stream, carry, sizeof(carry), test_stream_cb, &trace);
+            for (int off = 0; off < len; off += BENCH_CHUNK) {
+                TEST_ASSERT_EQUAL(OS_SUCCESS, json_stream_feed(&stream, js + off,
+                                                               len - off < BENCH_CHUNK ? len - off : BENCH_CHUNK));
+                carry_peak = stream.buf_len > carry_peak ? stream.buf_len : carry_peak;
+            }
+            TEST_ASSERT_EQUAL(OS_SUCCESS, json_stream_finish(&stream));
+            stream_time += bench_cycles() - start;
+        }
+
+        /* The carry-over buffer is reserved whole */
+        int stream_peak = sizeof(json_stream_t) + CARRY_SIZE;
+        carry_peaks[i] = carry_peak;
+        printf("%5d bytes: json_parser %6d bytes %7u cycles, json_stream %3d bytes (%d carried) %7u cycles\n",
+               len, dom_peak, (unsigned)(dom_time / BENCH_RUNS), stream_peak, carry_peak,
+               (unsigned)(stream_time / BENCH_RUNS));
+
+        /* The document and its tokens against the nesting and the longest token */
+        TEST_ASSERT_LESS_THAN(dom_peak / 4, stream_peak);
+        TEST_ASSERT_LESS_OR_EQUAL(CARRY_SIZE, carry_peak);
+        free(js);
+    }
+
+    /* Flat in the size of the document */
+    TEST_ASSERT_EQUAL(carry_peaks[0], carry_peaks[2]);
+}
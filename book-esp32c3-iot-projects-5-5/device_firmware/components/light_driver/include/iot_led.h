@@ -40,8 +40,187 @@ extern "C" {
         } \
     } while(0)
 
+/**
+ * @brief Handle of an iot led instance, a group of LEDC channels sharing one LEDC timer
+ */
+typedef struct iot_led *iot_led_handle_t;
+
+/**
+ * @brief Configuration of an iot led instance
+ */
+typedef struct {
+    ledc_timer_t      timer_num;        /**< LEDC timer of the instance */
+    ledc_mode_t       speed_mode;       /**< LEDC speed mode */
+    uint32_t          freq_hz;          /**< LEDC timer frequency (Hz) */
+    ledc_clk_cfg_t    clk_cfg;          /**< Clock source of LEDC, LEDC_USE_RC_FAST_CLK keeps the LEDs on in light sleep */
+    ledc_timer_bit_t  duty_resolution;  /**< LEDC channel duty resolution, up to 16 bits */
+    const uint16_t   *gamma_table;      /**< GAMMA_TABLE_SIZE entries, NULL for the GAMMA_CORRECTION curve */
+    bool              hw_fade;          /**< Run fades and loop-fades on the LEDC fade engine */
+} iot_led_config_t;
+
+/**
+ * @brief Tick scheduler statistics, shared by all instances
+ *
+ * @note  tick_count + tick_skipped is what a fixed DUTY_SET_CYCLE tick would
+ *        have cost, tick_skipped are CPU wakeups saved, e.g. for CONFIG_PM_ENABLE.
+ */
+typedef struct {
+    uint32_t tick_count;       /**< Number of tick callbacks */
+    uint32_t tick_skipped;     /**< DUTY_SET_CYCLE ticks slept through while no update was due */
+    uint32_t channel_visits;   /**< Active channels looked at by the tick */
+    uint32_t channel_updates;  /**< Number of channel duty updates done by the tick */
+    uint64_t tick_cycles;      /**< CPU cycles spent in the tick callback */
+    uint32_t sw_fades;         /**< Fades and blinks run by the tick */
+    uint32_t hw_fades;         /**< Fades run by the LEDC fade engine */
+    uint32_t hw_wakeups;       /**< LEDC fade end interrupts */
+    uint32_t cmd_count;        /**< Channel commands run by the tick */
+    uint32_t cmd_dropped;      /**< Channel commands rejected because the queue was full */
+    uint32_t power_limited;    /**< Updates of a power limited instance scaled down to its budget */
+} iot_led_stats_t;
+
+/**
+  * @brief Create an iot led instance and configure its LEDC timer
+  *
+  * @note  All instances are stepped by a single one-shot esp_timer, armed for the
+  *        next update that is due: every DUTY_SET_CYCLE at most, every half period
+  *        for a blink, and less often while a slow fade moves the duty by less than
+  *        one LSB per tick. With hw_fade, a fade is split into up to 8 linear LEDC
+  *        fades along the gamma curve and the tick only runs for blinks, or when
+  *        the LEDC fade engine rejects a fade.
+  */
+esp_err_t iot_led_create(const iot_led_config_t *config, iot_led_handle_t *handle);
+
+/**
+  * @brief Delete an iot led instance and free its resources
+  */
+esp_err_t iot_led_delete(iot_led_handle_t handle);
+
+/**
+  * @brief Map the channel index of an instance to an LEDC channel & GPIO
+  *
+  * @param index Channel index within the instance, 0 .. LEDC_CHANNEL_MAX - 1
+  */
+esp_err_t iot_led_add_channel(iot_led_handle_t handle, uint8_t index, ledc_channel_t channel, gpio_num_t gpio_num);
+
+/**
+  * @brief Get current value (0..255) of a channel of an instance
+  *
+  * @note  The set / blink / stop functions below only queue a command for the
+  *        tick and never block. The value reflects them once the tick has run.
+  *        This one waits for a tick that is running while it reads.
+  */
+esp_err_t iot_led_channel_get(iot_led_handle_t handle, uint8_t index, uint8_t *dst);
+
+/**
+  * @brief Set a channel of an instance to value with fade time (ms)
+  *
+  * @return
+  *     - ESP_OK
+  *     - ESP_ERR_INVALID_ARG: the channel index is not mapped
+  *     - ESP_ERR_NO_MEM: the command queue is full
+  */
+esp_err_t iot_led_channel_set(iot_led_handle_t handle, uint8_t index, uint8_t value, uint32_t fade_ms);
+
+/**
+  * @brief Start blink / loop-fade on a channel of an instance
+  * @param fade_flag 1: loop fade, 0: blink
+  */
+esp_err_t iot_led_channel_start_blink(iot_led_handle_t handle, uint8_t index, uint8_t value,
+                                      uint32_t period_ms, bool fade_flag);
+
+/**
+  * @brief Stop blink / loop-fade on a channel of an instance
+  */
+esp_err_t iot_led_channel_stop_blink(iot_led_handle_t handle, uint8_t index);
+
+/**
+  * @brief Override the gamma table of an instance
+  */
+esp_err_t iot_led_channel_set_gamma_table(iot_led_handle_t handle, const uint16_t gamma_table[GAMMA_TABLE_SIZE]);
+
+/**
+  * @brief Limit the estimated power of the channels of an instance
+  *
+  * @note  Channel index i draws power_mw[i] * duty / max duty. When the channels
+  *        of the instance draw more than budget_mw, the tick scales all their
+  *        duties down by the same factor. iot_led_channel_get() still returns
+  *        the values before the limit. Fades of a power limited instance run on
+  *        the software tick, fades running on the LEDC fade engine stop where they are.
+  *
+  * @param power_mw    Power of each channel index at full duty, may be NULL to remove the limit
+  * @param channel_num Number of entries in power_mw
+  * @param budget_mw   0 to remove the limit
+  */
+esp_err_t iot_led_set_power_limit(iot_led_handle_t handle, const uint16_t *power_mw, uint8_t channel_num,
+                                  uint32_t budget_mw);
+
+/**
+  * @brief Get the estimated power of the duties written to a power limited instance
+  *
+  * @return
+  *     - ESP_OK
+  *     - ESP_ERR_INVALID_ARG
+  *     - ESP_ERR_INVALID_STATE: the instance has no power limit
+  */
+esp_err_t iot_led_get_power(iot_led_handle_t handle, uint32_t *power_mw);
+
+/**
+  * @brief Convert a channel value to the LEDC duty of an instance, as the tick does
+  *
+  * @param q8_value Channel value in Q8 fixed point, 0 .. (255 << 8)
+  */
+esp_err_t iot_led_value_to_duty(iot_led_handle_t handle, uint16_t q8_value, uint32_t *duty);
+
+/**
+  * @brief Play a timeline compiled by led_timeline_compile() on the channels of an instance
+  *
+  * @note  Timeline channel i drives channel index i, all of them from the same tick.
+  *        The timeline is copied. Setting, blinking or stopping a channel detaches
+  *        it from the timeline, starting another timeline replaces it.
+  *
+  * @return
+  *     - ESP_OK
+  *     - ESP_ERR_INVALID_ARG, ESP_ERR_INVALID_SIZE, ESP_ERR_INVALID_VERSION: see led_timeline_check()
+  *     - ESP_ERR_NO_MEM: out of memory or the command queue is full
+  */
+esp_err_t iot_led_timeline_start(iot_led_handle_t handle, const void *timeline, size_t size);
+
+/**
+  * @brief Stop the timeline of an instance, the channels keep their current value
+  */
+esp_err_t iot_led_timeline_stop(iot_led_handle_t handle);
+
+/**
+  * @brief Get the tick scheduler statistics
+  */
+esp_err_t iot_led_get_stats(iot_led_stats_t *stats);
+
+/**
+  * @brief Reset the tick scheduler statistics
+  */
+esp_err_t iot_led_reset_stats(void);
+
+/**
+  * @brief Told by the tick when the LEDs start or stop moving
+  *
+  * @param active true once a fade, blink or timeline runs, false once none is left
+  */
+typedef void (*iot_led_activity_cb_t)(bool active, void *arg);
+
+/**
+  * @brief Set the callback of all instances told when the LEDs start or stop moving,
+  *        e.g. to hold a PM lock only while a fade runs
+  *
+  * @note  Called from the esp_timer task, once per change: set it before the first
+  *        fade so the first call is active = true. NULL removes it
+  */
+esp_err_t iot_led_set_activity_cb(iot_led_activity_cb_t cb, void *arg);
+
 /**
   * @brief Initialize and set the ledc timer for the iot led
+  *
+  * @note  Creates the default instance used by the functions below, whose channel
+  *        index is the LEDC channel number.
   */
 esp_err_t iot_led_init(ledc_timer_t timer_num, ledc_mode_t speed_mode, uint32_t freq_hz,
                        ledc_clk_cfg_t clk_cfg, ledc_timer_bit_t duty_resolution);
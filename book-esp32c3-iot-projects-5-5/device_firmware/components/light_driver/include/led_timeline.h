@@ -0,0 +1,139 @@
+// Copyright 2017 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __LED_TIMELINE_H__
+#define __LED_TIMELINE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A compiled timeline is a self-contained little-endian blob, so it can be
+ * stored with app_storage or received from the cloud as is:
+ *
+ *   header:   'L' 'T' version channel_num loop_count keyframe_num
+ *   keyframe: duration_ms (u16) easing (u8) value[channel_num] (u8, 0..255)
+ *
+ * Keyframe k is reached from the previous keyframe in duration_ms along its
+ * easing curve. The first keyframe is reached from the values the channels
+ * had when the timeline started, then from the last keyframe on every loop.
+ */
+#define LED_TIMELINE_VERSION       (1)
+#define LED_TIMELINE_CHANNEL_MAX   (8)
+#define LED_TIMELINE_HEADER_SIZE   (6)
+#define LED_TIMELINE_SIZE(channel_num, keyframe_num) \
+    (LED_TIMELINE_HEADER_SIZE + (size_t)(keyframe_num) * (3 + (channel_num)))
+
+typedef enum {
+    LED_EASE_LINEAR,
+    LED_EASE_IN,         /**< Quadratic, slow start */
+    LED_EASE_OUT,        /**< Quadratic, slow end */
+    LED_EASE_IN_OUT,     /**< Smoothstep */
+    LED_EASE_STEP,       /**< Hold the previous keyframe, then jump */
+    LED_EASE_MAX,
+} led_easing_t;
+
+typedef struct {
+    uint16_t duration_ms;
+    uint8_t  easing;                           /**< led_easing_t */
+    uint8_t  value[LED_TIMELINE_CHANNEL_MAX];  /**< Channel values, 0..255 */
+} led_keyframe_t;
+
+/**
+ * @brief Playback position in a timeline
+ */
+typedef struct {
+    const uint8_t *data;                            /**< Compiled timeline */
+    uint16_t       from[LED_TIMELINE_CHANNEL_MAX];  /**< Q8 values the current segment starts from */
+    uint32_t       elapsed_ms;                      /**< Time into the current segment */
+    uint8_t        keyframe;                        /**< Keyframe the current segment ends on */
+    uint8_t        loop;                            /**< Passes done */
+    bool           done;
+} led_timeline_cursor_t;
+
+/**
+ * @brief  Compile keyframes into a timeline
+ *
+ * @param  loop_count Number of passes, 0 to loop forever
+ * @param  size       Size of buf, set to the size of the timeline
+ *
+ * @return
+ *      - ESP_OK
+ *      - ESP_ERR_INVALID_ARG
+ *      - ESP_ERR_INVALID_SIZE: buf is too small
+ */
+esp_err_t led_timeline_compile(const led_keyframe_t *keyframes, uint8_t keyframe_num, uint8_t channel_num,
+                               uint8_t loop_count, void *buf, size_t *size);
+
+/**
+ * @brief  Check a timeline received from storage or the network
+ *
+ * @note   A timeline looping forever must last longer than 0 ms.
+ *
+ * @return
+ *      - ESP_OK
+ *      - ESP_ERR_INVALID_SIZE: size does not match the header
+ *      - ESP_ERR_INVALID_VERSION
+ *      - ESP_ERR_INVALID_ARG
+ */
+esp_err_t led_timeline_check(const void *timeline, size_t size);
+
+/**
+ * @brief  Size of a timeline from its header, 0 if the header is invalid
+ */
+size_t led_timeline_size(const void *timeline, size_t size);
+
+/**
+ * @brief  Number of channels of a checked timeline
+ */
+uint8_t led_timeline_channel_num(const void *timeline);
+
+/**
+ * @brief  Start a checked timeline
+ *
+ * @param  start Q8 channel values to start from, NULL for 0
+ */
+void led_timeline_cursor_init(led_timeline_cursor_t *cursor, const void *timeline, const uint16_t *start);
+
+/**
+ * @brief  Advance a timeline and get the Q8 channel values
+ *
+ * @return false once the last pass is done, the values then hold the last keyframe
+ */
+bool led_timeline_step(led_timeline_cursor_t *cursor, uint32_t ms, uint16_t *value);
+
+/**
+ * @brief  Render a timeline as the tick plays it, to preview or regression-test effects
+ *
+ * @param  step_ms  Time between two rows, DUTY_SET_CYCLE for the tick
+ * @param  trace    step_num rows of channel_num Q8 values
+ *
+ * @return
+ *      - ESP_OK
+ *      - ESP_ERR_INVALID_ARG
+ */
+esp_err_t led_timeline_render(const void *timeline, size_t size, const uint16_t *start,
+                              uint32_t step_ms, uint16_t *trace, size_t step_num);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif/**< __LED_TIMELINE_H__ */
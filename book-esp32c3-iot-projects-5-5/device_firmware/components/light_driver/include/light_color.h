@@ -0,0 +1,110 @@
+// Copyright 2017 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __LIGHT_COLOR_H__
+#define __LIGHT_COLOR_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Color components are 16-bit, 0 .. LIGHT_COLOR_MAX. Hue is split in six
+ * sectors of LIGHT_COLOR_HUE_SECTOR units, one per 60 degrees.
+ */
+#define LIGHT_COLOR_MAX          (0xFFFF)
+#define LIGHT_COLOR_HUE_SECTOR   (8192)
+#define LIGHT_COLOR_HUE_MAX      (6 * LIGHT_COLOR_HUE_SECTOR)   /**< 360 degrees, wraps to 0 */
+
+#define LIGHT_COLOR_HUE_FROM_DEGREE(degree) ((uint32_t)(degree) * LIGHT_COLOR_HUE_SECTOR / 60)
+#define LIGHT_COLOR_HUE_TO_DEGREE(hue)      (((uint32_t)(hue) * 60 + LIGHT_COLOR_HUE_SECTOR / 2) / LIGHT_COLOR_HUE_SECTOR)
+#define LIGHT_COLOR_FROM_PERCENT(percent)   (((uint32_t)(percent) * LIGHT_COLOR_MAX + 50) / 100)
+
+typedef struct {
+    uint16_t hue;         /**< 0 .. LIGHT_COLOR_HUE_MAX - 1 */
+    uint16_t saturation;
+    uint16_t value;
+} light_hsv_t;
+
+typedef struct {
+    uint16_t red;
+    uint16_t green;
+    uint16_t blue;
+} light_rgb_t;
+
+typedef struct {
+    uint16_t color_temperature;   /**< 0: cold .. LIGHT_COLOR_MAX: warm */
+    uint16_t brightness;
+} light_ctb_t;
+
+typedef struct {
+    uint16_t warm;
+    uint16_t cold;
+} light_wc_t;
+
+/**
+ * @brief Conversions run by light_color_convert_n()
+ */
+typedef enum {
+    LIGHT_COLOR_HSV2RGB,   /**< light_hsv_t -> light_rgb_t */
+    LIGHT_COLOR_RGB2HSV,   /**< light_rgb_t -> light_hsv_t */
+    LIGHT_COLOR_CTB2WC,    /**< light_ctb_t -> light_wc_t */
+} light_color_conversion_t;
+
+/**
+ * @brief  Scale a 16-bit component to 0 .. max, rounded
+ *
+ * @note   Used to get 8-bit channel values (max 255) or percentages (max 100)
+ */
+uint16_t light_color_scale(uint16_t component, uint16_t max);
+
+/**
+ * @brief  Convert HSV to RGB
+ */
+void light_color_hsv2rgb(const light_hsv_t *hsv, light_rgb_t *rgb);
+
+/**
+ * @brief  Convert RGB to HSV
+ */
+void light_color_rgb2hsv(const light_rgb_t *rgb, light_hsv_t *hsv);
+
+/**
+ * @brief  Convert color temperature & brightness to warm and cold channel levels
+ *
+ * @note   Levels above 15% are compressed to 14% + 86% of the level, as the
+ *         warm and cold LEDs are brighter than the RGB ones.
+ */
+void light_color_ctb2wc(const light_ctb_t *ctb, light_wc_t *wc);
+
+/**
+ * @brief  Convert n colors, for effects and scene playback
+ *
+ * @param  src Array of n colors, of the source type of the conversion
+ * @param  dst Array of n colors, of the destination type of the conversion, may not overlap src
+ *
+ * @return
+ *      - ESP_OK
+ *      - ESP_ERR_INVALID_ARG
+ */
+esp_err_t light_color_convert_n(light_color_conversion_t conversion, const void *src, void *dst, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif/**< __LIGHT_COLOR_H__ */
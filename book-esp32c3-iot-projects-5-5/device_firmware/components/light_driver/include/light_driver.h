@@ -53,6 +53,8 @@ typedef struct {
     uint32_t freq_hz;         /**< LEDC timer frequency (Hz) */
     ledc_clk_cfg_t clk_cfg;   /**< Clock srouce of LEDC */
     ledc_timer_bit_t duty_resolution;  /**< LEDC channel duty resolution */
+    ledc_timer_t timer_num;            /**< LEDC timer, LEDC_TIMER_0 if not set */
+    ledc_channel_t channel_base;       /**< LEDC channel of red, the other four follow in order, LEDC_CHANNEL_0 if not set */
 } light_driver_config_t;
 
 /**
@@ -154,6 +156,24 @@ esp_err_t light_driver_fade_warm(uint8_t color_temperature);
 esp_err_t light_driver_fade_stop();
 /**@}*/
 
+/**@{*/
+/**
+ * @brief  Effects, timelines compiled by led_timeline_compile()
+ *
+ * @note   Timeline channels are red, green, blue, warm and cold, in this order.
+ *         light_driver_effect_save() stores a timeline with app_storage under key,
+ *         light_driver_effect_play() plays it back.
+ *
+ * @return
+ *      - ESP_OK
+ *      - ESP_ERR_INVALID_ARG
+ */
+esp_err_t light_driver_effect_start(const void *timeline, size_t size);
+esp_err_t light_driver_effect_stop();
+esp_err_t light_driver_effect_save(const char *key, const void *timeline, size_t size);
+esp_err_t light_driver_effect_play(const char *key);
+/**@}*/
+
 #ifdef __cplusplus
 }
 #endif
@@ -6,18 +6,22 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <math.h>
+#include <stdatomic.h>
+#include <sys/param.h>
 
 #include "esp_log.h"
+#include "esp_attr.h"
 #include "esp_timer.h"
+#include "esp_cpu.h"
 #include "driver/ledc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/timers.h"
 
 #include "iot_led.h"
+#include "led_timeline.h"
 
-#define LEDC_TIMER_PRECISION (LEDC_TIMER_13_BIT)
-#define LEDC_MAX_DUTY        ((1U << LEDC_TIMER_PRECISION) - 1)
-
-/* Map a 16-bit value to current LEDC duty resolution */
-#define LEDC_VALUE_TO_DUTY(value16) ( (uint32_t)((uint64_t)(value16) * (LEDC_MAX_DUTY) / 0xFFFFU) )
+#define LEDC_DUTY_BIT_MAX    (16)   /**< Widest duty resolution the 16-bit duty LUT holds */
 
 #define LEDC_FIXED_Q (8)
 #define FLOATINT_2_FIXED(X, Q)  ((int)((X) * (1U << (Q))))
@@ -25,26 +29,160 @@
 #define GET_FIXED_INTEGER_PART(X, Q) ((X) >> (Q))
 #define GET_FIXED_DECIMAL_PART(X, Q) ((X) & ((1U << (Q)) - 1))
 
+#define LED_SLOT_NUM         (LEDC_SPEED_MODE_MAX * LEDC_CHANNEL_MAX)
+#define LED_SLOT_NONE        (0xFF)
+#define LED_SLOT_INDEX(mode, channel) ((mode) * LEDC_CHANNEL_MAX + (channel))
+
+#define HW_FADE_SEGMENT_MAX     (8)    /**< Linear LEDC fades a gamma corrected fade is split into */
+#define HW_FADE_SEGMENT_MIN_MS  (100)  /**< Shortest hardware segment, shorter fades use fewer segments */
+
+#define LED_TICK_US             (DUTY_SET_CYCLE * 1000)
+#define LED_TICK_SLACK_US       (LED_TICK_US / 2)   /**< Updates due this close to a tick run in it */
+#define LED_TICK_SKIP_MAX       (8)    /**< Most ticks a software fade step can span */
+
+#define LED_POWER_Q             (16)   /**< Fixed point of the power limit scale */
+#define LED_POWER_BUDGET_MAX    (LEDC_CHANNEL_MAX * UINT16_MAX)
+
+#define LED_CMD_QUEUE_SIZE      (32)   /**< Pending channel commands, must be a power of two */
+#define LED_CMD_QUEUE_MASK      (LED_CMD_QUEUE_SIZE - 1)
+
+_Static_assert((LED_CMD_QUEUE_SIZE & LED_CMD_QUEUE_MASK) == 0, "LED_CMD_QUEUE_SIZE must be a power of two");
+_Static_assert(LED_SLOT_NUM <= 32, "g_hw_fade_done and g_led_active have one bit per slot");
+
 typedef struct {
     int     cur;    // Q8 fixed  value 0..(255<<Q)
     int     final;  // Q8 target
     int     step;   // Q8 step (+/-)
     int     cycle;  // for blink/fade loop: number of ticks for half-period
     size_t  num;    // ticks remaining for one transition
+    size_t  ticks;  // ticks the next update advances, see led_slot_schedule()
+    int64_t due_us; // time of the next update
 } ledc_fade_data_t;
 
+/**
+ * @brief Fade run by the LEDC fade engine, one linear segment of the gamma curve at a time
+ */
+typedef struct {
+    int       from;       /**< Q8 value the fade started from */
+    int       to;         /**< Q8 target */
+    int64_t   start_us;   /**< Start of the fade, used to report the current value */
+    uint32_t  fade_ms;
+    uint32_t  seg_duty;   /**< Duty the running segment ends on */
+    uint8_t   seg;        /**< Segments started so far */
+    uint8_t   seg_num;
+    bool      loop;       /**< Loop-fade: swap from/to at the end of every fade */
+    bool      active;
+} ledc_hw_fade_t;
+
+/**
+ * @brief One hardware LEDC channel, owned by at most one instance
+ */
+typedef struct {
+    ledc_fade_data_t  fade_data;
+    ledc_hw_fade_t    hw_fade;
+    struct iot_led   *owner;     /**< NULL while the channel is free */
+    uint32_t          duty;      /**< Duty before the power limit */
+    ledc_channel_t    channel;
+    uint8_t           index;     /**< Channel index within the owner */
+} iot_led_slot_t;
+
+typedef enum {
+    LED_CMD_SET,
+    LED_CMD_BLINK,
+    LED_CMD_STOP,
+    LED_CMD_TIMELINE,
+} led_cmd_type_t;
+
+/**
+ * @brief Channel command, queued by the API and run by the tick
+ */
+typedef struct {
+    struct iot_led   *owner;      /**< Dropped if the slot changed owner meanwhile, NULL once purged */
+    void             *data;       /**< Timeline copy, freed by the tick */
+    uint32_t          time_ms;    /**< Fade time or blink period */
+    uint8_t           type;
+    uint8_t           slot;
+    uint8_t           value;
+    bool              fade_flag;
+} led_cmd_t;
+
+typedef struct {
+    atomic_uint       seq;        /**< Position the cell is ready for, see led_cmd_push() */
+    led_cmd_t         cmd;
+} led_cmd_cell_t;
+
+/**
+ * @brief Bounded multi-producer / single-consumer ring, the tick is the only consumer
+ */
 typedef struct {
-    ledc_fade_data_t  fade_data[LEDC_CHANNEL_MAX];
+    led_cmd_cell_t    cells[LED_CMD_QUEUE_SIZE];
+    atomic_uint       head;       /**< Next position to reserve, shared by producers */
+    uint32_t          tail;       /**< Next position to read, owned by the tick */
+} led_cmd_queue_t;
+
+typedef struct iot_led {
+    uint8_t           slot_map[LEDC_CHANNEL_MAX];   /**< Instance channel index -> slot, LED_SLOT_NONE if unmapped */
+    uint16_t          gamma_table[GAMMA_TABLE_SIZE];
+    uint16_t          duty_table[GAMMA_TABLE_SIZE];   /**< gamma_table mapped to the duty resolution of the timer */
+    uint32_t          max_duty;
     ledc_mode_t       speed_mode;
     ledc_timer_t      timer_num;
+    bool              hw_fade;
+    ledc_sleep_mode_t sleep_mode;         /**< Channels keep their output in light sleep if the clock runs there */
+    led_timeline_cursor_t timeline;       /**< Timeline played by the tick, timeline.data NULL if none */
+    int64_t           timeline_due_us;    /**< Time of the next timeline step */
+    uint32_t          timeline_mask;      /**< Channel indexes still driven by the timeline */
+    uint16_t          power_mw[LEDC_CHANNEL_MAX];   /**< Power of each channel index at full duty */
+    uint32_t          power_budget_mw;    /**< 0 if the instance is not power limited */
+    uint64_t          power;              /**< Sum of power_mw * duty written by the last update */
+    bool              power_dirty;        /**< A duty changed, rewrite the channels at the end of the tick */
+    struct iot_led   *next;
 } iot_light_t;
 
 static const char *TAG = "iot_light";
 
-static iot_light_t           *g_light_config   = NULL;
-static uint16_t              *g_gamma_table    = NULL;
-static esp_timer_handle_t     g_timer_handle   = NULL;
-static bool                   g_timer_started  = false;
+/**
+ * The tick walks this flat table instead of the instances, so its cost only
+ * depends on the number of LEDC channels in use and one esp_timer serves all
+ * instances.
+ */
+static iot_led_slot_t         g_led_slots[LED_SLOT_NUM];
+static uint8_t                g_led_instance_num = 0;
+static SemaphoreHandle_t      g_led_lock         = NULL;
+static esp_timer_handle_t     g_timer_handle     = NULL;
+static iot_led_stats_t        g_led_stats        = {0};
+static iot_led_handle_t       g_led_list         = NULL;   /**< All instances, for the timelines */
+static bool                   g_fade_installed   = false;
+
+/**
+ * Slots with a software fade or blink, one bit per slot. The tick only
+ * looks at these and sleeps until the earliest of their updates is due.
+ */
+static uint32_t               g_led_active       = 0;
+static int64_t                g_tick_us          = 0;      /**< Start of the running tick */
+
+/**
+ * Whether a fade, blink or timeline ran at the end of the last tick, only
+ * touched by the tick, which tells g_activity_cb when it changes.
+ */
+static bool                   g_led_busy         = false;
+static iot_led_activity_cb_t  g_activity_cb      = NULL;
+static void                  *g_activity_arg     = NULL;
+
+/**
+ * Fade state in g_led_slots is only written by the tick. The API queues
+ * commands in g_cmd_queue and never blocks, LEDC fade-end interrupts set
+ * a bit in g_hw_fade_done, and readers use g_led_seq as a seqlock, which
+ * falls back to g_led_lock when their read overlaps a tick.
+ */
+static led_cmd_queue_t        g_cmd_queue;
+static atomic_uint            g_cmd_dropped      = 0;
+static atomic_uint            g_hw_fade_done     = 0;
+static atomic_uint            g_hw_wakeups       = 0;
+static atomic_uint            g_led_seq          = 0;
+
+/** Default instance behind the single-light API */
+static iot_led_handle_t       g_default_led      = NULL;
 
 /* -------------------- gamma & duty helpers -------------------- */
 
@@ -65,19 +203,30 @@ static void gamma_table_create(uint16_t *gamma_table, float correction)
     }
 }
 
-static inline uint32_t gamma_value_to_duty(int q8_value)
+static void duty_table_create(uint16_t *duty_table, const uint16_t *gamma_table, uint32_t max_duty)
+{
+    /* chia 64-bit chỉ chạy một lần ở đây, không phải mỗi tick */
+    for (int i = 0; i < GAMMA_TABLE_SIZE; i++) {
+        duty_table[i] = (uint16_t)((uint64_t)gamma_table[i] * max_duty / 0xFFFFU);
+    }
+}
+
+static inline uint32_t gamma_value_to_duty(const uint16_t *duty_table, int q8_value)
 {
     /* q8_value là Q8 cố định: 0 .. (255<<8) */
     uint32_t idx  = GET_FIXED_INTEGER_PART(q8_value, LEDC_FIXED_Q);             // 0..255
     uint32_t frac = GET_FIXED_DECIMAL_PART(q8_value, LEDC_FIXED_Q);             // 0..255
 
-    uint16_t cur  = LEDC_VALUE_TO_DUTY(g_gamma_table[idx]);
-    uint16_t next = (idx < (GAMMA_TABLE_SIZE - 1)) ? LEDC_VALUE_TO_DUTY(g_gamma_table[idx + 1]) : cur;
+    if (idx >= GAMMA_TABLE_SIZE - 1) {
+        return duty_table[GAMMA_TABLE_SIZE - 1];
+    }
 
-    /* nội suy tuyến tính trong Q8 */
-    uint32_t duty = cur + (uint32_t)(( (int)next - (int)cur ) * (int)frac / (1 << LEDC_FIXED_Q));
-    if (duty > LEDC_MAX_DUTY) duty = LEDC_MAX_DUTY;
-    return duty;
+#ifdef CONFIG_LIGHT_DRIVER_DUTY_INTERPOLATION
+    /* nội suy tuyến tính trong Q8, chỉ nhân và dịch bit */
+    return (duty_table[idx] * ((1U << LEDC_FIXED_Q) - frac) + duty_table[idx + 1] * frac) >> LEDC_FIXED_Q;
+#else
+    return duty_table[idx + (frac >> (LEDC_FIXED_Q - 1))];
+#endif
 }
 
 static inline esp_err_t ledc_apply_duty(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t duty)
@@ -87,101 +236,713 @@ static inline esp_err_t ledc_apply_duty(ledc_mode_t speed_mode, ledc_channel_t c
     return ledc_update_duty(speed_mode, channel);
 }
 
-/* -------------------- periodic tick (esp_timer) -------------------- */
+static inline esp_err_t led_slot_apply(iot_led_slot_t *slot, int q8_value)
+{
+    slot->duty = gamma_value_to_duty(slot->owner->duty_table, q8_value);
 
-static void led_tick_cb(void *arg)
+    /* kênh bị giới hạn công suất được ghi ở cuối tick, cùng mọi kênh của instance */
+    if (slot->owner->power_budget_mw) {
+        slot->owner->power_dirty = true;
+        return ESP_OK;
+    }
+
+    return ledc_apply_duty(slot->owner->speed_mode, slot->channel, slot->duty);
+}
+
+/**
+ * @brief Write the duties of a power limited instance, scaled down together if they exceed its budget
+ *
+ * @return true if the duties were scaled down
+ */
+static bool led_power_apply(iot_light_t *led)
+{
+    uint64_t budget = (uint64_t)led->power_budget_mw * led->max_duty;
+    uint64_t power  = 0;
+    uint32_t scale  = 1U << LED_POWER_Q;
+
+    for (int i = 0; i < LEDC_CHANNEL_MAX; i++) {
+        if (led->slot_map[i] != LED_SLOT_NONE) {
+            power += (uint32_t)led->power_mw[i] * g_led_slots[led->slot_map[i]].duty;
+        }
+    }
+
+    /* chỉ chia khi vượt ngân sách; làm tròn xuống nên tổng sau khi scale không vượt */
+    if (power > budget) {
+        scale = (uint32_t)((budget << LED_POWER_Q) / power);
+    }
+
+    led->power = 0;
+
+    for (int i = 0; i < LEDC_CHANNEL_MAX; i++) {
+        if (led->slot_map[i] == LED_SLOT_NONE) {
+            continue;
+        }
+
+        const iot_led_slot_t *slot = &g_led_slots[led->slot_map[i]];
+        uint32_t duty = (uint32_t)(((uint64_t)slot->duty * scale) >> LED_POWER_Q);
+
+        (void)ledc_apply_duty(led->speed_mode, slot->channel, duty);
+        led->power += (uint32_t)led->power_mw[i] * duty;
+    }
+
+    return power > budget;
+}
+
+static inline iot_led_slot_t *led_slot_get(iot_led_handle_t handle, uint8_t index)
+{
+    if (handle == NULL || index >= LEDC_CHANNEL_MAX || handle->slot_map[index] == LED_SLOT_NONE) {
+        return NULL;
+    }
+
+    return &g_led_slots[handle->slot_map[index]];
+}
+
+static inline uint32_t led_slot_bit(const iot_led_slot_t *slot)
+{
+    return 1U << (slot - g_led_slots);
+}
+
+/* -------------------- hardware fade (LEDC fade engine) -------------------- */
+
+static int led_hw_fade_value(const iot_led_slot_t *slot)
+{
+    const ledc_hw_fade_t *hw = &slot->hw_fade;
+    int64_t elapsed_us = esp_timer_get_time() - hw->start_us;
+    int64_t fade_us    = (int64_t)hw->fade_ms * 1000;
+
+    if (elapsed_us >= fade_us) {
+        return hw->to;
+    }
+
+    return hw->from + (int)((int64_t)(hw->to - hw->from) * elapsed_us / fade_us);
+}
+
+static esp_err_t led_hw_fade_segment_start(iot_led_slot_t *slot)
+{
+    ledc_hw_fade_t *hw = &slot->hw_fade;
+
+    hw->seg++;
+
+    /* mỗi segment là một đoạn thẳng giữa hai điểm trên đường gamma */
+    int value       = hw->from + (hw->to - hw->from) * hw->seg / hw->seg_num;
+    uint32_t seg_ms = hw->fade_ms * hw->seg / hw->seg_num - hw->fade_ms * (hw->seg - 1) / hw->seg_num;
+
+    hw->seg_duty    = gamma_value_to_duty(slot->owner->duty_table, value);
+
+    esp_err_t ret = ledc_set_fade_with_time(slot->owner->speed_mode, slot->channel, hw->seg_duty, seg_ms);
+    if (ret != ESP_OK) return ret;
+    return ledc_fade_start(slot->owner->speed_mode, slot->channel, LEDC_FADE_NO_WAIT);
+}
+
+static esp_err_t led_hw_fade_start(iot_led_slot_t *slot, int from, int to, uint32_t fade_ms, bool loop)
+{
+    ledc_hw_fade_t *hw = &slot->hw_fade;
+
+    hw->from     = from;
+    hw->to       = to;
+    hw->start_us = esp_timer_get_time();
+    hw->fade_ms  = fade_ms;
+    hw->seg      = 0;
+    hw->seg_num  = MAX(1, MIN(HW_FADE_SEGMENT_MAX, fade_ms / HW_FADE_SEGMENT_MIN_MS));
+    hw->loop     = loop;
+    hw->active   = true;
+
+    esp_err_t ret = led_hw_fade_segment_start(slot);
+
+    if (ret != ESP_OK) {
+        hw->active = false;
+        return ret;
+    }
+
+    g_led_stats.hw_fades++;
+    return ESP_OK;
+}
+
+static void led_hw_fade_stop(iot_led_slot_t *slot)
+{
+    if (slot->hw_fade.active) {
+        slot->fade_data.cur   = led_hw_fade_value(slot);
+        slot->hw_fade.active  = false;
+        (void)ledc_fade_stop(slot->owner->speed_mode, slot->channel);
+    }
+}
+
+/**
+ * @brief Runs in the tick once a segment has ended
+ */
+static void led_hw_fade_next(iot_led_slot_t *slot)
+{
+    ledc_hw_fade_t *hw = &slot->hw_fade;
+    esp_err_t ret      = ESP_OK;
+
+    if (slot->owner == NULL || !hw->active) {
+        /* fade đã bị dừng trước khi callback tới */
+    } else if (ledc_get_duty(slot->owner->speed_mode, slot->channel) != hw->seg_duty) {
+        /* fade-end của một fade đã bị thay thế, segment hiện tại chưa xong */
+    } else if (hw->seg < hw->seg_num) {
+        ret = led_hw_fade_segment_start(slot);
+    } else if (hw->loop) {
+        ret = led_hw_fade_start(slot, hw->to, hw->from, hw->fade_ms, true);
+    } else {
+        hw->active = false;
+        slot->fade_data.cur = hw->to;
+    }
+
+    if (ret != ESP_OK) {
+        /* không chạy tiếp được trên phần cứng: chốt target */
+        ESP_LOGW(TAG, "<%s> LEDC fade on channel %d failed", esp_err_to_name(ret), slot->channel);
+        hw->active = false;
+        slot->fade_data.cur = hw->to;
+        (void)led_slot_apply(slot, hw->to);
+    }
+}
+
+static void led_tick_kick(void)
+{
+    esp_timer_handle_t timer = g_timer_handle;
+
+    /* tick có thể đang ngủ tới một cập nhật xa: gọi lại ngay thay vì chờ */
+    if (timer && esp_timer_restart(timer, 0) != ESP_OK) {
+        /* không có tick nào được hẹn, hoặc tick đang chạy và sẽ hẹn lại */
+        esp_timer_start_once(timer, 0);
+    }
+}
+
+static void led_hw_fade_kick(void *arg, uint32_t unused)
 {
     (void)arg;
+    (void)unused;
+    led_tick_kick();
+}
 
-    if (!g_light_config) return;
+static IRAM_ATTR bool led_hw_fade_end_cb(const ledc_cb_param_t *param, void *user_arg)
+{
+    BaseType_t task_woken = pdFALSE;
 
-    int idle_channels = 0;
+    atomic_fetch_add_explicit(&g_hw_wakeups, 1, memory_order_relaxed);
 
-    for (int ch = 0; ch < LEDC_CHANNEL_MAX; ch++) {
-        ledc_fade_data_t *fd = &g_light_config->fade_data[ch];
+    if (param->event == LEDC_FADE_END_EVT) {
+        atomic_fetch_or_explicit(&g_hw_fade_done, 1U << (uintptr_t)user_arg, memory_order_release);
+        xTimerPendFunctionCallFromISR(led_hw_fade_kick, NULL, 0, &task_woken);
+    }
 
-        if (fd->num > 0) {
-            /* đang trong một pha fade */
-            fd->num--;
+    return task_woken == pdTRUE;
+}
 
-            if (fd->step) {
-                fd->cur += fd->step;
+/* -------------------- command queue -------------------- */
 
-                /* nếu còn tick, cập nhật trung gian; nếu hết, chốt target */
-                if (fd->num != 0) {
-                    (void)ledc_apply_duty(g_light_config->speed_mode, ch, gamma_value_to_duty(fd->cur));
-                } else {
-                    (void)ledc_apply_duty(g_light_config->speed_mode, ch, gamma_value_to_duty(fd->final));
-                    fd->cur = fd->final;
-                }
-            } else {
-                /* không cần chia nhỏ: set trực tiếp target */
-                (void)ledc_apply_duty(g_light_config->speed_mode, ch, gamma_value_to_duty(fd->final));
-                fd->cur = fd->final;
-            }
-        } else if (fd->cycle) {
-            /* blink / loop-fade: đảo chiều hoặc chuyển trạng thái mỗi half-period */
-            fd->num = (fd->cycle > 0) ? (size_t)fd->cycle : 0;
-
-            if (fd->step) {
-                fd->step = -fd->step;
-                fd->cur += fd->step;
-            } else {
-                fd->cur = (fd->cur == fd->final) ? 0 : fd->final;
+static void led_cmd_queue_reset(void)
+{
+    for (uint32_t i = 0; i < LED_CMD_QUEUE_SIZE; i++) {
+        atomic_init(&g_cmd_queue.cells[i].seq, i);
+    }
+
+    atomic_init(&g_cmd_queue.head, 0);
+    g_cmd_queue.tail = 0;
+}
+
+/**
+ * @brief Reserve a cell with a CAS on head, then publish it through its seq
+ *
+ * @return false if the queue is full, never waits
+ */
+static bool led_cmd_push(const led_cmd_t *cmd)
+{
+    unsigned int pos = atomic_load_explicit(&g_cmd_queue.head, memory_order_relaxed);
+
+    for (;;) {
+        led_cmd_cell_t *cell = &g_cmd_queue.cells[pos & LED_CMD_QUEUE_MASK];
+        unsigned int seq     = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        int diff             = (int)(seq - pos);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&g_cmd_queue.head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                cell->cmd = *cmd;
+                atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+                return true;
             }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = atomic_load_explicit(&g_cmd_queue.head, memory_order_relaxed);
+        }
+    }
+}
+
+static bool led_cmd_pop(led_cmd_t *cmd)
+{
+    uint32_t pos         = g_cmd_queue.tail;
+    led_cmd_cell_t *cell = &g_cmd_queue.cells[pos & LED_CMD_QUEUE_MASK];
+
+    /* cell chưa được producer publish xong */
+    if (atomic_load_explicit(&cell->seq, memory_order_acquire) != pos + 1) {
+        return false;
+    }
+
+    *cmd = cell->cmd;
+    atomic_store_explicit(&cell->seq, pos + LED_CMD_QUEUE_SIZE, memory_order_release);
+    g_cmd_queue.tail = pos + 1;
+    return true;
+}
+
+/**
+ * @brief Drop the queued commands of an instance, with g_led_lock held
+ *
+ * @note  The tick only pops under the same lock. A cell reserved but not
+ *        published yet is skipped rather than waited for, it belongs to a
+ *        producer still sending for another instance.
+ */
+static void led_cmd_purge(const iot_light_t *owner)
+{
+    unsigned int head = atomic_load_explicit(&g_cmd_queue.head, memory_order_acquire);
+
+    for (uint32_t pos = g_cmd_queue.tail; pos != head; pos++) {
+        led_cmd_cell_t *cell = &g_cmd_queue.cells[pos & LED_CMD_QUEUE_MASK];
+
+        if (atomic_load_explicit(&cell->seq, memory_order_acquire) == pos + 1 && cell->cmd.owner == owner) {
+            free(cell->cmd.data);
+            cell->cmd.data  = NULL;
+            cell->cmd.owner = NULL;
+        }
+    }
+}
+
+static esp_err_t led_cmd_send(const led_cmd_t *cmd)
+{
+    if (!led_cmd_push(cmd)) {
+        atomic_fetch_add_explicit(&g_cmd_dropped, 1, memory_order_relaxed);
+        return ESP_ERR_NO_MEM;
+    }
+
+    led_tick_kick();
+    return ESP_OK;
+}
+
+/* -------------------- channel commands, run by the tick -------------------- */
+
+/**
+ * @brief Hand a software fade or blink to the tick, its first update runs in the current tick
+ */
+static void led_slot_activate(iot_led_slot_t *slot)
+{
+    slot->fade_data.ticks  = 1;
+    slot->fade_data.due_us = g_tick_us;
+    g_led_active |= led_slot_bit(slot);
+}
+
+static void led_cmd_set(iot_led_slot_t *slot, uint8_t value, uint32_t fade_ms)
+{
+    ledc_fade_data_t *fd = &slot->fade_data;
+
+    led_hw_fade_stop(slot);
+    g_led_active &= ~led_slot_bit(slot);
+
+    fd->final = FLOATINT_2_FIXED(value, LEDC_FIXED_Q);
+
+    if (fade_ms == 0) {
+        /* set ngay */
+        fd->cur = fd->final;
+        fd->num = 0;
+        fd->step = 0;
+        fd->cycle = 0;
+        (void)led_slot_apply(slot, fd->final);
+        return;
+    }
+
+    /* blink loop off khi set trực tiếp */
+    fd->cycle = 0;
+
+    if (slot->owner->hw_fade && !slot->owner->power_budget_mw) {
+        esp_err_t ret = led_hw_fade_start(slot, fd->cur, fd->final, fade_ms, false);
+
+        if (ret == ESP_OK) {
+            fd->num  = 0;
+            fd->step = 0;
+            return;
+        }
+
+        ESP_LOGD(TAG, "<%s> LEDC fade unavailable, use the software tick", esp_err_to_name(ret));
+    }
+
+    /* số tick cần chạy */
+    fd->num = (fade_ms < DUTY_SET_CYCLE) ? 1 : (fade_ms / DUTY_SET_CYCLE);
+
+    int diff = abs(fd->final - fd->cur);
+    fd->step = (fd->num > 0) ? (diff / (int)fd->num) : diff;
+
+    if (fd->final < fd->cur) fd->step = -fd->step;
+
+    led_slot_activate(slot);
+    g_led_stats.sw_fades++;
+}
+
+static void led_cmd_blink(iot_led_slot_t *slot, uint8_t value, uint32_t period_ms, bool fade_flag)
+{
+    ledc_fade_data_t *fd = &slot->fade_data;
+
+    led_hw_fade_stop(slot);
+    g_led_active &= ~led_slot_bit(slot);
+
+    fd->final = fd->cur = FLOATINT_2_FIXED(value, LEDC_FIXED_Q);
+
+    if (fade_flag && slot->owner->hw_fade && !slot->owner->power_budget_mw) {
+        /* loop-fade: value -> 0 -> value, mỗi chiều nửa chu kỳ */
+        if (led_hw_fade_start(slot, fd->cur, 0, MAX(period_ms / 2, 1), true) == ESP_OK) {
+            fd->cycle = 0;
+            fd->num   = 0;
+            fd->step  = 0;
+            return;
+        }
+    }
+
+    int half_ticks = (period_ms / 2) / DUTY_SET_CYCLE;
+    if (half_ticks <= 0) half_ticks = 1;
+    fd->cycle = half_ticks;
+
+    if (fade_flag) {
+        fd->num  = half_ticks;
+        fd->step = (fd->num > 0) ? -(fd->cur / fd->num) : 0;
+    } else {
+        fd->num  = 0;
+        fd->step = 0; // blink: bật/tắt tức thời mỗi nửa chu kỳ
+    }
+
+    led_slot_activate(slot);
+    g_led_stats.sw_fades++;
+}
+
+static void led_cmd_stop(iot_led_slot_t *slot)
+{
+    ledc_fade_data_t *fd = &slot->fade_data;
+
+    led_hw_fade_stop(slot);
+    g_led_active &= ~led_slot_bit(slot);
+
+    fd->cycle = 0;
+    fd->num   = 0;
+    fd->step  = 0;
+}
+
+static void led_timeline_release(iot_light_t *led)
+{
+    free((void *)led->timeline.data);
+    led->timeline.data = NULL;
+    led->timeline_mask = 0;
+}
+
+static void led_cmd_timeline(iot_light_t *owner, void *timeline)
+{
+    iot_light_t *led = g_led_list;
+
+    while (led && led != owner) {
+        led = led->next;
+    }
+
+    /* instance đã bị xóa sau khi lệnh được gửi */
+    if (led == NULL) {
+        free(timeline);
+        return;
+    }
+
+    led_timeline_release(led);
+
+    if (timeline == NULL) {
+        return;
+    }
+
+    uint16_t start[LED_TIMELINE_CHANNEL_MAX] = {0};
+    uint8_t channel_num = MIN(led_timeline_channel_num(timeline), LEDC_CHANNEL_MAX);
+
+    /* các kênh được timeline điều khiển bắt đầu từ giá trị hiện tại */
+    for (int i = 0; i < channel_num; i++) {
+        if (led->slot_map[i] == LED_SLOT_NONE) {
+            continue;
+        }
+
+        iot_led_slot_t *slot = &g_led_slots[led->slot_map[i]];
+
+        led_cmd_stop(slot);
+        start[i] = slot->fade_data.cur;
+        led->timeline_mask |= 1U << i;
+    }
+
+    led_timeline_cursor_init(&led->timeline, timeline, start);
+    led->timeline_due_us = g_tick_us;
+}
+
+/**
+ * @brief Step the timeline of an instance and apply it to the channels it still drives
+ *
+ * @note  The timeline is released once it is done
+ */
+static void led_timeline_run(iot_light_t *led, uint32_t *updates)
+{
+    uint16_t value[LED_TIMELINE_CHANNEL_MAX];
+    bool running = led_timeline_step(&led->timeline, DUTY_SET_CYCLE, value);
+
+    for (int i = 0; i < LED_TIMELINE_CHANNEL_MAX; i++) {
+        if (!(led->timeline_mask & (1U << i))) {
+            continue;
+        }
+
+        iot_led_slot_t *slot = &g_led_slots[led->slot_map[i]];
+
+        slot->fade_data.cur = slot->fade_data.final = value[i];
+        (void)led_slot_apply(slot, value[i]);
+        (*updates)++;
+    }
+
+    if (!running || led->timeline_mask == 0) {
+        led_timeline_release(led);
+    }
+}
+
+static void led_cmd_run(const led_cmd_t *cmd)
+{
+    if (cmd->type == LED_CMD_TIMELINE) {
+        led_cmd_timeline(cmd->owner, cmd->data);
+        return;
+    }
+
+    iot_led_slot_t *slot = &g_led_slots[cmd->slot];
+
+    /* kênh đã bị xóa hoặc chuyển cho instance khác sau khi lệnh được gửi */
+    if (cmd->owner == NULL || slot->owner != cmd->owner) {
+        return;
+    }
+
+    /* lệnh riêng cho một kênh tách kênh đó khỏi timeline */
+    slot->owner->timeline_mask &= ~(1U << slot->index);
+
+    switch (cmd->type) {
+        case LED_CMD_SET:
+            led_cmd_set(slot, cmd->value, cmd->time_ms);
+            break;
+
+        case LED_CMD_BLINK:
+            led_cmd_blink(slot, cmd->value, cmd->time_ms, cmd->fade_flag);
+            break;
 
-            (void)ledc_apply_duty(g_light_config->speed_mode, ch, gamma_value_to_duty(fd->cur));
+        case LED_CMD_STOP:
+            led_cmd_stop(slot);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* -------------------- shared tick (esp_timer) -------------------- */
+
+/**
+ * @brief Advance a software fade or blink by fd->ticks ticks and apply it
+ *
+ * @return true while the slot has more updates to run
+ */
+static bool led_slot_step(iot_led_slot_t *slot)
+{
+    ledc_fade_data_t *fd = &slot->fade_data;
+
+    if (fd->cycle && fd->step == 0) {
+        /* blink: bật/tắt mỗi half-period */
+        fd->cur = (fd->cur == fd->final) ? 0 : fd->final;
+    } else {
+        fd->num -= MIN(fd->ticks, fd->num);
+
+        if (fd->num != 0) {
+            fd->cur += fd->step * (int)fd->ticks;
+        } else if (fd->cycle) {
+            /* loop-fade: chốt đầu mút của nửa chu kỳ rồi đảo chiều */
+            fd->cur  = (fd->step < 0) ? 0 : fd->final;
+            fd->step = -fd->step;
+            fd->num  = fd->cycle;
         } else {
-            idle_channels++;
+            /* hết fade: chốt target */
+            fd->cur = fd->final;
         }
     }
 
-    if (idle_channels >= LEDC_CHANNEL_MAX) {
-        if (g_timer_started) {
-            esp_timer_stop(g_timer_handle);
-            g_timer_started = false;
+    (void)led_slot_apply(slot, fd->cur);
+    return fd->num > 0 || fd->cycle;
+}
+
+/**
+ * @brief Pick how many ticks the next update of a slot advances, and when it is due
+ *
+ * While the duty moves by less than one LSB per tick, a step spans up to
+ * LED_TICK_SKIP_MAX ticks. A blink sleeps for its whole half period.
+ */
+static void led_slot_schedule(iot_led_slot_t *slot, int64_t last_us)
+{
+    ledc_fade_data_t *fd = &slot->fade_data;
+    size_t ticks = 1;
+
+    if (fd->cycle && fd->step == 0) {
+        ticks = fd->cycle;
+    } else if (fd->step == 0) {
+        /* fade nhỏ hơn một bước: chỉ cần chốt target ở cuối */
+        ticks = fd->num;
+    } else {
+        const uint16_t *duty_table = slot->owner->duty_table;
+        uint32_t duty = gamma_value_to_duty(duty_table, fd->cur);
+
+        /* nhân đôi số tick gộp chừng nào duty chưa đổi được 1 LSB */
+        while (ticks < LED_TICK_SKIP_MAX && ticks < fd->num
+                && gamma_value_to_duty(duty_table, fd->cur + fd->step * (int)ticks) == duty) {
+            ticks <<= 1;
         }
+
+        ticks = MIN(ticks, fd->num);
     }
+
+    fd->ticks  = ticks;
+    fd->due_us = last_us + (int64_t)ticks * LED_TICK_US;
 }
 
-static inline void timer_ensure_running(void)
+static void led_tick_cb(void *arg)
 {
-    if (!g_timer_started && g_timer_handle) {
-        /* chu kỳ tính theo us */
-        esp_timer_start_periodic(g_timer_handle, (uint64_t)DUTY_SET_CYCLE * 1000ULL);
-        g_timer_started = true;
+    (void)arg;
+
+    uint32_t start_cycles = esp_cpu_get_cycle_count();
+    uint32_t updates      = 0;
+    uint32_t visits       = 0;
+    uint32_t cmds         = 0;
+    uint32_t skipped      = 0;
+    uint32_t limited      = 0;
+    int64_t next_us       = INT64_MAX;
+    led_cmd_t cmd;
+
+    xSemaphoreTake(g_led_lock, portMAX_DELAY);
+
+    /* seqlock: số lẻ trong khi tick đang ghi */
+    atomic_fetch_add_explicit(&g_led_seq, 1, memory_order_acq_rel);
+
+    const int64_t now = g_tick_us = esp_timer_get_time();
+
+    /* fade-end trước, vì chúng thuộc về các fade đang chạy trước khi có lệnh mới */
+    uint32_t hw_done = atomic_exchange_explicit(&g_hw_fade_done, 0, memory_order_acquire);
+
+    for (int i = 0; hw_done; i++, hw_done >>= 1) {
+        if (hw_done & 1) {
+            led_hw_fade_next(&g_led_slots[i]);
+        }
+    }
+
+    while (led_cmd_pop(&cmd)) {
+        led_cmd_run(&cmd);
+        cmds++;
+    }
+
+    /* mọi kênh của một timeline được cập nhật trong cùng một tick */
+    for (iot_light_t *led = g_led_list; led; led = led->next) {
+        if (led->timeline.data && led->timeline_due_us - now <= LED_TICK_SLACK_US) {
+            /* tick trễ quá nhiều thì đặt lại nhịp, không chạy bù */
+            led->timeline_due_us = MAX(led->timeline_due_us, now - LED_TICK_SLACK_US) + LED_TICK_US;
+            led_timeline_run(led, &updates);
+        }
+
+        if (led->timeline.data) {
+            next_us = MIN(next_us, led->timeline_due_us);
+        }
+    }
+
+    /* chỉ duyệt các slot đang chạy bằng phần mềm */
+    for (uint32_t active = g_led_active; active; active &= active - 1) {
+        int i = __builtin_ctz(active);
+        iot_led_slot_t *slot = &g_led_slots[i];
+        ledc_fade_data_t *fd = &slot->fade_data;
+
+        visits++;
+
+        if (fd->due_us - now <= LED_TICK_SLACK_US) {
+            updates++;
+
+            if (!led_slot_step(slot)) {
+                g_led_active &= ~(1U << i);
+                continue;
+            }
+
+            led_slot_schedule(slot, MAX(fd->due_us, now - LED_TICK_SLACK_US));
+        }
+
+        next_us = MIN(next_us, fd->due_us);
+    }
+
+    for (iot_light_t *led = g_led_list; led; led = led->next) {
+        if (led->power_dirty) {
+            led->power_dirty = false;
+            limited += led_power_apply(led);
+        }
+    }
+
+    atomic_fetch_add_explicit(&g_led_seq, 1, memory_order_acq_rel);
+
+    /* fade phần cứng không cần tick, nhưng đèn vẫn đang chuyển động */
+    bool busy = next_us != INT64_MAX;
+
+    for (int i = 0; i < LED_SLOT_NUM && !busy; i++) {
+        busy = g_led_slots[i].hw_fade.active;
+    }
+
+    /* ngủ tới cập nhật gần nhất; không còn gì chạy bằng phần mềm thì dừng hẳn */
+    if (next_us != INT64_MAX) {
+        int64_t delay_us = MAX(next_us - now, 0);
+
+        /* các tick DUTY_SET_CYCLE cố định đã được bỏ qua */
+        skipped = (delay_us + LED_TICK_SLACK_US) / LED_TICK_US;
+        skipped = skipped ? skipped - 1 : 0;
+        esp_timer_start_once(g_timer_handle, delay_us);
     }
+
+    xSemaphoreGive(g_led_lock);
+
+    /* gọi ngoài lock, callback có thể chờ (vd. lấy PM lock) */
+    iot_led_activity_cb_t activity_cb = g_activity_cb;
+
+    if (busy != g_led_busy) {
+        g_led_busy = busy;
+
+        if (activity_cb) {
+            activity_cb(busy, g_activity_arg);
+        }
+    }
+
+    g_led_stats.tick_count++;
+    g_led_stats.tick_skipped    += skipped;
+    g_led_stats.power_limited   += limited;
+    g_led_stats.cmd_count       += cmds;
+    g_led_stats.channel_visits  += visits;
+    g_led_stats.channel_updates += updates;
+    g_led_stats.tick_cycles     += (uint32_t)(esp_cpu_get_cycle_count() - start_cycles);
 }
 
-/* -------------------- Public API impl -------------------- */
+/* -------------------- Instance API impl -------------------- */
 
-esp_err_t iot_led_init(ledc_timer_t timer_num, ledc_mode_t speed_mode, uint32_t freq_hz,
-                       ledc_clk_cfg_t clk_cfg, ledc_timer_bit_t duty_resolution)
+esp_err_t iot_led_create(const iot_led_config_t *config, iot_led_handle_t *handle)
 {
+    LIGHT_PARAM_CHECK(config);
+    LIGHT_PARAM_CHECK(handle);
+    LIGHT_PARAM_CHECK(config->speed_mode < LEDC_SPEED_MODE_MAX);
+    LIGHT_PARAM_CHECK(config->duty_resolution > 0 && config->duty_resolution <= LEDC_DUTY_BIT_MAX);
+
     esp_err_t ret;
 
     const ledc_timer_config_t tcfg = {
-        .speed_mode      = speed_mode,
-        .duty_resolution = duty_resolution,   // nên là 13-bit như macro trên
-        .timer_num       = timer_num,
-        .freq_hz         = freq_hz,
-        .clk_cfg         = clk_cfg,
+        .speed_mode      = config->speed_mode,
+        .duty_resolution = config->duty_resolution,
+        .timer_num       = config->timer_num,
+        .freq_hz         = config->freq_hz,
+        .clk_cfg         = config->clk_cfg,
     };
 
     ret = ledc_timer_config(&tcfg);
     LIGHT_ERROR_CHECK(ret != ESP_OK, ret, "LEDC timer config failed");
 
-    if (!g_gamma_table) {
-        g_gamma_table = calloc(GAMMA_TABLE_SIZE, sizeof(uint16_t));
-        if (!g_gamma_table) return ESP_ERR_NO_MEM;
-        gamma_table_create(g_gamma_table, GAMMA_CORRECTION);
-    }
-
-    if (!g_light_config) {
-        g_light_config = calloc(1, sizeof(iot_light_t));
-        if (!g_light_config) return ESP_ERR_NO_MEM;
-        g_light_config->timer_num  = timer_num;
-        g_light_config->speed_mode = speed_mode;
+    if (!g_led_lock) {
+        g_led_lock = xSemaphoreCreateMutex();
+        LIGHT_ERROR_CHECK(g_led_lock == NULL, ESP_ERR_NO_MEM, "xSemaphoreCreateMutex failed");
+        led_cmd_queue_reset();
     }
 
     if (!g_timer_handle) {
@@ -196,136 +957,440 @@ esp_err_t iot_led_init(ledc_timer_t timer_num, ledc_mode_t speed_mode, uint32_t
         LIGHT_ERROR_CHECK(ret != ESP_OK, ret, "esp_timer_create failed");
     }
 
+    iot_light_t *led = calloc(1, sizeof(iot_light_t));
+    LIGHT_ERROR_CHECK(led == NULL, ESP_ERR_NO_MEM, "calloc failed");
+
+    led->timer_num  = config->timer_num;
+    led->speed_mode = config->speed_mode;
+    led->hw_fade    = config->hw_fade;
+    /* RC_FAST chạy cả trong light sleep: đèn giữ nguyên khi chip ngủ */
+    led->sleep_mode = config->clk_cfg == LEDC_USE_RC_FAST_CLK ? LEDC_SLEEP_MODE_KEEP_ALIVE : LEDC_SLEEP_MODE_NO_ALIVE_NO_PD;
+    led->max_duty   = (1U << config->duty_resolution) - 1;
+
+    if (led->hw_fade && !g_fade_installed) {
+        /* ESP_ERR_INVALID_STATE: đã được cài bởi một module khác */
+        ret = ledc_fade_func_install(0);
+        g_fade_installed = (ret == ESP_OK || ret == ESP_ERR_INVALID_STATE);
+
+        if (!g_fade_installed) {
+            ESP_LOGW(TAG, "<%s> ledc_fade_func_install failed, fades use the software tick", esp_err_to_name(ret));
+            led->hw_fade = false;
+        }
+    }
+    memset(led->slot_map, LED_SLOT_NONE, sizeof(led->slot_map));
+
+    if (config->gamma_table) {
+        memcpy(led->gamma_table, config->gamma_table, GAMMA_TABLE_SIZE * sizeof(uint16_t));
+    } else {
+        gamma_table_create(led->gamma_table, GAMMA_CORRECTION);
+    }
+
+    duty_table_create(led->duty_table, led->gamma_table, led->max_duty);
+
+    xSemaphoreTake(g_led_lock, portMAX_DELAY);
+    led->next  = g_led_list;
+    g_led_list = led;
+    g_led_instance_num++;
+    xSemaphoreGive(g_led_lock);
+
+    *handle = led;
     return ESP_OK;
 }
 
-esp_err_t iot_led_deinit(void)
+esp_err_t iot_led_delete(iot_led_handle_t handle)
 {
-    if (g_timer_handle) {
-        if (g_timer_started) {
-            esp_timer_stop(g_timer_handle);
-            g_timer_started = false;
+    LIGHT_PARAM_CHECK(handle);
+    LIGHT_ERROR_CHECK(g_led_lock == NULL, ESP_ERR_INVALID_STATE, "iot_led_create() must be called first");
+
+    xSemaphoreTake(g_led_lock, portMAX_DELAY);
+
+    /**< Once freed, a new instance may get the same address and match them */
+    led_cmd_purge(handle);
+
+    for (int i = 0; i < LED_SLOT_NUM; i++) {
+        if (g_led_slots[i].owner == handle) {
+            led_hw_fade_stop(&g_led_slots[i]);
+            g_led_active &= ~(1U << i);
+            memset(&g_led_slots[i], 0, sizeof(iot_led_slot_t));
         }
-        esp_timer_delete(g_timer_handle);
-        g_timer_handle = NULL;
     }
 
-    if (g_light_config) {
-        free(g_light_config);
-        g_light_config = NULL;
+    for (iot_light_t **led = &g_led_list; *led; led = &(*led)->next) {
+        if (*led == handle) {
+            *led = handle->next;
+            break;
+        }
     }
 
-    if (g_gamma_table) {
-        free(g_gamma_table);
-        g_gamma_table = NULL;
+    led_timeline_release(handle);
+
+    bool last_instance = (--g_led_instance_num == 0);
+
+    if (last_instance && g_timer_handle) {
+        esp_timer_stop(g_timer_handle);
+        esp_timer_delete(g_timer_handle);
+        g_timer_handle = NULL;
     }
 
+    /**< The lock is kept, a tick already dispatched may still be waiting on it */
+    xSemaphoreGive(g_led_lock);
+
+    free(handle);
     return ESP_OK;
 }
 
-esp_err_t iot_led_regist_channel(ledc_channel_t channel, gpio_num_t gpio_num)
+esp_err_t iot_led_add_channel(iot_led_handle_t handle, uint8_t index, ledc_channel_t channel, gpio_num_t gpio_num)
 {
-    LIGHT_ERROR_CHECK(g_light_config == NULL, ESP_ERR_INVALID_ARG, "iot_led_init() must be called first");
+    LIGHT_PARAM_CHECK(handle);
+    LIGHT_PARAM_CHECK(index < LEDC_CHANNEL_MAX);
+    LIGHT_PARAM_CHECK(channel < LEDC_CHANNEL_MAX);
+    LIGHT_ERROR_CHECK(handle->slot_map[index] != LED_SLOT_NONE, ESP_ERR_INVALID_STATE,
+                      "channel index %d is already mapped", index);
 
 #ifdef CONFIG_SPIRAM_SUPPORT
     LIGHT_ERROR_CHECK(gpio_num == GPIO_NUM_16 || gpio_num == GPIO_NUM_17, ESP_ERR_INVALID_ARG,
                       "gpio_num must not conflict with PSRAM (IO16/IO17)");
 #endif
 
+    uint8_t slot_index   = LED_SLOT_INDEX(handle->speed_mode, channel);
+    iot_led_slot_t *slot = &g_led_slots[slot_index];
+    LIGHT_ERROR_CHECK(slot->owner != NULL, ESP_ERR_INVALID_STATE,
+                      "LEDC channel %d is used by another instance", channel);
+
     const ledc_channel_config_t chcfg = {
         .gpio_num   = gpio_num,
         .channel    = channel,
         .intr_type  = LEDC_INTR_DISABLE,
-        .speed_mode = g_light_config->speed_mode,
-        .timer_sel  = g_light_config->timer_num,
+        .speed_mode = handle->speed_mode,
+        .timer_sel  = handle->timer_num,
         .duty       = 0,
         .hpoint     = 0,
+        .sleep_mode = handle->sleep_mode,
         .flags.output_invert = 0,
     };
 
     esp_err_t ret = ledc_channel_config(&chcfg);
     LIGHT_ERROR_CHECK(ret != ESP_OK, ret, "LEDC channel config failed");
+
+    if (handle->hw_fade) {
+        ledc_cbs_t cbs = {
+            .fade_cb = led_hw_fade_end_cb,
+        };
+        ret = ledc_cb_register(handle->speed_mode, channel, &cbs, (void *)(uintptr_t)slot_index);
+        LIGHT_ERROR_CHECK(ret != ESP_OK, ret, "ledc_cb_register failed");
+    }
+
+    xSemaphoreTake(g_led_lock, portMAX_DELAY);
+    memset(&slot->fade_data, 0, sizeof(ledc_fade_data_t));
+    memset(&slot->hw_fade, 0, sizeof(ledc_hw_fade_t));
+    slot->channel = channel;
+    slot->index   = index;
+    slot->owner   = handle;
+    handle->slot_map[index] = slot_index;
+    xSemaphoreGive(g_led_lock);
+
     return ESP_OK;
 }
 
-esp_err_t iot_led_get_channel(ledc_channel_t channel, uint8_t *dst)
+/**
+ * @brief Whether a seqlock read that started at seq overlapped a tick
+ *
+ * @note  The reader then takes g_led_lock once rather than spinning, a tick
+ *        preempted by a higher priority reader would never finish otherwise
+ */
+static inline bool led_seq_retry(unsigned int seq)
 {
-    LIGHT_ERROR_CHECK(g_light_config == NULL, ESP_ERR_INVALID_ARG, "iot_led_init() must be called first");
+    return (seq & 1) || seq != atomic_load_explicit(&g_led_seq, memory_order_relaxed);
+}
+
+esp_err_t iot_led_channel_get(iot_led_handle_t handle, uint8_t index, uint8_t *dst)
+{
+    iot_led_slot_t *slot = led_slot_get(handle, index);
+    LIGHT_ERROR_CHECK(slot == NULL, ESP_ERR_INVALID_ARG, "channel index %d is not mapped", index);
     LIGHT_ERROR_CHECK(dst == NULL, ESP_ERR_INVALID_ARG, "dst is NULL");
-    int cur_q8 = g_light_config->fade_data[channel].cur;
+
+    unsigned int seq = atomic_load_explicit(&g_led_seq, memory_order_acquire);
+    int cur_q8       = slot->hw_fade.active ? led_hw_fade_value(slot) : slot->fade_data.cur;
+    atomic_thread_fence(memory_order_acquire);
+
+    /* tick ghi xen vào giữa: đọc lại dưới lock của tick */
+    if (led_seq_retry(seq)) {
+        xSemaphoreTake(g_led_lock, portMAX_DELAY);
+        cur_q8 = slot->hw_fade.active ? led_hw_fade_value(slot) : slot->fade_data.cur;
+        xSemaphoreGive(g_led_lock);
+    }
+
     if (cur_q8 < 0) cur_q8 = 0;
     if (cur_q8 > (255 << LEDC_FIXED_Q)) cur_q8 = (255 << LEDC_FIXED_Q);
     *dst = (uint8_t)FIXED_2_FLOATING(cur_q8, LEDC_FIXED_Q);
     return ESP_OK;
 }
 
-esp_err_t iot_led_set_channel(ledc_channel_t channel, uint8_t value, uint32_t fade_ms)
+esp_err_t iot_led_channel_set(iot_led_handle_t handle, uint8_t index, uint8_t value, uint32_t fade_ms)
 {
-    LIGHT_ERROR_CHECK(g_light_config == NULL, ESP_ERR_INVALID_ARG, "iot_led_init() must be called first");
+    iot_led_slot_t *slot = led_slot_get(handle, index);
+    LIGHT_ERROR_CHECK(slot == NULL, ESP_ERR_INVALID_ARG, "channel index %d is not mapped", index);
 
-    ledc_fade_data_t *fd = &g_light_config->fade_data[channel];
-    fd->final = FLOATINT_2_FIXED(value, LEDC_FIXED_Q);
+    const led_cmd_t cmd = {
+        .owner   = handle,
+        .time_ms = fade_ms,
+        .type    = LED_CMD_SET,
+        .slot    = handle->slot_map[index],
+        .value   = value,
+    };
 
-    if (fade_ms == 0) {
-        /* set ngay */
-        fd->cur = fd->final;
-        fd->num = 0;
-        fd->step = 0;
-        fd->cycle = 0;
-        return ledc_apply_duty(g_light_config->speed_mode, channel, gamma_value_to_duty(fd->final));
+    /**< A full queue is counted in cmd_dropped, not logged, it happens in bursts */
+    return led_cmd_send(&cmd);
+}
+
+esp_err_t iot_led_channel_start_blink(iot_led_handle_t handle, uint8_t index, uint8_t value,
+                                      uint32_t period_ms, bool fade_flag)
+{
+    iot_led_slot_t *slot = led_slot_get(handle, index);
+    LIGHT_ERROR_CHECK(slot == NULL, ESP_ERR_INVALID_ARG, "channel index %d is not mapped", index);
+
+    const led_cmd_t cmd = {
+        .owner     = handle,
+        .time_ms   = period_ms,
+        .type      = LED_CMD_BLINK,
+        .slot      = handle->slot_map[index],
+        .value     = value,
+        .fade_flag = fade_flag,
+    };
+
+    return led_cmd_send(&cmd);
+}
+
+esp_err_t iot_led_channel_stop_blink(iot_led_handle_t handle, uint8_t index)
+{
+    iot_led_slot_t *slot = led_slot_get(handle, index);
+    LIGHT_ERROR_CHECK(slot == NULL, ESP_ERR_INVALID_ARG, "channel index %d is not mapped", index);
+
+    const led_cmd_t cmd = {
+        .owner = handle,
+        .type  = LED_CMD_STOP,
+        .slot  = handle->slot_map[index],
+    };
+
+    return led_cmd_send(&cmd);
+}
+
+esp_err_t iot_led_channel_set_gamma_table(iot_led_handle_t handle, const uint16_t gamma_table[GAMMA_TABLE_SIZE])
+{
+    LIGHT_PARAM_CHECK(handle);
+    LIGHT_PARAM_CHECK(gamma_table);
+
+    /* tick đọc duty_table, nên đổi bảng trong lock */
+    xSemaphoreTake(g_led_lock, portMAX_DELAY);
+    memcpy(handle->gamma_table, gamma_table, GAMMA_TABLE_SIZE * sizeof(uint16_t));
+    duty_table_create(handle->duty_table, handle->gamma_table, handle->max_duty);
+    xSemaphoreGive(g_led_lock);
+
+    return ESP_OK;
+}
+
+esp_err_t iot_led_set_power_limit(iot_led_handle_t handle, const uint16_t *power_mw, uint8_t channel_num,
+                                  uint32_t budget_mw)
+{
+    LIGHT_PARAM_CHECK(handle);
+    LIGHT_PARAM_CHECK(power_mw || budget_mw == 0);
+    LIGHT_PARAM_CHECK(channel_num <= LEDC_CHANNEL_MAX);
+    LIGHT_PARAM_CHECK(budget_mw <= LED_POWER_BUDGET_MAX);
+
+    xSemaphoreTake(g_led_lock, portMAX_DELAY);
+
+    memset(handle->power_mw, 0, sizeof(handle->power_mw));
+
+    if (power_mw) {
+        memcpy(handle->power_mw, power_mw, channel_num * sizeof(uint16_t));
     }
 
-    /* số tick cần chạy */
-    fd->num = (fade_ms < DUTY_SET_CYCLE) ? 1 : (fade_ms / DUTY_SET_CYCLE);
+    for (int i = 0; i < LEDC_CHANNEL_MAX; i++) {
+        iot_led_slot_t *slot = led_slot_get(handle, i);
 
-    int diff = abs(fd->final - fd->cur);
-    fd->step = (fd->num > 0) ? (diff / (int)fd->num) : diff;
+        if (slot == NULL) {
+            continue;
+        }
 
-    if (fd->final < fd->cur) fd->step = -fd->step;
+        /* fade phần cứng không scale được: dừng tại chỗ, các fade sau chạy bằng tick */
+        if (budget_mw) {
+            led_hw_fade_stop(slot);
+            slot->duty = gamma_value_to_duty(handle->duty_table, slot->fade_data.cur);
+        }
 
-    /* blink loop off khi set trực tiếp */
-    fd->cycle = 0;
+        /* bỏ giới hạn: ghi lại duty chưa scale */
+        if (!budget_mw && handle->power_budget_mw) {
+            (void)ledc_apply_duty(handle->speed_mode, slot->channel, slot->duty);
+        }
+    }
 
-    timer_ensure_running();
+    handle->power_budget_mw = budget_mw;
+    handle->power_dirty     = (budget_mw != 0);
+    xSemaphoreGive(g_led_lock);
+
+    led_tick_kick();
     return ESP_OK;
 }
 
-esp_err_t iot_led_start_blink(ledc_channel_t channel, uint8_t value, uint32_t period_ms, bool fade_flag)
+esp_err_t iot_led_get_power(iot_led_handle_t handle, uint32_t *power_mw)
 {
-    LIGHT_ERROR_CHECK(g_light_config == NULL, ESP_ERR_INVALID_ARG, "iot_led_init() must be called first");
+    LIGHT_PARAM_CHECK(handle);
+    LIGHT_PARAM_CHECK(power_mw);
+    LIGHT_ERROR_CHECK(handle->power_budget_mw == 0, ESP_ERR_INVALID_STATE, "no power limit is set");
 
-    ledc_fade_data_t *fd = &g_light_config->fade_data[channel];
-    fd->final = fd->cur = FLOATINT_2_FIXED(value, LEDC_FIXED_Q);
+    unsigned int seq = atomic_load_explicit(&g_led_seq, memory_order_acquire);
+    uint64_t power   = handle->power;
+    atomic_thread_fence(memory_order_acquire);
 
-    int half_ticks = (period_ms / 2) / DUTY_SET_CYCLE;
-    if (half_ticks <= 0) half_ticks = 1;
-    fd->cycle = half_ticks;
+    if (led_seq_retry(seq)) {
+        xSemaphoreTake(g_led_lock, portMAX_DELAY);
+        power = handle->power;
+        xSemaphoreGive(g_led_lock);
+    }
 
-    if (fade_flag) {
-        fd->num  = half_ticks;
-        fd->step = (fd->num > 0) ? -(fd->cur / fd->num) : 0;
-    } else {
-        fd->num  = 0;
-        fd->step = 0; // blink: bật/tắt tức thời mỗi nửa chu kỳ
+    *power_mw = (uint32_t)(power / handle->max_duty);
+    return ESP_OK;
+}
+
+esp_err_t iot_led_value_to_duty(iot_led_handle_t handle, uint16_t q8_value, uint32_t *duty)
+{
+    LIGHT_PARAM_CHECK(handle);
+    LIGHT_PARAM_CHECK(duty);
+    LIGHT_PARAM_CHECK(q8_value <= (UINT8_MAX << LEDC_FIXED_Q));
+
+    *duty = gamma_value_to_duty(handle->duty_table, q8_value);
+    return ESP_OK;
+}
+
+esp_err_t iot_led_timeline_start(iot_led_handle_t handle, const void *timeline, size_t size)
+{
+    LIGHT_PARAM_CHECK(handle);
+
+    esp_err_t ret = led_timeline_check(timeline, size);
+    LIGHT_ERROR_CHECK(ret != ESP_OK, ret, "");
+
+    /* tick giữ bản sao, người gọi có thể giải phóng timeline ngay */
+    void *data = malloc(size);
+    LIGHT_ERROR_CHECK(data == NULL, ESP_ERR_NO_MEM, "malloc failed");
+    memcpy(data, timeline, size);
+
+    const led_cmd_t cmd = {
+        .owner = handle,
+        .data  = data,
+        .type  = LED_CMD_TIMELINE,
+        .slot  = LED_SLOT_NONE,
+    };
+
+    ret = led_cmd_send(&cmd);
+
+    if (ret != ESP_OK) {
+        free(data);
     }
 
-    timer_ensure_running();
+    return ret;
+}
+
+esp_err_t iot_led_timeline_stop(iot_led_handle_t handle)
+{
+    LIGHT_PARAM_CHECK(handle);
+
+    const led_cmd_t cmd = {
+        .owner = handle,
+        .type  = LED_CMD_TIMELINE,
+        .slot  = LED_SLOT_NONE,
+    };
+
+    return led_cmd_send(&cmd);
+}
+
+esp_err_t iot_led_get_stats(iot_led_stats_t *stats)
+{
+    LIGHT_PARAM_CHECK(stats);
+    *stats = g_led_stats;
+    stats->cmd_dropped = atomic_load(&g_cmd_dropped);
+    stats->hw_wakeups  = atomic_load(&g_hw_wakeups);
     return ESP_OK;
 }
 
-esp_err_t iot_led_stop_blink(ledc_channel_t channel)
+esp_err_t iot_led_reset_stats(void)
 {
-    LIGHT_ERROR_CHECK(g_light_config == NULL, ESP_ERR_INVALID_ARG, "iot_led_init() must be called first");
-    ledc_fade_data_t *fd = &g_light_config->fade_data[channel];
-    fd->cycle = 0;
-    fd->num   = 0;
-    fd->step  = 0;
+    memset(&g_led_stats, 0, sizeof(iot_led_stats_t));
+    atomic_store(&g_cmd_dropped, 0);
+    atomic_store(&g_hw_wakeups, 0);
     return ESP_OK;
 }
 
-esp_err_t iot_led_set_gamma_table(const uint16_t gamma_table[GAMMA_TABLE_SIZE])
+esp_err_t iot_led_set_activity_cb(iot_led_activity_cb_t cb, void *arg)
 {
-    LIGHT_ERROR_CHECK(g_gamma_table == NULL, ESP_ERR_INVALID_ARG, "iot_led_init() must be called first");
-    memcpy(g_gamma_table, gamma_table, GAMMA_TABLE_SIZE * sizeof(uint16_t));
+    g_activity_arg = arg;
+    g_activity_cb  = cb;
     return ESP_OK;
 }
+
+/* -------------------- Single-light API impl -------------------- */
+
+esp_err_t iot_led_init(ledc_timer_t timer_num, ledc_mode_t speed_mode, uint32_t freq_hz,
+                       ledc_clk_cfg_t clk_cfg, ledc_timer_bit_t duty_resolution)
+{
+    if (g_default_led) {
+        return ESP_OK;
+    }
+
+    const iot_led_config_t config = {
+        .timer_num       = timer_num,
+        .speed_mode      = speed_mode,
+        .freq_hz         = freq_hz,
+        .clk_cfg         = clk_cfg,
+        .duty_resolution = duty_resolution,
+        .gamma_table     = NULL,
+        .hw_fade         = false,
+    };
+
+    return iot_led_create(&config, &g_default_led);
+}
+
+esp_err_t iot_led_deinit(void)
+{
+    if (g_default_led) {
+        iot_led_delete(g_default_led);
+        g_default_led = NULL;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t iot_led_regist_channel(ledc_channel_t channel, gpio_num_t gpio_num)
+{
+    LIGHT_ERROR_CHECK(g_default_led == NULL, ESP_ERR_INVALID_ARG, "iot_led_init() must be called first");
+    return iot_led_add_channel(g_default_led, channel, channel, gpio_num);
+}
+
+esp_err_t iot_led_get_channel(ledc_channel_t channel, uint8_t *dst)
+{
+    LIGHT_ERROR_CHECK(g_default_led == NULL, ESP_ERR_INVALID_ARG, "iot_led_init() must be called first");
+    return iot_led_channel_get(g_default_led, channel, dst);
+}
+
+esp_err_t iot_led_set_channel(ledc_channel_t channel, uint8_t value, uint32_t fade_ms)
+{
+    LIGHT_ERROR_CHECK(g_default_led == NULL, ESP_ERR_INVALID_ARG, "iot_led_init() must be called first");
+    return iot_led_channel_set(g_default_led, channel, value, fade_ms);
+}
+
+esp_err_t iot_led_start_blink(ledc_channel_t channel, uint8_t value, uint32_t period_ms, bool fade_flag)
+{
+    LIGHT_ERROR_CHECK(g_default_led == NULL, ESP_ERR_INVALID_ARG, "iot_led_init() must be called first");
+    return iot_led_channel_start_blink(g_default_led, channel, value, period_ms, fade_flag);
+}
+
+esp_err_t iot_led_stop_blink(ledc_channel_t channel)
+{
+    LIGHT_ERROR_CHECK(g_default_led == NULL, ESP_ERR_INVALID_ARG, "iot_led_init() must be called first");
+    return iot_led_channel_stop_blink(g_default_led, channel);
+}
+
+esp_err_t iot_led_set_gamma_table(const uint16_t gamma_table[GAMMA_TABLE_SIZE])
+{
+    LIGHT_ERROR_CHECK(g_default_led == NULL, ESP_ERR_INVALID_ARG, "iot_led_init() must be called first");
+    return iot_led_channel_set_gamma_table(g_default_led, gamma_table);
+}
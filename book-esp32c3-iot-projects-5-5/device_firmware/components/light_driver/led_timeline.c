@@ -0,0 +1,224 @@
+// Copyright 2017 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "iot_led.h"
+#include "led_timeline.h"
+
+#define TIMELINE_MAGIC_0       'L'
+#define TIMELINE_MAGIC_1       'T'
+
+#define TIMELINE_VERSION(t)      ((t)[2])
+#define TIMELINE_CHANNEL_NUM(t)  ((t)[3])
+#define TIMELINE_LOOP_COUNT(t)   ((t)[4])
+#define TIMELINE_KEYFRAME_NUM(t) ((t)[5])
+
+#define EASE_Q                 (16)
+#define EASE_ONE               (1U << EASE_Q)
+
+static const char *TAG = "led_timeline";
+
+static inline const uint8_t *timeline_keyframe(const uint8_t *timeline, uint8_t keyframe)
+{
+    return timeline + LED_TIMELINE_SIZE(TIMELINE_CHANNEL_NUM(timeline), keyframe);
+}
+
+static inline uint16_t keyframe_duration(const uint8_t *keyframe)
+{
+    return keyframe[0] | (keyframe[1] << 8);
+}
+
+/**
+ * @brief Eased progress, Q16, of a segment at elapsed_ms
+ */
+static uint32_t timeline_ease(uint8_t easing, uint32_t elapsed_ms, uint32_t duration_ms)
+{
+    uint32_t p = (uint32_t)(((uint64_t)elapsed_ms << EASE_Q) / duration_ms);
+    uint32_t q = EASE_ONE - p;
+
+    switch (easing) {
+        case LED_EASE_IN:
+            return (p * p) >> EASE_Q;
+
+        case LED_EASE_OUT:
+            /* q có thể bằng EASE_ONE, tích cần 33 bit */
+            return EASE_ONE - (uint32_t)(((uint64_t)q * q) >> EASE_Q);
+
+        case LED_EASE_IN_OUT: {
+            /* 3p^2 - 2p^3 */
+            uint32_t p2 = (p * p) >> EASE_Q;
+            return (3 * p2) - ((2 * ((p2 * p) >> EASE_Q)));
+        }
+
+        case LED_EASE_STEP:
+            return 0;
+
+        default:
+            return p;
+    }
+}
+
+esp_err_t led_timeline_compile(const led_keyframe_t *keyframes, uint8_t keyframe_num, uint8_t channel_num,
+                               uint8_t loop_count, void *buf, size_t *size)
+{
+    LIGHT_PARAM_CHECK(keyframes);
+    LIGHT_PARAM_CHECK(buf);
+    LIGHT_PARAM_CHECK(size);
+    LIGHT_PARAM_CHECK(keyframe_num > 0);
+    LIGHT_PARAM_CHECK(channel_num > 0 && channel_num <= LED_TIMELINE_CHANNEL_MAX);
+    LIGHT_ERROR_CHECK(*size < LED_TIMELINE_SIZE(channel_num, keyframe_num), ESP_ERR_INVALID_SIZE,
+                      "Timeline needs %u bytes", (unsigned)LED_TIMELINE_SIZE(channel_num, keyframe_num));
+
+    uint8_t *p = buf;
+
+    *p++ = TIMELINE_MAGIC_0;
+    *p++ = TIMELINE_MAGIC_1;
+    *p++ = LED_TIMELINE_VERSION;
+    *p++ = channel_num;
+    *p++ = loop_count;
+    *p++ = keyframe_num;
+
+    for (int i = 0; i < keyframe_num; i++) {
+        LIGHT_PARAM_CHECK(keyframes[i].easing < LED_EASE_MAX);
+
+        *p++ = keyframes[i].duration_ms & 0xFF;
+        *p++ = keyframes[i].duration_ms >> 8;
+        *p++ = keyframes[i].easing;
+        memcpy(p, keyframes[i].value, channel_num);
+        p += channel_num;
+    }
+
+    *size = p - (uint8_t *)buf;
+    return led_timeline_check(buf, *size);
+}
+
+size_t led_timeline_size(const void *timeline, size_t size)
+{
+    const uint8_t *t = timeline;
+
+    if (t == NULL || size < LED_TIMELINE_HEADER_SIZE || t[0] != TIMELINE_MAGIC_0 || t[1] != TIMELINE_MAGIC_1) {
+        return 0;
+    }
+
+    return LED_TIMELINE_SIZE(TIMELINE_CHANNEL_NUM(t), TIMELINE_KEYFRAME_NUM(t));
+}
+
+esp_err_t led_timeline_check(const void *timeline, size_t size)
+{
+    const uint8_t *t = timeline;
+    uint32_t total_ms = 0;
+
+    LIGHT_PARAM_CHECK(timeline);
+    LIGHT_ERROR_CHECK(led_timeline_size(t, size) != size, ESP_ERR_INVALID_SIZE,
+                      "Timeline header does not match its size: %u", (unsigned)size);
+    LIGHT_ERROR_CHECK(TIMELINE_VERSION(t) != LED_TIMELINE_VERSION, ESP_ERR_INVALID_VERSION,
+                      "Timeline version: %d", TIMELINE_VERSION(t));
+    LIGHT_PARAM_CHECK(TIMELINE_CHANNEL_NUM(t) > 0 && TIMELINE_CHANNEL_NUM(t) <= LED_TIMELINE_CHANNEL_MAX);
+    LIGHT_PARAM_CHECK(TIMELINE_KEYFRAME_NUM(t) > 0);
+
+    for (int i = 0; i < TIMELINE_KEYFRAME_NUM(t); i++) {
+        const uint8_t *keyframe = timeline_keyframe(t, i);
+
+        LIGHT_PARAM_CHECK(keyframe[2] < LED_EASE_MAX);
+        total_ms += keyframe_duration(keyframe);
+    }
+
+    /**< Would never leave led_timeline_step() */
+    LIGHT_PARAM_CHECK(TIMELINE_LOOP_COUNT(t) != 0 || total_ms > 0);
+
+    return ESP_OK;
+}
+
+uint8_t led_timeline_channel_num(const void *timeline)
+{
+    return TIMELINE_CHANNEL_NUM((const uint8_t *)timeline);
+}
+
+void led_timeline_cursor_init(led_timeline_cursor_t *cursor, const void *timeline, const uint16_t *start)
+{
+    memset(cursor, 0, sizeof(led_timeline_cursor_t));
+    cursor->data = timeline;
+
+    if (start) {
+        memcpy(cursor->from, start, TIMELINE_CHANNEL_NUM(cursor->data) * sizeof(uint16_t));
+    }
+}
+
+bool led_timeline_step(led_timeline_cursor_t *cursor, uint32_t ms, uint16_t *value)
+{
+    const uint8_t *t          = cursor->data;
+    const uint8_t channel_num = TIMELINE_CHANNEL_NUM(t);
+    const uint8_t *keyframe   = timeline_keyframe(t, cursor->keyframe);
+
+    if (!cursor->done) {
+        cursor->elapsed_ms += ms;
+    }
+
+    /* qua hết các segment đã kết thúc trong khoảng ms này */
+    while (!cursor->done && cursor->elapsed_ms >= keyframe_duration(keyframe)) {
+        cursor->elapsed_ms -= keyframe_duration(keyframe);
+
+        for (int i = 0; i < channel_num; i++) {
+            cursor->from[i] = keyframe[3 + i] << 8;
+        }
+
+        if (++cursor->keyframe == TIMELINE_KEYFRAME_NUM(t)) {
+            cursor->loop++;
+            cursor->keyframe = 0;
+            cursor->done = (TIMELINE_LOOP_COUNT(t) != 0 && cursor->loop >= TIMELINE_LOOP_COUNT(t));
+        }
+
+        keyframe = timeline_keyframe(t, cursor->keyframe);
+    }
+
+    if (cursor->done) {
+        memcpy(value, cursor->from, channel_num * sizeof(uint16_t));
+        return false;
+    }
+
+    /* một lần tính easing cho mọi kênh; tiến độ Q15 để diff * ease vừa int32 */
+    int32_t ease = timeline_ease(keyframe[2], cursor->elapsed_ms, keyframe_duration(keyframe)) >> (EASE_Q - 15);
+
+    for (int i = 0; i < channel_num; i++) {
+        int32_t diff = (keyframe[3 + i] << 8) - cursor->from[i];
+        value[i] = cursor->from[i] + ((diff * ease) >> 15);
+    }
+
+    return true;
+}
+
+esp_err_t led_timeline_render(const void *timeline, size_t size, const uint16_t *start,
+                              uint32_t step_ms, uint16_t *trace, size_t step_num)
+{
+    LIGHT_PARAM_CHECK(trace);
+    LIGHT_PARAM_CHECK(step_ms > 0);
+
+    esp_err_t ret = led_timeline_check(timeline, size);
+    LIGHT_ERROR_CHECK(ret != ESP_OK, ret, "");
+
+    led_timeline_cursor_t cursor;
+    const uint8_t channel_num = led_timeline_channel_num(timeline);
+
+    led_timeline_cursor_init(&cursor, timeline, start);
+
+    for (size_t i = 0; i < step_num; i++) {
+        led_timeline_step(&cursor, step_ms, trace + i * channel_num);
+    }
+
+    return ESP_OK;
+}
@@ -0,0 +1,156 @@
+// Copyright 2017 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <sys/param.h>
+
+#include "esp_log.h"
+
+#include "iot_led.h"
+#include "light_color.h"
+
+#define LIGHT_CTB_KNEE       LIGHT_COLOR_FROM_PERCENT(15)
+#define LIGHT_CTB_KNEE_BASE  LIGHT_COLOR_FROM_PERCENT(14)
+#define LIGHT_CTB_KNEE_GAIN  LIGHT_COLOR_FROM_PERCENT(86)
+
+static const char *TAG = "light_color";
+
+/**
+ * @brief a * b / LIGHT_COLOR_MAX, rounded, without a division
+ */
+static inline uint32_t color_mul(uint32_t a, uint32_t b)
+{
+    uint32_t t = a * b + 0x8000;
+    return (t + (t >> 16)) >> 16;
+}
+
+uint16_t light_color_scale(uint16_t component, uint16_t max)
+{
+    return color_mul(component, max);
+}
+
+void light_color_hsv2rgb(const light_hsv_t *hsv, light_rgb_t *rgb)
+{
+    /**
+     * Index of v, p, q, t of each hue sector in red, green, blue order
+     */
+    static const uint8_t sector_map[6][3] = {
+        {0, 3, 1}, {2, 0, 1}, {1, 0, 3}, {1, 2, 0}, {3, 1, 0}, {0, 1, 2},
+    };
+
+    uint32_t hue    = hsv->hue < LIGHT_COLOR_HUE_MAX ? hsv->hue : 0;
+    uint32_t sector = hue / LIGHT_COLOR_HUE_SECTOR;
+    uint32_t f      = (hue % LIGHT_COLOR_HUE_SECTOR) * (LIGHT_COLOR_MAX + 1) / LIGHT_COLOR_HUE_SECTOR;
+    uint32_t s      = hsv->saturation;
+    uint32_t v      = hsv->value;
+
+    const uint16_t level[4] = {
+        v,
+        color_mul(v, LIGHT_COLOR_MAX - s),
+        color_mul(v, LIGHT_COLOR_MAX - color_mul(s, f)),
+        color_mul(v, LIGHT_COLOR_MAX - color_mul(s, LIGHT_COLOR_MAX - f)),
+    };
+
+    rgb->red   = level[sector_map[sector][0]];
+    rgb->green = level[sector_map[sector][1]];
+    rgb->blue  = level[sector_map[sector][2]];
+}
+
+void light_color_rgb2hsv(const light_rgb_t *rgb, light_hsv_t *hsv)
+{
+    int32_t max   = MAX(rgb->red, MAX(rgb->green, rgb->blue));
+    int32_t min   = MIN(rgb->red, MIN(rgb->green, rgb->blue));
+    int32_t delta = max - min;
+
+    hsv->value = max;
+
+    if (delta == 0) {
+        hsv->hue        = 0;
+        hsv->saturation = 0;
+        return;
+    }
+
+    /**< The two remaining divisions, rounded to nearest */
+    hsv->saturation = ((uint32_t)delta * LIGHT_COLOR_MAX + max / 2) / max;
+
+    int32_t base, diff;
+
+    if (rgb->red == max) {
+        base = 0;
+        diff = rgb->green - rgb->blue;
+    } else if (rgb->green == max) {
+        base = 2 * LIGHT_COLOR_HUE_SECTOR;
+        diff = rgb->blue - rgb->red;
+    } else {
+        base = 4 * LIGHT_COLOR_HUE_SECTOR;
+        diff = rgb->red - rgb->green;
+    }
+
+    int32_t offset = diff * LIGHT_COLOR_HUE_SECTOR;
+    int32_t hue    = base + (offset + (offset < 0 ? -delta : delta) / 2) / delta;
+
+    if (hue < 0) {
+        hue += LIGHT_COLOR_HUE_MAX;
+    } else if (hue >= LIGHT_COLOR_HUE_MAX) {
+        hue -= LIGHT_COLOR_HUE_MAX;
+    }
+
+    hsv->hue = hue;
+}
+
+static inline uint16_t light_ctb_knee(uint32_t level)
+{
+    return level < LIGHT_CTB_KNEE ? level : LIGHT_CTB_KNEE_BASE + color_mul(level, LIGHT_CTB_KNEE_GAIN);
+}
+
+void light_color_ctb2wc(const light_ctb_t *ctb, light_wc_t *wc)
+{
+    wc->warm = light_ctb_knee(color_mul(ctb->color_temperature, ctb->brightness));
+    wc->cold = light_ctb_knee(color_mul(LIGHT_COLOR_MAX - ctb->color_temperature, ctb->brightness));
+}
+
+esp_err_t light_color_convert_n(light_color_conversion_t conversion, const void *src, void *dst, size_t n)
+{
+    LIGHT_PARAM_CHECK(src || n == 0);
+    LIGHT_PARAM_CHECK(dst || n == 0);
+    LIGHT_PARAM_CHECK(conversion <= LIGHT_COLOR_CTB2WC);
+
+    switch (conversion) {
+        case LIGHT_COLOR_HSV2RGB:
+            for (size_t i = 0; i < n; i++) {
+                light_color_hsv2rgb((const light_hsv_t *)src + i, (light_rgb_t *)dst + i);
+            }
+
+            break;
+
+        case LIGHT_COLOR_RGB2HSV:
+            for (size_t i = 0; i < n; i++) {
+                light_color_rgb2hsv((const light_rgb_t *)src + i, (light_hsv_t *)dst + i);
+            }
+
+            break;
+
+        case LIGHT_COLOR_CTB2WC:
+            for (size_t i = 0; i < n; i++) {
+                light_color_ctb2wc((const light_ctb_t *)src + i, (light_wc_t *)dst + i);
+            }
+
+            break;
+
+        default:
+            break;
+    }
+
+    return ESP_OK;
+}
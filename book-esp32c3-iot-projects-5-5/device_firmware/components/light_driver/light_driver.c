@@ -15,13 +15,15 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdlib.h>
 
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/timers.h"
 
 #include "light_driver.h"
+#include "light_color.h"
+#include "led_timeline.h"
 #include "app_storage.h"
 
 /**
@@ -52,13 +54,14 @@ enum light_channel {
 
 #define LIGHT_STATUS_STORE_KEY   "light_status"
 #define LIGHT_FADE_PERIOD_MAX_MS (3 * 1000)
+#define LIGHT_HUE_FADE_MS_PER_60 (LIGHT_FADE_PERIOD_MAX_MS * 2 / 6)
+#define LIGHT_EFFECT_SIZE_MAX    (512)
 
 static const char *TAG               = "light_driver";
 static light_status_t g_light_status = {0};
 static bool g_light_blink_flag       = false;
-static TimerHandle_t g_fade_timer    = NULL;
 static int g_fade_mode               = MODE_NONE;
-static uint16_t g_fade_hue           = 0;
+static iot_led_handle_t g_led        = NULL;
 
 esp_err_t light_driver_init(light_driver_config_t *config)
 {
@@ -80,13 +83,47 @@ esp_err_t light_driver_init(light_driver_config_t *config)
         g_light_status.blink_period_ms = config->blink_period_ms;
     }
 
-    iot_led_init(LEDC_TIMER_0, LEDC_LOW_SPEED_MODE, config->freq_hz, config->clk_cfg, config->duty_resolution);
+    const iot_led_config_t led_config = {
+        .timer_num       = config->timer_num,
+        .speed_mode      = LEDC_LOW_SPEED_MODE,
+        .freq_hz         = config->freq_hz,
+        .clk_cfg         = config->clk_cfg,
+        .duty_resolution = config->duty_resolution,
+        .gamma_table     = NULL,
+#ifdef CONFIG_LIGHT_DRIVER_HW_FADE
+        .hw_fade         = true,
+#endif
+    };
+
+    esp_err_t ret = iot_led_create(&led_config, &g_led);
+    LIGHT_ERROR_CHECK(ret != ESP_OK, ret, "iot_led_create, ret: %d", ret);
+
+    const gpio_num_t gpio_map[] = {
+        [CHANNEL_ID_RED]   = config->gpio_red,
+        [CHANNEL_ID_GREEN] = config->gpio_green,
+        [CHANNEL_ID_BLUE]  = config->gpio_blue,
+        [CHANNEL_ID_WARM]  = config->gpio_warm,
+        [CHANNEL_ID_COLD]  = config->gpio_cold,
+    };
+
+    for (int i = 0; i < sizeof(gpio_map) / sizeof(gpio_map[0]); i++) {
+        ret = iot_led_add_channel(g_led, i, config->channel_base + i, gpio_map[i]);
+        LIGHT_ERROR_CHECK(ret != ESP_OK, ret, "iot_led_add_channel, ret: %d", ret);
+    }
+
+#ifdef CONFIG_LIGHT_DRIVER_POWER_LIMIT
+    const uint16_t power_mw[] = {
+        [CHANNEL_ID_RED]   = CONFIG_LIGHT_DRIVER_POWER_RED_MW,
+        [CHANNEL_ID_GREEN] = CONFIG_LIGHT_DRIVER_POWER_GREEN_MW,
+        [CHANNEL_ID_BLUE]  = CONFIG_LIGHT_DRIVER_POWER_BLUE_MW,
+        [CHANNEL_ID_WARM]  = CONFIG_LIGHT_DRIVER_POWER_WARM_MW,
+        [CHANNEL_ID_COLD]  = CONFIG_LIGHT_DRIVER_POWER_COLD_MW,
+    };
 
-    iot_led_regist_channel(CHANNEL_ID_RED, config->gpio_red);
-    iot_led_regist_channel(CHANNEL_ID_GREEN, config->gpio_green);
-    iot_led_regist_channel(CHANNEL_ID_BLUE, config->gpio_blue);
-    iot_led_regist_channel(CHANNEL_ID_WARM, config->gpio_warm);
-    iot_led_regist_channel(CHANNEL_ID_COLD, config->gpio_cold);
+    ret = iot_led_set_power_limit(g_led, power_mw, sizeof(power_mw) / sizeof(power_mw[0]),
+                                  CONFIG_LIGHT_DRIVER_POWER_BUDGET_MW);
+    LIGHT_ERROR_CHECK(ret != ESP_OK, ret, "iot_led_set_power_limit, ret: %d", ret);
+#endif
 
     ESP_LOGD(TAG, "hue: %d, saturation: %d, value: %d",
              g_light_status.hue, g_light_status.saturation, g_light_status.value);
@@ -100,7 +137,10 @@ esp_err_t light_driver_deinit()
 {
     esp_err_t ret = ESP_OK;
 
-    iot_led_deinit();
+    /**< Persist the last state before the driver goes away */
+    app_storage_flush();
+    iot_led_delete(g_led);
+    g_led = NULL;
 
     return ret;
 }
@@ -117,20 +157,20 @@ esp_err_t light_driver_set_rgb(uint8_t red, uint8_t green, uint8_t blue)
 {
     esp_err_t ret = 0;
 
-    ret = iot_led_set_channel(CHANNEL_ID_RED, red, 0);
-    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+    ret = iot_led_channel_set(g_led, CHANNEL_ID_RED, red, 0);
+    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
 
-    ret = iot_led_set_channel(CHANNEL_ID_GREEN, green, 0);
-    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+    ret = iot_led_channel_set(g_led, CHANNEL_ID_GREEN, green, 0);
+    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
 
-    ret = iot_led_set_channel(CHANNEL_ID_BLUE, blue, 0);
-    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+    ret = iot_led_channel_set(g_led, CHANNEL_ID_BLUE, blue, 0);
+    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
 
-    ret = iot_led_set_channel(CHANNEL_ID_WARM, 0, 0);
-    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+    ret = iot_led_channel_set(g_led, CHANNEL_ID_WARM, 0, 0);
+    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
 
-    ret = iot_led_set_channel(CHANNEL_ID_COLD, 0, 0);
-    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+    ret = iot_led_channel_set(g_led, CHANNEL_ID_COLD, 0, 0);
+    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
 
     return ESP_OK;
 }
@@ -138,95 +178,47 @@ esp_err_t light_driver_set_rgb(uint8_t red, uint8_t green, uint8_t blue)
 static esp_err_t light_driver_hsv2rgb(uint16_t hue, uint8_t saturation, uint8_t value,
                                       uint8_t *red, uint8_t *green, uint8_t *blue)
 {
-    hue = hue % 360;
-    uint16_t hi = (hue / 60) % 6;
-    uint16_t F = 100 * hue / 60 - 100 * hi;
-    uint16_t P = value * (100 - saturation) / 100;
-    uint16_t Q = value * (10000 - F * saturation) / 10000;
-    uint16_t T = value * (10000 - saturation * (100 - F)) / 10000;
-
-    switch (hi) {
-        case 0:
-            *red   = value;
-            *green = T;
-            *blue  = P;
-            break;
-
-        case 1:
-            *red   = Q;
-            *green = value;
-            *blue  = P;
-            break;
-
-        case 2:
-            *red   = P;
-            *green = value;
-            *blue  = T;
-            break;
-
-        case 3:
-            *red   = P;
-            *green = Q;
-            *blue  = value;
-            break;
-
-        case 4:
-            *red   = T;
-            *green = P;
-            *blue  = value;
-            break;
-
-        case 5:
-            *red   = value;
-            *green = P;
-            *blue  = Q;
-            break;
-
-        default:
-            return ESP_FAIL;
-    }
+    const light_hsv_t hsv = {
+        .hue        = LIGHT_COLOR_HUE_FROM_DEGREE(hue % 360),
+        .saturation = LIGHT_COLOR_FROM_PERCENT(saturation),
+        .value      = LIGHT_COLOR_FROM_PERCENT(value),
+    };
+    light_rgb_t rgb = {0};
 
-    *red   = *red * 255 / 100;
-    *green = *green * 255 / 100;
-    *blue  = *blue * 255 / 100;
+    light_color_hsv2rgb(&hsv, &rgb);
+
+    *red   = light_color_scale(rgb.red, 255);
+    *green = light_color_scale(rgb.green, 255);
+    *blue  = light_color_scale(rgb.blue, 255);
 
     return ESP_OK;
 }
 
-static void light_driver_rgb2hsv(uint16_t red, uint16_t green, uint16_t blue,
+static void light_driver_rgb2hsv(uint8_t red, uint8_t green, uint8_t blue,
                                  uint16_t *h, uint8_t *s, uint8_t *v)
 {
-    double hue, saturation, value;
-    double m_max = MAX(red, MAX(green, blue));
-    double m_min = MIN(red, MIN(green, blue));
-    double m_delta = m_max - m_min;
+    const light_rgb_t rgb = {red * 257, green * 257, blue * 257};
+    light_hsv_t hsv = {0};
 
-    value = m_max / 255.0;
+    light_color_rgb2hsv(&rgb, &hsv);
 
-    if (m_delta == 0) {
-        hue = 0;
-        saturation = 0;
-    } else {
-        saturation = m_delta / m_max;
+    *h = LIGHT_COLOR_HUE_TO_DEGREE(hsv.hue) % 360;
+    *s = light_color_scale(hsv.saturation, 100);
+    *v = light_color_scale(hsv.value, 100);
+}
 
-        if (red == m_max) {
-            hue = (green - blue) / m_delta;
-        } else if (green == m_max) {
-            hue = 2 + (blue - red) / m_delta;
-        } else {
-            hue = 4 + (red - green) / m_delta;
-        }
+static void light_driver_ctb2wc(uint8_t color_temperature, uint8_t brightness, uint8_t *warm, uint8_t *cold)
+{
+    const light_ctb_t ctb = {
+        .color_temperature = LIGHT_COLOR_FROM_PERCENT(color_temperature),
+        .brightness        = LIGHT_COLOR_FROM_PERCENT(brightness),
+    };
+    light_wc_t wc = {0};
 
-        hue = hue * 60;
+    light_color_ctb2wc(&ctb, &wc);
 
-        if (hue < 0) {
-            hue = hue + 360;
-        }
-    }
-
-    *h = (int)(hue + 0.5);
-    *s = (int)(saturation * 100 + 0.5);
-    *v = (int)(value * 100 + 0.5);
+    *warm = light_color_scale(wc.warm, 255);
+    *cold = light_color_scale(wc.cold, 255);
 }
 
 esp_err_t light_driver_set_hsv(uint16_t hue, uint8_t saturation, uint8_t value)
@@ -245,21 +237,21 @@ esp_err_t light_driver_set_hsv(uint16_t hue, uint8_t saturation, uint8_t value)
 
     ESP_LOGV(TAG, "red: %d, green: %d, blue: %d", red, green, blue);
 
-    ret = iot_led_set_channel(CHANNEL_ID_RED, red, g_light_status.fade_period_ms);
-    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+    ret = iot_led_channel_set(g_led, CHANNEL_ID_RED, red, g_light_status.fade_period_ms);
+    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
 
-    ret = iot_led_set_channel(CHANNEL_ID_GREEN, green, g_light_status.fade_period_ms);
-    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+    ret = iot_led_channel_set(g_led, CHANNEL_ID_GREEN, green, g_light_status.fade_period_ms);
+    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
 
-    ret = iot_led_set_channel(CHANNEL_ID_BLUE, blue, g_light_status.fade_period_ms);
-    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+    ret = iot_led_channel_set(g_led, CHANNEL_ID_BLUE, blue, g_light_status.fade_period_ms);
+    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
 
     if (g_light_status.mode != MODE_HSV) {
-        ret = iot_led_set_channel(CHANNEL_ID_WARM, 0, g_light_status.fade_period_ms);
-        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+        ret = iot_led_channel_set(g_led, CHANNEL_ID_WARM, 0, g_light_status.fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_COLD, 0, g_light_status.fade_period_ms);
-        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+        ret = iot_led_channel_set(g_led, CHANNEL_ID_COLD, 0, g_light_status.fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
     }
 
     g_light_status.mode       = MODE_HSV;
@@ -268,8 +260,8 @@ esp_err_t light_driver_set_hsv(uint16_t hue, uint8_t saturation, uint8_t value)
     g_light_status.value      = value;
     g_light_status.saturation = saturation;
 
-    ret = app_storage_set(LIGHT_STATUS_STORE_KEY, &g_light_status, sizeof(light_status_t));
-    LIGHT_ERROR_CHECK(ret < 0, ret, "app_storage_set, ret: %d", ret);
+    ret = app_storage_set_lazy(LIGHT_STATUS_STORE_KEY, &g_light_status, sizeof(light_status_t));
+    LIGHT_ERROR_CHECK(ret < 0, ret, "app_storage_set_lazy, ret: %d", ret);
 
     return ESP_OK;
 }
@@ -328,28 +320,26 @@ esp_err_t light_driver_set_ctb(uint8_t color_temperature, uint8_t brightness)
     LIGHT_PARAM_CHECK(color_temperature <= 100);
 
     esp_err_t ret = ESP_OK;
-    uint8_t warm_tmp = color_temperature * brightness / 100;
-    uint8_t cold_tmp = (100 - color_temperature) * brightness / 100;
-    warm_tmp         = warm_tmp < 15 ? warm_tmp : 14 + warm_tmp * 86 / 100;
-    cold_tmp         = cold_tmp < 15 ? cold_tmp : 14 + cold_tmp * 86 / 100;
+    uint8_t warm  = 0;
+    uint8_t cold  = 0;
 
-    ret = iot_led_set_channel(CHANNEL_ID_COLD,
-                              cold_tmp * 255 / 100, g_light_status.fade_period_ms);
-    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+    light_driver_ctb2wc(color_temperature, brightness, &warm, &cold);
 
-    ret = iot_led_set_channel(CHANNEL_ID_WARM,
-                              warm_tmp * 255 / 100, g_light_status.fade_period_ms);
-    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+    ret = iot_led_channel_set(g_led, CHANNEL_ID_COLD, cold, g_light_status.fade_period_ms);
+    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
+
+    ret = iot_led_channel_set(g_led, CHANNEL_ID_WARM, warm, g_light_status.fade_period_ms);
+    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
 
     if (g_light_status.mode != MODE_CTB) {
-        ret = iot_led_set_channel(CHANNEL_ID_RED, 0, g_light_status.fade_period_ms);
-        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+        ret = iot_led_channel_set(g_led, CHANNEL_ID_RED, 0, g_light_status.fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_GREEN, 0, g_light_status.fade_period_ms);
-        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+        ret = iot_led_channel_set(g_led, CHANNEL_ID_GREEN, 0, g_light_status.fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_BLUE, 0, g_light_status.fade_period_ms);
-        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+        ret = iot_led_channel_set(g_led, CHANNEL_ID_BLUE, 0, g_light_status.fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
     }
 
     g_light_status.mode              = MODE_CTB;
@@ -357,8 +347,8 @@ esp_err_t light_driver_set_ctb(uint8_t color_temperature, uint8_t brightness)
     g_light_status.brightness        = brightness;
     g_light_status.color_temperature = color_temperature;
 
-    ret = app_storage_set(LIGHT_STATUS_STORE_KEY, &g_light_status, sizeof(light_status_t));
-    LIGHT_ERROR_CHECK(ret < 0, ret, "app_storage_set, ret: %d", ret);
+    ret = app_storage_set_lazy(LIGHT_STATUS_STORE_KEY, &g_light_status, sizeof(light_status_t));
+    LIGHT_ERROR_CHECK(ret < 0, ret, "app_storage_set_lazy, ret: %d", ret);
 
     return ESP_OK;
 }
@@ -400,20 +390,20 @@ esp_err_t light_driver_set_switch(bool on)
     g_light_status.on = on;
 
     if (!g_light_status.on) {
-        ret = iot_led_set_channel(CHANNEL_ID_RED, 0, g_light_status.fade_period_ms);
-        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_set_channel, ret: %d", ret);
+        ret = iot_led_channel_set(g_led, CHANNEL_ID_RED, 0, g_light_status.fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_set, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_GREEN, 0, g_light_status.fade_period_ms);
-        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_set_channel, ret: %d", ret);
+        ret = iot_led_channel_set(g_led, CHANNEL_ID_GREEN, 0, g_light_status.fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_set, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_BLUE, 0, g_light_status.fade_period_ms);
-        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_set_channel, ret: %d", ret);
+        ret = iot_led_channel_set(g_led, CHANNEL_ID_BLUE, 0, g_light_status.fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_set, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_COLD, 0, g_light_status.fade_period_ms);
-        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_set_channel, ret: %d", ret);
+        ret = iot_led_channel_set(g_led, CHANNEL_ID_COLD, 0, g_light_status.fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_set, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_WARM, 0, g_light_status.fade_period_ms);
-        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_set_channel, ret: %d", ret);
+        ret = iot_led_channel_set(g_led, CHANNEL_ID_WARM, 0, g_light_status.fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_set, ret: %d", ret);
 
     } else {
         switch (g_light_status.mode) {
@@ -435,8 +425,8 @@ esp_err_t light_driver_set_switch(bool on)
         }
     }
 
-    ret = app_storage_set(LIGHT_STATUS_STORE_KEY, &g_light_status, sizeof(light_status_t));
-    LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "app_storage_set, ret: %d", ret);
+    ret = app_storage_set_lazy(LIGHT_STATUS_STORE_KEY, &g_light_status, sizeof(light_status_t));
+    LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "app_storage_set_lazy, ret: %d", ret);
 
     return ESP_OK;
 }
@@ -450,15 +440,15 @@ esp_err_t light_driver_breath_start(uint8_t red, uint8_t green, uint8_t blue)
 {
     esp_err_t ret = ESP_OK;
 
-    ret = iot_led_start_blink(CHANNEL_ID_RED,
-                              red, g_light_status.blink_period_ms, true);
-    LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_start_blink, ret: %d", ret);
-    ret = iot_led_start_blink(CHANNEL_ID_GREEN,
-                              green, g_light_status.blink_period_ms, true);
-    LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_start_blink, ret: %d", ret);
-    ret = iot_led_start_blink(CHANNEL_ID_BLUE,
-                              blue, g_light_status.blink_period_ms, true);
-    LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_start_blink, ret: %d", ret);
+    ret = iot_led_channel_start_blink(g_led, CHANNEL_ID_RED,
+                                      red, g_light_status.blink_period_ms, true);
+    LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_start_blink, ret: %d", ret);
+    ret = iot_led_channel_start_blink(g_led, CHANNEL_ID_GREEN,
+                                      green, g_light_status.blink_period_ms, true);
+    LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_start_blink, ret: %d", ret);
+    ret = iot_led_channel_start_blink(g_led, CHANNEL_ID_BLUE,
+                                      blue, g_light_status.blink_period_ms, true);
+    LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_start_blink, ret: %d", ret);
 
     g_light_blink_flag = true;
 
@@ -473,14 +463,14 @@ esp_err_t light_driver_breath_stop()
         return ESP_OK;
     }
 
-    ret = iot_led_stop_blink(CHANNEL_ID_RED);
-    LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_stop_blink, ret: %d", ret);
+    ret = iot_led_channel_stop_blink(g_led, CHANNEL_ID_RED);
+    LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_stop_blink, ret: %d", ret);
 
-    ret = iot_led_stop_blink(CHANNEL_ID_GREEN);
-    LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_stop_blink, ret: %d", ret);
+    ret = iot_led_channel_stop_blink(g_led, CHANNEL_ID_GREEN);
+    LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_stop_blink, ret: %d", ret);
 
-    ret = iot_led_stop_blink(CHANNEL_ID_BLUE);
-    LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_stop_blink, ret: %d", ret);
+    ret = iot_led_channel_stop_blink(g_led, CHANNEL_ID_BLUE);
+    LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_stop_blink, ret: %d", ret);
 
     light_driver_set_switch(true);
 
@@ -502,12 +492,12 @@ esp_err_t light_driver_fade_brightness(uint8_t brightness)
         LIGHT_ERROR_CHECK(ret < 0, ret, "light_driver_hsv2rgb, ret: %d", ret);
 
         if (brightness != 0) {
-            ret = iot_led_get_channel((ledc_channel_t)CHANNEL_ID_RED, &red);
-            LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_get_channel, ret: %d", ret);
-            ret = iot_led_get_channel((ledc_channel_t)CHANNEL_ID_GREEN, &green);
-            LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_get_channel, ret: %d", ret);
-            ret = iot_led_get_channel((ledc_channel_t)CHANNEL_ID_BLUE, &blue);
-            LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_get_channel, ret: %d", ret);
+            ret = iot_led_channel_get(g_led, CHANNEL_ID_RED, &red);
+            LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_get, ret: %d", ret);
+            ret = iot_led_channel_get(g_led, CHANNEL_ID_GREEN, &green);
+            LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_get, ret: %d", ret);
+            ret = iot_led_channel_get(g_led, CHANNEL_ID_BLUE, &blue);
+            LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_get, ret: %d", ret);
 
             uint8_t max_color       = MAX(MAX(red, green), blue);
             uint8_t change_value    = brightness * 255 / 100 - max_color;
@@ -520,14 +510,14 @@ esp_err_t light_driver_fade_brightness(uint8_t brightness)
         g_light_status.value = brightness;
         light_driver_hsv2rgb(g_light_status.hue, g_light_status.saturation, g_light_status.value, &red, &green, &blue);
 
-        ret = iot_led_set_channel(CHANNEL_ID_RED, red, fade_period_ms);
-        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+        ret = iot_led_channel_set(g_led, CHANNEL_ID_RED, red, fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_GREEN, green, fade_period_ms);
-        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+        ret = iot_led_channel_set(g_led, CHANNEL_ID_GREEN, green, fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_BLUE, blue, fade_period_ms);
-        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+        ret = iot_led_channel_set(g_led, CHANNEL_ID_BLUE, blue, fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
 
     } else if (g_light_status.mode == MODE_CTB) {
         uint8_t warm_tmp = 0;
@@ -541,94 +531,69 @@ esp_err_t light_driver_fade_brightness(uint8_t brightness)
             fade_period_ms = LIGHT_FADE_PERIOD_MAX_MS * change_value / 100;
         }
 
-        ret = iot_led_set_channel(CHANNEL_ID_COLD,
+        ret = iot_led_channel_set(g_led, CHANNEL_ID_COLD,
                                   cold_tmp * 255 / 100, fade_period_ms);
-        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_WARM,
+        ret = iot_led_channel_set(g_led, CHANNEL_ID_WARM,
                                   warm_tmp * 255 / 100, fade_period_ms);
-        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
 
         g_light_status.brightness = brightness;
     }
 
-    ret = app_storage_set(LIGHT_STATUS_STORE_KEY, &g_light_status, sizeof(light_status_t));
-    LIGHT_ERROR_CHECK(ret < 0, ret, "app_storage_set, ret: %d", ret);
+    ret = app_storage_set_lazy(LIGHT_STATUS_STORE_KEY, &g_light_status, sizeof(light_status_t));
+    LIGHT_ERROR_CHECK(ret < 0, ret, "app_storage_set_lazy, ret: %d", ret);
 
     return ESP_OK;
 }
 
-static void light_fade_timer_stop()
-{
-    if (!g_fade_timer) {
-        return ;
-    }
-
-    if (!xTimerStop(g_fade_timer, portMAX_DELAY)) {
-        ESP_LOGW(TAG, "xTimerStop timer: %p", g_fade_timer);
-    }
-
-    if (!xTimerDelete(g_fade_timer, portMAX_DELAY)) {
-        ESP_LOGW(TAG, "xTimerDelete timer: %p", g_fade_timer);
-    }
-
-    g_fade_timer = NULL;
-}
-
-// ==== CHANGED: FreeRTOS timer callback signature for IDF 5.x ====
-static void light_fade_timer_cb(TimerHandle_t xTimer)
-{
-    (void)xTimer; // not used
-
-    uint8_t red   = 0;
-    uint8_t green = 0;
-    uint8_t blue  = 0;
-    uint32_t fade_period_ms = LIGHT_FADE_PERIOD_MAX_MS * 2 / 6;
-    int variety = (g_fade_hue > 180) ? 60 : -60;
-
-    if (g_light_status.hue >= 360 || g_light_status.hue <= 0) {
-        light_fade_timer_stop();
-    }
-
-    g_light_status.hue = g_light_status.hue >= 360 ? 360 : g_light_status.hue + variety;
-    g_light_status.hue = g_light_status.hue <= 60 ? 0 : g_light_status.hue + variety;
-
-    light_driver_hsv2rgb(g_light_status.hue, g_light_status.saturation, g_light_status.value, &red, &green, &blue);
-
-    iot_led_set_channel(CHANNEL_ID_RED, red, fade_period_ms);
-    iot_led_set_channel(CHANNEL_ID_GREEN, green, fade_period_ms);
-    iot_led_set_channel(CHANNEL_ID_BLUE, blue, fade_period_ms);
-}
-
 esp_err_t light_driver_fade_hue(uint16_t hue)
 {
     esp_err_t ret = ESP_OK;
     g_fade_mode   = MODE_HSV;
-    g_fade_hue    = hue;
-
-    light_fade_timer_stop();
 
     if (g_light_status.mode != MODE_HSV) {
-        ret = iot_led_set_channel(CHANNEL_ID_WARM, 0, 0);
-        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+        ret = iot_led_channel_set(g_led, CHANNEL_ID_WARM, 0, 0);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_COLD, 0, 0);
-        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+        ret = iot_led_channel_set(g_led, CHANNEL_ID_COLD, 0, 0);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
     }
 
-    g_light_status.mode     = MODE_HSV;
-    g_light_status.value    = (g_light_status.value == 0) ? 100 : g_light_status.value;
-    uint32_t fade_period_ms = LIGHT_FADE_PERIOD_MAX_MS * 2 / 6;
+    g_light_status.mode  = MODE_HSV;
+    g_light_status.value = (g_light_status.value == 0) ? 100 : g_light_status.value;
+
+    /**
+     * Sweep to 360 or 0 with a keyframe on every 60 degree sector boundary, the
+     * red, green and blue channels are linear between them.
+     */
+    led_keyframe_t keyframes[7] = {0};
+    int keyframe_num = 0;
+    int current      = MIN(g_light_status.hue, 360);
+    int end          = (hue > 180) ? 360 : 0;
+
+    do {
+        int next = (end > current) ? (current / 60 + 1) * 60 : ((current + 59) / 60 - 1) * 60;
+        next = (end > current) ? MIN(next, end) : MAX(next, end);
+
+        led_keyframe_t *keyframe = &keyframes[keyframe_num++];
+        keyframe->duration_ms    = LIGHT_HUE_FADE_MS_PER_60 * abs(next - current) / 60;
+        keyframe->easing         = LED_EASE_LINEAR;
+        light_driver_hsv2rgb(next, g_light_status.saturation, g_light_status.value,
+                             &keyframe->value[CHANNEL_ID_RED], &keyframe->value[CHANNEL_ID_GREEN],
+                             &keyframe->value[CHANNEL_ID_BLUE]);
+        current = next;
+    } while (current != end);
+
+    uint8_t timeline[LED_TIMELINE_SIZE(CHANNEL_ID_BLUE + 1, 7)];
+    size_t size = sizeof(timeline);
 
-    light_fade_timer_cb(NULL);
+    ret = led_timeline_compile(keyframes, keyframe_num, CHANNEL_ID_BLUE + 1, 1, timeline, &size);
+    LIGHT_ERROR_CHECK(ret < 0, ret, "led_timeline_compile, ret: %d", ret);
 
-    // ==== CHANGED: use ticks + pdTRUE ====
-    g_fade_timer = xTimerCreate("light_timer",
-                                pdMS_TO_TICKS(fade_period_ms),
-                                pdTRUE,
-                                NULL,
-                                light_fade_timer_cb);
-    xTimerStart(g_fade_timer, 0);
+    ret = iot_led_timeline_start(g_led, timeline, size);
+    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_timeline_start, ret: %d", ret);
 
     return ESP_OK;
 }
@@ -639,29 +604,31 @@ esp_err_t light_driver_fade_warm(uint8_t color_temperature)
     g_fade_mode   = MODE_CTB;
 
     if (g_light_status.mode != MODE_CTB) {
-        ret = iot_led_set_channel(CHANNEL_ID_RED, 0, g_light_status.fade_period_ms);
-        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+        ret = iot_led_channel_set(g_led, CHANNEL_ID_RED, 0, g_light_status.fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_GREEN, 0, g_light_status.fade_period_ms);
-        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+        ret = iot_led_channel_set(g_led, CHANNEL_ID_GREEN, 0, g_light_status.fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_BLUE, 0, g_light_status.fade_period_ms);
-        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+        ret = iot_led_channel_set(g_led, CHANNEL_ID_BLUE, 0, g_light_status.fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
     }
 
-    uint8_t warm_tmp =  color_temperature * g_light_status.brightness / 100;
-    uint8_t cold_tmp = (100 - color_temperature) * g_light_status.brightness / 100;
+    uint8_t warm = 0;
+    uint8_t cold = 0;
 
-    ret = iot_led_set_channel(CHANNEL_ID_COLD, cold_tmp * 255 / 100, LIGHT_FADE_PERIOD_MAX_MS);
-    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+    light_driver_ctb2wc(color_temperature, g_light_status.brightness, &warm, &cold);
 
-    ret = iot_led_set_channel(CHANNEL_ID_WARM, warm_tmp * 255 / 100, LIGHT_FADE_PERIOD_MAX_MS);
-    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+    ret = iot_led_channel_set(g_led, CHANNEL_ID_COLD, cold, LIGHT_FADE_PERIOD_MAX_MS);
+    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
+
+    ret = iot_led_channel_set(g_led, CHANNEL_ID_WARM, warm, LIGHT_FADE_PERIOD_MAX_MS);
+    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_channel_set, ret: %d", ret);
 
     g_light_status.mode              = MODE_CTB;
     g_light_status.color_temperature = color_temperature;
-    ret = app_storage_set(LIGHT_STATUS_STORE_KEY, &g_light_status, sizeof(light_status_t));
-    LIGHT_ERROR_CHECK(ret < 0, ret, "app_storage_set, ret: %d", ret);
+    ret = app_storage_set_lazy(LIGHT_STATUS_STORE_KEY, &g_light_status, sizeof(light_status_t));
+    LIGHT_ERROR_CHECK(ret < 0, ret, "app_storage_set_lazy, ret: %d", ret);
 
     return ESP_OK;
 }
@@ -670,30 +637,31 @@ esp_err_t light_driver_fade_stop()
 {
     esp_err_t ret = ESP_OK;
 
-    light_fade_timer_stop();
+    ret = iot_led_timeline_stop(g_led);
+    LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_timeline_stop, ret: %d", ret);
 
     if (g_light_status.mode != MODE_CTB) {
         uint16_t hue       = 0;
         uint8_t saturation = 0;
         uint8_t value      = 0;
 
-        ret = iot_led_stop_blink(CHANNEL_ID_RED);
-        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_stop_blink, ret: %d", ret);
+        ret = iot_led_channel_stop_blink(g_led, CHANNEL_ID_RED);
+        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_stop_blink, ret: %d", ret);
 
-        ret = iot_led_stop_blink(CHANNEL_ID_GREEN);
-        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_stop_blink, ret: %d", ret);
+        ret = iot_led_channel_stop_blink(g_led, CHANNEL_ID_GREEN);
+        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_stop_blink, ret: %d", ret);
 
-        ret = iot_led_stop_blink(CHANNEL_ID_BLUE);
-        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_stop_blink, ret: %d", ret);
+        ret = iot_led_channel_stop_blink(g_led, CHANNEL_ID_BLUE);
+        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_stop_blink, ret: %d", ret);
 
         uint8_t red, green, blue;
 
-        ret = iot_led_get_channel(CHANNEL_ID_RED, &red);
-        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_get_channel, ret: %d", ret);
-        ret = iot_led_get_channel(CHANNEL_ID_GREEN, &green);
-        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_get_channel, ret: %d", ret);
-        ret = iot_led_get_channel(CHANNEL_ID_BLUE, &blue);
-        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_get_channel, ret: %d", ret);
+        ret = iot_led_channel_get(g_led, CHANNEL_ID_RED, &red);
+        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_get, ret: %d", ret);
+        ret = iot_led_channel_get(g_led, CHANNEL_ID_GREEN, &green);
+        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_get, ret: %d", ret);
+        ret = iot_led_channel_get(g_led, CHANNEL_ID_BLUE, &blue);
+        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_get, ret: %d", ret);
 
         light_driver_rgb2hsv(red, green, blue, &hue, &saturation, &value);
 
@@ -703,21 +671,21 @@ esp_err_t light_driver_fade_stop()
         uint8_t color_temperature = 0;
         uint8_t brightness        = 0;
 
-        ret = iot_led_stop_blink(CHANNEL_ID_COLD);
-        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_stop_blink, ret: %d", ret);
+        ret = iot_led_channel_stop_blink(g_led, CHANNEL_ID_COLD);
+        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_stop_blink, ret: %d", ret);
 
-        ret = iot_led_stop_blink(CHANNEL_ID_WARM);
-        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_stop_blink, ret: %d", ret);
+        ret = iot_led_channel_stop_blink(g_led, CHANNEL_ID_WARM);
+        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_stop_blink, ret: %d", ret);
 
         uint8_t warm_tmp, cold_tmp;
         uint8_t tmp;
 
-        ret = iot_led_get_channel(CHANNEL_ID_WARM, &tmp);
-        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_get_channel, ret: %d", ret);
+        ret = iot_led_channel_get(g_led, CHANNEL_ID_WARM, &tmp);
+        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_get, ret: %d", ret);
         warm_tmp = (int32_t)tmp * 100 / 255;
 
-        ret = iot_led_get_channel(CHANNEL_ID_COLD, &tmp);
-        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_get_channel, ret: %d", ret);
+        ret = iot_led_channel_get(g_led, CHANNEL_ID_COLD, &tmp);
+        LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_channel_get, ret: %d", ret);
         cold_tmp = (int32_t)tmp * 100 / 255;
 
         color_temperature = (!warm_tmp) ? 0 : 100 / (cold_tmp / warm_tmp + 1);
@@ -727,9 +695,58 @@ esp_err_t light_driver_fade_stop()
         g_light_status.color_temperature = (g_fade_mode == MODE_CTB) ? color_temperature : g_light_status.color_temperature;
     }
 
-    ret = app_storage_set(LIGHT_STATUS_STORE_KEY, &g_light_status, sizeof(light_status_t));
-    LIGHT_ERROR_CHECK(ret < 0, ret, "app_storage_set, ret: %d", ret);
+    ret = app_storage_set_lazy(LIGHT_STATUS_STORE_KEY, &g_light_status, sizeof(light_status_t));
+    LIGHT_ERROR_CHECK(ret < 0, ret, "app_storage_set_lazy, ret: %d", ret);
 
     g_fade_mode = MODE_NONE;
     return ESP_OK;
 }
+
+esp_err_t light_driver_effect_start(const void *timeline, size_t size)
+{
+    esp_err_t ret = iot_led_timeline_start(g_led, timeline, size);
+    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_timeline_start, ret: %d", ret);
+
+    return ESP_OK;
+}
+
+esp_err_t light_driver_effect_stop()
+{
+    esp_err_t ret = iot_led_timeline_stop(g_led);
+    LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_timeline_stop, ret: %d", ret);
+
+    return ESP_OK;
+}
+
+esp_err_t light_driver_effect_save(const char *key, const void *timeline, size_t size)
+{
+    LIGHT_PARAM_CHECK(key);
+    LIGHT_PARAM_CHECK(size <= LIGHT_EFFECT_SIZE_MAX);
+
+    esp_err_t ret = led_timeline_check(timeline, size);
+    LIGHT_ERROR_CHECK(ret < 0, ret, "led_timeline_check, ret: %d", ret);
+
+    ret = app_storage_set(key, timeline, size);
+    LIGHT_ERROR_CHECK(ret < 0, ret, "app_storage_set, ret: %d", ret);
+
+    return ESP_OK;
+}
+
+esp_err_t light_driver_effect_play(const char *key)
+{
+    LIGHT_PARAM_CHECK(key);
+
+    uint8_t *timeline = calloc(1, LIGHT_EFFECT_SIZE_MAX);
+    LIGHT_ERROR_CHECK(timeline == NULL, ESP_ERR_NO_MEM, "calloc failed");
+
+    esp_err_t ret = app_storage_get(key, timeline, LIGHT_EFFECT_SIZE_MAX);
+
+    if (ret == ESP_OK) {
+        ret = iot_led_timeline_start(g_led, timeline, led_timeline_size(timeline, LIGHT_EFFECT_SIZE_MAX));
+    }
+
+    free(timeline);
+    LIGHT_ERROR_CHECK(ret < 0, ret, "Play effect, key: %s", key);
+
+    return ESP_OK;
+}
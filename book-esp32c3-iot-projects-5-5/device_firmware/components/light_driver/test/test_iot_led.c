@@ -0,0 +1,635 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stdio.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "unity.h"
+#include "iot_led.h"
+
+static const char *TAG = "IOT_LED TEST";
+
+#define TEST_FADE_MS    1000
+#define TEST_GPIO_NUM   6
+
+#define STRESS_TASK_NUM 4
+#define STRESS_ROUNDS   2000
+
+#define BENCH_CONVERSIONS 100000
+
+#define POWER_CHANNEL_NUM 5
+#define POWER_BUDGET_MW   3000
+
+static const gpio_num_t g_test_gpio[TEST_GPIO_NUM] = {
+    GPIO_NUM_3, GPIO_NUM_4, GPIO_NUM_5, GPIO_NUM_6, GPIO_NUM_7, GPIO_NUM_10,
+};
+
+static iot_led_handle_t test_led_create_res(ledc_timer_t timer_num, bool hw_fade, ledc_timer_bit_t duty_resolution)
+{
+    iot_led_handle_t led = NULL;
+    const iot_led_config_t config = {
+        .timer_num       = timer_num,
+        .speed_mode      = LEDC_LOW_SPEED_MODE,
+        .freq_hz         = 5000,
+        .clk_cfg         = LEDC_AUTO_CLK,
+        .duty_resolution = duty_resolution,
+        .gamma_table     = NULL,
+        .hw_fade         = hw_fade,
+    };
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_create(&config, &led));
+    TEST_ASSERT_NOT_NULL(led);
+    return led;
+}
+
+static iot_led_handle_t test_led_create(ledc_timer_t timer_num, bool hw_fade)
+{
+    return test_led_create_res(timer_num, hw_fade, LEDC_TIMER_13_BIT);
+}
+
+static int test_channel_num(void)
+{
+    return LEDC_CHANNEL_MAX < TEST_GPIO_NUM ? LEDC_CHANNEL_MAX : TEST_GPIO_NUM;
+}
+
+TEST_CASE("iot_led instances own their channels", "[iot_led]")
+{
+    iot_led_handle_t led_a = test_led_create(LEDC_TIMER_0, false);
+    iot_led_handle_t led_b = test_led_create(LEDC_TIMER_1, false);
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_add_channel(led_a, 0, LEDC_CHANNEL_0, g_test_gpio[0]));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_add_channel(led_b, 0, LEDC_CHANNEL_1, g_test_gpio[1]));
+
+    /**< One LEDC channel can only belong to one instance */
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, iot_led_add_channel(led_b, 1, LEDC_CHANNEL_0, g_test_gpio[0]));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, iot_led_add_channel(led_a, 0, LEDC_CHANNEL_2, g_test_gpio[2]));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, iot_led_channel_set(led_a, 1, 255, 0));
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_set(led_a, 0, 200, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_set(led_b, 0, 50, 0));
+    vTaskDelay(pdMS_TO_TICKS(DUTY_SET_CYCLE));
+
+    uint8_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_get(led_a, 0, &value));
+    TEST_ASSERT_EQUAL(200, value);
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_get(led_b, 0, &value));
+    TEST_ASSERT_EQUAL(50, value);
+
+    /**< A deleted instance releases its LEDC channels */
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_delete(led_a));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_add_channel(led_b, 1, LEDC_CHANNEL_0, g_test_gpio[0]));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_delete(led_b));
+}
+
+TEST_CASE("iot_led instances share one tick", "[iot_led]")
+{
+    iot_led_handle_t led_a = test_led_create(LEDC_TIMER_0, false);
+    iot_led_handle_t led_b = test_led_create(LEDC_TIMER_1, false);
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_add_channel(led_a, 0, LEDC_CHANNEL_0, g_test_gpio[0]));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_add_channel(led_b, 0, LEDC_CHANNEL_1, g_test_gpio[1]));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_reset_stats());
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_set(led_a, 0, 255, TEST_FADE_MS));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_set(led_b, 0, 128, TEST_FADE_MS));
+    vTaskDelay(pdMS_TO_TICKS(TEST_FADE_MS + 5 * DUTY_SET_CYCLE));
+
+    uint8_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_get(led_a, 0, &value));
+    TEST_ASSERT_EQUAL(255, value);
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_get(led_b, 0, &value));
+    TEST_ASSERT_EQUAL(128, value);
+
+    /**< Both fades are stepped by the same tick, which stops once they are done */
+    iot_led_stats_t stats = {0};
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_get_stats(&stats));
+    ESP_LOGI(TAG, "ticks: %u, channel updates: %u", (unsigned)stats.tick_count, (unsigned)stats.channel_updates);
+    TEST_ASSERT_UINT32_WITHIN(2, TEST_FADE_MS / DUTY_SET_CYCLE + 1, stats.tick_count);
+    TEST_ASSERT_EQUAL(2 * (TEST_FADE_MS / DUTY_SET_CYCLE), stats.channel_updates);
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_delete(led_a));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_delete(led_b));
+}
+
+TEST_CASE("iot_led tick sleeps until an update is due", "[iot_led]")
+{
+    iot_led_handle_t led = test_led_create_res(LEDC_TIMER_0, false, LEDC_TIMER_8_BIT);
+    iot_led_stats_t stats = {0};
+    uint8_t value = 0;
+    uint32_t duty = 0;
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_add_channel(led, 0, LEDC_CHANNEL_0, g_test_gpio[0]));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_add_channel(led, 1, LEDC_CHANNEL_1, g_test_gpio[1]));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_reset_stats());
+
+    /**< At 8 bits, this fade moves the duty by less than one LSB per tick */
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_set(led, 0, 8, 2 * TEST_FADE_MS));
+    vTaskDelay(pdMS_TO_TICKS(2 * TEST_FADE_MS + 5 * DUTY_SET_CYCLE));
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_get(led, 0, &value));
+    TEST_ASSERT_EQUAL(8, value);
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_value_to_duty(led, 8 << 8, &duty));
+    TEST_ASSERT_EQUAL(duty, ledc_get_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0));
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_get_stats(&stats));
+    printf("slow fade of %d ms: %u ticks, %u skipped\n", 2 * TEST_FADE_MS,
+           (unsigned)stats.tick_count, (unsigned)stats.tick_skipped);
+    TEST_ASSERT_LESS_THAN(TEST_FADE_MS / DUTY_SET_CYCLE / 2, stats.tick_count);
+    TEST_ASSERT_UINT32_WITHIN(2, 2 * TEST_FADE_MS / DUTY_SET_CYCLE + 1, stats.tick_count + stats.tick_skipped);
+
+    /**< A blink wakes the tick once per half period, and only its channel is looked at */
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_reset_stats());
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_start_blink(led, 1, 200, TEST_FADE_MS, false));
+
+    for (int i = 0; i < 3; i++) {
+        vTaskDelay(pdMS_TO_TICKS(i ? TEST_FADE_MS / 2 : TEST_FADE_MS / 4));
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_get(led, 1, &value));
+        TEST_ASSERT_EQUAL((i & 1) ? 200 : 0, value);
+    }
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_get_stats(&stats));
+    TEST_ASSERT_EQUAL(3, stats.tick_count);
+    TEST_ASSERT_EQUAL(stats.tick_count, stats.channel_visits);
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_stop_blink(led, 1));
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_delete(led));
+}
+
+/**
+ * Worst cases for a five-channel light (red, green, blue, warm, cold) whose
+ * budget covers less than all channels at full duty
+ */
+static const uint16_t g_test_power_mw[POWER_CHANNEL_NUM] = {1000, 1000, 1000, 2000, 2000};
+
+static const struct {
+    uint8_t  value[POWER_CHANNEL_NUM];
+    uint32_t fade_ms;
+} g_test_power_steps[] = {
+    {{255, 255, 255,   0,   0}, 500},   /**< White from RGB, still within budget */
+    {{  0,   0,   0, 255, 255}, 500},   /**< HSV to CTB cross-fade */
+    {{255, 255, 255, 255, 255},   0},   /**< Every channel at once */
+    {{  0, 255,   0, 255,   0}, 300},
+    {{ 60,  60,  60,  60,  60}, 200},   /**< Back within budget */
+};
+
+static uint64_t test_power_drawn(void)
+{
+    uint64_t power = 0;
+
+    for (int i = 0; i < POWER_CHANNEL_NUM; i++) {
+        power += (uint32_t)g_test_power_mw[i] * ledc_get_duty(LEDC_LOW_SPEED_MODE, i);
+    }
+
+    return power;
+}
+
+TEST_CASE("iot_led power limit holds through worst-case fades", "[iot_led]")
+{
+    iot_led_handle_t led = test_led_create(LEDC_TIMER_0, true);
+    const uint32_t max_duty = (1 << LEDC_TIMER_13_BIT) - 1;
+    iot_led_stats_t stats = {0};
+    uint32_t power_mw = 0;
+    uint8_t value = 0;
+
+    for (int i = 0; i < POWER_CHANNEL_NUM; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_add_channel(led, i, i, g_test_gpio[i]));
+    }
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, iot_led_get_power(led, &power_mw));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_set_power_limit(led, g_test_power_mw, POWER_CHANNEL_NUM, POWER_BUDGET_MW));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_reset_stats());
+
+    for (int s = 0; s < sizeof(g_test_power_steps) / sizeof(g_test_power_steps[0]); s++) {
+        for (int i = 0; i < POWER_CHANNEL_NUM; i++) {
+            TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_set(led, i, g_test_power_steps[s].value[i],
+                                                          g_test_power_steps[s].fade_ms));
+        }
+
+        /**< Sample between the ticks, the limit must hold at any time */
+        for (int t = 0; t < g_test_power_steps[s].fade_ms + 5 * DUTY_SET_CYCLE; t += DUTY_SET_CYCLE / 2) {
+            TEST_ASSERT_TRUE(test_power_drawn() <= (uint64_t)POWER_BUDGET_MW * max_duty);
+            vTaskDelay(pdMS_TO_TICKS(DUTY_SET_CYCLE / 2));
+        }
+
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_get_power(led, &power_mw));
+        TEST_ASSERT_EQUAL(test_power_drawn() / max_duty, power_mw);
+
+        /**< The limit scales the output only */
+        for (int i = 0; i < POWER_CHANNEL_NUM; i++) {
+            TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_get(led, i, &value));
+            TEST_ASSERT_EQUAL(g_test_power_steps[s].value[i], value);
+        }
+    }
+
+    /**< Within budget the duties are not touched */
+    for (int i = 0; i < POWER_CHANNEL_NUM; i++) {
+        uint32_t duty = 0;
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_value_to_duty(led, 60 << 8, &duty));
+        TEST_ASSERT_EQUAL(duty, ledc_get_duty(LEDC_LOW_SPEED_MODE, i));
+    }
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_get_stats(&stats));
+    printf("power limited in %u ticks, %u channel updates\n", (unsigned)stats.power_limited,
+           (unsigned)stats.channel_updates);
+    TEST_ASSERT_GREATER_THAN(0, stats.power_limited);
+    TEST_ASSERT_EQUAL(0, stats.hw_fades);
+
+    /**< Removing the limit restores the full duties */
+    for (int i = 0; i < POWER_CHANNEL_NUM; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_set(led, i, 255, 0));
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(DUTY_SET_CYCLE));
+    TEST_ASSERT_NOT_EQUAL(max_duty, ledc_get_duty(LEDC_LOW_SPEED_MODE, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_set_power_limit(led, NULL, 0, 0));
+
+    for (int i = 0; i < POWER_CHANNEL_NUM; i++) {
+        TEST_ASSERT_EQUAL(max_duty, ledc_get_duty(LEDC_LOW_SPEED_MODE, i));
+    }
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_delete(led));
+}
+
+TEST_CASE("iot_led tick cost per active channel", "[iot_led][bench]")
+{
+    iot_led_handle_t led = test_led_create(LEDC_TIMER_0, false);
+
+    for (int i = 0; i < test_channel_num(); i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_add_channel(led, i, i, g_test_gpio[i]));
+    }
+
+    for (int active = 1; active <= test_channel_num(); active++) {
+        iot_led_stats_t stats = {0};
+        iot_led_reset_stats();
+
+        for (int i = 0; i < active; i++) {
+            TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_set(led, i, 0, 0));
+            TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_set(led, i, 255, TEST_FADE_MS));
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(TEST_FADE_MS + 5 * DUTY_SET_CYCLE));
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_get_stats(&stats));
+        TEST_ASSERT_EQUAL(active * (TEST_FADE_MS / DUTY_SET_CYCLE), stats.channel_updates);
+
+        uint32_t per_tick = (uint32_t)(stats.tick_cycles / stats.tick_count);
+        printf("%d active channel(s): %4u ticks, %6u cycles per tick, %6u cycles per channel\n",
+               active, (unsigned)stats.tick_count, (unsigned)per_tick, (unsigned)(per_tick / active));
+    }
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_delete(led));
+}
+
+TEST_CASE("iot_led duty follows the timer resolution", "[iot_led]")
+{
+    const ledc_timer_bit_t resolutions[] = {LEDC_TIMER_8_BIT, LEDC_TIMER_11_BIT, LEDC_TIMER_13_BIT};
+
+    for (int r = 0; r < sizeof(resolutions) / sizeof(resolutions[0]); r++) {
+        iot_led_handle_t led = test_led_create_res(LEDC_TIMER_0, false, resolutions[r]);
+        uint32_t max_duty = (1U << resolutions[r]) - 1;
+        uint32_t duty = 0, last = 0;
+
+        /**< Every Q8 step of 0..255 maps monotonically onto 0..max duty */
+        for (uint32_t q8_value = 0; q8_value <= (255 << 8); q8_value++) {
+            TEST_ASSERT_EQUAL(ESP_OK, iot_led_value_to_duty(led, q8_value, &duty));
+            TEST_ASSERT_GREATER_OR_EQUAL(last, duty);
+            last = duty;
+        }
+
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_value_to_duty(led, 0, &duty));
+        TEST_ASSERT_EQUAL(0, duty);
+        TEST_ASSERT_EQUAL(max_duty, last);
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, iot_led_value_to_duty(led, (255 << 8) + 1, &duty));
+
+        /**< Full on drives the channel at the full duty of its timer */
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_add_channel(led, 0, LEDC_CHANNEL_0, g_test_gpio[0]));
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_set(led, 0, 255, 0));
+        vTaskDelay(pdMS_TO_TICKS(DUTY_SET_CYCLE));
+        TEST_ASSERT_EQUAL(max_duty, ledc_get_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0));
+
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_delete(led));
+    }
+}
+
+TEST_CASE("iot_led value to duty conversion cost", "[iot_led][bench]")
+{
+    iot_led_handle_t led = test_led_create(LEDC_TIMER_0, false);
+    uint32_t duty = 0, sum = 0;
+    uint32_t r = 1;
+
+    uint32_t start = esp_cpu_get_cycle_count();
+
+    for (int i = 0; i < BENCH_CONVERSIONS; i++) {
+        r = r * 1103515245 + 12345;
+        iot_led_value_to_duty(led, (r >> 8) % ((255 << 8) + 1), &duty);
+        sum += duty;
+    }
+
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+    printf("%d conversions in %u cycles, %u cycles per conversion (checksum %u)\n", BENCH_CONVERSIONS,
+           (unsigned)cycles, (unsigned)(cycles / BENCH_CONVERSIONS), (unsigned)sum);
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_delete(led));
+}
+
+TEST_CASE("iot_led hardware fade follows the gamma curve", "[iot_led]")
+{
+    iot_led_handle_t led = test_led_create(LEDC_TIMER_0, true);
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_add_channel(led, 0, LEDC_CHANNEL_0, g_test_gpio[0]));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_set(led, 0, 0, 0));
+    vTaskDelay(pdMS_TO_TICKS(DUTY_SET_CYCLE));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_reset_stats());
+
+    uint8_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_set(led, 0, 255, TEST_FADE_MS));
+    vTaskDelay(pdMS_TO_TICKS(TEST_FADE_MS / 2));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_get(led, 0, &value));
+    TEST_ASSERT_UINT32_WITHIN(8, 128, value);
+
+    vTaskDelay(pdMS_TO_TICKS(TEST_FADE_MS / 2 + 5 * DUTY_SET_CYCLE));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_get(led, 0, &value));
+    TEST_ASSERT_EQUAL(255, value);
+    TEST_ASSERT_EQUAL((1 << LEDC_TIMER_13_BIT) - 1, ledc_get_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0));
+
+    /**< The tick only ran to start the fade and each of its segments */
+    iot_led_stats_t stats = {0};
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_get_stats(&stats));
+    TEST_ASSERT_EQUAL(0, stats.channel_updates);
+    TEST_ASSERT_EQUAL(1, stats.hw_fades);
+    TEST_ASSERT_LESS_OR_EQUAL(stats.hw_wakeups + 1, stats.tick_count);
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_delete(led));
+}
+
+TEST_CASE("iot_led CPU wakeups per fade", "[iot_led][bench]")
+{
+    for (int hw_fade = 0; hw_fade <= 1; hw_fade++) {
+        iot_led_handle_t led = test_led_create(LEDC_TIMER_0, hw_fade);
+        iot_led_stats_t stats = {0};
+
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_add_channel(led, 0, LEDC_CHANNEL_0, g_test_gpio[0]));
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_set(led, 0, 0, 0));
+        vTaskDelay(pdMS_TO_TICKS(DUTY_SET_CYCLE));
+        iot_led_reset_stats();
+
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_set(led, 0, 255, TEST_FADE_MS));
+        vTaskDelay(pdMS_TO_TICKS(TEST_FADE_MS + 5 * DUTY_SET_CYCLE));
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_get_stats(&stats));
+
+        /**< A segment end wakes the CPU once, for the interrupt and the tick it kicks */
+        uint32_t fades   = stats.sw_fades + stats.hw_fades;
+        uint32_t wakeups = hw_fade ? stats.hw_wakeups : stats.tick_count;
+        TEST_ASSERT_EQUAL(1, fades);
+        printf("%s fade of %d ms: %3u CPU wakeups\n", hw_fade ? "hardware" : "software",
+               TEST_FADE_MS, (unsigned)(wakeups / fades));
+
+        if (hw_fade) {
+            TEST_ASSERT_LESS_THAN(TEST_FADE_MS / DUTY_SET_CYCLE / 4, wakeups);
+        }
+
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_delete(led));
+    }
+}
+
+typedef struct {
+    int      count;
+    bool     active[4];
+    int64_t  time_us[4];
+} activity_log_t;
+
+static void activity_cb(bool active, void *arg)
+{
+    activity_log_t *log = (activity_log_t *)arg;
+
+    if (log->count < 4) {
+        log->active[log->count]  = active;
+        log->time_us[log->count] = esp_timer_get_time();
+    }
+
+    log->count++;
+}
+
+TEST_CASE("iot_led activity callback brackets the fades", "[iot_led]")
+{
+    for (int hw_fade = 0; hw_fade <= 1; hw_fade++) {
+        iot_led_handle_t led = test_led_create(LEDC_TIMER_0, hw_fade);
+        activity_log_t log = {0};
+
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_add_channel(led, 0, LEDC_CHANNEL_0, g_test_gpio[0]));
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_add_channel(led, 1, LEDC_CHANNEL_1, g_test_gpio[1]));
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_set_activity_cb(activity_cb, &log));
+
+        /**< A set without fade leaves the LEDs static */
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_set(led, 0, 0, 0));
+        vTaskDelay(pdMS_TO_TICKS(DUTY_SET_CYCLE));
+        TEST_ASSERT_EQUAL(0, log.count);
+
+        /**< Two overlapping fades are one period of activity */
+        int64_t start_us = esp_timer_get_time();
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_set(led, 0, 255, TEST_FADE_MS));
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_set(led, 1, 255, TEST_FADE_MS / 2));
+        vTaskDelay(pdMS_TO_TICKS(TEST_FADE_MS + 5 * DUTY_SET_CYCLE));
+
+        TEST_ASSERT_EQUAL(2, log.count);
+        TEST_ASSERT_TRUE(log.active[0]);
+        TEST_ASSERT_FALSE(log.active[1]);
+        TEST_ASSERT_LESS_THAN(DUTY_SET_CYCLE * 1000, log.time_us[0] - start_us);
+        TEST_ASSERT_INT64_WITHIN(3 * DUTY_SET_CYCLE * 1000, TEST_FADE_MS * 1000, log.time_us[1] - start_us);
+
+        /**< A blink keeps them moving until it stops */
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_start_blink(led, 1, 200, TEST_FADE_MS / 4, false));
+        vTaskDelay(pdMS_TO_TICKS(TEST_FADE_MS));
+        TEST_ASSERT_EQUAL(3, log.count);
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_stop_blink(led, 1));
+        vTaskDelay(pdMS_TO_TICKS(5 * DUTY_SET_CYCLE));
+        TEST_ASSERT_EQUAL(4, log.count);
+        TEST_ASSERT_FALSE(log.active[3]);
+
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_set_activity_cb(NULL, NULL));
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_delete(led));
+    }
+}
+
+typedef struct {
+    SemaphoreHandle_t entered;
+    SemaphoreHandle_t release;
+} tick_hold_t;
+
+static void tick_hold_cb(bool active, void *arg)
+{
+    tick_hold_t *hold = (tick_hold_t *)arg;
+
+    if (active) {
+        xSemaphoreGive(hold->entered);
+        xSemaphoreTake(hold->release, portMAX_DELAY);
+    }
+}
+
+TEST_CASE("iot_led delete drops the commands the instance left queued", "[iot_led]")
+{
+    /**< led_b keeps the tick alive while led_a is deleted */
+    iot_led_handle_t led_b = test_led_create(LEDC_TIMER_1, false);
+    iot_led_handle_t led_a = test_led_create(LEDC_TIMER_0, false);
+    tick_hold_t hold = {
+        .entered = xSemaphoreCreateBinary(),
+        .release = xSemaphoreCreateBinary(),
+    };
+    uint8_t value = 0;
+
+    TEST_ASSERT_NOT_NULL(hold.entered);
+    TEST_ASSERT_NOT_NULL(hold.release);
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_add_channel(led_a, 0, LEDC_CHANNEL_0, g_test_gpio[0]));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_set_activity_cb(tick_hold_cb, &hold));
+
+    /**< Hold the tick in the activity callback, outside its lock, so the next commands stay queued */
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_set(led_a, 0, 255, TEST_FADE_MS));
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(hold.entered, portMAX_DELAY));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_set(led_a, 0, 77, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_delete(led_a));
+
+    /**< The allocator usually hands the memory of led_a to led_c */
+    iot_led_handle_t led_c = test_led_create(LEDC_TIMER_0, false);
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_add_channel(led_c, 0, LEDC_CHANNEL_0, g_test_gpio[0]));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_set_activity_cb(NULL, NULL));
+    xSemaphoreGive(hold.release);
+    vTaskDelay(pdMS_TO_TICKS(5 * DUTY_SET_CYCLE));
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_get(led_c, 0, &value));
+    TEST_ASSERT_EQUAL(0, value);
+    TEST_ASSERT_EQUAL(0, ledc_get_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0));
+
+    vSemaphoreDelete(hold.entered);
+    vSemaphoreDelete(hold.release);
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_delete(led_c));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_delete(led_b));
+}
+
+typedef struct {
+    iot_led_handle_t  led;
+    uint32_t          seed;
+    uint32_t          sent;      /**< Commands accepted by the queue */
+    uint32_t          dropped;   /**< Commands rejected with ESP_ERR_NO_MEM */
+    uint32_t          errors;    /**< Any other result */
+    SemaphoreHandle_t done;
+} stress_arg_t;
+
+static void stress_task(void *arg)
+{
+    stress_arg_t *stress = (stress_arg_t *)arg;
+    uint32_t r = stress->seed;
+
+    for (int i = 0; i < STRESS_ROUNDS; i++) {
+        r = r * 1103515245 + 12345;
+
+        uint8_t index = (r >> 8) % test_channel_num();
+        uint8_t value = r >> 16;
+        esp_err_t ret;
+
+        switch ((r >> 24) % 3) {
+            case 0:
+                ret = iot_led_channel_set(stress->led, index, value, (r >> 4) % 200);
+                break;
+
+            case 1:
+                ret = iot_led_channel_start_blink(stress->led, index, value, 100 + (r >> 4) % 400, r & 1);
+                break;
+
+            default:
+                ret = iot_led_channel_stop_blink(stress->led, index);
+                break;
+        }
+
+        if (ret == ESP_OK) {
+            stress->sent++;
+        } else if (ret == ESP_ERR_NO_MEM) {
+            stress->dropped++;
+        } else {
+            stress->errors++;
+        }
+
+        if ((i & 15) == 0) {
+            vTaskDelay(1);
+        }
+    }
+
+    xSemaphoreGive(stress->done);
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("iot_led commands from several tasks are neither lost nor torn", "[iot_led]")
+{
+    for (int hw_fade = 0; hw_fade <= 1; hw_fade++) {
+        iot_led_handle_t led = test_led_create(LEDC_TIMER_0, hw_fade);
+        stress_arg_t stress[STRESS_TASK_NUM] = {0};
+        SemaphoreHandle_t done = xSemaphoreCreateCounting(STRESS_TASK_NUM, 0);
+        TEST_ASSERT_NOT_NULL(done);
+
+        for (int i = 0; i < test_channel_num(); i++) {
+            TEST_ASSERT_EQUAL(ESP_OK, iot_led_add_channel(led, i, i, g_test_gpio[i]));
+        }
+
+        iot_led_reset_stats();
+
+        for (int i = 0; i < STRESS_TASK_NUM; i++) {
+            stress[i].led  = led;
+            stress[i].seed = 0x9E3779B9U * (i + 1);
+            stress[i].done = done;
+            TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(stress_task, "led_stress", 3072, &stress[i], 5, NULL));
+        }
+
+        for (int i = 0; i < STRESS_TASK_NUM; i++) {
+            xSemaphoreTake(done, portMAX_DELAY);
+        }
+
+        /**< Let the tick drain the queue, then settle every channel on off or full on */
+        vTaskDelay(pdMS_TO_TICKS(DUTY_SET_CYCLE));
+
+        for (int i = 0; i < test_channel_num(); i++) {
+            TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_stop_blink(led, i));
+            TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_set(led, i, (i & 1) ? 255 : 0, 100));
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(400));
+
+        iot_led_stats_t stats = {0};
+        uint32_t sent = 0, dropped = 0;
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_get_stats(&stats));
+
+        for (int i = 0; i < STRESS_TASK_NUM; i++) {
+            TEST_ASSERT_EQUAL(0, stress[i].errors);
+            sent    += stress[i].sent;
+            dropped += stress[i].dropped;
+        }
+
+        printf("%s: %u commands run, %u dropped as queue full\n", hw_fade ? "hardware fade" : "software fade",
+               (unsigned)stats.cmd_count, (unsigned)stats.cmd_dropped);
+
+        /**< Every accepted command ran exactly once */
+        TEST_ASSERT_EQUAL(sent + 2 * test_channel_num(), stats.cmd_count);
+        TEST_ASSERT_EQUAL(dropped, stats.cmd_dropped);
+
+        for (int i = 0; i < test_channel_num(); i++) {
+            uint8_t value = 0;
+            TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_get(led, i, &value));
+            TEST_ASSERT_EQUAL((i & 1) ? 255 : 0, value);
+            TEST_ASSERT_EQUAL((i & 1) ? (1 << LEDC_TIMER_13_BIT) - 1 : 0, ledc_get_duty(LEDC_LOW_SPEED_MODE, i));
+        }
+
+        vSemaphoreDelete(done);
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_delete(led));
+    }
+}
@@ -0,0 +1,204 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stdio.h"
+#include "string.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "unity.h"
+#include "iot_led.h"
+#include "led_timeline.h"
+
+#define TEST_CHANNEL_NUM  3
+#define TEST_STEP_NUM     100
+
+static const gpio_num_t g_test_gpio[TEST_CHANNEL_NUM] = {GPIO_NUM_3, GPIO_NUM_4, GPIO_NUM_5};
+
+/**
+ * Jump to red off and green on, ramp red up and green down in 1 s, hold for
+ * 200 ms, then jump back to the start: 1.2 s per pass.
+ */
+static const led_keyframe_t g_test_keyframes[] = {
+    {.duration_ms = 0,    .easing = LED_EASE_STEP,   .value = {0, 255, 0}},
+    {.duration_ms = 1000, .easing = LED_EASE_LINEAR, .value = {255, 0, 0}},
+    {.duration_ms = 200,  .easing = LED_EASE_STEP,   .value = {255, 0, 0}},
+};
+
+static const led_keyframe_t g_test_ease[] = {
+    {.duration_ms = 1000, .easing = LED_EASE_IN_OUT, .value = {255, 255, 255}},
+};
+
+static size_t test_timeline_compile(const led_keyframe_t *keyframes, uint8_t keyframe_num,
+                                    uint8_t loop_count, uint8_t *buf, size_t size)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, led_timeline_compile(keyframes, keyframe_num, TEST_CHANNEL_NUM, loop_count, buf, &size));
+    TEST_ASSERT_EQUAL(LED_TIMELINE_SIZE(TEST_CHANNEL_NUM, keyframe_num), size);
+    return size;
+}
+
+static iot_led_handle_t test_led_create(void)
+{
+    iot_led_handle_t led = NULL;
+    const iot_led_config_t config = {
+        .timer_num       = LEDC_TIMER_0,
+        .speed_mode      = LEDC_LOW_SPEED_MODE,
+        .freq_hz         = 5000,
+        .clk_cfg         = LEDC_AUTO_CLK,
+        .duty_resolution = LEDC_TIMER_13_BIT,
+    };
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_create(&config, &led));
+
+    for (int i = 0; i < TEST_CHANNEL_NUM; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, iot_led_add_channel(led, i, i, g_test_gpio[i]));
+    }
+
+    return led;
+}
+
+TEST_CASE("led_timeline compiled form is checked", "[led_timeline]")
+{
+    uint8_t timeline[LED_TIMELINE_SIZE(TEST_CHANNEL_NUM, 3)];
+    size_t size = test_timeline_compile(g_test_keyframes, 3, 2, timeline, sizeof(timeline));
+    size_t small = size - 1;
+
+    TEST_ASSERT_EQUAL(ESP_OK, led_timeline_check(timeline, size));
+    TEST_ASSERT_EQUAL(size, led_timeline_size(timeline, size));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, led_timeline_check(timeline, size - 1));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE,
+                      led_timeline_compile(g_test_keyframes, 3, TEST_CHANNEL_NUM, 2, timeline, &small));
+
+    /**< A timeline looping forever must take some time */
+    const led_keyframe_t instant = {.duration_ms = 0};
+    size = sizeof(timeline);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, led_timeline_compile(&instant, 1, TEST_CHANNEL_NUM, 0, timeline, &size));
+
+    size = test_timeline_compile(g_test_keyframes, 3, 2, timeline, sizeof(timeline));
+    timeline[2] = LED_TIMELINE_VERSION + 1;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_VERSION, led_timeline_check(timeline, size));
+    timeline[2] = LED_TIMELINE_VERSION;
+    timeline[LED_TIMELINE_HEADER_SIZE + 2] = LED_EASE_MAX;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, led_timeline_check(timeline, size));
+}
+
+TEST_CASE("led_timeline simulator renders keyframes, easing and loops", "[led_timeline]")
+{
+    uint8_t timeline[LED_TIMELINE_SIZE(TEST_CHANNEL_NUM, 3)];
+    static uint16_t trace[TEST_STEP_NUM * 2][TEST_CHANNEL_NUM];
+    size_t size = test_timeline_compile(g_test_keyframes, 3, 2, timeline, sizeof(timeline));
+
+    TEST_ASSERT_EQUAL(ESP_OK, led_timeline_render(timeline, size, NULL, DUTY_SET_CYCLE, trace[0], TEST_STEP_NUM * 2));
+
+    /**< Row i is the value after (i + 1) ticks, the pass lasts 60 ticks */
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < 50; i++) {
+            uint16_t *row = trace[pass * 60 + i];
+            TEST_ASSERT_UINT32_WITHIN(2, (255 << 8) * (i + 1) / 50, row[0]);
+            TEST_ASSERT_UINT32_WITHIN(1, (255 << 8) - row[0], row[1]);
+            TEST_ASSERT_EQUAL(0, row[2]);
+        }
+
+        for (int i = 50; i < 59; i++) {
+            TEST_ASSERT_EQUAL(255 << 8, trace[pass * 60 + i][0]);
+        }
+    }
+
+    /**< After the last pass the channels hold the last keyframe */
+    for (int i = 120; i < TEST_STEP_NUM * 2; i++) {
+        TEST_ASSERT_EQUAL(255 << 8, trace[i][0]);
+        TEST_ASSERT_EQUAL(0, trace[i][1]);
+    }
+
+    /**< Smoothstep: symmetric around the middle and monotonic */
+    size = test_timeline_compile(g_test_ease, 1, 1, timeline, sizeof(timeline));
+    TEST_ASSERT_EQUAL(ESP_OK, led_timeline_render(timeline, size, NULL, 10, trace[0], TEST_STEP_NUM));
+    TEST_ASSERT_UINT32_WITHIN(16, (255 << 8) / 2, trace[49][0]);
+
+    for (int i = 1; i < TEST_STEP_NUM; i++) {
+        TEST_ASSERT_GREATER_OR_EQUAL(trace[i - 1][0], trace[i][0]);
+    }
+
+    TEST_ASSERT_UINT32_WITHIN(16, (255 << 8) - trace[19][0], trace[79][0]);
+}
+
+TEST_CASE("led_timeline played by the tick matches the simulator", "[led_timeline]")
+{
+    iot_led_handle_t led = test_led_create();
+    uint8_t timeline[LED_TIMELINE_SIZE(TEST_CHANNEL_NUM, 3)];
+    static uint16_t trace[TEST_STEP_NUM][TEST_CHANNEL_NUM];
+    size_t size = test_timeline_compile(g_test_keyframes, 3, 1, timeline, sizeof(timeline));
+
+    TEST_ASSERT_EQUAL(ESP_OK, led_timeline_render(timeline, size, NULL, DUTY_SET_CYCLE, trace[0], TEST_STEP_NUM));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_reset_stats());
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_timeline_start(led, timeline, size));
+    memset(timeline, 0, sizeof(timeline));
+
+    /**< Sample the channels every 10 ticks, all of them step in the same tick */
+    vTaskDelay(pdMS_TO_TICKS(DUTY_SET_CYCLE / 2));
+
+    for (int i = 0; i < 60; i += 10) {
+        for (int ch = 0; ch < TEST_CHANNEL_NUM; ch++) {
+            uint32_t duty = 0;
+            TEST_ASSERT_EQUAL(ESP_OK, iot_led_value_to_duty(led, trace[i][ch], &duty));
+            TEST_ASSERT_EQUAL(duty, ledc_get_duty(LEDC_LOW_SPEED_MODE, ch));
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(10 * DUTY_SET_CYCLE));
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(5 * DUTY_SET_CYCLE));
+
+    /**< The tick stops with the timeline, one update per channel and tick */
+    iot_led_stats_t stats = {0};
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_get_stats(&stats));
+    printf("timeline of 1200 ms: %u ticks, %u cycles per tick\n", (unsigned)stats.tick_count,
+           (unsigned)(stats.tick_cycles / stats.tick_count));
+    TEST_ASSERT_UINT32_WITHIN(2, 60, stats.tick_count);
+    TEST_ASSERT_EQUAL(TEST_CHANNEL_NUM * 60, stats.channel_updates);
+
+    uint8_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_get(led, 0, &value));
+    TEST_ASSERT_EQUAL(255, value);
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_delete(led));
+}
+
+TEST_CASE("led_timeline channel set detaches the channel", "[led_timeline]")
+{
+    iot_led_handle_t led = test_led_create();
+    uint8_t timeline[LED_TIMELINE_SIZE(TEST_CHANNEL_NUM, 3)];
+    size_t size = test_timeline_compile(g_test_keyframes, 3, 0, timeline, sizeof(timeline));
+    uint8_t value = 0;
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_timeline_start(led, timeline, size));
+    vTaskDelay(pdMS_TO_TICKS(5 * DUTY_SET_CYCLE));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_set(led, 2, 77, 0));
+    vTaskDelay(pdMS_TO_TICKS(20 * DUTY_SET_CYCLE));
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_get(led, 2, &value));
+    TEST_ASSERT_EQUAL(77, value);
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_get(led, 0, &value));
+    TEST_ASSERT_GREATER_THAN(0, value);
+
+    /**< Stopping keeps the current values */
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_timeline_stop(led));
+    vTaskDelay(pdMS_TO_TICKS(DUTY_SET_CYCLE));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_get(led, 0, &value));
+    uint8_t stopped = value;
+    vTaskDelay(pdMS_TO_TICKS(10 * DUTY_SET_CYCLE));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_channel_get(led, 0, &value));
+    TEST_ASSERT_EQUAL(stopped, value);
+
+    TEST_ASSERT_EQUAL(ESP_OK, iot_led_delete(led));
+}
@@ -0,0 +1,188 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stdio.h"
+#include "math.h"
+#include "esp_cpu.h"
+#include "unity.h"
+#include "light_color.h"
+
+/**< Every 8-bit RGB color on the host, a subset on the chip to keep the test short */
+#ifdef CONFIG_IDF_TARGET_LINUX
+#define TEST_RGB_STEP     1
+#else
+#define TEST_RGB_STEP     5
+#endif
+
+#define BENCH_COLOR_NUM   256
+#define BENCH_ROUNDS      200
+
+static void test_hsv2rgb_ref(double hue, double saturation, double value, double rgb[3])
+{
+    double h = fmod(hue, 360.0) / 60.0;
+    int sector = (int)h;
+    double f = h - sector;
+    double p = value * (1 - saturation);
+    double q = value * (1 - saturation * f);
+    double t = value * (1 - saturation * (1 - f));
+
+    const double level[6][3] = {
+        {value, t, p}, {q, value, p}, {p, value, t}, {p, q, value}, {t, p, value}, {value, p, q},
+    };
+
+    rgb[0] = level[sector][0];
+    rgb[1] = level[sector][1];
+    rgb[2] = level[sector][2];
+}
+
+static void test_rgb2hsv_ref(double red, double green, double blue, double *hue, double *saturation)
+{
+    double max = fmax(red, fmax(green, blue));
+    double delta = max - fmin(red, fmin(green, blue));
+
+    *hue = 0;
+    *saturation = (max > 0) ? delta / max : 0;
+
+    if (delta == 0) {
+        return;
+    } else if (red == max) {
+        *hue = 60 * (green - blue) / delta;
+    } else if (green == max) {
+        *hue = 60 * (2 + (blue - red) / delta);
+    } else {
+        *hue = 60 * (4 + (red - green) / delta);
+    }
+
+    if (*hue < 0) {
+        *hue += 360;
+    }
+}
+
+TEST_CASE("light_color hsv2rgb matches a double reference", "[light_color]")
+{
+    const uint16_t levels[] = {0, 1, 257, 4096, 32768, 49151, 65534, LIGHT_COLOR_MAX};
+    double max_error = 0;
+
+    for (uint32_t hue = 0; hue < LIGHT_COLOR_HUE_MAX; hue++) {
+        for (int s = 0; s < sizeof(levels) / sizeof(levels[0]); s++) {
+            for (int v = 0; v < sizeof(levels) / sizeof(levels[0]); v++) {
+                const light_hsv_t hsv = {hue, levels[s], levels[v]};
+                light_rgb_t rgb;
+                double ref[3];
+
+                light_color_hsv2rgb(&hsv, &rgb);
+                test_hsv2rgb_ref(hue * 360.0 / LIGHT_COLOR_HUE_MAX, (double)levels[s] / LIGHT_COLOR_MAX,
+                                 (double)levels[v] / LIGHT_COLOR_MAX, ref);
+
+                max_error = fmax(max_error, fabs(rgb.red - ref[0] * LIGHT_COLOR_MAX));
+                max_error = fmax(max_error, fabs(rgb.green - ref[1] * LIGHT_COLOR_MAX));
+                max_error = fmax(max_error, fabs(rgb.blue - ref[2] * LIGHT_COLOR_MAX));
+            }
+        }
+    }
+
+    printf("hsv2rgb: max error %.2f / %u\n", max_error, LIGHT_COLOR_MAX);
+    TEST_ASSERT_LESS_OR_EQUAL(2, max_error);
+}
+
+TEST_CASE("light_color rgb round trip is exact at 8 bits", "[light_color]")
+{
+    double max_hue_error = 0, max_saturation_error = 0;
+
+    for (int red = 0; red < 256; red += TEST_RGB_STEP) {
+        for (int green = 0; green < 256; green += TEST_RGB_STEP) {
+            for (int blue = 0; blue < 256; blue += TEST_RGB_STEP) {
+                const light_rgb_t rgb = {red * 257, green * 257, blue * 257};
+                light_hsv_t hsv;
+                light_rgb_t out;
+                double hue, saturation;
+
+                light_color_rgb2hsv(&rgb, &hsv);
+                light_color_hsv2rgb(&hsv, &out);
+
+                TEST_ASSERT_EQUAL(red, light_color_scale(out.red, 255));
+                TEST_ASSERT_EQUAL(green, light_color_scale(out.green, 255));
+                TEST_ASSERT_EQUAL(blue, light_color_scale(out.blue, 255));
+
+                test_rgb2hsv_ref(red, green, blue, &hue, &saturation);
+                double hue_error = fabs(hsv.hue * 360.0 / LIGHT_COLOR_HUE_MAX - hue);
+                max_hue_error = fmax(max_hue_error, fmin(hue_error, 360 - hue_error));
+                max_saturation_error = fmax(max_saturation_error, fabs(hsv.saturation - saturation * LIGHT_COLOR_MAX));
+            }
+        }
+    }
+
+    printf("rgb2hsv: max hue error %.4f degree, max saturation error %.2f / %u\n",
+           max_hue_error, max_saturation_error, LIGHT_COLOR_MAX);
+    TEST_ASSERT_LESS_OR_EQUAL(0.01, max_hue_error);
+    TEST_ASSERT_LESS_OR_EQUAL(0.5, max_saturation_error);
+}
+
+TEST_CASE("light_color ctb2wc keeps the warm and cold split", "[light_color]")
+{
+    for (int ct = 0; ct <= 100; ct++) {
+        for (int br = 0; br <= 100; br++) {
+            const light_ctb_t ctb = {LIGHT_COLOR_FROM_PERCENT(ct), LIGHT_COLOR_FROM_PERCENT(br)};
+            light_wc_t wc;
+            light_color_ctb2wc(&ctb, &wc);
+
+            double warm = ct * br / 100.0, cold = (100 - ct) * br / 100.0;
+            warm = (warm < 15) ? warm : 14 + warm * 0.86;
+            cold = (cold < 15) ? cold : 14 + cold * 0.86;
+
+            TEST_ASSERT_FLOAT_WITHIN(2, warm * LIGHT_COLOR_MAX / 100, wc.warm);
+            TEST_ASSERT_FLOAT_WITHIN(2, cold * LIGHT_COLOR_MAX / 100, wc.cold);
+        }
+    }
+
+    const light_ctb_t full = {LIGHT_COLOR_MAX, LIGHT_COLOR_MAX};
+    light_wc_t wc;
+    TEST_ASSERT_EQUAL(ESP_OK, light_color_convert_n(LIGHT_COLOR_CTB2WC, &full, &wc, 1));
+    TEST_ASSERT_EQUAL(LIGHT_COLOR_MAX, wc.warm);
+    TEST_ASSERT_EQUAL(0, wc.cold);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, light_color_convert_n(LIGHT_COLOR_CTB2WC + 1, &full, &wc, 1));
+}
+
+TEST_CASE("light_color conversion cost", "[light_color][bench]")
+{
+    static light_hsv_t hsv[BENCH_COLOR_NUM];
+    static light_rgb_t rgb[BENCH_COLOR_NUM];
+    uint32_t r = 1;
+
+    for (int i = 0; i < BENCH_COLOR_NUM; i++) {
+        r = r * 1103515245 + 12345;
+        hsv[i].hue        = (r >> 8) % LIGHT_COLOR_HUE_MAX;
+        hsv[i].saturation = r >> 16;
+        hsv[i].value      = r;
+    }
+
+    uint32_t start = esp_cpu_get_cycle_count();
+
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        light_color_convert_n(LIGHT_COLOR_HSV2RGB, hsv, rgb, BENCH_COLOR_NUM);
+    }
+
+    uint32_t hsv2rgb_cycles = esp_cpu_get_cycle_count() - start;
+    start = esp_cpu_get_cycle_count();
+
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        light_color_convert_n(LIGHT_COLOR_RGB2HSV, rgb, hsv, BENCH_COLOR_NUM);
+    }
+
+    uint32_t rgb2hsv_cycles = esp_cpu_get_cycle_count() - start;
+
+    printf("hsv2rgb: %u cycles per color, rgb2hsv: %u cycles per color\n",
+           (unsigned)(hsv2rgb_cycles / (BENCH_ROUNDS * BENCH_COLOR_NUM)),
+           (unsigned)(rgb2hsv_cycles / (BENCH_ROUNDS * BENCH_COLOR_NUM)));
+}
@@ -0,0 +1,209 @@
+/*
+ * ADC1 of the ESP32-C3, reading one raw value per channel, see host_adc_set_raw().
+ * The oneshot reads block for the conversion time, the continuous driver fills its
+ * pool at the sample frequency in the background like the DMA, so reading it costs
+ * nothing.
+ * No calibration: the drivers fall back to the raw values.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_continuous.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "soc/soc_caps.h"
+#include "host_adc.h"
+
+#define ADC_ONESHOT_CONVERSION_US   20
+#define ADC_PATTERN_MAX             8
+
+/* One level per channel, a ladder of buttons pressed or not */
+static int g_adc_raw[ADC_CHANNEL_9 + 1] = {200, 700, 1100, 1500, 1900, 2300, 2700, 3100, 0, 0};
+
+struct adc_oneshot_unit_ctx_t {
+    adc_unit_t unit_id;
+};
+
+struct adc_continuous_ctx_t {
+    uint32_t                  frame_size;
+    uint32_t                  pool_size;
+    adc_digi_pattern_config_t pattern[ADC_PATTERN_MAX];
+    uint32_t                  pattern_num;
+    uint32_t                  pattern_idx;
+    uint32_t                  sample_freq_hz;
+    bool                      started;
+    int64_t                   since_us;     /**< Of the samples not counted yet */
+    uint64_t                  samples;      /**< In the pool */
+};
+
+void host_adc_set_raw(adc_channel_t channel, int raw)
+{
+    __atomic_store_n(&g_adc_raw[channel], raw, __ATOMIC_RELAXED);
+}
+
+esp_err_t adc_oneshot_new_unit(const adc_oneshot_unit_init_cfg_t *init_config, adc_oneshot_unit_handle_t *ret_unit)
+{
+    if (!init_config || !ret_unit) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *ret_unit = calloc(1, sizeof(struct adc_oneshot_unit_ctx_t));
+
+    if (!*ret_unit) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    (*ret_unit)->unit_id = init_config->unit_id;
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_config_channel(adc_oneshot_unit_handle_t handle, adc_channel_t channel,
+                                     const adc_oneshot_chan_cfg_t *config)
+{
+    return handle && config && channel <= ADC_CHANNEL_9 ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t adc_oneshot_read(adc_oneshot_unit_handle_t handle, adc_channel_t chan, int *out_raw)
+{
+    if (!handle || !out_raw || chan > ADC_CHANNEL_9) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_rom_delay_us(ADC_ONESHOT_CONVERSION_US);
+    *out_raw = __atomic_load_n(&g_adc_raw[chan], __ATOMIC_RELAXED);
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_del_unit(adc_oneshot_unit_handle_t handle)
+{
+    free(handle);
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t *hdl_config, adc_continuous_handle_t *ret_handle)
+{
+    if (!hdl_config || !ret_handle || hdl_config->conv_frame_size % SOC_ADC_DIGI_RESULT_BYTES ||
+            hdl_config->max_store_buf_size < hdl_config->conv_frame_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *ret_handle = calloc(1, sizeof(struct adc_continuous_ctx_t));
+
+    if (!*ret_handle) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    (*ret_handle)->frame_size = hdl_config->conv_frame_size;
+    (*ret_handle)->pool_size = hdl_config->max_store_buf_size;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_config(adc_continuous_handle_t handle, const adc_continuous_config_t *config)
+{
+    if (!handle || !config || !config->pattern_num || config->pattern_num > ADC_PATTERN_MAX ||
+            config->sample_freq_hz < SOC_ADC_SAMPLE_FREQ_THRES_LOW ||
+            config->sample_freq_hz > SOC_ADC_SAMPLE_FREQ_THRES_HIGH ||
+            config->format != ADC_DIGI_OUTPUT_FORMAT_TYPE2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (handle->started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    memcpy(handle->pattern, config->adc_pattern, config->pattern_num * sizeof(adc_digi_pattern_config_t));
+    handle->pattern_num = config->pattern_num;
+    handle->sample_freq_hz = config->sample_freq_hz;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_start(adc_continuous_handle_t handle)
+{
+    if (!handle->pattern_num || handle->started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    handle->started = true;
+    handle->since_us = esp_timer_get_time();
+    handle->samples = 0;
+    handle->pattern_idx = 0;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_stop(adc_continuous_handle_t handle)
+{
+    if (!handle->started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    handle->started = false;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_deinit(adc_continuous_handle_t handle)
+{
+    if (handle->started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    free(handle);
+    return ESP_OK;
+}
+
+/**
+ * One frame at most, the samples beyond the pool are lost like when the DMA overflows
+ */
+esp_err_t adc_continuous_read(adc_continuous_handle_t handle, uint8_t *buf, uint32_t length_max,
+                              uint32_t *out_length, uint32_t timeout_ms)
+{
+    if (!handle->started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int64_t now = esp_timer_get_time();
+    uint64_t produced = (uint64_t)(now - handle->since_us) * handle->sample_freq_hz / 1000000;
+    uint64_t pool = handle->pool_size / SOC_ADC_DIGI_RESULT_BYTES;
+    uint32_t frame = (length_max < handle->frame_size ? length_max : handle->frame_size) / SOC_ADC_DIGI_RESULT_BYTES;
+
+    /**< keep the remainder of a sample for the next read */
+    handle->since_us += (int64_t)(produced * 1000000 / handle->sample_freq_hz);
+    handle->samples = handle->samples + produced < pool ? handle->samples + produced : pool;
+
+    if (!frame || handle->samples < frame) {
+        *out_length = 0;
+        return ESP_ERR_TIMEOUT;
+    }
+
+    for (uint32_t i = 0; i < frame; i++) {
+        const adc_digi_pattern_config_t *pattern = &handle->pattern[handle->pattern_idx];
+        adc_digi_output_data_t data = {0};
+
+        data.type2.channel = pattern->channel;
+        data.type2.unit = pattern->unit;
+        data.type2.data = __atomic_load_n(&g_adc_raw[pattern->channel], __ATOMIC_RELAXED);
+        memcpy(buf + i * SOC_ADC_DIGI_RESULT_BYTES, &data, SOC_ADC_DIGI_RESULT_BYTES);
+        handle->pattern_idx = (handle->pattern_idx + 1) % handle->pattern_num;
+    }
+
+    handle->samples -= frame;
+    *out_length = frame * SOC_ADC_DIGI_RESULT_BYTES;
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_create_scheme_curve_fitting(const adc_cali_curve_fitting_config_t *config,
+                                               adc_cali_handle_t *ret_handle)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t adc_cali_delete_scheme_curve_fitting(adc_cali_handle_t handle)
+{
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t handle, int raw, int *voltage)
+{
+    return ESP_ERR_INVALID_ARG;
+}
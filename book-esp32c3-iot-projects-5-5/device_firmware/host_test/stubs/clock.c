@@ -0,0 +1,128 @@
+/*
+ * A simulated clock: time only moves once every task is blocked, straight to the
+ * earliest deadline. A trace of minutes replays in milliseconds, and always the
+ * same way whatever the load of the machine running the tests. The work between
+ * two blocks takes no time, a cost is modelled with esp_rom_delay_us().
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "host_kernel.h"
+
+static int64_t g_now_us;
+static int g_running = 1;     /**< Tasks not blocked, the main one to begin with */
+
+int64_t esp_timer_get_time(void)
+{
+    return __atomic_load_n(&g_now_us, __ATOMIC_RELAXED);
+}
+
+static void host_clock_schedule(void)
+{
+    while (!g_running) {
+        host_task_t *next = NULL;
+
+        for (host_task_t *task = g_host_tasks; task; task = task->next) {
+            if (task->blocked && task->deadline_us != HOST_FOREVER &&
+                    (!next || task->deadline_us < next->deadline_us)) {
+                next = task;
+            }
+        }
+
+        if (!next) {
+            fprintf(stderr, "Every task is blocked for ever:");
+
+            for (host_task_t *task = g_host_tasks; task; task = task->next) {
+                fprintf(stderr, " %s", task->name);
+            }
+
+            fprintf(stderr, "\n");
+            abort();
+        }
+
+        if (next->deadline_us > g_now_us) {
+            __atomic_store_n(&g_now_us, next->deadline_us, __ATOMIC_RELAXED);
+        }
+
+        next->blocked = false;
+        g_running++;
+        pthread_cond_signal(&next->cond);
+    }
+}
+
+void host_clock_block(host_task_t *self, int64_t deadline_us)
+{
+    self->woken = false;
+
+    if (self->deleted) {
+        return;
+    }
+
+    self->deadline_us = deadline_us;
+    self->blocked = true;
+    g_running--;
+    host_clock_schedule();
+
+    while (self->blocked) {
+        pthread_cond_wait(&self->cond, &g_host_lock);
+    }
+
+    self->deadline_us = HOST_FOREVER;
+}
+
+void host_clock_wake(host_task_t *task)
+{
+    task->woken = true;
+
+    if (task->blocked) {
+        task->blocked = false;
+        g_running++;
+        pthread_cond_signal(&task->cond);
+    }
+}
+
+void host_clock_task_start(host_task_t *task)
+{
+    g_running++;
+}
+
+void host_clock_task_exit(host_task_t *task)
+{
+    g_running--;
+    host_clock_schedule();
+}
+
+void host_clock_delay_us(uint32_t us)
+{
+    host_task_t *self = host_task_self();
+
+    pthread_mutex_lock(&g_host_lock);
+    int64_t end_us = g_now_us + us;
+
+    while (!self->deleted && g_now_us < end_us) {
+        host_clock_block(self, end_us);
+    }
+
+    pthread_mutex_unlock(&g_host_lock);
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+    host_clock_delay_us(us);
+}
+
+/**
+ * The exception to the simulated clock: a cycle count for the benchmarks of the
+ * components, from the CPU time of the thread, as if the host ran at 160 MHz
+ */
+uint32_t esp_cpu_get_cycle_count(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint32_t)(((int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec) * 160 / 1000);
+}
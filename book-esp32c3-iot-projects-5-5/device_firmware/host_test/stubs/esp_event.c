@@ -0,0 +1,171 @@
+/*
+ * The default event loop: the events are copied to a queue and the handlers run
+ * one event at a time from the "sys_evt" task, like on the chip. The loop is never
+ * deleted.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_event.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#define EVENT_QUEUE_SIZE        32      /**< CONFIG_ESP_SYSTEM_EVENT_QUEUE_SIZE */
+#define EVENT_TASK_PRIORITY     20
+#define EVENT_TASK_STACK_SIZE   2304
+#define EVENT_HANDLER_MAX       16
+
+typedef struct {
+    esp_event_base_t base;
+    int32_t          id;
+    void            *data;
+} event_t;
+
+typedef struct {
+    esp_event_base_t    base;
+    int32_t             id;
+    esp_event_handler_t handler;
+    void               *arg;
+} event_handler_t;
+
+static event_t g_events[EVENT_QUEUE_SIZE];
+static uint32_t g_event_head;
+static uint32_t g_event_tail;
+static event_handler_t g_handlers[EVENT_HANDLER_MAX];
+static SemaphoreHandle_t g_event_lock;
+static SemaphoreHandle_t g_event_count;
+static portMUX_TYPE g_event_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void event_loop_task(void *arg)
+{
+    for (;;) {
+        xSemaphoreTake(g_event_count, portMAX_DELAY);
+
+        portENTER_CRITICAL(&g_event_mux);
+        event_t event = g_events[g_event_tail++ % EVENT_QUEUE_SIZE];
+        portEXIT_CRITICAL(&g_event_mux);
+
+        xSemaphoreTake(g_event_lock, portMAX_DELAY);
+        event_handler_t handlers[EVENT_HANDLER_MAX];
+        memcpy(handlers, g_handlers, sizeof(handlers));
+        xSemaphoreGive(g_event_lock);
+
+        for (int i = 0; i < EVENT_HANDLER_MAX; i++) {
+            if (handlers[i].handler &&
+                    (handlers[i].base == ESP_EVENT_ANY_BASE || handlers[i].base == event.base) &&
+                    (handlers[i].id == ESP_EVENT_ANY_ID || handlers[i].id == event.id)) {
+                handlers[i].handler(handlers[i].arg, event.base, event.id, event.data);
+            }
+        }
+
+        free(event.data);
+    }
+}
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    if (g_event_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    g_event_lock = xSemaphoreCreateMutex();
+    g_event_count = xSemaphoreCreateCounting(EVENT_QUEUE_SIZE, 0);
+
+    if (!g_event_lock || !g_event_count ||
+            xTaskCreate(event_loop_task, "sys_evt", EVENT_TASK_STACK_SIZE, NULL, EVENT_TASK_PRIORITY, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id,
+                                     esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    esp_err_t ret = ESP_ERR_NO_MEM;
+
+    if (!g_event_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (!event_handler) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(g_event_lock, portMAX_DELAY);
+
+    for (int i = 0; i < EVENT_HANDLER_MAX; i++) {
+        if (!g_handlers[i].handler) {
+            g_handlers[i] = (event_handler_t) {
+                event_base, event_id, event_handler, event_handler_arg,
+            };
+            ret = ESP_OK;
+            break;
+        }
+    }
+
+    xSemaphoreGive(g_event_lock);
+    return ret;
+}
+
+esp_err_t esp_event_handler_unregister(esp_event_base_t event_base, int32_t event_id,
+                                       esp_event_handler_t event_handler)
+{
+    if (!g_event_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(g_event_lock, portMAX_DELAY);
+
+    for (int i = 0; i < EVENT_HANDLER_MAX; i++) {
+        if (g_handlers[i].handler == event_handler && g_handlers[i].base == event_base &&
+                g_handlers[i].id == event_id) {
+            memset(&g_handlers[i], 0, sizeof(event_handler_t));
+        }
+    }
+
+    xSemaphoreGive(g_event_lock);
+    return ESP_OK;
+}
+
+/**
+ * Never waits for room in the queue, whatever ticks_to_wait
+ */
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id, const void *event_data,
+                         size_t event_data_size, TickType_t ticks_to_wait)
+{
+    if (!g_event_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    void *data = NULL;
+
+    if (event_data && event_data_size) {
+        data = malloc(event_data_size);
+
+        if (!data) {
+            return ESP_ERR_NO_MEM;
+        }
+
+        memcpy(data, event_data, event_data_size);
+    }
+
+    portENTER_CRITICAL(&g_event_mux);
+    bool full = g_event_head - g_event_tail >= EVENT_QUEUE_SIZE;
+
+    if (!full) {
+        g_events[g_event_head++ % EVENT_QUEUE_SIZE] = (event_t) {
+            event_base, event_id, data,
+        };
+    }
+
+    portEXIT_CRITICAL(&g_event_mux);
+
+    if (full) {
+        free(data);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    xSemaphoreGive(g_event_count);
+    return ESP_OK;
+}
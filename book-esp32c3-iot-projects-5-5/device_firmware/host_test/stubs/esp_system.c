@@ -0,0 +1,36 @@
+/*
+ * The shutdown handlers are kept, esp_restart() is not there to run them
+ */
+#include "esp_system.h"
+
+#define HOST_SHUTDOWN_HANDLERS_MAX  5
+
+static shutdown_handler_t g_shutdown_handlers[HOST_SHUTDOWN_HANDLERS_MAX];
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler)
+{
+    for (int i = 0; i < HOST_SHUTDOWN_HANDLERS_MAX; i++) {
+        if (g_shutdown_handlers[i] == handler) {
+            return ESP_ERR_INVALID_STATE;
+        }
+
+        if (!g_shutdown_handlers[i]) {
+            g_shutdown_handlers[i] = handler;
+            return ESP_OK;
+        }
+    }
+
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_unregister_shutdown_handler(shutdown_handler_t handler)
+{
+    for (int i = 0; i < HOST_SHUTDOWN_HANDLERS_MAX; i++) {
+        if (g_shutdown_handlers[i] == handler) {
+            g_shutdown_handlers[i] = NULL;
+            return ESP_OK;
+        }
+    }
+
+    return ESP_ERR_INVALID_STATE;
+}
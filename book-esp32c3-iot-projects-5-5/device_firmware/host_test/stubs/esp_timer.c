@@ -0,0 +1,179 @@
+/*
+ * esp_timer on top of the host kernel: the callbacks run one at a time from the
+ * "esp_timer" task
+ */
+#include <stdlib.h>
+
+#include "esp_timer.h"
+#include "host_kernel.h"
+
+struct esp_timer {
+    esp_timer_cb_t    callback;
+    void             *arg;
+    int64_t           due_us;
+    int64_t           period_us;    /**< 0 for a one-shot timer */
+    bool              active;
+    struct esp_timer *next;
+};
+
+static struct esp_timer *g_timers;
+static TaskHandle_t g_timer_task;
+static pthread_once_t g_timer_once = PTHREAD_ONCE_INIT;
+
+static void esp_timer_task(void *arg)
+{
+    host_task_t *self = host_task_self();
+
+    pthread_mutex_lock(&g_host_lock);
+
+    for (;;) {
+        struct esp_timer *due = NULL;
+
+        for (struct esp_timer *timer = g_timers; timer; timer = timer->next) {
+            if (timer->active && (!due || timer->due_us < due->due_us)) {
+                due = timer;
+            }
+        }
+
+        if (due && due->due_us <= esp_timer_get_time()) {
+            esp_timer_cb_t callback = due->callback;
+            void *callback_arg = due->arg;
+
+            if (due->period_us) {
+                due->due_us += due->period_us;
+            } else {
+                due->active = false;
+            }
+
+            pthread_mutex_unlock(&g_host_lock);
+            callback(callback_arg);
+            pthread_mutex_lock(&g_host_lock);
+            continue;
+        }
+
+        host_clock_block(self, due ? due->due_us : HOST_FOREVER);
+    }
+}
+
+static void esp_timer_task_create(void)
+{
+    xTaskCreate(esp_timer_task, "esp_timer", 4096, NULL, 22, &g_timer_task);
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    if (!create_args || !create_args->callback || !out_handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct esp_timer *timer = calloc(1, sizeof(struct esp_timer));
+
+    if (!timer) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    pthread_once(&g_timer_once, esp_timer_task_create);
+    timer->callback = create_args->callback;
+    timer->arg = create_args->arg;
+
+    pthread_mutex_lock(&g_host_lock);
+    timer->next = g_timers;
+    g_timers = timer;
+    pthread_mutex_unlock(&g_host_lock);
+
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t esp_timer_start(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us)
+{
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+
+    pthread_mutex_lock(&g_host_lock);
+
+    if (!timer->active) {
+        timer->due_us = esp_timer_get_time() + timeout_us;
+        timer->period_us = period_us;
+        timer->active = true;
+        host_clock_wake(g_timer_task);
+        ret = ESP_OK;
+    }
+
+    pthread_mutex_unlock(&g_host_lock);
+    return ret;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return esp_timer_start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    return esp_timer_start(timer, period, period);
+}
+
+esp_err_t esp_timer_restart(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+
+    pthread_mutex_lock(&g_host_lock);
+
+    if (timer->active) {
+        timer->due_us = esp_timer_get_time() + timeout_us;
+        timer->period_us = timer->period_us ? timeout_us : 0;
+        host_clock_wake(g_timer_task);
+        ret = ESP_OK;
+    }
+
+    pthread_mutex_unlock(&g_host_lock);
+    return ret;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+
+    pthread_mutex_lock(&g_host_lock);
+
+    if (timer->active) {
+        timer->active = false;
+        ret = ESP_OK;
+    }
+
+    pthread_mutex_unlock(&g_host_lock);
+    return ret;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if (!timer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&g_host_lock);
+
+    if (timer->active) {
+        pthread_mutex_unlock(&g_host_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    for (struct esp_timer **it = &g_timers; *it; it = &(*it)->next) {
+        if (*it == timer) {
+            *it = timer->next;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&g_host_lock);
+    free(timer);
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    pthread_mutex_lock(&g_host_lock);
+    bool active = timer->active;
+    pthread_mutex_unlock(&g_host_lock);
+    return active;
+}
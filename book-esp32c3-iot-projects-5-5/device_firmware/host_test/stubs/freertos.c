@@ -0,0 +1,501 @@
+/*
+ * Tasks, notifications, semaphores and event groups on POSIX threads
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+
+#include "host_kernel.h"
+
+pthread_mutex_t g_host_lock = PTHREAD_MUTEX_INITIALIZER;
+host_task_t *g_host_tasks;
+
+static pthread_mutex_t g_critical_lock;
+static __thread host_task_t *g_self;
+static host_task_t g_main_task = {.name = "main", .priority = 1, .deadline_us = HOST_FOREVER};
+
+__attribute__((constructor)) static void host_kernel_init(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&g_critical_lock, &attr);
+
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&g_main_task.cond, &cond_attr);
+
+    g_main_task.next = g_host_tasks;
+    g_host_tasks = &g_main_task;
+}
+
+void host_enter_critical(portMUX_TYPE *mux)
+{
+    pthread_mutex_lock(&g_critical_lock);
+}
+
+void host_exit_critical(portMUX_TYPE *mux)
+{
+    pthread_mutex_unlock(&g_critical_lock);
+}
+
+host_task_t *host_task_self(void)
+{
+    return g_self ? g_self : &g_main_task;
+}
+
+static void host_list_remove(host_wait_list_t *list, host_task_t *task)
+{
+    for (host_task_t **it = &list->head; *it; it = &(*it)->next_waiter) {
+        if (*it == task) {
+            *it = task->next_waiter;
+            task->next_waiter = NULL;
+            return;
+        }
+    }
+}
+
+static void host_task_exit_locked(host_task_t *self)
+{
+    for (host_task_t **it = &g_host_tasks; *it; it = &(*it)->next) {
+        if (*it == self) {
+            *it = self->next;
+            break;
+        }
+    }
+
+    host_clock_task_exit(self);
+    pthread_mutex_unlock(&g_host_lock);
+    pthread_exit(NULL);
+}
+
+bool host_wait(host_wait_list_t *list, int64_t timeout_us)
+{
+    host_task_t *self = host_task_self();
+    host_task_t **tail = &list->head;
+
+    while (*tail) {
+        tail = &(*tail)->next_waiter;
+    }
+
+    *tail = self;
+    self->next_waiter = NULL;
+    host_clock_block(self, timeout_us == HOST_FOREVER ? HOST_FOREVER : esp_timer_get_time() + timeout_us);
+
+    bool woken = self->woken;
+
+    if (!woken || self->deleted) {
+        host_list_remove(list, self);
+    }
+
+    if (self->deleted) {
+        /**< Hand a wake up meant for the list over to the next task */
+        if (woken) {
+            host_wake_one(list);
+        }
+
+        host_task_exit_locked(self);
+    }
+
+    return woken;
+}
+
+bool host_wake_one(host_wait_list_t *list)
+{
+    host_task_t *task = list->head;
+
+    if (!task) {
+        return false;
+    }
+
+    list->head = task->next_waiter;
+    task->next_waiter = NULL;
+    host_clock_wake(task);
+    return true;
+}
+
+static int64_t host_ticks_to_us(TickType_t ticks)
+{
+    return ticks == portMAX_DELAY ? HOST_FOREVER : (int64_t)ticks * portTICK_PERIOD_MS * 1000;
+}
+
+static void *host_task_entry(void *arg)
+{
+    host_task_t *task = (host_task_t *)arg;
+
+    g_self = task;
+    task->fn(task->arg);
+
+    /**< A FreeRTOS task must not return, vTaskDelete(NULL) like one that does */
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    host_task_t *task = calloc(1, sizeof(host_task_t));
+    pthread_condattr_t cond_attr;
+    pthread_t thread;
+
+    if (!task) {
+        return pdFAIL;
+    }
+
+    strncpy(task->name, name ? name : "", sizeof(task->name) - 1);
+    task->fn = fn;
+    task->arg = arg;
+    task->priority = priority;
+    task->deadline_us = HOST_FOREVER;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&task->cond, &cond_attr);
+
+    pthread_mutex_lock(&g_host_lock);
+    task->next = g_host_tasks;
+    g_host_tasks = task;
+    host_clock_task_start(task);
+
+    if (handle) {
+        *handle = task;
+    }
+
+    if (pthread_create(&thread, NULL, host_task_entry, task)) {
+        fprintf(stderr, "Could not create the task %s\n", task->name);
+        abort();
+    }
+
+    pthread_detach(thread);
+    pthread_mutex_unlock(&g_host_lock);
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    host_task_t *self = host_task_self();
+
+    pthread_mutex_lock(&g_host_lock);
+
+    if (!task || task == self) {
+        host_task_exit_locked(self);
+    }
+
+    /**< It ends the next time it blocks, or now if it is blocked */
+    task->deleted = true;
+
+    if (task->blocked) {
+        host_clock_wake(task);
+    }
+
+    pthread_mutex_unlock(&g_host_lock);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    host_task_t *self = host_task_self();
+
+    pthread_mutex_lock(&g_host_lock);
+    int64_t deadline_us = esp_timer_get_time() + host_ticks_to_us(ticks);
+
+    while (!self->deleted && esp_timer_get_time() < deadline_us) {
+        host_clock_block(self, deadline_us);
+    }
+
+    if (self->deleted) {
+        host_task_exit_locked(self);
+    }
+
+    pthread_mutex_unlock(&g_host_lock);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / (portTICK_PERIOD_MS * 1000));
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+    return (task ? task : host_task_self())->priority;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return host_task_self();
+}
+
+char *pcTaskGetName(TaskHandle_t task)
+{
+    return (task ? task : host_task_self())->name;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&g_host_lock);
+    task->notify++;
+
+    if (task->notify_waiter) {
+        task->notify_waiter = NULL;
+        host_clock_wake(task);
+    }
+
+    pthread_mutex_unlock(&g_host_lock);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken)
+{
+    xTaskNotifyGive(task);
+
+    if (higher_priority_task_woken) {
+        *higher_priority_task_woken = pdFALSE;
+    }
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait)
+{
+    host_task_t *self = host_task_self();
+    host_wait_list_t list = {0};
+
+    pthread_mutex_lock(&g_host_lock);
+
+    if (!self->notify && ticks_to_wait) {
+        self->notify_waiter = self;
+        list.head = self;
+        host_wait(&list, host_ticks_to_us(ticks_to_wait));
+        self->notify_waiter = NULL;
+    }
+
+    uint32_t notify = self->notify;
+
+    if (notify) {
+        self->notify = clear_on_exit ? 0 : notify - 1;
+    }
+
+    pthread_mutex_unlock(&g_host_lock);
+    return notify;
+}
+
+struct host_semaphore {
+    UBaseType_t      count;
+    UBaseType_t      max_count;
+    host_wait_list_t waiters;
+    host_task_t     *holder;        /**< Of a recursive mutex */
+    UBaseType_t      recursion;
+};
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    SemaphoreHandle_t semaphore = calloc(1, sizeof(struct host_semaphore));
+
+    if (semaphore) {
+        semaphore->count = initial_count;
+        semaphore->max_count = max_count;
+    }
+
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+/**< Without priority inheritance, which the tests do not rely on */
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait)
+{
+    pthread_mutex_lock(&g_host_lock);
+    int64_t timeout_us = host_ticks_to_us(ticks_to_wait);
+    int64_t deadline_us = timeout_us == HOST_FOREVER ? HOST_FOREVER : esp_timer_get_time() + timeout_us;
+
+    while (!semaphore->count) {
+        int64_t left_us = deadline_us == HOST_FOREVER ? HOST_FOREVER : deadline_us - esp_timer_get_time();
+
+        if (left_us <= 0 || !host_wait(&semaphore->waiters, left_us)) {
+            break;
+        }
+    }
+
+    BaseType_t ret = semaphore->count ? pdTRUE : pdFALSE;
+
+    if (ret) {
+        semaphore->count--;
+    }
+
+    pthread_mutex_unlock(&g_host_lock);
+    return ret;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    BaseType_t ret = pdFALSE;
+
+    pthread_mutex_lock(&g_host_lock);
+
+    if (semaphore->count < semaphore->max_count) {
+        semaphore->count++;
+        host_wake_one(&semaphore->waiters);
+        ret = pdTRUE;
+    }
+
+    pthread_mutex_unlock(&g_host_lock);
+    return ret;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t *higher_priority_task_woken)
+{
+    if (higher_priority_task_woken) {
+        *higher_priority_task_woken = pdFALSE;
+    }
+
+    return xSemaphoreGive(semaphore);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+    return xSemaphoreCreateMutex();
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait)
+{
+    host_task_t *self = host_task_self();
+
+    pthread_mutex_lock(&g_host_lock);
+    bool held = semaphore->holder == self;
+
+    if (held) {
+        semaphore->recursion++;
+    }
+
+    pthread_mutex_unlock(&g_host_lock);
+
+    if (held) {
+        return pdTRUE;
+    }
+
+    if (!xSemaphoreTake(semaphore, ticks_to_wait)) {
+        return pdFALSE;
+    }
+
+    pthread_mutex_lock(&g_host_lock);
+    semaphore->holder = self;
+    semaphore->recursion = 1;
+    pthread_mutex_unlock(&g_host_lock);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore)
+{
+    pthread_mutex_lock(&g_host_lock);
+
+    if (semaphore->holder != host_task_self()) {
+        pthread_mutex_unlock(&g_host_lock);
+        return pdFALSE;
+    }
+
+    bool released = --semaphore->recursion == 0;
+
+    if (released) {
+        semaphore->holder = NULL;
+    }
+
+    pthread_mutex_unlock(&g_host_lock);
+    return released ? xSemaphoreGive(semaphore) : pdTRUE;
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t semaphore)
+{
+    pthread_mutex_lock(&g_host_lock);
+    UBaseType_t count = semaphore->count;
+    pthread_mutex_unlock(&g_host_lock);
+    return count;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    free(semaphore);
+}
+
+struct host_event_group {
+    EventBits_t      bits;
+    host_wait_list_t waiters;
+};
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    return calloc(1, sizeof(struct host_event_group));
+}
+
+void vEventGroupDelete(EventGroupHandle_t group)
+{
+    free(group);
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    pthread_mutex_lock(&g_host_lock);
+    EventBits_t bits = group->bits;
+    pthread_mutex_unlock(&g_host_lock);
+    return bits;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock(&g_host_lock);
+    group->bits |= bits;
+    EventBits_t ret = group->bits;
+
+    /**< Each waiter checks its own bits */
+    while (host_wake_one(&group->waiters)) {
+    }
+
+    pthread_mutex_unlock(&g_host_lock);
+    return ret;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock(&g_host_lock);
+    EventBits_t ret = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&g_host_lock);
+    return ret;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks_to_wait)
+{
+    pthread_mutex_lock(&g_host_lock);
+    int64_t timeout_us = host_ticks_to_us(ticks_to_wait);
+    int64_t deadline_us = timeout_us == HOST_FOREVER ? HOST_FOREVER : esp_timer_get_time() + timeout_us;
+
+    for (;;) {
+        bool met = wait_for_all ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+        int64_t left_us = deadline_us == HOST_FOREVER ? HOST_FOREVER : deadline_us - esp_timer_get_time();
+
+        if (met || left_us <= 0 || !host_wait(&group->waiters, left_us)) {
+            break;
+        }
+    }
+
+    EventBits_t ret = group->bits;
+    bool met = wait_for_all ? (ret & bits) == bits : (ret & bits) != 0;
+
+    if (met && clear_on_exit) {
+        group->bits &= ~bits;
+    }
+
+    pthread_mutex_unlock(&g_host_lock);
+    return ret;
+}
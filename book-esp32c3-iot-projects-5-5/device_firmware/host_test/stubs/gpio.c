@@ -0,0 +1,215 @@
+/*
+ * GPIO of the ESP32-C3: an INPUT_OUTPUT pin reads back its own level, like the
+ * loopback of the button tests, and a level interrupt fires as long as it is
+ * enabled and its level is on. The handler runs from the task changing the level
+ * or enabling the interrupt, where the interrupt would preempt it on the chip.
+ */
+#include "driver/gpio.h"
+#include "esp_sleep.h"
+#include "freertos/FreeRTOS.h"
+
+typedef struct {
+    bool            output;
+    bool            intr_enabled;
+    uint8_t         level;
+    gpio_int_type_t intr_type;
+    gpio_isr_t      isr_handler;
+    void           *args;
+} host_gpio_t;
+
+static host_gpio_t g_gpio[GPIO_NUM_MAX];
+static bool g_isr_service_installed;
+static portMUX_TYPE g_gpio_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool gpio_intr_active(const host_gpio_t *gpio)
+{
+    return gpio->isr_handler && gpio->intr_enabled &&
+           ((gpio->intr_type == GPIO_INTR_HIGH_LEVEL && gpio->level) ||
+            (gpio->intr_type == GPIO_INTR_LOW_LEVEL && !gpio->level));
+}
+
+/**
+ * The handler has to disable the interrupt or change the level, like on the chip
+ */
+static void gpio_intr_fire(gpio_num_t gpio_num)
+{
+    for (;;) {
+        portENTER_CRITICAL(&g_gpio_lock);
+        host_gpio_t gpio = g_gpio[gpio_num];
+        portEXIT_CRITICAL(&g_gpio_lock);
+
+        if (!gpio_intr_active(&gpio)) {
+            return;
+        }
+
+        gpio.isr_handler(gpio.args);
+    }
+}
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    for (gpio_num_t i = 0; i < GPIO_NUM_MAX; i++) {
+        if (!(config->pin_bit_mask & (1ULL << i))) {
+            continue;
+        }
+
+        portENTER_CRITICAL(&g_gpio_lock);
+        host_gpio_t *gpio = &g_gpio[i];
+        gpio->output = config->mode == GPIO_MODE_OUTPUT || config->mode == GPIO_MODE_INPUT_OUTPUT;
+        gpio->intr_type = config->intr_type;
+        gpio->intr_enabled = config->intr_type != GPIO_INTR_DISABLE;
+
+        /**< a floating input keeps its level */
+        if (!gpio->output && (config->pull_up_en || config->pull_down_en)) {
+            gpio->level = config->pull_up_en == GPIO_PULLUP_ENABLE;
+        }
+
+        portEXIT_CRITICAL(&g_gpio_lock);
+        gpio_intr_fire(i);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&g_gpio_lock);
+    g_gpio[gpio_num].output = mode == GPIO_MODE_OUTPUT || mode == GPIO_MODE_INPUT_OUTPUT;
+    portEXIT_CRITICAL(&g_gpio_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&g_gpio_lock);
+    bool output = g_gpio[gpio_num].output;
+
+    if (output) {
+        g_gpio[gpio_num].level = !!level;
+    }
+
+    portEXIT_CRITICAL(&g_gpio_lock);
+
+    if (output) {
+        gpio_intr_fire(gpio_num);
+    }
+
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+        return 0;
+    }
+
+    portENTER_CRITICAL(&g_gpio_lock);
+    int level = g_gpio[gpio_num].level;
+    portEXIT_CRITICAL(&g_gpio_lock);
+    return level;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&g_gpio_lock);
+    g_gpio[gpio_num].intr_type = intr_type;
+    portEXIT_CRITICAL(&g_gpio_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&g_gpio_lock);
+    g_gpio[gpio_num].intr_enabled = true;
+    portEXIT_CRITICAL(&g_gpio_lock);
+    gpio_intr_fire(gpio_num);
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio_num)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&g_gpio_lock);
+    g_gpio[gpio_num].intr_enabled = false;
+    portEXIT_CRITICAL(&g_gpio_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    portENTER_CRITICAL(&g_gpio_lock);
+    bool installed = g_isr_service_installed;
+    g_isr_service_installed = true;
+    portEXIT_CRITICAL(&g_gpio_lock);
+    return installed ? ESP_ERR_INVALID_STATE : ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&g_gpio_lock);
+    bool installed = g_isr_service_installed;
+
+    if (installed) {
+        g_gpio[gpio_num].isr_handler = isr_handler;
+        g_gpio[gpio_num].args = args;
+    }
+
+    portEXIT_CRITICAL(&g_gpio_lock);
+    return installed ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&g_gpio_lock);
+    g_gpio[gpio_num].isr_handler = NULL;
+    portEXIT_CRITICAL(&g_gpio_lock);
+    return ESP_OK;
+}
+
+/* No light sleep on the host, the wake up sources are only checked */
+esp_err_t gpio_wakeup_enable(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX ||
+            (intr_type != GPIO_INTR_LOW_LEVEL && intr_type != GPIO_INTR_HIGH_LEVEL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_disable(gpio_num_t gpio_num)
+{
+    return gpio_num < 0 || gpio_num >= GPIO_NUM_MAX ? ESP_ERR_INVALID_ARG : ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_gpio_wakeup(void)
+{
+    return ESP_OK;
+}
@@ -0,0 +1,11 @@
+/*
+ * The input of the ADC stub, for the host only cases of host_test/test/
+ */
+#pragma once
+
+#include "hal/adc_types.h"
+
+/**
+ * The raw value read on a channel from now on, what the board would wire to it
+ */
+void host_adc_set_raw(adc_channel_t channel, int raw);
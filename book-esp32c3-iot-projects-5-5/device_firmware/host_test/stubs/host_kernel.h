@@ -0,0 +1,79 @@
+/*
+ * FreeRTOS on POSIX threads, for the host tests.
+ *
+ * Every task is a thread. The kernel state is guarded by one lock, g_host_lock, and
+ * a task blocks on its own condition variable until another one wakes it up or its
+ * deadline passes on the simulated clock of clock.c.
+ */
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define HOST_FOREVER    INT64_MAX
+
+typedef struct host_task {
+    char              name[configMAX_TASK_NAME_LEN];
+    TaskFunction_t    fn;
+    void             *arg;
+    UBaseType_t       priority;
+    pthread_cond_t    cond;
+    bool              blocked;
+    bool              woken;        /**< By another task, since it blocked */
+    bool              deleted;      /**< By vTaskDelete() from another task */
+    int64_t           deadline_us;  /**< Of the block in progress, or HOST_FOREVER */
+    uint32_t          notify;
+    struct host_task *notify_waiter;
+    struct host_task *next_waiter;
+    struct host_task *next;         /**< All the tasks */
+} host_task_t;
+
+/**
+ * FIFO of the tasks blocked on a semaphore, an event group or a notification
+ */
+typedef struct {
+    host_task_t *head;
+} host_wait_list_t;
+
+extern pthread_mutex_t g_host_lock;
+extern host_task_t *g_host_tasks;
+
+host_task_t *host_task_self(void);
+
+/**
+ * With g_host_lock held: block on the list until host_wake_one() or the timeout
+ *
+ * @return false on timeout
+ */
+bool host_wait(host_wait_list_t *list, int64_t timeout_us);
+
+/**
+ * With g_host_lock held: wake the first task of the list up, if any
+ */
+bool host_wake_one(host_wait_list_t *list);
+
+/**
+ * With g_host_lock held: block until another task calls host_clock_wake() or until
+ * the deadline
+ */
+void host_clock_block(host_task_t *self, int64_t deadline_us);
+
+/**
+ * With g_host_lock held: end the block of a task, or the next one
+ */
+void host_clock_wake(host_task_t *task);
+
+/**
+ * With g_host_lock held: a task starts or ends
+ */
+void host_clock_task_start(host_task_t *task);
+void host_clock_task_exit(host_task_t *task);
+
+/**
+ * esp_rom_delay_us(), the other tasks run in the meantime like the interrupts would
+ */
+void host_clock_delay_us(uint32_t us);
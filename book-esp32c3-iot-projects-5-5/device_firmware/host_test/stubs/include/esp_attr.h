@@ -0,0 +1,6 @@
+#pragma once
+
+/* Everything runs from the RAM of the host */
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Cycles of a 160 MHz core, counted on the CPU time of the calling thread, see clock.c */
+uint32_t esp_cpu_get_cycle_count(void);
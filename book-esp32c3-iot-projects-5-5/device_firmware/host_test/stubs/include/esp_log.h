@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdio.h>
+#include "esp_err.h"
+
+int64_t esp_timer_get_time(void);
+
+#define HOST_LOG(letter, tag, format, ...) \
+    printf(#letter " (%lld) %s: " format "\n", (long long)(esp_timer_get_time() / 1000), tag, ##__VA_ARGS__)
+
+#define ESP_LOGE(tag, format, ...) HOST_LOG(E, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) HOST_LOG(W, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) HOST_LOG(I, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) do { if (0) HOST_LOG(D, tag, format, ##__VA_ARGS__); } while (0)
+#define ESP_LOGV(tag, format, ...) do { if (0) HOST_LOG(V, tag, format, ##__VA_ARGS__); } while (0)
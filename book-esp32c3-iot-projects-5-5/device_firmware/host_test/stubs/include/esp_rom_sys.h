@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Takes us of the simulated clock, see clock.c */
+void esp_rom_delay_us(uint32_t us);
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+
+typedef int32_t  BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE                 0
+#define pdTRUE                  1
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+
+/* A 1 ms tick, so pdMS_TO_TICKS() of the tests is exact */
+#define configTICK_RATE_HZ      1000
+#define configMAX_TASK_NAME_LEN 16
+#define portTICK_PERIOD_MS      (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+/* One lock for every critical section, like a single core with the interrupts off */
+typedef struct {
+    int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    {0}
+
+void host_enter_critical(portMUX_TYPE *mux);
+void host_exit_critical(portMUX_TYPE *mux);
+
+#define portENTER_CRITICAL(mux)         host_enter_critical(mux)
+#define portEXIT_CRITICAL(mux)          host_exit_critical(mux)
+#define portENTER_CRITICAL_ISR(mux)     host_enter_critical(mux)
+#define portEXIT_CRITICAL_ISR(mux)      host_exit_critical(mux)
+#define portENTER_CRITICAL_SAFE(mux)    host_enter_critical(mux)
+#define portEXIT_CRITICAL_SAFE(mux)     host_exit_critical(mux)
+#define portYIELD_FROM_ISR(...)         do { } while (0)
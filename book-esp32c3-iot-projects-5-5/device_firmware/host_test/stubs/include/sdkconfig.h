@@ -0,0 +1,2 @@
+/* The Kconfig values of each suite are set in host_test/CMakeLists.txt */
+#pragma once
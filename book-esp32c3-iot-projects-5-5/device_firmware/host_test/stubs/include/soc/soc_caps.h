@@ -0,0 +1,7 @@
+#pragma once
+
+/* The ESP32-C3 values */
+#define SOC_ADC_DIGI_RESULT_BYTES       4
+#define SOC_ADC_DIGI_MAX_BITWIDTH       12
+#define SOC_ADC_SAMPLE_FREQ_THRES_LOW   611
+#define SOC_ADC_SAMPLE_FREQ_THRES_HIGH  83333
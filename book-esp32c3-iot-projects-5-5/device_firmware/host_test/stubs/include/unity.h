@@ -0,0 +1,99 @@
+/*
+ * The part of Unity the component tests use, with the TEST_CASE() registration
+ * of the ESP-IDF unit test app. A failed assertion ends the test case when it
+ * is on the task running the tests, and the program anywhere else.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+void unity_register(const char *name, const char *tags, const char *file, void (*fn)(void));
+void unity_fail(const char *file, int line, const char *message);
+void unity_assert_int(bool ok, const char *file, int line, const char *expression,
+                      long long expected, long long actual);
+
+#define UNITY_CAT_(a, b)    a##b
+#define UNITY_CAT(a, b)     UNITY_CAT_(a, b)
+
+#define TEST_CASE(name, tags) TEST_CASE_(name, tags, UNITY_CAT(unity_test_, __LINE__))
+#define TEST_CASE_(name, tags, fn)                                              \
+    static void fn(void);                                                       \
+    __attribute__((constructor)) static void UNITY_CAT(fn, _register)(void)     \
+    {                                                                           \
+        unity_register(name, tags, __FILE__, fn);                               \
+    }                                                                           \
+    static void fn(void)
+
+#define UNITY_INT(op, expected, actual)                                                       \
+    do {                                                                                      \
+        long long unity_e_ = (long long)(expected), unity_a_ = (long long)(actual);           \
+        unity_assert_int(unity_a_ op unity_e_, __FILE__, __LINE__, #actual " " #op " " #expected, \
+                         unity_e_, unity_a_);                                                 \
+    } while (0)
+
+#define TEST_ASSERT_MESSAGE(condition, message)                                  \
+    do { if (!(condition)) unity_fail(__FILE__, __LINE__, message); } while (0)
+#define TEST_ASSERT(condition)              TEST_ASSERT_MESSAGE(condition, #condition)
+#define TEST_ASSERT_TRUE(condition)         TEST_ASSERT_MESSAGE(condition, "Expected TRUE: " #condition)
+#define TEST_ASSERT_FALSE(condition)        TEST_ASSERT_MESSAGE(!(condition), "Expected FALSE: " #condition)
+#define TEST_ASSERT_NULL(pointer)           TEST_ASSERT_MESSAGE(NULL == (pointer), "Expected NULL: " #pointer)
+#define TEST_ASSERT_NOT_NULL(pointer)       TEST_ASSERT_MESSAGE(NULL != (pointer), "Expected not NULL: " #pointer)
+#define TEST_FAIL_MESSAGE(message)          unity_fail(__FILE__, __LINE__, message)
+#define TEST_FAIL()                         unity_fail(__FILE__, __LINE__, "Failed")
+
+#define TEST_ASSERT_EQUAL(expected, actual)             UNITY_INT(==, expected, actual)
+#define TEST_ASSERT_EQUAL_INT(expected, actual)         UNITY_INT(==, expected, actual)
+#define TEST_ASSERT_EQUAL_INT32(expected, actual)       UNITY_INT(==, expected, actual)
+#define TEST_ASSERT_EQUAL_INT64(expected, actual)       UNITY_INT(==, expected, actual)
+#define TEST_ASSERT_EQUAL_UINT8(expected, actual)       UNITY_INT(==, expected, actual)
+#define TEST_ASSERT_EQUAL_UINT16(expected, actual)      UNITY_INT(==, expected, actual)
+#define TEST_ASSERT_EQUAL_UINT32(expected, actual)      UNITY_INT(==, expected, actual)
+#define TEST_ASSERT_EQUAL_HEX(expected, actual)         UNITY_INT(==, expected, actual)
+#define TEST_ASSERT_EQUAL_HEX32(expected, actual)       UNITY_INT(==, expected, actual)
+#define TEST_ASSERT_NOT_EQUAL(expected, actual)         UNITY_INT(!=, expected, actual)
+#define TEST_ASSERT_EQUAL_PTR(expected, actual)         UNITY_INT(==, (intptr_t)(expected), (intptr_t)(actual))
+#define TEST_ASSERT_EQUAL_MESSAGE(expected, actual, message) \
+    TEST_ASSERT_MESSAGE((long long)(expected) == (long long)(actual), message)
+
+/* Within Unity's default precision, 0.00001 of the expected value */
+#define TEST_ASSERT_EQUAL_FLOAT(expected, actual)                                              \
+    do {                                                                                       \
+        float unity_fe_ = (expected), unity_fa_ = (actual);                                    \
+        float unity_fd_ = unity_fa_ > unity_fe_ ? unity_fa_ - unity_fe_ : unity_fe_ - unity_fa_; \
+        float unity_ft_ = (unity_fe_ < 0 ? -unity_fe_ : unity_fe_) * 0.00001f;                 \
+        TEST_ASSERT_MESSAGE(unity_fa_ == unity_fe_ || unity_fd_ <= unity_ft_,                  \
+                            "Expected " #expected ": " #actual);                               \
+    } while (0)
+
+#define TEST_ASSERT_FLOAT_WITHIN(delta, expected, actual)                                      \
+    do {                                                                                       \
+        float unity_fe_ = (expected), unity_fa_ = (actual);                                    \
+        float unity_fd_ = unity_fa_ > unity_fe_ ? unity_fa_ - unity_fe_ : unity_fe_ - unity_fa_; \
+        TEST_ASSERT_MESSAGE(unity_fd_ <= (delta), #actual " within " #delta " of " #expected);  \
+    } while (0)
+
+#define TEST_ASSERT_GREATER_THAN(threshold, actual)     UNITY_INT(>, threshold, actual)
+#define TEST_ASSERT_GREATER_OR_EQUAL(threshold, actual) UNITY_INT(>=, threshold, actual)
+#define TEST_ASSERT_LESS_THAN(threshold, actual)        UNITY_INT(<, threshold, actual)
+#define TEST_ASSERT_LESS_OR_EQUAL(threshold, actual)    UNITY_INT(<=, threshold, actual)
+#define TEST_ASSERT_LESS_OR_EQUAL_UINT32(threshold, actual) UNITY_INT(<=, threshold, actual)
+
+#define TEST_ASSERT_INT_WITHIN(delta, expected, actual)                                        \
+    do {                                                                                       \
+        long long unity_e_ = (long long)(expected), unity_a_ = (long long)(actual);            \
+        long long unity_d_ = unity_a_ > unity_e_ ? unity_a_ - unity_e_ : unity_e_ - unity_a_;  \
+        unity_assert_int(unity_d_ <= (long long)(delta), __FILE__, __LINE__,                   \
+                         #actual " within " #delta " of " #expected, unity_e_, unity_a_);      \
+    } while (0)
+#define TEST_ASSERT_INT32_WITHIN(delta, expected, actual)   TEST_ASSERT_INT_WITHIN(delta, expected, actual)
+#define TEST_ASSERT_UINT32_WITHIN(delta, expected, actual)  TEST_ASSERT_INT_WITHIN(delta, expected, actual)
+#define TEST_ASSERT_INT64_WITHIN(delta, expected, actual)   TEST_ASSERT_INT_WITHIN(delta, expected, actual)
+
+#define TEST_ASSERT_EQUAL_STRING(expected, actual) \
+    TEST_ASSERT_MESSAGE(!strcmp(expected, actual), "Expected \"" #expected "\"")
+#define TEST_ASSERT_EQUAL_STRING_LEN(expected, actual, len) \
+    TEST_ASSERT_MESSAGE(!strncmp(expected, actual, len), "Expected \"" #expected "\"")
+#define TEST_ASSERT_EQUAL_MEMORY(expected, actual, len) \
+    TEST_ASSERT_MESSAGE(!memcmp(expected, actual, len), "Memory mismatch: " #actual)
@@ -0,0 +1,291 @@
+/*
+ * LEDC: the duty of each channel, and a fade engine on the simulated clock. A fade
+ * moves the duty in a straight line to its target, ledc_get_duty() reads it on the
+ * way, and its end callback runs from the "esp_timer" task like the fade-end
+ * interrupt would.
+ */
+#include <pthread.h>
+#include <stddef.h>
+
+#include "driver/ledc.h"
+#include "esp_timer.h"
+
+typedef struct {
+    bool               configured;
+    uint32_t           duty;
+    uint32_t           next_duty;     /**< Of ledc_set_duty(), until ledc_update_duty() */
+    uint32_t           fade_target;   /**< Of ledc_set_fade_with_time(), until ledc_fade_start() */
+    int64_t            fade_time_us;
+    bool               fading;
+    uint32_t           fade_from;
+    int64_t            fade_start_us;
+    int64_t            fade_us;
+    esp_timer_handle_t fade_timer;
+    ledc_cb_t          fade_cb;
+    void              *fade_cb_arg;
+} host_ledc_channel_t;
+
+static pthread_mutex_t g_ledc_lock = PTHREAD_MUTEX_INITIALIZER;
+static host_ledc_channel_t g_ledc_channels[LEDC_SPEED_MODE_MAX][LEDC_CHANNEL_MAX];
+static bool g_ledc_timer_configured[LEDC_SPEED_MODE_MAX][LEDC_TIMER_MAX];
+static bool g_ledc_fade_installed;
+
+static host_ledc_channel_t *host_ledc_channel(ledc_mode_t speed_mode, ledc_channel_t channel)
+{
+    if (speed_mode >= LEDC_SPEED_MODE_MAX || channel >= LEDC_CHANNEL_MAX) {
+        return NULL;
+    }
+
+    return &g_ledc_channels[speed_mode][channel];
+}
+
+/**
+ * With g_ledc_lock held: the duty now, on the way of a fade
+ */
+static uint32_t host_ledc_duty(const host_ledc_channel_t *ch)
+{
+    int64_t elapsed_us = esp_timer_get_time() - ch->fade_start_us;
+
+    if (!ch->fading) {
+        return ch->duty;
+    } else if (elapsed_us >= ch->fade_us) {
+        return ch->fade_target;
+    }
+
+    return ch->fade_from + (int32_t)(((int64_t)ch->fade_target - ch->fade_from) * elapsed_us / ch->fade_us);
+}
+
+/**
+ * With g_ledc_lock held: freeze the duty where the fade is
+ */
+static void host_ledc_fade_cancel(host_ledc_channel_t *ch)
+{
+    if (ch->fading) {
+        ch->duty = host_ledc_duty(ch);
+        ch->fading = false;
+        esp_timer_stop(ch->fade_timer);
+    }
+}
+
+static void host_ledc_fade_end(void *arg)
+{
+    host_ledc_channel_t *ch = arg;
+    ledc_cb_param_t param = {
+        .event      = LEDC_FADE_END_EVT,
+        .speed_mode = (ch - &g_ledc_channels[0][0]) / LEDC_CHANNEL_MAX,
+        .channel    = (ch - &g_ledc_channels[0][0]) % LEDC_CHANNEL_MAX,
+    };
+
+    pthread_mutex_lock(&g_ledc_lock);
+
+    /**< A fade restarted while this end was dispatched has its own end to come */
+    if (!ch->fading || esp_timer_get_time() < ch->fade_start_us + ch->fade_us) {
+        pthread_mutex_unlock(&g_ledc_lock);
+        return;
+    }
+
+    ch->duty = param.duty = ch->fade_target;
+    ch->fading = false;
+    ledc_cb_t fade_cb = ch->fade_cb;
+    void *fade_cb_arg = ch->fade_cb_arg;
+    pthread_mutex_unlock(&g_ledc_lock);
+
+    if (fade_cb) {
+        fade_cb(&param, fade_cb_arg);
+    }
+}
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t *timer_conf)
+{
+    if (!timer_conf || timer_conf->speed_mode >= LEDC_SPEED_MODE_MAX || timer_conf->timer_num >= LEDC_TIMER_MAX
+            || timer_conf->duty_resolution >= LEDC_TIMER_BIT_MAX || !timer_conf->freq_hz) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&g_ledc_lock);
+    g_ledc_timer_configured[timer_conf->speed_mode][timer_conf->timer_num] = !timer_conf->deconfigure;
+    pthread_mutex_unlock(&g_ledc_lock);
+    return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t *ledc_conf)
+{
+    host_ledc_channel_t *ch = ledc_conf ? host_ledc_channel(ledc_conf->speed_mode, ledc_conf->channel) : NULL;
+
+    if (!ch || ledc_conf->timer_sel >= LEDC_TIMER_MAX || ledc_conf->gpio_num < 0
+            || ledc_conf->gpio_num >= GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&g_ledc_lock);
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+
+    if (g_ledc_timer_configured[ledc_conf->speed_mode][ledc_conf->timer_sel]) {
+        host_ledc_fade_cancel(ch);
+        ch->configured = true;
+        ch->duty = ch->next_duty = ledc_conf->duty;
+        ret = ESP_OK;
+    }
+
+    pthread_mutex_unlock(&g_ledc_lock);
+    return ret;
+}
+
+esp_err_t ledc_set_duty(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t duty)
+{
+    host_ledc_channel_t *ch = host_ledc_channel(speed_mode, channel);
+
+    if (!ch) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&g_ledc_lock);
+    ch->next_duty = duty;
+    pthread_mutex_unlock(&g_ledc_lock);
+    return ESP_OK;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t speed_mode, ledc_channel_t channel)
+{
+    host_ledc_channel_t *ch = host_ledc_channel(speed_mode, channel);
+
+    if (!ch) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&g_ledc_lock);
+    host_ledc_fade_cancel(ch);
+    ch->duty = ch->next_duty;
+    pthread_mutex_unlock(&g_ledc_lock);
+    return ESP_OK;
+}
+
+uint32_t ledc_get_duty(ledc_mode_t speed_mode, ledc_channel_t channel)
+{
+    host_ledc_channel_t *ch = host_ledc_channel(speed_mode, channel);
+
+    if (!ch) {
+        return UINT32_MAX;
+    }
+
+    pthread_mutex_lock(&g_ledc_lock);
+    uint32_t duty = host_ledc_duty(ch);
+    pthread_mutex_unlock(&g_ledc_lock);
+    return duty;
+}
+
+esp_err_t ledc_fade_func_install(int intr_alloc_flags)
+{
+    pthread_mutex_lock(&g_ledc_lock);
+    esp_err_t ret = g_ledc_fade_installed ? ESP_ERR_INVALID_STATE : ESP_OK;
+    g_ledc_fade_installed = true;
+    pthread_mutex_unlock(&g_ledc_lock);
+    return ret;
+}
+
+void ledc_fade_func_uninstall(void)
+{
+    pthread_mutex_lock(&g_ledc_lock);
+
+    for (int mode = 0; mode < LEDC_SPEED_MODE_MAX; mode++) {
+        for (int channel = 0; channel < LEDC_CHANNEL_MAX; channel++) {
+            host_ledc_fade_cancel(&g_ledc_channels[mode][channel]);
+            g_ledc_channels[mode][channel].fade_cb = NULL;
+        }
+    }
+
+    g_ledc_fade_installed = false;
+    pthread_mutex_unlock(&g_ledc_lock);
+}
+
+esp_err_t ledc_set_fade_with_time(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t target_duty,
+                                  int max_fade_time_ms)
+{
+    host_ledc_channel_t *ch = host_ledc_channel(speed_mode, channel);
+
+    if (!ch || max_fade_time_ms < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&g_ledc_lock);
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+
+    if (g_ledc_fade_installed && ch->configured) {
+        ch->fade_target = target_duty;
+        ch->fade_time_us = (int64_t)max_fade_time_ms * 1000;
+        ret = ESP_OK;
+    }
+
+    pthread_mutex_unlock(&g_ledc_lock);
+    return ret;
+}
+
+esp_err_t ledc_fade_start(ledc_mode_t speed_mode, ledc_channel_t channel, ledc_fade_mode_t fade_mode)
+{
+    host_ledc_channel_t *ch = host_ledc_channel(speed_mode, channel);
+
+    /**< Nothing in the components waits for a fade, LEDC_FADE_WAIT_DONE is left out */
+    if (!ch || fade_mode != LEDC_FADE_NO_WAIT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&g_ledc_lock);
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+
+    if (g_ledc_fade_installed && ch->configured) {
+        const esp_timer_create_args_t args = {
+            .callback = host_ledc_fade_end,
+            .arg      = ch,
+            .name     = "ledc_fade",
+        };
+
+        host_ledc_fade_cancel(ch);
+        ret = ch->fade_timer ? ESP_OK : esp_timer_create(&args, &ch->fade_timer);
+    }
+
+    if (ret == ESP_OK) {
+        ch->fade_from = ch->duty;
+        ch->fade_start_us = esp_timer_get_time();
+        ch->fade_us = ch->fade_time_us;
+        ch->fading = true;
+        esp_timer_start_once(ch->fade_timer, ch->fade_us);
+    }
+
+    pthread_mutex_unlock(&g_ledc_lock);
+    return ret;
+}
+
+esp_err_t ledc_fade_stop(ledc_mode_t speed_mode, ledc_channel_t channel)
+{
+    host_ledc_channel_t *ch = host_ledc_channel(speed_mode, channel);
+
+    if (!ch) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&g_ledc_lock);
+    esp_err_t ret = g_ledc_fade_installed ? ESP_OK : ESP_ERR_INVALID_STATE;
+    host_ledc_fade_cancel(ch);
+    pthread_mutex_unlock(&g_ledc_lock);
+    return ret;
+}
+
+esp_err_t ledc_cb_register(ledc_mode_t speed_mode, ledc_channel_t channel, ledc_cbs_t *cbs, void *user_arg)
+{
+    host_ledc_channel_t *ch = host_ledc_channel(speed_mode, channel);
+
+    if (!ch || !cbs) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&g_ledc_lock);
+    esp_err_t ret = g_ledc_fade_installed ? ESP_OK : ESP_ERR_INVALID_STATE;
+
+    if (ret == ESP_OK) {
+        ch->fade_cb = cbs->fade_cb;
+        ch->fade_cb_arg = user_arg;
+    }
+
+    pthread_mutex_unlock(&g_ledc_lock);
+    return ret;
+}
@@ -0,0 +1,240 @@
+/*
+ * NVS in RAM: blobs by namespace and key, for the lifetime of the test program.
+ * Like the real NVS, a value is stored by nvs_set_blob() and nvs_commit() has
+ * nothing left to write.
+ */
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nvs_flash.h"
+
+#define HOST_NVS_ENTRIES_MAX    64
+#define HOST_NVS_HANDLES_MAX    16
+
+typedef struct {
+    char    ns[NVS_KEY_NAME_MAX_SIZE];
+    char    key[NVS_KEY_NAME_MAX_SIZE];
+    void   *value;
+    size_t  length;
+} host_nvs_entry_t;
+
+typedef struct {
+    bool            open;
+    nvs_open_mode_t mode;
+    char            ns[NVS_KEY_NAME_MAX_SIZE];
+} host_nvs_handle_t;
+
+static pthread_mutex_t g_nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+static host_nvs_entry_t g_nvs_entries[HOST_NVS_ENTRIES_MAX];
+static host_nvs_handle_t g_nvs_handles[HOST_NVS_HANDLES_MAX];
+static bool g_nvs_init;
+
+static host_nvs_handle_t *host_nvs_handle(nvs_handle_t handle)
+{
+    if (handle == 0 || handle > HOST_NVS_HANDLES_MAX || !g_nvs_handles[handle - 1].open) {
+        return NULL;
+    }
+
+    return &g_nvs_handles[handle - 1];
+}
+
+static host_nvs_entry_t *host_nvs_find(const char *ns, const char *key)
+{
+    for (int i = 0; i < HOST_NVS_ENTRIES_MAX; i++) {
+        if (g_nvs_entries[i].value && !strcmp(g_nvs_entries[i].ns, ns)
+                && (!key || !strcmp(g_nvs_entries[i].key, key))) {
+            return &g_nvs_entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void host_nvs_drop(host_nvs_entry_t *entry)
+{
+    free(entry->value);
+    memset(entry, 0, sizeof(host_nvs_entry_t));
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    pthread_mutex_lock(&g_nvs_lock);
+    g_nvs_init = true;
+    pthread_mutex_unlock(&g_nvs_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    pthread_mutex_lock(&g_nvs_lock);
+
+    for (int i = 0; i < HOST_NVS_ENTRIES_MAX; i++) {
+        host_nvs_drop(&g_nvs_entries[i]);
+    }
+
+    pthread_mutex_unlock(&g_nvs_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    esp_err_t ret = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+
+    if (strlen(name) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+
+    pthread_mutex_lock(&g_nvs_lock);
+
+    if (!g_nvs_init) {
+        ret = ESP_ERR_NVS_NOT_INITIALIZED;
+    } else if (open_mode == NVS_READONLY && !host_nvs_find(name, NULL)) {
+        /**< A namespace only exists once something was written to it */
+        ret = ESP_ERR_NVS_NOT_FOUND;
+    } else {
+        for (int i = 0; i < HOST_NVS_HANDLES_MAX; i++) {
+            if (!g_nvs_handles[i].open) {
+                g_nvs_handles[i].open = true;
+                g_nvs_handles[i].mode = open_mode;
+                strcpy(g_nvs_handles[i].ns, name);
+                *out_handle = i + 1;
+                ret = ESP_OK;
+                break;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&g_nvs_lock);
+    return ret;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&g_nvs_lock);
+    host_nvs_handle_t *h = host_nvs_handle(handle);
+
+    if (h) {
+        h->open = false;
+    }
+
+    pthread_mutex_unlock(&g_nvs_lock);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    esp_err_t ret = ESP_OK;
+
+    if (strlen(key) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+
+    pthread_mutex_lock(&g_nvs_lock);
+    host_nvs_handle_t *h = host_nvs_handle(handle);
+    host_nvs_entry_t *entry = h ? host_nvs_find(h->ns, key) : NULL;
+
+    if (!h) {
+        ret = ESP_ERR_NVS_INVALID_HANDLE;
+    } else if (h->mode == NVS_READONLY) {
+        ret = ESP_ERR_NVS_READ_ONLY;
+    } else {
+        for (int i = 0; i < HOST_NVS_ENTRIES_MAX && !entry; i++) {
+            entry = g_nvs_entries[i].value ? NULL : &g_nvs_entries[i];
+        }
+
+        void *copy = malloc(length ? length : 1);
+
+        if (!entry || !copy) {
+            free(copy);
+            ret = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        } else {
+            free(entry->value);
+            memcpy(copy, value, length);
+            strcpy(entry->ns, h->ns);
+            strcpy(entry->key, key);
+            entry->value = copy;
+            entry->length = length;
+        }
+    }
+
+    pthread_mutex_unlock(&g_nvs_lock);
+    return ret;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    esp_err_t ret = ESP_OK;
+
+    pthread_mutex_lock(&g_nvs_lock);
+    host_nvs_handle_t *h = host_nvs_handle(handle);
+    host_nvs_entry_t *entry = h ? host_nvs_find(h->ns, key) : NULL;
+
+    if (!h) {
+        ret = ESP_ERR_NVS_INVALID_HANDLE;
+    } else if (!entry) {
+        ret = ESP_ERR_NVS_NOT_FOUND;
+    } else if (!out_value) {
+        /**< Only the length is asked for */
+        *length = entry->length;
+    } else if (*length < entry->length) {
+        ret = ESP_ERR_NVS_INVALID_LENGTH;
+    } else {
+        memcpy(out_value, entry->value, entry->length);
+        *length = entry->length;
+    }
+
+    pthread_mutex_unlock(&g_nvs_lock);
+    return ret;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    esp_err_t ret = ESP_OK;
+
+    pthread_mutex_lock(&g_nvs_lock);
+    host_nvs_handle_t *h = host_nvs_handle(handle);
+    host_nvs_entry_t *entry = h ? host_nvs_find(h->ns, key) : NULL;
+
+    if (!h) {
+        ret = ESP_ERR_NVS_INVALID_HANDLE;
+    } else if (h->mode == NVS_READONLY) {
+        ret = ESP_ERR_NVS_READ_ONLY;
+    } else if (!entry) {
+        ret = ESP_ERR_NVS_NOT_FOUND;
+    } else {
+        host_nvs_drop(entry);
+    }
+
+    pthread_mutex_unlock(&g_nvs_lock);
+    return ret;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    esp_err_t ret = ESP_OK;
+
+    pthread_mutex_lock(&g_nvs_lock);
+    host_nvs_handle_t *h = host_nvs_handle(handle);
+
+    if (!h) {
+        ret = ESP_ERR_NVS_INVALID_HANDLE;
+    } else if (h->mode == NVS_READONLY) {
+        ret = ESP_ERR_NVS_READ_ONLY;
+    } else {
+        for (host_nvs_entry_t *entry; (entry = host_nvs_find(h->ns, NULL));) {
+            host_nvs_drop(entry);
+        }
+    }
+
+    pthread_mutex_unlock(&g_nvs_lock);
+    return ret;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&g_nvs_lock);
+    esp_err_t ret = host_nvs_handle(handle) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+    pthread_mutex_unlock(&g_nvs_lock);
+    return ret;
+}
@@ -0,0 +1,210 @@
+/*
+ * FreeRTOS software timers on top of the host kernel: the callbacks and the
+ * pended function calls run one at a time from the "Tmr Svc" task
+ */
+#include <stdlib.h>
+
+#include "esp_timer.h"
+#include "freertos/timers.h"
+#include "host_kernel.h"
+
+struct host_timer {
+    TimerCallbackFunction_t callback;
+    void                   *id;
+    TickType_t              period;
+    bool                    auto_reload;
+    bool                    active;
+    int64_t                 due_us;
+    struct host_timer      *next;
+};
+
+typedef struct host_pended_call {
+    PendedFunction_t         fn;
+    void                    *arg1;
+    uint32_t                 arg2;
+    struct host_pended_call *next;
+} host_pended_call_t;
+
+static struct host_timer *g_timers;
+static host_pended_call_t *g_pended_head, *g_pended_tail;
+static TaskHandle_t g_timer_task;
+static pthread_once_t g_timer_once = PTHREAD_ONCE_INIT;
+
+static void host_timer_task(void *arg)
+{
+    host_task_t *self = host_task_self();
+
+    pthread_mutex_lock(&g_host_lock);
+
+    for (;;) {
+        if (g_pended_head) {
+            host_pended_call_t *call = g_pended_head;
+            g_pended_head = call->next;
+            g_pended_tail = g_pended_head ? g_pended_tail : NULL;
+
+            pthread_mutex_unlock(&g_host_lock);
+            call->fn(call->arg1, call->arg2);
+            free(call);
+            pthread_mutex_lock(&g_host_lock);
+            continue;
+        }
+
+        struct host_timer *due = NULL;
+
+        for (struct host_timer *timer = g_timers; timer; timer = timer->next) {
+            if (timer->active && (!due || timer->due_us < due->due_us)) {
+                due = timer;
+            }
+        }
+
+        if (due && due->due_us <= esp_timer_get_time()) {
+            if (due->auto_reload) {
+                due->due_us += (int64_t)due->period * portTICK_PERIOD_MS * 1000;
+            } else {
+                due->active = false;
+            }
+
+            pthread_mutex_unlock(&g_host_lock);
+            due->callback(due);
+            pthread_mutex_lock(&g_host_lock);
+            continue;
+        }
+
+        host_clock_block(self, due ? due->due_us : HOST_FOREVER);
+    }
+}
+
+static void host_timer_task_create(void)
+{
+    xTaskCreate(host_timer_task, "Tmr Svc", 4096, NULL, 1, &g_timer_task);
+}
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t auto_reload, void *id,
+                           TimerCallbackFunction_t callback)
+{
+    if (!period || !callback) {
+        return NULL;
+    }
+
+    struct host_timer *timer = calloc(1, sizeof(struct host_timer));
+
+    if (!timer) {
+        return NULL;
+    }
+
+    pthread_once(&g_timer_once, host_timer_task_create);
+    timer->callback = callback;
+    timer->id = id;
+    timer->period = period;
+    timer->auto_reload = auto_reload;
+
+    pthread_mutex_lock(&g_host_lock);
+    timer->next = g_timers;
+    g_timers = timer;
+    pthread_mutex_unlock(&g_host_lock);
+
+    return timer;
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t ticks_to_wait)
+{
+    if (!period) {
+        return pdFAIL;
+    }
+
+    /**< Like FreeRTOS, a new period starts the timer from now */
+    pthread_mutex_lock(&g_host_lock);
+    timer->period = period;
+    timer->due_us = esp_timer_get_time() + (int64_t)period * portTICK_PERIOD_MS * 1000;
+    timer->active = true;
+    host_clock_wake(g_timer_task);
+    pthread_mutex_unlock(&g_host_lock);
+
+    return pdPASS;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks_to_wait)
+{
+    return xTimerChangePeriod(timer, timer->period, ticks_to_wait);
+}
+
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t ticks_to_wait)
+{
+    return xTimerChangePeriod(timer, timer->period, ticks_to_wait);
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks_to_wait)
+{
+    pthread_mutex_lock(&g_host_lock);
+    timer->active = false;
+    pthread_mutex_unlock(&g_host_lock);
+
+    return pdPASS;
+}
+
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t ticks_to_wait)
+{
+    pthread_mutex_lock(&g_host_lock);
+
+    for (struct host_timer **it = &g_timers; *it; it = &(*it)->next) {
+        if (*it == timer) {
+            *it = timer->next;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&g_host_lock);
+    free(timer);
+    return pdPASS;
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer)
+{
+    pthread_mutex_lock(&g_host_lock);
+    bool active = timer->active;
+    pthread_mutex_unlock(&g_host_lock);
+    return active ? pdTRUE : pdFALSE;
+}
+
+void *pvTimerGetTimerID(TimerHandle_t timer)
+{
+    return timer->id;
+}
+
+BaseType_t xTimerPendFunctionCall(PendedFunction_t fn, void *arg1, uint32_t arg2, TickType_t ticks_to_wait)
+{
+    host_pended_call_t *call = calloc(1, sizeof(host_pended_call_t));
+
+    if (!call) {
+        return pdFAIL;
+    }
+
+    pthread_once(&g_timer_once, host_timer_task_create);
+    call->fn = fn;
+    call->arg1 = arg1;
+    call->arg2 = arg2;
+
+    pthread_mutex_lock(&g_host_lock);
+
+    if (g_pended_tail) {
+        g_pended_tail->next = call;
+    } else {
+        g_pended_head = call;
+    }
+
+    g_pended_tail = call;
+    host_clock_wake(g_timer_task);
+    pthread_mutex_unlock(&g_host_lock);
+
+    return pdPASS;
+}
+
+BaseType_t xTimerPendFunctionCallFromISR(PendedFunction_t fn, void *arg1, uint32_t arg2,
+                                         BaseType_t *higher_priority_task_woken)
+{
+    if (higher_priority_task_woken) {
+        *higher_priority_task_woken = pdFALSE;
+    }
+
+    return xTimerPendFunctionCall(fn, arg1, arg2, 0);
+}
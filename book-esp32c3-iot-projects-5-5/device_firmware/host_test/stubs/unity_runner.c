@@ -0,0 +1,104 @@
+/*
+ * Runs the registered TEST_CASE()s, the way the unit test app of ESP-IDF runs them
+ * from its menu: with no argument, all of them; otherwise the ones whose name is an
+ * argument, or whose tags hold a "[tag]" argument and none of the "![tag]" ones.
+ */
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "unity.h"
+
+#define UNITY_TEST_MAX  64
+
+typedef struct {
+    const char *name;
+    const char *tags;
+    const char *file;
+    void (*fn)(void);
+} unity_test_t;
+
+static unity_test_t g_tests[UNITY_TEST_MAX];
+static int g_test_num;
+static jmp_buf g_test_abort;
+static TaskHandle_t g_test_task;
+
+void unity_register(const char *name, const char *tags, const char *file, void (*fn)(void))
+{
+    if (g_test_num == UNITY_TEST_MAX) {
+        fprintf(stderr, "More than %d test cases\n", UNITY_TEST_MAX);
+        abort();
+    }
+
+    g_tests[g_test_num++] = (unity_test_t) {
+        name, tags, file, fn
+    };
+}
+
+void unity_fail(const char *file, int line, const char *message)
+{
+    printf("%s:%d:FAIL: %s\n", file, line, message);
+    fflush(stdout);
+
+    if (xTaskGetCurrentTaskHandle() != g_test_task) {
+        printf("Failed on the task \"%s\"\n", pcTaskGetName(NULL));
+        exit(1);
+    }
+
+    longjmp(g_test_abort, 1);
+}
+
+void unity_assert_int(bool ok, const char *file, int line, const char *expression,
+                      long long expected, long long actual)
+{
+    if (!ok) {
+        char message[256];
+        snprintf(message, sizeof(message), "%s, expected %lld, was %lld", expression, expected, actual);
+        unity_fail(file, line, message);
+    }
+}
+
+static bool unity_selected(const unity_test_t *test, int argc, char **argv)
+{
+    bool included = argc < 2;
+
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '!' && strstr(test->tags, argv[i] + 1)) {
+            return false;
+        }
+
+        included |= argv[i][0] == '[' ? strstr(test->tags, argv[i]) != NULL : !strcmp(test->name, argv[i]);
+    }
+
+    return included;
+}
+
+int main(int argc, char **argv)
+{
+    int run = 0, failed = 0;
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    g_test_task = xTaskGetCurrentTaskHandle();
+
+    for (int i = 0; i < g_test_num; i++) {
+        if (!unity_selected(&g_tests[i], argc, argv)) {
+            continue;
+        }
+
+        printf("Running %s...\n", g_tests[i].name);
+        run++;
+
+        if (!setjmp(g_test_abort)) {
+            g_tests[i].fn();
+            printf("%s:PASS\n", g_tests[i].name);
+        } else {
+            failed++;
+        }
+    }
+
+    printf("-----------------------\n%d Tests %d Failures 0 Ignored\n%s\n", run, failed, failed ? "FAIL" : "OK");
+    return failed || !run;
+}
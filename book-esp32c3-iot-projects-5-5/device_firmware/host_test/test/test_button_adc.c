@@ -0,0 +1,73 @@
+// Copyright 2020 Espressif Systems (Shanghai) Co. Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stdio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "unity.h"
+#include "button_adc.h"
+#include "host_adc.h"
+
+#define SCAN_MAX        64
+
+static const button_adc_config_t g_low = {
+    .adc_channel = ADC_CHANNEL_0, .button_index = 0, .min = 999, .max = 1000,
+};
+
+static const button_adc_config_t g_high = {
+    .adc_channel = ADC_CHANNEL_0, .button_index = 1, .min = 1002, .max = 1003,
+};
+
+/**
+ * Scans until the button reads pressed, -1 if it never does
+ */
+static int test_scan_until_pressed(const button_adc_config_t *cfg)
+{
+    for (int i = 0; i < SCAN_MAX; i++) {
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_BUTTON_PERIOD_TIME_MS));
+
+        if (button_adc_get_key_level((void *)ADC_BUTTON_COMBINE(cfg->adc_channel, cfg->button_index))) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+TEST_CASE("adc button filter settles on the voltage, rising or falling", "[adc][filter]")
+{
+    host_adc_set_raw(ADC_CHANNEL_0, 1000);
+    TEST_ASSERT_EQUAL(ESP_OK, button_adc_init(&g_low));
+    TEST_ASSERT_EQUAL(ESP_OK, button_adc_init(&g_high));
+
+    /**< seeded with the first sample */
+    TEST_ASSERT_NOT_EQUAL(-1, test_scan_until_pressed(&g_low));
+
+    /**< a step smaller than 2^shift, the last LSB included */
+    host_adc_set_raw(ADC_CHANNEL_0, 1003);
+    TEST_ASSERT_NOT_EQUAL(-1, test_scan_until_pressed(&g_high));
+
+    host_adc_set_raw(ADC_CHANNEL_0, 1000);
+    TEST_ASSERT_NOT_EQUAL(-1, test_scan_until_pressed(&g_low));
+
+    /**< a full swing and back */
+    host_adc_set_raw(ADC_CHANNEL_0, 3000);
+    vTaskDelay(pdMS_TO_TICKS(SCAN_MAX * CONFIG_BUTTON_PERIOD_TIME_MS));
+    host_adc_set_raw(ADC_CHANNEL_0, 1003);
+    TEST_ASSERT_NOT_EQUAL(-1, test_scan_until_pressed(&g_high));
+
+    TEST_ASSERT_EQUAL(ESP_OK, button_adc_deinit(ADC_CHANNEL_0, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, button_adc_deinit(ADC_CHANNEL_0, 1));
+    host_adc_set_raw(ADC_CHANNEL_0, 200);
+}